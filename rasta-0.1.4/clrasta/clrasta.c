@@ -31,9 +31,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
 #include <glib.h>
 
 #ifdef HAVE_READLINE
@@ -44,11 +46,21 @@
 
 
 
+/*
+ * Defines
+ */
+#define CLR_PAGE_LINES 10       /* Choices per page off a terminal */
+#define CLR_PAGE_RESERVED 5     /* Terminal lines kept for the prompt */
+#define CLR_ABANDONED_MAX 16    /* Unfinished list commands left to reap */
+
+
+
 /*
  * Typedefs
  */
 typedef struct _CLROptions      CLROptions;
 typedef struct _CLRMenuItem     CLRMenuItem;
+typedef struct _CLRList         CLRList;
 
 
 
@@ -61,6 +73,8 @@ struct _CLROptions
     gchar *filename;
     gchar *state_filename;
     gchar *fastpath;
+    gchar *trace_filename;
+    gchar *profile_filename;
 };
 
 struct _CLRMenuItem
@@ -69,6 +83,23 @@ struct _CLRMenuItem
     gchar *next_id;
 };
 
+/*
+ * Choices for a list query.  A LISTCOMMAND's output is read only as
+ * far as the user has looked, so the first page shows while the
+ * command is still running.
+ */
+struct _CLRList
+{
+    GPtrArray *items;           /* Lines read so far */
+    GIOChannel *chan;           /* Command output, NULL when complete */
+    gint errfd;
+    pid_t pid;
+    gchar *encoding;
+    gchar *match;               /* Current value to look for */
+    gboolean match_column;      /* Match the first column only */
+    gint selected;              /* Item matching match, or -1 */
+};
+
 
 
 /*
@@ -86,6 +117,9 @@ typedef enum _CLRQueryResult
     CLR_QUERY_MORE,             /* more choices */
     CLR_QUERY_CANCEL,           /* cancel list */
     CLR_QUERY_DONE,             /* done with list */
+    CLR_QUERY_FILTER,           /* filter list, text in query_text */
+    CLR_QUERY_PREV,             /* previous choices */
+    CLR_QUERY_GOTO,             /* go to a choice */
     CLR_QUERY_UNKNOWN           /* unknown response */
 } CLRQueryResult;
 
@@ -100,11 +134,27 @@ typedef enum _CLRQueryFlags
     CLR_QUERY_FLAG_CANCEL = (1<<6),     /* cancel list */
     CLR_QUERY_FLAG_DONE = (1<<7),       /* done with list */
     CLR_QUERY_FLAG_CONT = (1<<8),       /* continue with default */
-    CLR_QUERY_FLAG_HELP = (1<<9)        /* display help text */
+    CLR_QUERY_FLAG_HELP = (1<<9),       /* display help text */
+    CLR_QUERY_FLAG_FILTER = (1<<10),    /* filter list */
+    CLR_QUERY_FLAG_PREV = (1<<11),      /* previous choices */
+    CLR_QUERY_FLAG_GOTO = (1<<12)       /* go to a choice */
 } CLRQueryFlags;
 
 
 
+/*
+ * Globals
+ */
+static gchar *query_text = NULL;  /* Text of the last '/' response */
+#ifdef HAVE_READLINE
+static RastaChoiceIndex *complete_index = NULL;
+static GPtrArray *complete_items = NULL;
+#endif  /* HAVE_READLINE */
+static pid_t abandoned_pids[CLR_ABANDONED_MAX];  /* Reaped on SIGCHLD */
+static gboolean reap_installed = FALSE;
+
+
+
 /*
  * Prototypes
  */
@@ -115,6 +165,10 @@ static RastaContext *load_context(CLROptions *options);
 static gint load_state(RastaContext *ctxt, CLROptions *options);
 static void pretty_print_title(const gchar *title);
 static gchar *clr_readline(const gchar *prompt);
+#ifdef HAVE_READLINE
+static char *clr_complete_choice(const char *text, int state);
+static char **clr_complete_list(const char *text, int start, int end);
+#endif  /* HAVE_READLINE */
 static void pretty_print_choice(guint count, const gchar *text,
                                 gboolean marked);
 static void clr_print_field(const char *text, const gchar *dfault,
@@ -126,14 +180,18 @@ static CLRQueryResult clr_query_response(const gchar *prompt,
                                          int *res_choice,
                                          gint start_choice,
                                          gint end_choice);
-static CLRQueryResult clr_query_list(gchar *valid_choices[],
-                                     guint num_choices,
+static guint clr_page_size();
+static void clr_query_list_load(CLRList *list,
+                                guint count,
+                                GArray *marked,
+                                RastaChoiceIndex *index);
+static CLRQueryResult clr_query_list(CLRList *list,
                                      gboolean multiple,
                                      GList **result);
 static GList *get_menu_items(RastaContext *ctxt, RastaScreen *screen);
-static gchar *get_menu_item_help(RastaContext *ctxt,
-                                 RastaScreen *screen,
-                                 CLRMenuItem *item);
+static const gchar *get_menu_item_help(RastaContext *ctxt,
+                                       RastaScreen *screen,
+                                       CLRMenuItem *item);
 static void free_menu_items(GList *m_items);
 static gboolean run_menu(RastaContext *ctxt, RastaScreen *screen);
 static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen);
@@ -162,8 +220,18 @@ static CLRQueryResult run_dialog_field_file(RastaContext *ctxt,
                                             RastaDialogField *field);
 static gint run_listcommand(RastaContext *ctxt,
                             RastaDialogField *field,
-                            gchar ***items,
-                            gint *num_items);
+                            CLRList **list);
+static CLRList *clr_list_new();
+static void clr_list_free(CLRList *list);
+static void clr_list_add(CLRList *list, gchar *item);
+static void clr_list_check(CLRList *list, guint i);
+static void clr_list_set_match(CLRList *list,
+                               const gchar *value,
+                               gboolean single_column);
+static void clr_list_fill(CLRList *list, guint count);
+static void clr_list_close(CLRList *list, gboolean report);
+static void clr_reap_abandoned(int sig);
+static void clr_abandon_child(pid_t pid);
 static void ring_items(RastaContext *ctxt,
                        RastaDialogField *field,
                        gchar ***list_items,
@@ -188,17 +256,19 @@ static CLRQueryResult run_dialog_field_list(RastaContext *ctxt,
                                             RastaDialogField *field)
 {
     gboolean done;
-    gchar *name, *result, *value, *tmp, *sym_name, *new_value;
+    const gchar *name, *sym_name, *help;
+    gchar *result, *value, *tmp, *new_value;
     gchar *t_val, *t_new_val, *prompt;
     CLRQueryFlags flags;
     CLRQueryResult ret;
-    gint i_result, i, num_items, len;
-    gchar **list_items, **res_items;
+    gint i_result, i;
+    gchar **res_items;
+    CLRList *list;
     GList *l_result, *elem;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
 
     flags = CLR_QUERY_FLAG_QUIT | CLR_QUERY_FLAG_BACK |
@@ -207,7 +277,7 @@ static CLRQueryResult run_dialog_field_list(RastaContext *ctxt,
     if (rasta_dialog_field_is_required(field))
         flags |= CLR_QUERY_FLAG_REQUIRED;
 
-    list_items = NULL;
+    list = NULL;
     done = FALSE;
     new_value = g_strdup(value);
     l_result = NULL;
@@ -241,57 +311,48 @@ static CLRQueryResult run_dialog_field_list(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_HELP)
         {
-            tmp = rasta_dialog_field_get_help(field);
-            if ((tmp != NULL) && (g_utf8_strlen(tmp, -1) > 0))
+            help = rasta_dialog_field_peek_help(field);
+            if ((help != NULL) && (g_utf8_strlen(help, -1) > 0))
                 fprintf(stdout, "\nHelp for \"%s\":\n%s\n",
-                        name, tmp);
+                        name, help);
             else
                 fprintf(stdout,
                         "\nThere is no help on this topic\n");
-            g_free(tmp);
         }
         else if (ret == CLR_QUERY_LIST)
         {
-            if (!list_items)
-                i_result = run_listcommand(ctxt, field,
-                                           &list_items, &num_items);
+            if (!list)
+                i_result = run_listcommand(ctxt, field, &list);
+            if (list)
+                clr_list_fill(list, 1);
         
-            if (!num_items || !list_items)
+            if (!list || !list->items->len)
             {
                 fprintf(stderr,
                         "clrasta: There are no items in this list.\n");
+                if (list)
+                {
+                    clr_list_free(list);
+                    list = NULL;
+                }
                 continue;
             }
 
             /*
              * Only compute initial values from a string if we are
              * in single-select mode.  Handling multiple-select with
-             * possibly entered/generated fields is Hard.
+             * possibly entered/generated fields is Hard.  The list
+             * marks the match as it is read.
              */
             if (!l_result && new_value && *new_value &&
                 !rasta_listcommand_allow_multiple(field))
-            {
-                for (i = 0; i < num_items; i++)
-                {
-                    if (rasta_listcommand_is_single_column(field))
-                    {
-                        len = strlen(new_value);
-                        if (!strchr(new_value, ' ') &&
-                            !strncmp(new_value, list_items[i], len) &&
-                            (!list_items[i][len] ||
-                             strchr(" \t\n", list_items[i][len])))
-                            break;
-                    }
-                    else if (!strcmp(new_value, list_items[i]))
-                        break;
-                }
-                if (i < num_items)
-                    l_result = g_list_append(NULL, GUINT_TO_POINTER(i));
-            }
+                clr_list_set_match(list, new_value,
+                                   rasta_listcommand_is_single_column(field));
+            else
+                clr_list_set_match(list, NULL, FALSE);
 
             ret =
-                clr_query_list(list_items,
-                               num_items,
+                clr_query_list(list,
                                rasta_listcommand_allow_multiple(field),
                                &l_result);
 
@@ -334,10 +395,11 @@ static CLRQueryResult run_dialog_field_list(RastaContext *ctxt,
             i = 0;
             while (elem && (i < i_result))
             {
-                if (GPOINTER_TO_UINT(elem->data) >= num_items)
+                if (GPOINTER_TO_UINT(elem->data) >= list->items->len)
                     continue;
 
-                result = g_strdup(list_items[GPOINTER_TO_UINT(elem->data)]);
+                result = g_strdup(g_ptr_array_index(list->items,
+                                                    GPOINTER_TO_UINT(elem->data)));
                 if (result)
                 {
                     if (rasta_listcommand_is_single_column(field))
@@ -376,8 +438,8 @@ static CLRQueryResult run_dialog_field_list(RastaContext *ctxt,
 
     if (l_result)
         g_list_free(l_result);
-    if (list_items)
-        g_strfreev(list_items);
+    if (list)
+        clr_list_free(list);
     if (new_value)
         g_free(new_value);
     if (value)
@@ -399,20 +461,22 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
                                           RastaDialogField *field)
 {
     gboolean done;
-    gchar *name, *result, *value, *tmp, *sym_name, *new_value;
+    const gchar *name, *sym_name, *help;
+    gchar *result, *value, *tmp, *new_value;
     gchar *format, *prompt, *conv;
     gchar *t_val, *t_new_val;
     CLRQueryFlags flags;
     CLRQueryResult ret;
-    gint i_result, i, num_items, len;
-    gchar **list_items, **res_items;
+    gint i_result, i;
+    gchar **res_items;
+    CLRList *list;
     GList *l_result, *elem;
     gssize br, bw;
     GError *error;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
 
     if (rasta_entry_dialog_field_is_numeric(field))
@@ -427,7 +491,7 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
     if (rasta_dialog_field_is_required(field))
         flags |= CLR_QUERY_FLAG_REQUIRED;
 
-    list_items = NULL;
+    list = NULL;
     l_result = NULL;
     done = FALSE;
     new_value = g_strdup(value);
@@ -461,14 +525,13 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_HELP)
         {
-            tmp = rasta_dialog_field_get_help(field);
-            if ((tmp != NULL) && (g_utf8_strlen(tmp, -1) > 0))
+            help = rasta_dialog_field_peek_help(field);
+            if ((help != NULL) && (g_utf8_strlen(help, -1) > 0))
                 fprintf(stdout, "\nHelp for \"%s\":\n%s\n",
-                        name, tmp);
+                        name, help);
             else
                 fprintf(stdout,
                         "\nThere is no help on this topic\n");
-            g_free(tmp);
         }
         else if (ret == CLR_QUERY_CHANGE)
         {
@@ -516,46 +579,38 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_LIST)
         {
-            if (!list_items)
-                i_result = run_listcommand(ctxt, field,
-                                           &list_items, &num_items);
+            if (!list)
+                i_result = run_listcommand(ctxt, field, &list);
+            if (list)
+                clr_list_fill(list, 1);
 
-            if (!num_items || !list_items)
+            if (!list || !list->items->len)
             {
                 fprintf(stderr,
                         "clrasta: There are no items in this list.\n");
+                if (list)
+                {
+                    clr_list_free(list);
+                    list = NULL;
+                }
                 continue;
             }
 
             /*
              * Only compute initial values from a string if we are
              * in single-select mode.  Handling multiple-select with
-             * possibly entered/generated fields is Hard.
+             * possibly entered/generated fields is Hard.  The list
+             * marks the match as it is read.
              */
             if (!l_result && new_value && *new_value &&
                 !rasta_listcommand_allow_multiple(field))
-            {
-                for (i = 0; i < num_items; i++)
-                {
-                    if (rasta_listcommand_is_single_column(field))
-                    {
-                        len = strlen(new_value);
-                        if (!strchr(new_value, ' ') &&
-                            !strncmp(new_value, list_items[i], len) &&
-                            (!list_items[i][len] ||
-                             strchr(" \t\n", list_items[i][len])))
-                            break;
-                    }
-                    else if (!strcmp(new_value, list_items[i]))
-                        break;
-                }
-                if (i < num_items)
-                    l_result = g_list_append(NULL, GUINT_TO_POINTER(i));
-            }
+                clr_list_set_match(list, new_value,
+                                   rasta_listcommand_is_single_column(field));
+            else
+                clr_list_set_match(list, NULL, FALSE);
 
             ret =
-                clr_query_list(list_items,
-                               num_items,
+                clr_query_list(list,
                                rasta_listcommand_allow_multiple(field),
                                &l_result);
 
@@ -599,10 +654,11 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
             i = 0;
             while (elem && (i < i_result))
             {
-                if (GPOINTER_TO_UINT(elem->data) >= num_items)
+                if (GPOINTER_TO_UINT(elem->data) >= list->items->len)
                     continue;
 
-                result = g_strdup(list_items[GPOINTER_TO_UINT(elem->data)]);
+                result = g_strdup(g_ptr_array_index(list->items,
+                                                    GPOINTER_TO_UINT(elem->data)));
                 if (result)
                 {
                     if (rasta_listcommand_is_single_column(field))
@@ -638,8 +694,8 @@ CLRQueryResult run_dialog_field_entrylist(RastaContext *ctxt,
     if (strcmp(t_val, t_new_val))
         rasta_symbol_put(ctxt, sym_name, new_value);
 
-    if (list_items)
-        g_strfreev(list_items);
+    if (list)
+        clr_list_free(list);
     if (format)
         g_free(format);
     if (new_value)
@@ -671,10 +727,11 @@ static void ring_items(RastaContext *ctxt,
                        gint *num_items,
                        gint *i_result)
 {
-    REnumeration *ren;
+    REnumeration ren;
     gint count, i;
     RastaRingValue *val;
-    gchar *sym_name, *sym_val;
+    const gchar *sym_name;
+    gchar *sym_val;
 
     g_return_if_fail(ctxt != NULL);
     g_return_if_fail(field != NULL);
@@ -688,22 +745,14 @@ static void ring_items(RastaContext *ctxt,
     *list_items = NULL;
     *val_items = NULL;
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     if (!sym_name)
         g_assert_not_reached();
 
     sym_val = rasta_symbol_lookup(ctxt, sym_name);
 
-    ren = rasta_dialog_field_enumerate_ring(field);
-    if (!ren)
-        return;
-
-    while (r_enumeration_has_more(ren))
-    {
-        r_enumeration_get_next(ren);
-        count++;
-    }
-    r_enumeration_free(ren);
+    rasta_dialog_field_init_ring_cursor(field, &ren);
+    count = r_enumeration_count(&ren);
 
     *list_items = g_new0(gchar *, count + 1);
     if (!*list_items)
@@ -715,15 +764,11 @@ static void ring_items(RastaContext *ctxt,
         return;
     }
 
-    ren = rasta_dialog_field_enumerate_ring(field);
-    if (!ren)
-        return;
-
     i = 0;
     *i_result = -1;
-    while (r_enumeration_has_more(ren) && (i < count))
+    while (r_enumeration_has_more(&ren) && (i < count))
     {
-        val = RASTA_RING_VALUE(r_enumeration_get_next(ren));
+        val = RASTA_RING_VALUE(r_enumeration_get_next(&ren));
         if (!val)
             continue;  /* Should we error? */
 
@@ -735,7 +780,6 @@ static void ring_items(RastaContext *ctxt,
             *i_result = i;
         i++;
     }
-    r_enumeration_free(ren);
 
     *num_items = i;
 }  /* ring_items() */
@@ -750,17 +794,19 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
                                             RastaDialogField *field)
 {
     gboolean done;
-    gchar *name, *value, *sym_name, *new_value, *disp_val;
-    gchar *t_val, *t_new_val, *prompt, *tmp;
+    const gchar *name, *sym_name, *help;
+    gchar *value, *new_value, *disp_val;
+    gchar *t_val, *t_new_val, *prompt;
     CLRQueryFlags flags;
     CLRQueryResult ret;
-    gint i_result, num_items;
+    gint i_result, num_items, i;
     gchar **list_items, **val_items;
+    CLRList *list;
     GList *l_result;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
 
     flags = CLR_QUERY_FLAG_QUIT | CLR_QUERY_FLAG_BACK |
@@ -773,6 +819,10 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
     ring_items(ctxt, field,
                &list_items, &val_items, &num_items, &i_result);
 
+    list = clr_list_new();
+    for (i = 0; i < num_items; i++)
+        clr_list_add(list, g_strdup(list_items[i]));
+
     l_result = NULL;
     if (i_result > -1)
     {
@@ -814,14 +864,13 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_HELP)
         {
-            tmp = rasta_dialog_field_get_help(field);
-            if ((tmp != NULL) && (g_utf8_strlen(tmp, -1) > 0))
+            help = rasta_dialog_field_peek_help(field);
+            if ((help != NULL) && (g_utf8_strlen(help, -1) > 0))
                 fprintf(stdout, "\nHelp for \"%s\":\n%s\n",
-                        name, tmp);
+                        name, help);
             else
                 fprintf(stdout,
                         "\nThere is no help on this topic\n");
-            g_free(tmp);
         }
         else if (ret == CLR_QUERY_LIST)
         {
@@ -833,7 +882,7 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
             }
 
             ret =
-                clr_query_list(list_items, num_items, FALSE, &l_result);
+                clr_query_list(list, FALSE, &l_result);
 
             if (ret == CLR_QUERY_NONE)
                 continue;
@@ -862,6 +911,7 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
     if (strcmp(t_val, t_new_val))
         rasta_symbol_put(ctxt, sym_name, new_value);
 
+    clr_list_free(list);
     g_strfreev(list_items);
     g_strfreev(val_items);
     if (l_result)
@@ -885,11 +935,12 @@ static CLRQueryResult run_dialog_field_ring(RastaContext *ctxt,
 static CLRQueryResult run_dialog_field_readonly(RastaContext *ctxt,
                                                 RastaDialogField *field)
 {
-    gchar *name, *value, *sym_name;
+    const gchar *name, *sym_name;
+    gchar *value;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
 
     clr_print_field(name, value ? value : "", FALSE);
@@ -909,9 +960,9 @@ static
 CLRQueryResult run_dialog_field_description(RastaContext *ctxt,
                                             RastaDialogField *field)
 {
-    gchar *name;
+    const gchar *name;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
     clr_print_field(name, NULL, FALSE);
 
@@ -929,16 +980,17 @@ static CLRQueryResult run_dialog_field_entry(RastaContext *ctxt,
                                              RastaDialogField *field)
 {
     gboolean done;
-    gchar *name, *value, *sym_name, *new_value, *format, *tmp;
+    const gchar *name, *sym_name, *help;
+    gchar *value, *new_value, *format, *tmp;
     gchar *t_val, *t_new_val, *prompt, *conv;
     gsize br, bw;
     GError *error;
     CLRQueryFlags flags;
     CLRQueryResult ret;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
     if (rasta_entry_dialog_field_is_numeric(field))
         format = rasta_entry_dialog_field_get_format(field);
@@ -984,14 +1036,13 @@ static CLRQueryResult run_dialog_field_entry(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_HELP)
         {
-            tmp = rasta_dialog_field_get_help(field);
-            if ((tmp != NULL) && (g_utf8_strlen(tmp, -1) > 0))
+            help = rasta_dialog_field_peek_help(field);
+            if ((help != NULL) && (g_utf8_strlen(help, -1) > 0))
                 fprintf(stdout, "\nHelp for \"%s\":\n%s\n",
-                        name, tmp);
+                        name, help);
             else
                 fprintf(stdout,
                         "\nThere is no help on this topic\n");
-            g_free(tmp);
         }
         else if (ret == CLR_QUERY_CHANGE)
         {
@@ -1062,16 +1113,17 @@ static CLRQueryResult run_dialog_field_file(RastaContext *ctxt,
                                             RastaDialogField *field)
 {
     gboolean done;
-    gchar *name, *value, *sym_name, *new_value;
+    const gchar *name, *sym_name, *help;
+    gchar *value, *new_value;
     gchar *t_val, *t_new_val, *prompt, *conv, *tmp;
     CLRQueryFlags flags;
     CLRQueryResult ret;
     gsize br, bw;
     GError *error;
 
-    name = rasta_dialog_field_get_text(field);
+    name = rasta_dialog_field_peek_text(field);
 
-    sym_name = rasta_dialog_field_get_symbol_name(field);
+    sym_name = rasta_dialog_field_peek_symbol_name(field);
     value = rasta_symbol_lookup(ctxt, sym_name);
 
     flags = CLR_QUERY_FLAG_QUIT | CLR_QUERY_FLAG_BACK |
@@ -1113,14 +1165,13 @@ static CLRQueryResult run_dialog_field_file(RastaContext *ctxt,
         }
         else if (ret == CLR_QUERY_HELP)
         {
-            tmp = rasta_dialog_field_get_help(field);
-            if ((tmp != NULL) && (g_utf8_strlen(tmp, -1) > 0))
+            help = rasta_dialog_field_peek_help(field);
+            if ((help != NULL) && (g_utf8_strlen(help, -1) > 0))
                 fprintf(stdout, "\nHelp for \"%s\":\n%s\n",
-                        name, tmp);
+                        name, help);
             else
                 fprintf(stdout,
                         "\nThere is no help on this topic\n");
-            g_free(tmp);
         }
         else if (ret == CLR_QUERY_CHANGE)
         {
@@ -1172,6 +1223,7 @@ static void print_usage()
 {
     fprintf(stderr,
             "Usage: clrasta [--load-push] [--file <filename>]\n"
+            "               [--trace <filename>] [--profile <filename>]\n"
             "               [<fastpath>]\n");
 }  /* print_usage() */
 
@@ -1224,6 +1276,20 @@ static gboolean load_options(gint argc, gchar *argv[],
                 return(FALSE);
             options->state_filename = argv[i];
         }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(FALSE);
+            options->trace_filename = argv[i];
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(FALSE);
+            options->profile_filename = argv[i];
+        }
         else
             return(FALSE);
     }
@@ -1452,10 +1518,23 @@ static gchar *clr_readline(const gchar *prompt)
     if (initialized == FALSE)
     {
         rl_bind_key('\t', rl_insert);  /* No completion */
+        rl_attempted_completion_function = clr_complete_list;
         initialized = TRUE;
     }
 
+    /* List choices complete against the choice index */
+    if (complete_index != NULL)
+    {
+        rl_bind_key('\t', rl_complete);
+        rl_completer_word_break_characters = "";
+        rl_completion_append_character = '\0';
+    }
+
     r = readline(prompt);
+
+    if (complete_index != NULL)
+        rl_bind_key('\t', rl_insert);
+
     if (r == NULL)
 #else
     if (prompt != NULL)
@@ -1475,6 +1554,64 @@ static gchar *clr_readline(const gchar *prompt)
 }  /* clr_readline() */
 
 
+#ifdef HAVE_READLINE
+/*
+ * static char *clr_complete_choice(const char *text, int state)
+ *
+ * Readline generator for list choices.  A leading '/' is kept, so
+ * the completed text can be used as a filter response.
+ */
+static char *clr_complete_choice(const char *text, int state)
+{
+    static guint *matches = NULL;
+    static guint n_matches = 0;
+    static guint pos = 0;
+    static gboolean slash = FALSE;
+    gchar *item;
+    char *r;
+
+    if (state == 0)
+    {
+        g_free(matches);
+        slash = (text[0] == '/');
+        matches = rasta_choice_index_find_prefix(complete_index,
+                                                 text + (slash ? 1 : 0),
+                                                 &n_matches);
+        pos = 0;
+    }
+
+    if (pos >= n_matches)
+        return(NULL);
+
+    item = g_ptr_array_index(complete_items, matches[pos++]);
+
+    /* Readline frees this with free() */
+    r = malloc(strlen(item) + 2);
+    if (r != NULL)
+        sprintf(r, "%s%s", slash ? "/" : "", item);
+
+    return(r);
+}  /* clr_complete_choice() */
+
+
+/*
+ * static char **clr_complete_list(const char *text, int start, int end)
+ *
+ * Readline completion hook.  Only list choices are completed, never
+ * filenames.
+ */
+static char **clr_complete_list(const char *text, int start, int end)
+{
+    rl_attempted_completion_over = 1;
+
+    if (complete_index == NULL)
+        return(NULL);
+
+    return(rl_completion_matches(text, clr_complete_choice));
+}  /* clr_complete_list() */
+#endif  /* HAVE_READLINE */
+
+
 /*
  * static CLRQueryResult clr_query_choice(gchar *valid_choices[],
  *                                        guint num_choices,
@@ -1627,6 +1764,12 @@ static char *clr_build_prompt(CLRQueryFlags flags,
                                start_choice, end_choice);
     if (flags & CLR_QUERY_FLAG_MORE)
         g_string_append(str, "[m]ore, ");
+    if (flags & CLR_QUERY_FLAG_PREV)
+        g_string_append(str, "[p]revious, ");
+    if (flags & CLR_QUERY_FLAG_GOTO)
+        g_string_append(str, "[g]oto <n>, ");
+    if (flags & CLR_QUERY_FLAG_FILTER)
+        g_string_append(str, "[/]filter, ");
     if (flags & CLR_QUERY_FLAG_DONE)
         g_string_append(str, "[d]one, ");
     if (flags & CLR_QUERY_FLAG_CANCEL)
@@ -1693,12 +1836,27 @@ static CLRQueryResult clr_query_response(const gchar *prompt,
         ret = CLR_QUERY_CHANGE;
     else if ((flags & CLR_QUERY_FLAG_MORE) && (strcmp(r, "m") == 0))
         ret = CLR_QUERY_MORE;
+    else if ((flags & CLR_QUERY_FLAG_PREV) && (strcmp(r, "p") == 0))
+        ret = CLR_QUERY_PREV;
+    else if ((flags & CLR_QUERY_FLAG_GOTO) && (r[0] == 'g') &&
+             res_choice)
+    {
+        *res_choice = (gint)strtol(r + 1, &ptr, 10);
+        if ((ptr != (r + 1)) && !*ptr)
+            ret = CLR_QUERY_GOTO;
+    }
     else if ((flags & CLR_QUERY_FLAG_DONE) && (strcmp(r, "d") == 0))
         ret = CLR_QUERY_DONE;
     else if ((flags & CLR_QUERY_FLAG_CANCEL) && (strcmp(r, "c") == 0))
         ret = CLR_QUERY_CANCEL;
     else if ((flags & CLR_QUERY_FLAG_HELP) && (strcmp(r, "h") == 0))
         ret = CLR_QUERY_HELP;
+    else if ((flags & CLR_QUERY_FLAG_FILTER) && (r[0] == '/'))
+    {
+        g_free(query_text);
+        query_text = g_strdup(r + 1);
+        ret = CLR_QUERY_FILTER;
+    }
     else if (res_choice)
     {
         *res_choice = (gint)strtol(r, &ptr, 10);
@@ -1713,38 +1871,95 @@ static CLRQueryResult clr_query_response(const gchar *prompt,
 
 
 /*
- * static CLRQueryResult clr_query_list(gchar *valid_choices[],
- *                                      guint num_choices,
+ * static guint clr_page_size()
+ *
+ * Returns the number of list choices to show at once.  On a terminal
+ * this fills the screen, leaving room for the prompt.
+ */
+static guint clr_page_size()
+{
+#ifdef TIOCGWINSZ
+    struct winsize ws;
+
+    if (isatty(STDOUT_FILENO) &&
+        (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0) &&
+        (ws.ws_row > CLR_PAGE_RESERVED))
+        return(ws.ws_row - CLR_PAGE_RESERVED);
+#endif  /* TIOCGWINSZ */
+
+    return(CLR_PAGE_LINES);
+}  /* clr_page_size() */
+
+
+/*
+ * static void clr_query_list_load(CLRList *list,
+ *                                 guint count,
+ *                                 GArray *marked,
+ *                                 RastaChoiceIndex *index)
+ *
+ * Reads choices until count of them are loaded or the list is
+ * complete, growing the marks and the choice index to match.
+ */
+static void clr_query_list_load(CLRList *list,
+                                guint count,
+                                GArray *marked,
+                                RastaChoiceIndex *index)
+{
+    guint i;
+
+    g_return_if_fail(list != NULL);
+    g_return_if_fail(marked != NULL);
+    g_return_if_fail(index != NULL);
+
+    clr_list_fill(list, count);
+
+    for (i = rasta_choice_index_size(index); i < list->items->len; i++)
+        rasta_choice_index_add(index, g_ptr_array_index(list->items, i));
+    g_array_set_size(marked, list->items->len);
+}  /* clr_query_list_load() */
+
+
+/*
+ * static CLRQueryResult clr_query_list(CLRList *list,
  *                                      gboolean multiple,
  *                                      GList **result)
  *
  * Asks the user choices in a list.  Returns CLR_QUERY_SUCCESS or
- * CLR_QUERY_NONE.
+ * CLR_QUERY_NONE.  Choices are numbered from the top of the list.
+ * A "/text" response narrows the list to the choices containing
+ * text, and "/" alone shows them all again.  "g<n>" goes to choice
+ * n, loading the list that far if needed.
  */
-static CLRQueryResult clr_query_list(gchar *valid_choices[],
-                                     guint num_choices,
+static CLRQueryResult clr_query_list(CLRList *list,
                                      gboolean multiple,
                                      GList **result)
 {
-    gboolean done;
+    gboolean done, matching;
     gchar *prompt;
-    gint count, start, res_n, end_choice, last_marked;
+    gint res_n, last_marked, item;
+    guint count, start, end, page, n_view, n_matches;
     CLRQueryResult ret;
     CLRQueryFlags newflags;
-    gboolean *marked;
+    GArray *marked;
     GList *elem;
+    RastaChoiceIndex *index;
+    guint *view, *matches;
 
-    g_return_val_if_fail(valid_choices != NULL, CLR_QUERY_NONE);
-    g_return_val_if_fail(num_choices > 0, CLR_QUERY_NONE);
+    g_return_val_if_fail(list != NULL, CLR_QUERY_NONE);
     g_return_val_if_fail(result != NULL, CLR_QUERY_NONE);
 
-    marked = g_new0(gboolean, num_choices);
+    marked = g_array_new(FALSE, TRUE, sizeof(gboolean));
+    index = rasta_choice_index_new();
+    clr_query_list_load(list, 1, marked, index);
+
     elem = *result;
     last_marked = -1;
     while (elem)
     {
         last_marked = GPOINTER_TO_UINT(elem->data);
-        marked[last_marked] = TRUE;
+        clr_query_list_load(list, last_marked + 1, marked, index);
+        if ((guint)last_marked < marked->len)
+            g_array_index(marked, gboolean, last_marked) = TRUE;
         if (!multiple)
             break;
         last_marked = -1;
@@ -1756,56 +1971,143 @@ static CLRQueryResult clr_query_list(gchar *valid_choices[],
         *result = NULL;
     }
 
+    /* The current value is marked once it streams in */
+    matching = (list->match != NULL) && (last_marked == -1);
+
+#ifdef HAVE_READLINE
+    complete_index = index;
+    complete_items = list->items;
+#endif  /* HAVE_READLINE */
+
+    /* view maps displayed positions to choices, NULL is all of them */
+    view = NULL;
+    n_view = 0;
+
     start = 0;
     done = FALSE;
     while (done == FALSE)
     {
-        fprintf(stdout, "\n");
-        for (count = 0; (count < 10) &&
-                        (count < (num_choices - start)); count++)
+        page = clr_page_size();
+        if (view == NULL)
         {
-            pretty_print_choice(count + 1,
-                                valid_choices[start + count],
-                                marked[start + count]);
+            /* One past the page, so we know if there is more */
+            clr_query_list_load(list, start + page + 1, marked, index);
+            n_view = list->items->len;
         }
+
+        if ((matching != FALSE) && (list->selected > -1))
+        {
+            g_array_index(marked, gboolean, list->selected) = TRUE;
+            last_marked = list->selected;
+            matching = FALSE;
+        }
+
+        if (start >= n_view)
+            start = 0;
+        end = MIN(start + page, n_view);
+
         fprintf(stdout, "\n");
+        for (count = start; count < end; count++)
+        {
+            item = view ? view[count] : count;
+            pretty_print_choice(count + 1,
+                                g_ptr_array_index(list->items, item),
+                                g_array_index(marked, gboolean, item));
+        }
+        if (view != NULL)
+            fprintf(stdout, "\nShowing %u-%u of %u matches\n",
+                    start + 1, end, n_view);
+        else if (list->chan != NULL)
+            fprintf(stdout, "\nShowing %u-%u of %u so far\n",
+                    start + 1, end, n_view);
+        else
+            fprintf(stdout, "\nShowing %u-%u of %u\n",
+                    start + 1, end, n_view);
         
-        newflags = CLR_QUERY_FLAG_CANCEL | CLR_QUERY_FLAG_DONE;
-        if (num_choices > 10)
+        newflags = CLR_QUERY_FLAG_CANCEL | CLR_QUERY_FLAG_DONE |
+            CLR_QUERY_FLAG_FILTER | CLR_QUERY_FLAG_GOTO;
+        if ((end < n_view) || (start > 0))
             newflags |= CLR_QUERY_FLAG_MORE;
-        end_choice = (num_choices - start) > 10 ?
-            10 : (num_choices - start);
-        prompt = clr_build_prompt(newflags, 1, end_choice);
+        if (start > 0)
+            newflags |= CLR_QUERY_FLAG_PREV;
+        prompt = clr_build_prompt(newflags, start + 1, end);
 
         ret = clr_query_response(prompt, newflags,
-                                 &res_n, 1, end_choice);
+                                 &res_n, start + 1, end);
         g_free(prompt);
 
         if (ret == CLR_QUERY_MORE)
         {
-            if ((num_choices - start) > 10)
-                start += 10;
+            if (end < n_view)
+                start = end;
             else
                 start = 0;
         }
+        else if (ret == CLR_QUERY_PREV)
+            start = start > page ? start - page : 0;
+        else if (ret == CLR_QUERY_GOTO)
+        {
+            if ((view == NULL) && (res_n > 0))
+            {
+                clr_query_list_load(list, res_n, marked, index);
+                n_view = list->items->len;
+            }
+            if ((res_n < 1) || (res_n > n_view))
+            {
+                fprintf(stdout, "There are only %u choices\n",
+                        n_view);
+                continue;
+            }
+            start = res_n - 1;
+        }
+        else if (ret == CLR_QUERY_FILTER)
+        {
+            if (query_text[0] == '\0')
+            {
+                g_free(view);
+                view = NULL;
+                start = 0;
+                continue;
+            }
+
+            /* Filtering needs every choice */
+            clr_query_list_load(list, G_MAXUINT, marked, index);
+            matches = rasta_choice_index_find(index, query_text,
+                                              &n_matches);
+            if (matches == NULL)
+            {
+                fprintf(stdout, "No choices match \"%s\"\n",
+                        query_text);
+                continue;
+            }
+            g_free(view);
+            view = matches;
+            n_view = n_matches;
+            start = 0;
+        }
         else if (ret == CLR_QUERY_SUCCESS)
         {
             res_n--; /* 0 based */
-            if ((res_n > -1) &&
-                (res_n < ((num_choices - start) > 10 ?
-                          10 : (num_choices - start))))
+            if ((res_n < (gint)start) || (res_n >= (gint)end))
             {
-                marked[res_n + start] = !marked[res_n + start];
+                fprintf(stdout, "Invalid choice\n");
+                continue;
             }
+
+            item = view ? view[res_n] : res_n;
+            g_array_index(marked, gboolean, item) =
+                !g_array_index(marked, gboolean, item);
+            matching = FALSE;
             if (!multiple)
             {
-                if ((res_n + start) == last_marked)
+                if (item == last_marked)
                     last_marked = -1;
                 else
                 {
                     if (last_marked  != -1)
-                        marked[last_marked] = FALSE;
-                    last_marked = res_n + start;
+                        g_array_index(marked, gboolean,
+                                      last_marked) = FALSE;
+                    last_marked = item;
                 }
             }
         }
@@ -1823,15 +2125,23 @@ static CLRQueryResult clr_query_list(gchar *valid_choices[],
             fprintf(stdout, "Invalid choice\n");
     }
 
+#ifdef HAVE_READLINE
+    complete_index = NULL;
+    complete_items = NULL;
+#endif  /* HAVE_READLINE */
+    rasta_choice_index_free(index);
+    g_free(view);
+
     if (ret == CLR_QUERY_SUCCESS)
     {
-        for (*result = NULL, count = 0; count < num_choices; count++)
+        for (*result = NULL, count = 0; count < marked->len; count++)
         {
-            if (marked[count])
+            if (g_array_index(marked, gboolean, count))
                 *result = g_list_prepend(*result,
                                          GUINT_TO_POINTER(count));
         }
     }
+    g_array_free(marked, TRUE);
 
     return(ret);
 }  /* clr_query_list() */
@@ -1848,15 +2158,15 @@ static GList *get_menu_items(RastaContext *ctxt, RastaScreen *screen)
     GList *m_items;
     RastaMenuItem *cur_item;
     CLRMenuItem *item;
-    REnumeration *enumer;
+    REnumeration enumer;
 
     g_return_val_if_fail(screen != NULL, NULL);
 
-    enumer = rasta_menu_screen_enumerate_items(ctxt, screen);
+    rasta_menu_screen_init_cursor(ctxt, screen, &enumer);
     m_items = NULL;
-    while (r_enumeration_has_more(enumer))
+    while (r_enumeration_has_more(&enumer))
     {
-        cur_item = RASTA_MENU_ITEM(r_enumeration_get_next(enumer));
+        cur_item = RASTA_MENU_ITEM(r_enumeration_get_next(&enumer));
         if (cur_item == NULL)
             continue;  /* should we error? */
 
@@ -1872,59 +2182,51 @@ static GList *get_menu_items(RastaContext *ctxt, RastaScreen *screen)
         if ((item->text == NULL) || (item->next_id == NULL))
         {
             fprintf(stderr, "clrasta: Unable to allocate memory\n");
-            r_enumeration_free(enumer);
             return(NULL);
         }
 
         m_items = g_list_append(m_items, item);
     }
-    r_enumeration_free(enumer);
     
     return(m_items);
 }  /* get_menu_items() */
 
 
 /*
- * static gchar *get_menu_item_help(RastaContext *ctxt,
- *                                  RastaScreen *screen,
- *                                  CLRMenuItem *item)
+ * static const gchar *get_menu_item_help(RastaContext *ctxt,
+ *                                        RastaScreen *screen,
+ *                                        CLRMenuItem *item)
  *
- * Gets the help text for the given menu item
+ * Gets the help text for the given menu item.  The text belongs to
+ * the menu screen and must not be freed.
  */
-static gchar *get_menu_item_help(RastaContext *ctxt,
-                                 RastaScreen *screen,
-                                 CLRMenuItem *item)
+static const gchar *get_menu_item_help(RastaContext *ctxt,
+                                       RastaScreen *screen,
+                                       CLRMenuItem *item)
 {
-    gchar *help_text, *cur_id;
+    const gchar *help_text, *cur_id;
     RastaMenuItem *cur_item;
-    REnumeration *enumer;
+    REnumeration enumer;
 
     g_return_val_if_fail(screen != NULL, NULL);
 
     help_text = NULL;
-    enumer = rasta_menu_screen_enumerate_items(ctxt, screen);
-    while (r_enumeration_has_more(enumer))
+    rasta_menu_screen_init_cursor(ctxt, screen, &enumer);
+    while (r_enumeration_has_more(&enumer))
     {
-        cur_item = RASTA_MENU_ITEM(r_enumeration_get_next(enumer));
+        cur_item = RASTA_MENU_ITEM(r_enumeration_get_next(&enumer));
         if (cur_item == NULL)
             continue;  /* should we error? */
 
-        cur_id = rasta_menu_item_get_id(cur_item);
+        cur_id = rasta_menu_item_peek_id(cur_item);
         if (cur_id == NULL)
-        {
-            fprintf(stderr, "clrasta: Unable to allocate memory\n");
-            r_enumeration_free(enumer);
-            return(NULL);
-        }
+            continue;  /* should we error? */
         if (strcmp(cur_id, item->next_id) == 0)
         {
-            help_text = rasta_menu_item_get_help(cur_item);
-            g_free(cur_id);
+            help_text = rasta_menu_item_peek_help(cur_item);
             break;
         }
-        g_free(cur_id);
     }
-    r_enumeration_free(enumer);
     
     return(help_text);
 }  /* get_menu_item_help() */
@@ -1964,7 +2266,7 @@ static void free_menu_items(GList *m_items)
 static gboolean run_menu(RastaContext *ctxt, RastaScreen *screen)
 {
     gint count, num_choices, ret_id, res;
-    gchar *title, *help;
+    const gchar *title, *help;
     GList *m_items, *elem;
     CLRMenuItem *item;
     gboolean done, retval;
@@ -1973,7 +2275,7 @@ static gboolean run_menu(RastaContext *ctxt, RastaScreen *screen)
     g_return_val_if_fail(ctxt != NULL, FALSE);
     g_return_val_if_fail(screen != NULL, FALSE);
 
-    title = rasta_screen_get_title(screen);
+    title = rasta_screen_peek_title(screen);
 
     m_items = get_menu_items(ctxt, screen);
     if (m_items == NULL)
@@ -2026,7 +2328,6 @@ static gboolean run_menu(RastaContext *ctxt, RastaScreen *screen)
                 else
                     fprintf(stdout,
                             "\nThere is no help on this topic\n");
-                g_free(help);
                 break;
 
             case CLR_QUERY_SUCCESS:
@@ -2044,7 +2345,6 @@ static gboolean run_menu(RastaContext *ctxt, RastaScreen *screen)
 
     g_free(choices);
     free_menu_items(m_items);
-    g_free(title);
 
     return(retval);
 }  /* run_menu() */
@@ -2151,6 +2451,8 @@ static gint run_initcommand(RastaContext *ctxt, RastaScreen *screen)
         if ((rc == -1) && (errno != EINTR))
             break;
     }
+    if (rc > 0)
+        rasta_trace_child_exited(pid, wstat, out_data ? out_len : 0);
 
     if (rc < 0)
     {
@@ -2227,51 +2529,44 @@ out_encoding:
 
 /*
  * static gint run_listcommand(RastaContext *ctxt,
- *                             RastaFialogField *field,
- *                             gchar ***items,
- *                             gchar *num_items)
+ *                             RastaDialogField *field,
+ *                             CLRList **list)
  *
- * Runs the list_command of list/entrylist fields
+ * Starts the list_command of list/entrylist fields.  The output is
+ * read into list as the user pages through it.
  */
 static gint run_listcommand(RastaContext *ctxt,
                             RastaDialogField *field,
-                            gchar ***items,
-                            gint *num_items)
+                            CLRList **list)
 {
-    pid_t pid;
-    gint rc, outfd, errfd, wstat;
-    GIOChannel *chan;
-    GIOStatus status;
+    gint rc, outfd;
     GError *error;
-    gsize out_len, err_len;
-    char *out_data, *err_data, *encoding, *tmp;
 
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
     g_return_val_if_fail(field != NULL, -EINVAL);
-    g_return_val_if_fail(items != NULL, -EINVAL);
-    g_return_val_if_fail(num_items != NULL, -EINVAL);
+    g_return_val_if_fail(list != NULL, -EINVAL);
 
-    *num_items = 0;
-    *items = NULL;
+    *list = clr_list_new();
+    if (*list == NULL)
+        return(-ENOMEM);
 
     rc = rasta_listcommand_run(ctxt, field,
-                               &pid, &outfd, &errfd);
+                               &((*list)->pid), &outfd,
+                               &((*list)->errfd));
     /* FIXME: Fix the g_errors() */
     if (rc != 0)
         g_error("Couldn't run list command\n");
 
-    error = NULL;
-    encoding = rasta_listcommand_get_encoding(field);
-    rc = -EIO;
-    out_data = NULL;
+    (*list)->encoding = rasta_listcommand_get_encoding(field);
     if (outfd > -1)
     {
-        chan = g_io_channel_unix_new(outfd);
-        if (!chan)
+        (*list)->chan = g_io_channel_unix_new(outfd);
+        if (!(*list)->chan)
             g_error("Couldn't create GIOChannel\n");
 
         error = NULL;
-        g_io_channel_set_encoding(chan, encoding, &error);
+        g_io_channel_set_encoding((*list)->chan, (*list)->encoding,
+                                  &error);
         if (error)
         {
             fprintf(stdout,
@@ -2279,11 +2574,160 @@ static gint run_listcommand(RastaContext *ctxt,
                     error->message ? error->message : "Unknown error");
             g_clear_error(&error);
         }
+    }
+    else
+        clr_list_close(*list, TRUE);
+
+    return(0);
+}  /* run_listcommand() */
 
+
+/*
+ * static CLRList *clr_list_new()
+ *
+ * Creates an empty, complete list of choices.
+ */
+static CLRList *clr_list_new()
+{
+    CLRList *list;
+
+    list = g_new0(CLRList, 1);
+    if (list == NULL)
+        return(NULL);
+
+    list->items = g_ptr_array_new();
+    list->chan = NULL;
+    list->errfd = -1;
+    list->pid = -1;
+    list->selected = -1;
+
+    return(list);
+}  /* clr_list_new() */
+
+
+/*
+ * static void clr_list_free(CLRList *list)
+ *
+ * Frees a list of choices.  A command still running is no longer
+ * read from, so it sees a broken pipe.
+ */
+static void clr_list_free(CLRList *list)
+{
+    guint i;
+
+    g_return_if_fail(list != NULL);
+
+    clr_list_close(list, FALSE);
+
+    for (i = 0; i < list->items->len; i++)
+        g_free(g_ptr_array_index(list->items, i));
+    g_ptr_array_free(list->items, TRUE);
+
+    g_free(list->encoding);
+    g_free(list->match);
+    g_free(list);
+}  /* clr_list_free() */
+
+
+/*
+ * static void clr_list_add(CLRList *list, gchar *item)
+ *
+ * Adds item to the end of list.  The list takes ownership of item.
+ */
+static void clr_list_add(CLRList *list, gchar *item)
+{
+    g_return_if_fail(list != NULL);
+    g_return_if_fail(item != NULL);
+
+    g_ptr_array_add(list->items, item);
+    clr_list_check(list, list->items->len - 1);
+}  /* clr_list_add() */
+
+
+/*
+ * static void clr_list_check(CLRList *list, guint i)
+ *
+ * Sets the selected item if item i is the first matching the
+ * current value.  Single column lists match on the first word.
+ */
+static void clr_list_check(CLRList *list, guint i)
+{
+    const gchar *item;
+    gsize len;
+
+    if ((list->match == NULL) || (list->selected > -1))
+        return;
+
+    item = g_ptr_array_index(list->items, i);
+    if (list->match_column != FALSE)
+    {
+        len = strlen(list->match);
+        if (!strchr(list->match, ' ') &&
+            !strncmp(list->match, item, len) &&
+            (!item[len] || strchr(" \t\n", item[len])))
+            list->selected = i;
+    }
+    else if (!strcmp(list->match, item))
+        list->selected = i;
+}  /* clr_list_check() */
+
+
+/*
+ * static void clr_list_set_match(CLRList *list,
+ *                                const gchar *value,
+ *                                gboolean single_column)
+ *
+ * Sets the value whose item should start out selected.  Items are
+ * checked as they are read, so the list need not be complete.  A
+ * NULL value selects nothing.
+ */
+static void clr_list_set_match(CLRList *list,
+                               const gchar *value,
+                               gboolean single_column)
+{
+    guint i;
+
+    g_return_if_fail(list != NULL);
+
+    g_free(list->match);
+    list->match = g_strdup(value);
+    list->match_column = single_column;
+    list->selected = -1;
+
+    for (i = 0; (i < list->items->len) && (list->selected < 0); i++)
+        clr_list_check(list, i);
+}  /* clr_list_set_match() */
+
+
+/*
+ * static void clr_list_fill(CLRList *list, guint count)
+ *
+ * Reads command output until list has count items or the command
+ * is done.
+ */
+static void clr_list_fill(CLRList *list, guint count)
+{
+    gchar *line;
+    gsize len, term;
+    GIOStatus status;
+    GError *error;
+
+    g_return_if_fail(list != NULL);
+
+    while ((list->chan != NULL) && (list->items->len < count))
+    {
         error = NULL;
-        status = g_io_channel_read_to_end(chan, &out_data, &out_len,
-                                          &error);
-        if (status != G_IO_STATUS_NORMAL)
+        line = NULL;
+        status = g_io_channel_read_line(list->chan, &line,
+                                        &len, &term, &error);
+        if (status == G_IO_STATUS_NORMAL)
+        {
+            line[term] = '\0';
+            clr_list_add(list, line);
+        }
+        else if (status == G_IO_STATUS_EOF)
+            clr_list_close(list, TRUE);
+        else if (status == G_IO_STATUS_ERROR)
         {
             fprintf(stderr,
                     "clrasta: Unable to read listcommand data: %s\n",
@@ -2292,135 +2736,190 @@ static gint run_listcommand(RastaContext *ctxt,
                     "Unknown error");
             if (error)
                 g_clear_error(&error);
-            goto out_encoding;
+            clr_list_close(list, FALSE);
         }
+    }
+}  /* clr_list_fill() */
 
-        g_io_channel_unref(chan);
+
+/*
+ * static void clr_list_close(CLRList *list, gboolean report)
+ *
+ * Stops reading the command, marking the list complete, and reaps
+ * it.  If report is TRUE, a failed command's error output is shown.
+ * If report is FALSE the user has moved on, so a command that is
+ * still running is terminated rather than waited for.
+ */
+static void clr_list_close(CLRList *list, gboolean report)
+{
+    gint rc, wstat;
+    guint i;
+    GIOChannel *chan;
+    GIOStatus status;
+    GError *error;
+    gsize err_len, bytes;
+    gchar *err_data;
+
+    g_return_if_fail(list != NULL);
+
+    if (list->chan != NULL)
+    {
+        g_io_channel_shutdown(list->chan, FALSE, NULL);
+        g_io_channel_unref(list->chan);
+        list->chan = NULL;
     }
 
     err_data = NULL;
-    if (errfd > -1)
+    if (list->errfd > -1)
     {
-        chan = g_io_channel_unix_new(errfd);
+        chan = g_io_channel_unix_new(list->errfd);
         if (!chan)
             g_error("Couldn't create GIOChannel\n");
 
-        error = NULL;
-        g_io_channel_set_encoding(chan, encoding, &error);
-        if (error)
+        if (report != FALSE)
         {
-            fprintf(stdout,
-                    "clrasta: Error setting encoding for listcommand: %s\n",
-                    error->message ? error->message : "Unknown error");
-            g_clear_error(&error);
-        }
-
-        error = NULL;
-        status = g_io_channel_read_to_end(chan, &err_data, &err_len,
-                                          &error);
-        if (status != G_IO_STATUS_NORMAL)
-        {
-            fprintf(stderr,
-                    "clrasta: Unable to read listcommand data: %s\n",
-                    (error && error->message) ?
-                    error->message :
-                    "Unknown error");
+            error = NULL;
+            g_io_channel_set_encoding(chan, list->encoding, &error);
             if (error)
                 g_clear_error(&error);
-            goto out_stdout;
+
+            status = g_io_channel_read_to_end(chan, &err_data,
+                                              &err_len, &error);
+            if (status != G_IO_STATUS_NORMAL)
+            {
+                if (error)
+                    g_clear_error(&error);
+                g_free(err_data);
+                err_data = NULL;
+            }
         }
 
+        g_io_channel_shutdown(chan, FALSE, NULL);
         g_io_channel_unref(chan);
+        list->errfd = -1;
     }
 
-    while (rc < 0)
-    {
-        rc = waitpid(pid, &wstat, 0);
-        if ((rc == -1) && (errno != EINTR))
-            break;
-    }
-
-    if (rc < 0)
+    if (list->pid < 0)
     {
-        fprintf(stderr,
-                "clrasta: Error running listcommand: %s\n",
-                g_strerror(errno));
-        goto out_stderr;
+        g_free(err_data);
+        return;
     }
 
-    if ((rc > 0) && WIFEXITED(wstat) && !WEXITSTATUS(wstat))
+    rc = -1;
+    if (report == FALSE)
     {
-        if (err_data)
-            g_free(err_data);
-        err_data = NULL;
-
-        if (out_data && out_len > 0)
+        rc = waitpid(list->pid, &wstat, WNOHANG);
+        if (rc == 0)
         {
-            rc = -ENOMEM;
-            tmp = g_new(gchar, out_len + 1);
-            if (!tmp)
-                goto out_stdout;
-            memmove(tmp, out_data, out_len);
-            tmp[out_len] = '\0';
-            g_free(out_data);
-            out_data = tmp;
-
-            *items = g_strsplit(out_data, "\n", 0);
-            if (*items == NULL)
-                goto out_stdout;
-    
-            for (; (*items)[*num_items] != NULL; (*num_items)++);
-    
-            // Trailing "line"
-            if ((*items)[*num_items - 1][0] == '\0')
-            {
-                g_free((*items)[*num_items - 1]);
-                (*items)[*num_items - 1] = NULL;
-                (*num_items)--;
-            }
+            /* child_pgrp() made the command a process group */
+            kill(-list->pid, SIGTERM);
+            rc = waitpid(list->pid, &wstat, WNOHANG);
+        }
+        if (rc == 0)
+        {
+            clr_abandon_child(list->pid);
+            rc = -1;
         }
-        rc = 0;
     }
     else
     {
-        if (rc > 0)
+        while (rc < 0)
         {
-            if (WIFEXITED(wstat))
-                rc = WEXITSTATUS(wstat);
-            else
-                rc = -ECHILD;
-        }
-        else
-            rc = -errno;
-
-        if (err_data)
-        {
-            tmp = g_new(gchar, err_len + 1);
-            if (!tmp)
-                goto out_stderr;
-            memmove(tmp, err_data, err_len);
-            tmp[err_len] = '\0';
-            g_free(err_data);
-            err_data = tmp;
+            rc = waitpid(list->pid, &wstat, 0);
+            if ((rc == -1) && (errno != EINTR))
+                break;
         }
-        else
-            err_data = g_strdup("Unknown error");
+    }
+    if (rc > 0)
+    {
+        for (i = 0, bytes = 0; i < list->items->len; i++)
+            bytes += strlen(g_ptr_array_index(list->items, i));
+        rasta_trace_child_exited(list->pid, wstat, bytes);
+    }
+    list->pid = -1;
 
+    if ((report != FALSE) &&
+        ((rc < 0) || !WIFEXITED(wstat) || WEXITSTATUS(wstat)))
+    {
         fprintf(stderr,
                 "clrasta: An error occurred running the listcommand:\n"
-                "%s\n", err_data);
+                "%s\n",
+                (err_data && *err_data) ? err_data : "Unknown error");
     }
-    
-out_stderr:
+
     g_free(err_data);
-out_stdout:
-    g_free(out_data);
-out_encoding:
-    if (encoding)
-        g_free(encoding);
+}  /* clr_list_close() */
 
-    return(rc);
-}  /* run_listcommand() */
+
+/*
+ * static void clr_reap_abandoned(int sig)
+ *
+ * SIGCHLD handler.  Reaps the list commands clr_abandon_child() was
+ * given once they exit.  Other children are left to their callers.
+ */
+static void clr_reap_abandoned(int sig)
+{
+    gint i, saved_errno;
+
+    saved_errno = errno;
+    for (i = 0; i < CLR_ABANDONED_MAX; i++)
+    {
+        if ((abandoned_pids[i] > 0) &&
+            (waitpid(abandoned_pids[i], NULL, WNOHANG) != 0))
+            abandoned_pids[i] = 0;
+    }
+    errno = saved_errno;
+}  /* clr_reap_abandoned() */
+
+
+/*
+ * static void clr_abandon_child(pid_t pid)
+ *
+ * Leaves a terminated list command to be reaped by the SIGCHLD
+ * handler when it finally exits, so clrasta doesn't wait for it.
+ */
+static void clr_abandon_child(pid_t pid)
+{
+    struct sigaction sa;
+    sigset_t set, old;
+    gint i, rc;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, &old);
+
+    if (reap_installed == FALSE)
+    {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = clr_reap_abandoned;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+        sigaction(SIGCHLD, &sa, NULL);
+        reap_installed = TRUE;
+    }
+
+    for (i = 0; i < CLR_ABANDONED_MAX; i++)
+    {
+        if (abandoned_pids[i] == 0)
+        {
+            abandoned_pids[i] = pid;
+            break;
+        }
+    }
+
+    /* It may have exited before it was on the list */
+    clr_reap_abandoned(SIGCHLD);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    if (i < CLR_ABANDONED_MAX)
+        return;
+
+    /* No room to remember it, so make sure it goes now */
+    kill(-pid, SIGKILL);
+    do
+        rc = waitpid(pid, NULL, 0);
+    while ((rc == -1) && (errno == EINTR));
+}  /* clr_abandon_child() */
 
 
 /*
@@ -2496,9 +2995,9 @@ static CLRQueryResult run_dialog_field(RastaContext *ctxt,
 static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen)
 {
     CLRQueryResult ret_id;
-    gchar *title;
+    const gchar *title;
     gboolean retval, done;
-    REnumeration *en;
+    REnumeration en;
     RastaDialogField *d_field;
 
     g_return_val_if_fail(ctxt != NULL, FALSE);
@@ -2510,16 +3009,10 @@ static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen)
             return(TRUE);
     }
 
-    title = rasta_screen_get_title(screen);
+    title = rasta_screen_peek_title(screen);
 
-    en = rasta_dialog_screen_enumerate_fields(ctxt, screen);
-    if (en == NULL)
-    {
-        fprintf(stderr, "clrasta: An error occurred\n");
-        return(FALSE);
-    }
-
-    if (!r_enumeration_has_more(en))
+    rasta_dialog_screen_init_cursor(ctxt, screen, &en);
+    if (!r_enumeration_has_more(&en))
     {
         fprintf(stderr, "clrasta: There are no items of this type\n");
         return(FALSE);
@@ -2529,9 +3022,9 @@ static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen)
     retval = TRUE;
     done = FALSE;
     ret_id = CLR_QUERY_NONE;
-    while (r_enumeration_has_more(en))
+    while (r_enumeration_has_more(&en))
     {
-        d_field = RASTA_DIALOG_FIELD(r_enumeration_get_next(en));
+        d_field = RASTA_DIALOG_FIELD(r_enumeration_get_next(&en));
         ret_id = run_dialog_field(ctxt, screen, d_field);
         switch (ret_id)
         {
@@ -2567,9 +3060,6 @@ static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen)
         if (done)
             break;
     }
-    r_enumeration_free(en);
-
-    g_free(title);
 
     if ((ret_id == CLR_QUERY_SUCCESS) || (ret_id == CLR_QUERY_NONE))
         rasta_dialog_screen_next(ctxt);
@@ -2587,16 +3077,15 @@ static gboolean run_dialog(RastaContext *ctxt, RastaScreen *screen)
 static gboolean run_hidden(RastaContext *ctxt, RastaScreen *screen)
 {
 #if DEBUG
-    gchar *title;
+    const gchar *title;
 #endif
 
     g_return_val_if_fail(ctxt != NULL, FALSE);
     g_return_val_if_fail(screen != NULL, FALSE);
 
 #if DEBUG
-    title = rasta_screen_get_title(screen);
+    title = rasta_screen_peek_title(screen);
     g_print("Hidden screen \"%s\"\n", title);
-    g_free(title);
 #endif  /* DEBUG */
 
     if (rasta_initcommand_is_required(ctxt, screen) == FALSE)
@@ -2619,13 +3108,13 @@ static gboolean run_hidden(RastaContext *ctxt, RastaScreen *screen)
  */
 static gboolean run_action(RastaContext *ctxt, RastaScreen *screen)
 {
-    gchar *title, *cmd, *prompt, *conv;
+    const gchar *title;
+    gchar *cmd, *prompt, *conv;
     gboolean retval, done;
     CLRQueryResult ret_id;
     RastaTTYType tty;
     pid_t pid;
     gint rc, wstat;
-    gsize br, bw;
     GError *error;
     /* Needs win32 cmd.exe #ifdef */
     gchar *args[] = {"/bin/sh", "-c", NULL, NULL};
@@ -2634,10 +3123,9 @@ static gboolean run_action(RastaContext *ctxt, RastaScreen *screen)
     g_return_val_if_fail(ctxt != NULL, FALSE);
     g_return_val_if_fail(screen != NULL, FALSE);
 
-    title = rasta_screen_get_title(screen);
+    title = rasta_screen_peek_title(screen);
 
     pretty_print_title(title);
-    g_free(title);
 
     fprintf(stdout, "\n");
 
@@ -2655,7 +3143,7 @@ static gboolean run_action(RastaContext *ctxt, RastaScreen *screen)
     }
 
     error = NULL;
-    conv = g_locale_from_utf8(cmd, -1, &br, &bw, &error);
+    conv = rasta_exec_locale_from_utf8(cmd, &error);
     g_free(cmd);
     if (error)
     {
@@ -2707,6 +3195,7 @@ static gboolean run_action(RastaContext *ctxt, RastaScreen *screen)
     }
     else if (pid > 1)
     {
+        rasta_profile_action(ctxt, pid);
         rc = -1;
         while (rc != pid)
         {
@@ -2714,6 +3203,8 @@ static gboolean run_action(RastaContext *ctxt, RastaScreen *screen)
              if ((rc < 0) && (errno != EINTR))
                  break;
         }
+        if (rc == pid)
+            rasta_trace_child_exited(pid, wstat, 0);
         if ((rc == pid) && WIFEXITED(wstat) && !WEXITSTATUS(wstat))
             fprintf(stdout, "clrasta: Action completed successfully\n");
         else
@@ -2772,7 +3263,7 @@ gint main (gint argc, gchar *argv[])
     gboolean done;
     RastaContext *ctxt;
     RastaScreen *screen;
-    CLROptions options = {FALSE, NULL, NULL, NULL};
+    CLROptions options = {FALSE, NULL, NULL, NULL, NULL, NULL};
 
     if (load_options(argc, argv, &options) == FALSE)
     {
@@ -2780,6 +3271,21 @@ gint main (gint argc, gchar *argv[])
         return(-EINVAL);
     }
 
+    if (options.trace_filename != NULL)
+    {
+        rc = rasta_trace_chrome_start(options.trace_filename);
+        if (rc != 0)
+        {
+            fprintf(stderr, "clrasta: Unable to open trace file %s: %s\n",
+                    options.trace_filename, g_strerror(-rc));
+            return(rc);
+        }
+    }
+
+    if (options.profile_filename != NULL)
+        rasta_profile_start(options.profile_filename,
+                            RASTA_PROFILE_INTERVAL);
+
     ctxt = load_context(&options);
     if (ctxt == NULL)
     {
@@ -2848,5 +3354,7 @@ gint main (gint argc, gchar *argv[])
     }
 
     rasta_context_destroy(ctxt);
+    rasta_trace_chrome_stop();
+    rasta_profile_stop();
     return(rc);
 }  /* main() */
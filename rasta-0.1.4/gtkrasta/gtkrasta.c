@@ -46,6 +46,11 @@
  */
 #define GTK_RASTA_ERROR gtk_rasta_error_quark()
 #define NUM_READ_PAGES 4
+#define LC_BATCH_ROWS 2048
+#define AC_FLUSH_INTERVAL 40            /* ms, 25 updates a second */
+#define AC_MAX_PARTIAL (64 * 1024)      /* Longest unterminated line */
+#define AC_SCROLLBACK_LINES 10000
+#define AC_SCROLLBACK_BYTES (1024 * 1024)
 
 #ifdef DEBUG
 #define d_print g_print
@@ -79,14 +84,27 @@ struct _GtkRastaContext
 {
     gchar *filename;
     gchar *fastpath;
+    gchar *log_filename;
+    gchar *trace_filename;
+    gchar *profile_filename;
+    guint scrollback_lines;     /* 0 is unlimited */
+    gsize scrollback_bytes;     /* 0 is unlimited */
     RastaContext *ctxt;
     GtkWidget *main_pane;
-    GIOChannel *child_out_chan;
-    GIOChannel *child_err_chan;
-    gchar *child_out_data;
-    gchar *child_err_data;
+    GString *child_out;
+    GString *child_err;
+    GPtrArray *child_rows;      /* LISTCOMMAND rows not yet stored */
+    guint child_row_pos;
+    gint child_row_count;
+    gint child_select;          /* Choice id to select, or -1 */
+    guint child_idle;
+    gboolean child_exited;
+    GString *child_pending;     /* Action output awaiting a flush */
+    guint child_flush;
+    gsize child_bytes;          /* Bytes in the action output buffer */
+    guint child_tags;           /* Streams already flagged */
+    FILE *child_log;
     pid_t child_pid;
-    gint child_status;
     gpointer child_data;
 };
 
@@ -154,28 +172,28 @@ static void do_list_response(GtkWidget *widget,
 
 /* Initcommands */
 static void ic_start(GtkRastaContext *main_ctxt);
-static gboolean ic_timeout(gpointer user_data);
-
-static gboolean ic_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
-static gboolean ic_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
+static void ic_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data);
 
 /* Listcommands */
 static void lc_start(GtkRastaContext *main_ctxt,
                      RastaDialogField *field);
-static gboolean lc_timeout(gpointer user_data);
+static void lc_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data);
 static void lc_maybe_add(GtkRastaContext *main_ctxt,
                          GString *data,
                          gboolean done);
-static gboolean lc_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
-static gboolean lc_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
+static void lc_output(RastaExecStream stream,
+                      const gchar *data,
+                      gsize len,
+                      gpointer user_data);
+static gboolean lc_idle(gpointer user_data);
+static void lc_finish(GtkRastaContext *main_ctxt);
+static void lc_clear_rows(GtkRastaContext *main_ctxt);
 static void pop_choice_foreach(GtkTreeModel *model,
                                GtkTreePath *path,
                                GtkTreeIter *iter,
@@ -185,6 +203,13 @@ static void pop_choice_dialog(GtkRastaContext *main_ctxt,
 static void add_choice_item(GtkRastaContext *main_ctxt,
                             const gchar *item,
                             gboolean selected);
+static gboolean choice_dialog_visible(GtkTreeModel *model,
+                                      GtkTreeIter *iter,
+                                      gpointer user_data);
+static void choice_dialog_attach(GtkRastaContext *main_ctxt,
+                                 GtkWidget *dialog);
+static void do_choice_filter_changed(GtkWidget *widget,
+                                     gpointer user_data);
 static void pop_list_dialog(GtkRastaContext *main_ctxt,
                             GtkWidget *widget);
 static void pop_ring_dialog(GtkRastaContext *main_ctxt,
@@ -198,14 +223,19 @@ static void ac_tag_output(GtkRastaContext *main_ctxt,
                           const gchar *stream);
 static void ac_maybe_output(GtkRastaContext *main_ctxt,
                             GString *data,
+                            const gchar *new_data,
+                            gsize len,
                             gboolean done);
-static gboolean ac_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
-static gboolean ac_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data);
-static gboolean ac_timeout(gpointer user_data);
+static gboolean ac_flush_timeout(gpointer user_data);
+static void ac_flush(GtkRastaContext *main_ctxt);
+static void ac_output(RastaExecStream stream,
+                      const gchar *data,
+                      gsize len,
+                      gpointer user_data);
+static void ac_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data);
 
 /* Initialization */
 static gboolean init_in_func(GIOChannel *chan,
@@ -214,6 +244,7 @@ static gboolean init_in_func(GIOChannel *chan,
 static gboolean init_start_func(gpointer user_data);
 static gboolean load_options(gint argc, gchar *argv[],
                              GtkRastaContext *main_ctxt);
+static gulong load_option_count(const gchar *arg, gulong max);
 
 /* Screen monkeying */
 static void build_screen(GtkRastaContext *main_ctxt);
@@ -489,7 +520,6 @@ static void do_numeric_insert_text(GtkWidget *widget,
     gboolean err, done, have_sign, have_dp;
     gunichar c, dp, ns, ps;
     gchar *curtext, *text, *ptr;
-    struct lconv *lc;
     
     err = TRUE;
     curtext = NULL;
@@ -511,33 +541,7 @@ static void do_numeric_insert_text(GtkWidget *widget,
 
     position = *(gint *)arg3;
 
-    lc = localeconv();
-    if (lc->decimal_point)
-    {
-        ptr = g_locale_to_utf8(lc->decimal_point, -1, NULL, NULL, NULL);
-        dp = g_utf8_get_char(ptr);
-        g_free(ptr);
-    }
-    else
-        dp = g_utf8_get_char(".");
-   
-    if (*(lc->negative_sign))
-    {
-        ptr = g_locale_to_utf8(lc->negative_sign, -1, NULL, NULL, NULL);
-        ns = g_utf8_get_char(ptr);
-        g_free(ptr);
-    }
-    else
-        ns = g_utf8_get_char("-");
- 
-    if (*(lc->positive_sign))
-    {
-        ptr = g_locale_to_utf8(lc->positive_sign, -1, NULL, NULL, NULL);
-        ps = g_utf8_get_char(ptr);
-        g_free(ptr);
-    }
-    else
-        ps = g_utf8_get_char("+");
+    rasta_get_number_locale(&dp, &ns, &ps);
 
     done = FALSE;
     have_sign = FALSE;
@@ -626,7 +630,7 @@ static void do_menu_help(GtkWidget *widget, gpointer user_data)
 {
     RastaMenuItem *item;
     GtkRastaContext *main_ctxt;
-    gchar *help_text;
+    const gchar *help_text;
 
     g_assert(widget != NULL);
     g_assert(user_data != NULL);
@@ -636,9 +640,8 @@ static void do_menu_help(GtkWidget *widget, gpointer user_data)
                                              "item"));
     g_assert(item != NULL);
 
-    help_text = rasta_menu_item_get_help(item);
+    help_text = rasta_menu_item_peek_help(item);
     pop_help(main_ctxt, help_text);
-    g_free(help_text);
 }  /* do_menu_help() */
 
 
@@ -651,7 +654,7 @@ static void do_dialog_help(GtkWidget *widget, gpointer user_data)
 {
     RastaDialogField *field;
     GtkRastaContext *main_ctxt;
-    gchar *help_text;
+    const gchar *help_text;
 
     g_assert(widget != NULL);
     g_assert(user_data != NULL);
@@ -661,9 +664,8 @@ static void do_dialog_help(GtkWidget *widget, gpointer user_data)
                                                  "field"));
     g_assert(field != NULL);
 
-    help_text = rasta_dialog_field_get_help(field);
+    help_text = rasta_dialog_field_peek_help(field);
     pop_help(main_ctxt, help_text);
-    g_free(help_text);
 }  /* do_dialog_help() */
 
 
@@ -743,15 +745,15 @@ static void create_dialog_widget_readonly(GtkRastaContext *main_ctxt,
                                           RastaDialogField *field)
                                  
 {
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     GtkWidget *widget;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_ENTRY));
     value = rasta_symbol_lookup(main_ctxt->ctxt, name);
-    g_free(name);
     widget = gtk_entry_new();
     gtk_entry_set_text(GTK_ENTRY(widget),
                        value ? value : "");
@@ -776,11 +778,12 @@ static void create_dialog_widget_entry(GtkRastaContext *main_ctxt,
                                        RastaDialogField *field)
 {
     guint length;
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     GtkWidget *widget;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_ENTRY));
 
@@ -826,12 +829,13 @@ static void create_dialog_widget_entrylist(GtkRastaContext *main_ctxt,
                                            RastaDialogField *field)
 { 
     guint length;
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     GtkWidget *widget, *image;
     GtkTooltips *tips;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_ENTRYLIST));
 
@@ -887,12 +891,13 @@ static void create_dialog_widget_file(GtkRastaContext *main_ctxt,
                                       GtkWidget *parent,
                                       RastaDialogField *field)
 {
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     GtkWidget *widget, *image;
     GtkTooltips *tips;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                         GINT_TO_POINTER(RASTA_FIELD_FILE));
 
@@ -930,12 +935,13 @@ static void create_dialog_widget_list(GtkRastaContext *main_ctxt,
                                       GtkWidget *parent,
                                       RastaDialogField *field)
 {
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     GtkWidget *widget, *image;
     GtkTooltips *tips;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_LIST));
 
@@ -976,14 +982,15 @@ static void create_dialog_widget_ring(GtkRastaContext *main_ctxt,
                                       GtkWidget *parent,
                                       RastaDialogField *field)
 {
-    gchar *name, *value, *r_value, *text;
+    const gchar *name, *r_value, *text;
+    gchar *value;
     GtkWidget *widget, *image;
-    REnumeration *er;
+    REnumeration er;
     RastaRingValue *r_item;
     GtkTooltips *tips;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_RING));
 
@@ -994,20 +1001,18 @@ static void create_dialog_widget_ring(GtkRastaContext *main_ctxt,
     if ((value != NULL) && (value[0] != '\0'))
     {
         text = NULL;
-        er = rasta_dialog_field_enumerate_ring(field);
-        while (r_enumeration_has_more(er))
+        rasta_dialog_field_init_ring_cursor(field, &er);
+        while (r_enumeration_has_more(&er))
         {
-            r_item = RASTA_RING_VALUE(r_enumeration_get_next(er));
+            r_item = RASTA_RING_VALUE(r_enumeration_get_next(&er));
             g_assert(r_item != NULL);
-            r_value = rasta_ring_value_get_value(r_item);
+            r_value = rasta_ring_value_peek_value(r_item);
             if (strcmp(r_value, value) == 0)
             {
-                g_free(r_value);
-                text = rasta_ring_value_get_text(r_item);
+                text = rasta_ring_value_peek_text(r_item);
                 break;
             }
         }
-        r_enumeration_free(er);
         gtk_entry_set_text(GTK_ENTRY(widget), text ? text : "");
     }
     else
@@ -1071,11 +1076,12 @@ static void create_dialog_widget_ip_addr(GtkRastaContext *main_ctxt,
 {
     gint i;
     GtkWidget *widget;
-    gchar *name, *value;
+    const gchar *name;
+    gchar *value;
     gchar **octets;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_IPADDR));
 
@@ -1158,12 +1164,13 @@ static void create_dialog_widget_volume(GtkRastaContext *main_ctxt,
                                         RastaDialogField *field)
 {
     gdouble curvol;
-    gchar *name, *value, *ptr;
+    const gchar *name;
+    gchar *value, *ptr;
     GtkObject *adjustment;
     GtkWidget *widget;
 
-    name = rasta_dialog_field_get_symbol_name(field);
-    g_object_set_data(G_OBJECT(parent), "name", name);
+    name = rasta_dialog_field_peek_symbol_name(field);
+    g_object_set_data(G_OBJECT(parent), "name", (gpointer)name);
     g_object_set_data(G_OBJECT(parent), "type",
                       GINT_TO_POINTER(RASTA_FIELD_VOLUME));
 
@@ -1314,10 +1321,10 @@ static gboolean build_dialog_screen(GtkRastaContext *main_ctxt,
     GtkWidget *wbox, *r_image;
     GtkTooltips *tips;
     gint page_num, row;
-    REnumeration *en;
+    REnumeration en;
     RastaDialogField *field;
     RastaDialogFieldType type;
-    gchar *text, *name;
+    const gchar *text;
 
     g_assert(main_ctxt != NULL);
     g_assert(screen != NULL);
@@ -1356,35 +1363,32 @@ static gboolean build_dialog_screen(GtkRastaContext *main_ctxt,
     {
         ditem = GTK_WIDGET(elem->data);
         g_assert(ditem != NULL);
-        name = (gchar *)g_object_get_data(G_OBJECT(ditem), "name");
-        g_free(name);
         gtk_container_remove(GTK_CONTAINER(dialog), ditem);
         elem = g_list_next(elem);
     }
     g_list_free(children);
-    gtk_table_resize(GTK_TABLE(dialog), 1, 5);
 
-    en = rasta_dialog_screen_enumerate_fields(main_ctxt->ctxt, screen);
-    if (r_enumeration_has_more(en) == FALSE)
+    rasta_dialog_screen_init_cursor(main_ctxt->ctxt, screen, &en);
+    if (r_enumeration_has_more(&en) == FALSE)
     {
-        r_enumeration_free(en);
+        gtk_table_resize(GTK_TABLE(dialog), 1, 5);
         /* TIMBOIZE */
         pop_error(main_ctxt, "There are no items of this type.");
         return(FALSE);
     }
+    gtk_table_resize(GTK_TABLE(dialog), r_enumeration_count(&en), 5);
 
     row = 0;
     field_widgets = NULL;
-    while (r_enumeration_has_more(en))
+    while (r_enumeration_has_more(&en))
     {
-        field = RASTA_DIALOG_FIELD(r_enumeration_get_next(en));
+        field = RASTA_DIALOG_FIELD(r_enumeration_get_next(&en));
         g_assert(field != NULL);
 
-        text = rasta_dialog_field_get_text(field);
+        text = rasta_dialog_field_peek_text(field);
         tbox = gtk_hbox_new(FALSE, 2);
         tlabel = gtk_label_new(text);
         gtk_label_set_line_wrap(GTK_LABEL(tlabel), TRUE);
-        g_free(text);
         gtk_label_set_justify(GTK_LABEL(tlabel), GTK_JUSTIFY_LEFT);
         gtk_box_pack_start(GTK_BOX(tbox), tlabel, FALSE, FALSE, 2);
 
@@ -1524,10 +1528,10 @@ static gboolean build_menu_screen(GtkRastaContext *main_ctxt,
     GtkWidget *tog_button, *menu, *screen_frame, *panes, *menu_pane;
     GtkWidget *tog_box, *h_button, *h_image;
     GtkTooltips *tips;
-    REnumeration *en;
+    REnumeration en;
     RastaMenuItem *item;
     GList *buttons, *elem;
-    gchar *item_text, *item_id;
+    const gchar *item_text, *item_id;
     gint page_num;
 
     g_assert(main_ctxt != NULL);
@@ -1558,22 +1562,21 @@ static gboolean build_menu_screen(GtkRastaContext *main_ctxt,
                                      "menu"));
     g_assert(menu != NULL);
 
-    en = rasta_menu_screen_enumerate_items(main_ctxt->ctxt, screen);
-    if (r_enumeration_has_more(en) == FALSE)
+    rasta_menu_screen_init_cursor(main_ctxt->ctxt, screen, &en);
+    if (r_enumeration_has_more(&en) == FALSE)
     {
-        r_enumeration_free(en);
         /* TIMBOIZE */
         pop_error(main_ctxt, "There are no items of this type.");
         return(FALSE);
     }
 
     elem = buttons = gtk_container_get_children(GTK_CONTAINER(menu));
-    while (r_enumeration_has_more(en))
+    while (r_enumeration_has_more(&en))
     {
-        item = RASTA_MENU_ITEM(r_enumeration_get_next(en));
+        item = RASTA_MENU_ITEM(r_enumeration_get_next(&en));
         g_assert(item != NULL);
-        item_text = rasta_menu_item_get_text(item);
-        item_id = rasta_menu_item_get_id(item);
+        item_text = rasta_menu_item_peek_text(item);
+        item_id = rasta_menu_item_peek_id(item);
         g_assert((item_text != NULL) && (item_id != NULL));
 
         if (elem != NULL)
@@ -1627,9 +1630,8 @@ static gboolean build_menu_screen(GtkRastaContext *main_ctxt,
             gtk_box_pack_start(GTK_BOX(menu), tog_box,
                                FALSE, FALSE, 2);
         }
-        g_free(item_text);
         g_object_set_data(G_OBJECT(tog_button), "next_id",
-                          item_id);
+                          (gpointer)item_id);
         g_signal_handlers_block_by_func(G_OBJECT(tog_button),
                                         do_menu_item_toggled,
                                         main_ctxt);
@@ -1639,7 +1641,6 @@ static gboolean build_menu_screen(GtkRastaContext *main_ctxt,
                                           do_menu_item_toggled,
                                           main_ctxt);
     }
-    r_enumeration_free(en);
 
     /* Remove extra items */
     while (elem != NULL)
@@ -1670,7 +1671,7 @@ static gboolean build_menu_screen(GtkRastaContext *main_ctxt,
  */
 static void build_screen(GtkRastaContext *main_ctxt)
 {
-    gchar *title;
+    const gchar *title;
     RastaScreen *screen;
     GtkWidget *screen_frame;
     gboolean done;
@@ -1690,7 +1691,7 @@ static void build_screen(GtkRastaContext *main_ctxt)
             return;
         }
     
-        title = rasta_screen_get_title(screen);
+        title = rasta_screen_peek_title(screen);
         
         screen_frame =
             GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
@@ -1744,8 +1745,6 @@ static void build_screen(GtkRastaContext *main_ctxt)
             default:
                 g_assert_not_reached();
         }
-
-        g_free(title);
     }
     while (done == FALSE);
 }  /* build_screen() */
@@ -1778,6 +1777,9 @@ static void print_usage(gint rc)
 
     out = rc ? stderr : stdout;
     fprintf(out, "Usage: gtkrasta [--file <filename>] [<fastpath>]\n"
+                 "                [--log <filename>] [--scrollback <lines>]\n"
+                 "                [--scrollback-bytes <bytes>]\n"
+                 "                [--trace <filename>] [--profile <filename>]\n"
                  "       gtkrasta --help\n");
     exit(rc);
 }  /* print_usage() */
@@ -1806,6 +1808,21 @@ static gboolean init_start_func(gpointer user_data)
 
     g_assert(main_ctxt->filename != NULL);
 
+    /*
+     * Follow changes made by rastaadd and rastadel while we run.
+     * The watch has parsed the file already, so skip the push.
+     */
+    if (rasta_watch_description(main_ctxt->filename) == 0)
+    {
+        main_ctxt->ctxt = rasta_context_init(main_ctxt->filename,
+                                             main_ctxt->fastpath);
+        if (main_ctxt->ctxt != NULL)
+        {
+            build_screen(main_ctxt);
+            return(FALSE);
+        }
+    }
+
     main_ctxt->ctxt = rasta_context_init_push(main_ctxt->filename,
                                               main_ctxt->fastpath);
 
@@ -1962,434 +1979,246 @@ static void ic_start(GtkRastaContext *main_ctxt)
     }
 
     encoding = rasta_initcommand_get_encoding(screen);
-
-    main_ctxt->child_out_chan = g_io_channel_unix_new(outfd);
-    g_io_channel_set_flags(main_ctxt->child_out_chan,
-                           G_IO_FLAG_NONBLOCK,
-                           NULL);
-    g_io_channel_set_encoding(main_ctxt->child_out_chan, encoding, NULL);
-    g_io_add_watch_full(main_ctxt->child_out_chan,
-                        G_PRIORITY_LOW,
-                        G_IO_IN | G_IO_HUP | G_IO_ERR,
-                        ic_out_func,
-                        main_ctxt,
-                        NULL);
-    g_io_channel_unref(main_ctxt->child_out_chan);
-
-    main_ctxt->child_err_chan = g_io_channel_unix_new(errfd);
-    g_io_channel_set_flags(main_ctxt->child_err_chan,
-                           G_IO_FLAG_NONBLOCK,
-                           NULL);
-    g_io_channel_set_encoding(main_ctxt->child_err_chan, encoding, NULL);
-    g_io_add_watch_full(main_ctxt->child_err_chan,
-                        G_PRIORITY_LOW,
-                        G_IO_IN | G_IO_HUP | G_IO_ERR,
-                        ic_err_func,
-                        main_ctxt,
-                        NULL);
-    g_io_channel_unref(main_ctxt->child_err_chan);
-    
+    rc = rasta_exec_watch_child(NULL, main_ctxt->child_pid,
+                                outfd, errfd, encoding,
+                                RASTA_EXEC_STREAM_NONE,
+                                NULL, ic_done, main_ctxt);
+    g_assert(rc == 0);
     g_free(encoding);
-
-    g_timeout_add(100, ic_timeout, main_ctxt);
 }  /* ic_start() */
 
 
 /*
- * static gboolean ic_timeout(gpointer user_data)
+ * static void ic_done(gint status,
+ *                     const gchar *out_data,
+ *                     const gchar *err_data,
+ *                     gpointer user_data)
  *
- * Timeout function to check whether the INITCOMMAND has finished
+ * Called once the INITCOMMAND has exited and its pipes have closed
  */
-static gboolean ic_timeout(gpointer user_data)
+static void ic_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data)
 {
-    gint rc;
     GtkRastaContext *main_ctxt;
     RastaScreen *screen;
+    gchar *output;
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
+    g_return_if_fail(user_data != NULL);
 
     main_ctxt = (GtkRastaContext *)user_data;
+    main_ctxt->child_pid = -1;
 
-    if (main_ctxt->child_pid > 0)
+    screen = rasta_context_get_screen(main_ctxt->ctxt);
+
+    if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
     {
-        rc = waitpid(main_ctxt->child_pid,
-                     &(main_ctxt->child_status),
-                     WNOHANG);
-        if (rc > 0)
-            main_ctxt->child_pid = -1;
-        else if ((rc < 0) && (errno == ECHILD))
-            g_assert_not_reached();
+        output = g_strdup(out_data != NULL ? out_data : "");
+        rasta_initcommand_complete(main_ctxt->ctxt, screen, output);
+        g_free(output);
     }
-
-    if ((main_ctxt->child_pid < 0) &&
-        (main_ctxt->child_out_chan == NULL) &&
-        (main_ctxt->child_err_chan == NULL))
+    else
     {
-        /* Clear our timeout before doing work */
-        g_source_remove_by_user_data(user_data);
-
-        screen = rasta_context_get_screen(main_ctxt->ctxt);
-
-        if (WIFEXITED(main_ctxt->child_status) &&
-            (WEXITSTATUS(main_ctxt->child_status) == 0))
-        {
-            if (main_ctxt->child_out_data == NULL)
-                main_ctxt->child_out_data = g_strdup("");
-
-            rasta_initcommand_complete(main_ctxt->ctxt,
-                                       screen,
-                                       main_ctxt->child_out_data);
-        }
-        else
-        {
-            pop_error(main_ctxt, main_ctxt->child_err_data);
-            rasta_initcommand_failed(main_ctxt->ctxt, screen);
-        }
-
-        if (main_ctxt->child_out_data != NULL)
-        {
-            g_free(main_ctxt->child_out_data);
-            main_ctxt->child_out_data = NULL;
-        }
-        if (main_ctxt->child_err_data != NULL)
-        {
-            g_free(main_ctxt->child_err_data);
-            main_ctxt->child_err_data = NULL;
-        }
-        build_screen(main_ctxt);
-        return(FALSE);
+        pop_error(main_ctxt, err_data);
+        rasta_initcommand_failed(main_ctxt->ctxt, screen);
     }
 
-    return(TRUE);
-}  /* ic_timeout() */
+    build_screen(main_ctxt);
+}  /* ic_done() */
 
 
 /*
- * static gboolean ic_out_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
+ * static void lc_start(GtkRastaContext *main_ctxt,
+ *                      RastaDialogField *field)
  *
- * Function to read data from an INITCOMMAND's STDOUT.
+ * Starts a LISTCOMMAND in the background.
  */
-static gboolean ic_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
+static void lc_start(GtkRastaContext *main_ctxt,
+                     RastaDialogField *field)
 {
-    GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *out = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
-
-    g_return_val_if_fail(user_data != NULL, FALSE);
-
-    if (out == NULL)
-        out = g_string_new(NULL);
+    gint outfd, errfd, rc;
+    gchar *encoding;
 
-    if (buffer == NULL)
-    {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
-    }
+    g_assert(main_ctxt != NULL);
+    g_assert(field != NULL);
 
-    d_print("IN = %s, HUP = %s, ERR = %s\n",
-            cond & G_IO_IN ? "true" : "false",
-            cond & G_IO_HUP ? "true" : "false",
-            cond & G_IO_ERR ? "true" : "false");
-    cont = TRUE;
-    main_ctxt = (GtkRastaContext *)user_data;
-    err = NULL;
-    d_print("Calling read_chars\n");
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
+    rc = rasta_listcommand_run(main_ctxt->ctxt, field,
+                               &(main_ctxt->child_pid),
+                               &outfd, &errfd);
+    if (rc != 0)
     {
-        case G_IO_STATUS_EOF:
-            d_print("Status EOF\n");
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
-
-        case G_IO_STATUS_NORMAL:
-            d_print("Status NORMAL\n");
-            d_print("Bytes read = %d\n", bytes_read);
-            g_assert(bytes_read > 0);
-            g_string_append_len(out, buffer, bytes_read);
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            d_print("Status AGAIN\n");
-            break;
-
-        case G_IO_STATUS_ERROR:
-            d_print("Status ERROR\n");
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
+        /* TIMBOIZE */
+        pop_error(main_ctxt, "Error generating list");
+        finish_activity(main_ctxt);
+        return;
     }
 
-    d_print("Chan refcount = %d\n", chan->ref_count);
-    if (cont == FALSE)
-    {
-        d_print("Calling shutdown\n");
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_out_chan = NULL;
-        if (out->len > 0)
-            main_ctxt->child_out_data = g_strdup(out->str);
-        g_string_free(out, TRUE);
-        out = NULL;
-    }
+    main_ctxt->child_out = g_string_new(NULL);
+    main_ctxt->child_rows = g_ptr_array_new();
+    main_ctxt->child_row_pos = 0;
+    main_ctxt->child_row_count = 0;
+    main_ctxt->child_select = -1;
+    main_ctxt->child_exited = FALSE;
 
-    d_print("cont = %s\n", cont ? "true" : "false");
-    return(cont);
-}  /* ic_out_func() */
+    encoding = rasta_listcommand_get_encoding(field);
+    rc = rasta_exec_watch_child(NULL, main_ctxt->child_pid,
+                                outfd, errfd, encoding,
+                                RASTA_EXEC_STREAM_STDOUT,
+                                lc_output, lc_done, main_ctxt);
+    g_assert(rc == 0);
+    g_free(encoding);
+}  /* lc_start() */
 
 
 /*
- * static gboolean ic_err_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
+ * static void lc_done(gint status,
+ *                     const gchar *out_data,
+ *                     const gchar *err_data,
+ *                     gpointer user_data)
  *
- * Function to read data from an INITCOMMAND's STDERR.
+ * Called when the LISTCOMMAND has exited.  Rows still waiting for
+ * lc_idle() are stored before the dialog is finished.
  */
-static gboolean ic_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
+static void lc_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data)
 {
+    GtkWidget *dialog;
     GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *ers = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
+    g_return_if_fail(user_data != NULL);
 
-    if (ers == NULL)
-        ers = g_string_new(NULL);
+    main_ctxt = (GtkRastaContext *)user_data;
+    main_ctxt->child_pid = -1;
 
-    if (buffer == NULL)
+    if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
     {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
+        main_ctxt->child_exited = TRUE;
+        if (main_ctxt->child_idle == 0)
+            lc_finish(main_ctxt);
+        return;
     }
 
-    cont = TRUE;
-    main_ctxt = (GtkRastaContext *)user_data;
-    err = NULL;
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
-    {
-        case G_IO_STATUS_EOF:
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
-
-        case G_IO_STATUS_NORMAL:
-            g_assert(bytes_read > 0);
-            g_string_append_len(ers, buffer, bytes_read);
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            break;
+    lc_clear_rows(main_ctxt);
 
-        case G_IO_STATUS_ERROR:
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
-    }
+    dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
+                                          "dialog"));
+    g_assert(dialog != NULL);
 
-    if (cont == FALSE)
-    {
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_err_chan = NULL;
-        if (ers->len > 0)
-            main_ctxt->child_err_data = g_strdup(ers->str);
-        g_string_free(ers, TRUE);
-        ers = NULL;
-    }
-    return(cont);
-}  /* ic_err_func() */
+    pop_error(main_ctxt, err_data);
+    gtk_widget_destroy(dialog);
+    finish_activity(main_ctxt);
+}  /* lc_done() */
 
 
 /*
- * static void lc_start(GtkRastaContext *main_ctxt,
- *                      RastaDialogField *field)
+ * static void lc_clear_rows(GtkRastaContext *main_ctxt)
  *
- * Starts a LISTCOMMAND in the background.
+ * Drops any rows not yet stored and stops the idle loader.
  */
-static void lc_start(GtkRastaContext *main_ctxt,
-                     RastaDialogField *field)
+static void lc_clear_rows(GtkRastaContext *main_ctxt)
 {
-    gint outfd, errfd, rc;
-    gchar *encoding;
+    guint i;
 
     g_assert(main_ctxt != NULL);
-    g_assert(field != NULL);
 
-    rc = rasta_listcommand_run(main_ctxt->ctxt, field,
-                               &(main_ctxt->child_pid),
-                               &outfd, &errfd);
-    if (rc != 0)
+    if (main_ctxt->child_idle != 0)
     {
-        /* TIMBOIZE */
-        pop_error(main_ctxt, "Error generating list");
-        finish_activity(main_ctxt);
-        return;
+        g_source_remove(main_ctxt->child_idle);
+        main_ctxt->child_idle = 0;
     }
 
-    encoding = rasta_listcommand_get_encoding(field);
-
-    main_ctxt->child_out_chan = g_io_channel_unix_new(outfd);
-    g_io_channel_set_flags(main_ctxt->child_out_chan,
-                           G_IO_FLAG_NONBLOCK,
-                           NULL);
-    g_io_channel_set_encoding(main_ctxt->child_out_chan, encoding, NULL);
-    g_io_add_watch_full(main_ctxt->child_out_chan,
-                        G_PRIORITY_LOW,
-                        G_IO_IN | G_IO_HUP | G_IO_ERR,
-                        lc_out_func,
-                        main_ctxt,
-                        NULL);
-    g_io_channel_unref(main_ctxt->child_out_chan);
-
-    main_ctxt->child_err_chan = g_io_channel_unix_new(errfd);
-    g_io_channel_set_flags(main_ctxt->child_err_chan,
-                           G_IO_FLAG_NONBLOCK,
-                           NULL);
-    g_io_channel_set_encoding(main_ctxt->child_err_chan, encoding, NULL);
-    g_io_add_watch_full(main_ctxt->child_err_chan,
-                        G_PRIORITY_LOW,
-                        G_IO_IN | G_IO_HUP | G_IO_ERR,
-                        lc_err_func,
-                        main_ctxt,
-                        NULL);
-    g_io_channel_unref(main_ctxt->child_err_chan);
-
-    g_free(encoding);
-
-    g_timeout_add(100, lc_timeout, main_ctxt);
-}  /* lc_start() */
+    if (main_ctxt->child_rows != NULL)
+    {
+        for (i = main_ctxt->child_row_pos;
+             i < main_ctxt->child_rows->len;
+             i++)
+            g_free(g_ptr_array_index(main_ctxt->child_rows, i));
+        g_ptr_array_free(main_ctxt->child_rows, TRUE);
+        main_ctxt->child_rows = NULL;
+    }
+    main_ctxt->child_row_pos = 0;
+}  /* lc_clear_rows() */
 
 
 /*
- * static gboolean lc_timeout(gpointer user_data)
+ * static gboolean lc_idle(gpointer user_data)
  *
- * Timeout to check for LISTCOMMAND completion.
+ * Idle function that moves up to LC_BATCH_ROWS pending rows into
+ * the choice dialog per run.
  */
-static gboolean lc_timeout(gpointer user_data)
+static gboolean lc_idle(gpointer user_data)
 {
-    GtkWidget *dialog, *tv;
-    GtkTreeSelection *sel;
-    GtkTreeModel *model;
-    GtkTreeIter iter;
-    GtkTreePath *path;
-    gint rc;
-    RastaDialogField *field;
     GtkRastaContext *main_ctxt;
+    GPtrArray *rows;
+    gchar *row;
+    guint end;
 
     g_return_val_if_fail(user_data != NULL, FALSE);
 
     main_ctxt = (GtkRastaContext *)user_data;
-    g_assert(main_ctxt != NULL);
+    rows = main_ctxt->child_rows;
+    g_assert(rows != NULL);
 
-    if (main_ctxt->child_pid > 0)
+    end = MIN(main_ctxt->child_row_pos + LC_BATCH_ROWS, rows->len);
+    for (; main_ctxt->child_row_pos < end; main_ctxt->child_row_pos++)
     {
-        rc = waitpid(main_ctxt->child_pid,
-                     &(main_ctxt->child_status),
-                     WNOHANG);
-        if (rc > 0)
-            main_ctxt->child_pid = -1;
-        else if ((rc < 0) && (errno == ECHILD))
-            g_assert_not_reached();
+        row = g_ptr_array_index(rows, main_ctxt->child_row_pos);
+        add_choice_item(main_ctxt, row, FALSE);
+        g_free(row);
     }
 
-    if ((main_ctxt->child_pid < 0) &&
-        (main_ctxt->child_out_chan == NULL) &&
-        (main_ctxt->child_err_chan == NULL))
-    {
-        /* Clear our timeout before doing work */
-        g_source_remove_by_user_data(user_data);
+    if (main_ctxt->child_row_pos < rows->len)
+        return(TRUE);
 
-        dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
-                                              "dialog"));
-        g_assert(dialog != NULL);
+    /* Everything queued so far is stored, reuse the array */
+    g_ptr_array_set_size(rows, 0);
+    main_ctxt->child_row_pos = 0;
+    main_ctxt->child_idle = 0;
 
-        if (WIFEXITED(main_ctxt->child_status) &&
-            (WEXITSTATUS(main_ctxt->child_status) == 0))
-        {
-            tv = GTK_WIDGET(g_object_get_data(G_OBJECT(dialog),
-                                                      "treeview"));
-            g_assert(tv != NULL);
-            model = gtk_tree_view_get_model(GTK_TREE_VIEW(tv));
-            g_assert(model != NULL);
-            if (gtk_tree_model_get_iter_first(model, &iter) == FALSE)
-            {
-                pop_error(main_ctxt,
-                          "There are no items in this list.");
-                gtk_widget_destroy(dialog);
-                finish_activity(main_ctxt);
-            }
-            else
-            {
-                field = RASTA_DIALOG_FIELD(g_object_get_data(G_OBJECT(main_ctxt->child_data),
-                                                             "field"));
-                g_assert(field != NULL);
-                if (rasta_listcommand_allow_multiple(field) == FALSE)
-                {
-                    sel =
-                        gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
-                    if (gtk_tree_selection_get_selected(sel,
-                                                        &model,
-                                                        &iter) != FALSE)
-                    {
-                        path = gtk_tree_model_get_path(model, &iter);
-                        gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tv),
-                                                     path, NULL,
-                                                     FALSE, 0.0, 0.0);
-                        gtk_tree_path_free(path);
-                    }
-                }
-    
-                g_signal_connect(G_OBJECT(dialog), "response",
-                                 G_CALLBACK(do_list_response),
-                                 main_ctxt);
-                gtk_widget_set_sensitive(dialog, TRUE);
-            }
-        }
-        else
-        {
-            pop_error(main_ctxt, main_ctxt->child_err_data);
-            gtk_widget_destroy(dialog);
-            finish_activity(main_ctxt);
-        }
+    if (main_ctxt->child_exited != FALSE)
+        lc_finish(main_ctxt);
 
-        if (main_ctxt->child_err_data != NULL)
-        {
-            g_free(main_ctxt->child_err_data);
-            main_ctxt->child_err_data = NULL;
-        }
-        return(FALSE);
+    return(FALSE);
+}  /* lc_idle() */
+
+
+/*
+ * static void lc_finish(GtkRastaContext *main_ctxt)
+ *
+ * Shows the filled list in the list dialog, selects the current
+ * value, and lets the user at it.
+ */
+static void lc_finish(GtkRastaContext *main_ctxt)
+{
+    GtkWidget *dialog;
+
+    g_assert(main_ctxt != NULL);
+
+    lc_clear_rows(main_ctxt);
+
+    dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
+                                          "dialog"));
+    g_assert(dialog != NULL);
+
+    if (main_ctxt->child_row_count == 0)
+    {
+        pop_error(main_ctxt,
+                  "There are no items in this list.");
+        gtk_widget_destroy(dialog);
+        finish_activity(main_ctxt);
+        return;
     }
 
-    return(TRUE);
-}  /* lc_timeout() */
+    choice_dialog_attach(main_ctxt, dialog);
+
+    g_signal_connect(G_OBJECT(dialog), "response",
+                     G_CALLBACK(do_list_response),
+                     main_ctxt);
+    gtk_widget_set_sensitive(dialog, TRUE);
+}  /* lc_finish() */
 
 
 /*
@@ -2398,26 +2227,26 @@ static gboolean lc_timeout(gpointer user_data)
  *                          gboolean done)
  *
  * Checks data for any complete lines of text.  If there are any, it
- * adds them to the list dialog.  If done == TRUE, it adds
- * all data, disregarding the newline check.
+ * queues them for lc_idle() to add to the list dialog.  If
+ * done == TRUE, it queues all data, disregarding the newline check.
+ * The consumed lines are dropped from data in one go.
  */
 static void lc_maybe_add(GtkRastaContext *main_ctxt,
                          GString *data,
                          gboolean done)
 {
-    gunichar c;
-    gint len;
-    gchar *str, *ptr, *tmp;
+    gsize len, cur_len, key_len;
+    gchar *line, *end, *limit;
     const gchar *cur;
     GtkWidget *entry;
     RastaDialogField *field;
     gboolean multiple;
     gboolean single;
-    gboolean select;
 
     g_assert(main_ctxt != NULL);
     g_assert(data != NULL);
     g_assert(data->str != NULL);
+    g_assert(main_ctxt->child_rows != NULL);
 
     field = RASTA_DIALOG_FIELD(g_object_get_data(G_OBJECT(main_ctxt->child_data),
                                                  "field"));
@@ -2429,227 +2258,79 @@ static void lc_maybe_add(GtkRastaContext *main_ctxt,
                                          "entry"));
     g_assert(entry != NULL);
     cur = gtk_entry_get_text(GTK_ENTRY(entry));
+    cur_len = (cur != NULL) ? strlen(cur) : 0;
 
-    c = g_utf8_get_char("\n");
-
-    while (data->len > 0)
+    line = data->str;
+    limit = data->str + data->len;
+    while (line < limit)
     {
-        select = FALSE;
-        ptr = g_utf8_strchr(data->str, -1, c);
-        if (ptr != NULL)
+        end = memchr(line, '\n', limit - line);
+        if (end == NULL)
         {
-            len = ptr - data->str;
-            str = g_new(gchar, len + 1);
-            memmove(str, data->str, len);
-            str[len] = '\0';
-
-            /* Only select if we are single-selection */
-            if (multiple == FALSE)
-            {
-                tmp = g_strdup(str);
-                if (single != FALSE)
-                {
-                    for (ptr = tmp;
-                         (*ptr != '\0') &&
-                         (*ptr != '\t') &&
-                         (*ptr != ' ');
-                         ptr++);
-                    *ptr = '\0';
-                }
-                if ((cur != NULL) && (strcmp(cur, tmp) == 0))
-                    select = TRUE;
-                g_free(tmp);
-            }
-            add_choice_item(main_ctxt, str, select);
-            g_free(str);
-
-            g_string_erase(data, 0, len + 1); /* + 1 to skip \n */
+            if (done == FALSE)
+                break;
+            end = limit;
         }
-        else if (done != FALSE)
+        len = end - line;
+
+        /* Only select if we are single-selection */
+        if ((multiple == FALSE) && (cur != NULL))
         {
-            if (data->str[data->len - 1] == '\n')
-                g_string_erase(data, data->len - 1, 1);
+            key_len = single ? strcspn(line, "\t \n") : len;
+            if (key_len > len)
+                key_len = len;
+            if ((key_len == cur_len) &&
+                (memcmp(line, cur, cur_len) == 0))
+                main_ctxt->child_select = main_ctxt->child_row_count;
+        }
 
-            /* Only select if we are single-selection */
-            if (multiple == FALSE)
-            {
-                tmp = g_strdup(data->str);
-                if (single != FALSE)
-                {
-                    for (ptr = tmp;
-                         (*ptr != '\0') &&
-                         (*ptr != '\t') &&
-                         (*ptr != ' ');
-                         ptr++);
-                    *ptr = '\0';
-                }
-                if ((cur != NULL) && (strcmp(cur, tmp) == 0))
-                    select = TRUE;
-                g_free(tmp);
-            }
-            add_choice_item(main_ctxt, data->str, select);
-            g_string_truncate(data, 0);
-        }
-        else
-            break;
-    }
+        g_ptr_array_add(main_ctxt->child_rows, g_strndup(line, len));
+        main_ctxt->child_row_count++;
 
-    d_print("Add run\n");
-    if (done == TRUE)
-    {
-        d_print("Done is true\n");
+        line = (end < limit) ? end + 1 : end; /* + 1 to skip \n */
     }
-}  /* lc_maybe_add() */
-
-
-/*
- * static gboolean lc_out_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
- *
- * Handles reading STDOUT from a LISTCOMMAND.
- */
-static gboolean lc_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
-{
-    GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *out = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
-
-    g_return_val_if_fail(user_data != NULL, FALSE);
 
-    if (out == NULL)
-        out = g_string_new(NULL);
+    if (line > data->str)
+        g_string_erase(data, 0, line - data->str);
 
-    if (buffer == NULL)
-    {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
-    }
-
-    cont = TRUE;
-    main_ctxt = (GtkRastaContext *)user_data;
-    err = NULL;
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
-    {
-        case G_IO_STATUS_EOF:
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
-
-        case G_IO_STATUS_NORMAL:
-            g_assert(bytes_read > 0);
-            g_string_append_len(out, buffer, bytes_read);
-            lc_maybe_add(main_ctxt, out, FALSE);
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            break;
-
-        case G_IO_STATUS_ERROR:
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
-    }
-
-    if (cont == FALSE)
-    {
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_out_chan = NULL;
-        lc_maybe_add(main_ctxt, out, TRUE);
-        g_string_free(out, TRUE);
-        out = NULL;
-    }
-    return(cont);
-}  /* lc_out_func() */
+    if ((main_ctxt->child_rows->len > main_ctxt->child_row_pos) &&
+        (main_ctxt->child_idle == 0))
+        main_ctxt->child_idle = g_idle_add(lc_idle, main_ctxt);
+}  /* lc_maybe_add() */
 
 
 /*
- * static gboolean lc_err_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
+ * static void lc_output(RastaExecStream stream,
+ *                       const gchar *data,
+ *                       gsize len,
+ *                       gpointer user_data)
  *
- * Handles reading STDERR from a LISTCOMMAND.
+ * Handles STDOUT from a LISTCOMMAND as it arrives.
  */
-static gboolean lc_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
+static void lc_output(RastaExecStream stream,
+                      const gchar *data,
+                      gsize len,
+                      gpointer user_data)
 {
     GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *ers = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
+    g_return_if_fail(user_data != NULL);
 
-    if (ers == NULL)
-        ers = g_string_new(NULL);
+    main_ctxt = (GtkRastaContext *)user_data;
+    g_assert(main_ctxt->child_out != NULL);
 
-    if (buffer == NULL)
+    if (data != NULL)
     {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
+        g_string_append_len(main_ctxt->child_out, data, len);
+        lc_maybe_add(main_ctxt, main_ctxt->child_out, FALSE);
     }
-
-    cont = TRUE;
-    main_ctxt = (GtkRastaContext *)user_data;
-    err = NULL;
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
+    else
     {
-        case G_IO_STATUS_EOF:
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
-
-        case G_IO_STATUS_NORMAL:
-            g_assert(bytes_read > 0);
-            g_string_append_len(ers, buffer, bytes_read);
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            break;
-
-        case G_IO_STATUS_ERROR:
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
+        lc_maybe_add(main_ctxt, main_ctxt->child_out, TRUE);
+        g_string_free(main_ctxt->child_out, TRUE);
+        main_ctxt->child_out = NULL;
     }
-
-    if (cont == FALSE)
-    {
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_err_chan = NULL;
-        if (ers->len > 0)
-            main_ctxt->child_err_data = g_strdup(ers->str);
-        g_string_free(ers, TRUE);
-        ers = NULL;
-    }
-    return(cont);
-}  /* lc_err_func() */
+}  /* lc_output() */
 
 
 /*
@@ -2683,17 +2364,18 @@ static void pop_choice_foreach(GtkTreeModel *model,
  *                             const gchar *item,
  *                             gboolean selected)
  *
- * Adds an item to the dialog.
+ * Adds an item to the dialog.  Items go into the dialog's store and
+ * choice index; nothing is shown until choice_dialog_attach().
  */
 static void add_choice_item(GtkRastaContext *main_ctxt,
                             const gchar *item,
                             gboolean selected)
 {
-    GtkWidget *dialog, *tv;
+    GtkWidget *dialog;
     GtkListStore *list;
+    RastaChoiceIndex *index;
     GtkTreeIter iter;
-    GtkTreeSelection *sel;
-    GValue gval = {0, };
+    guint id;
 
     g_assert(main_ctxt != NULL);
     g_assert(item != NULL);
@@ -2701,22 +2383,146 @@ static void add_choice_item(GtkRastaContext *main_ctxt,
     dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane), "dialog"));
     g_assert(dialog != NULL);
 
-    tv = GTK_WIDGET(g_object_get_data(G_OBJECT(dialog),
-                                      "treeview"));
-    g_assert(tv != NULL);
-
-    sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
-    list = GTK_LIST_STORE(gtk_tree_view_get_model(GTK_TREE_VIEW(tv)));
+    list = GTK_LIST_STORE(g_object_get_data(G_OBJECT(dialog), "store"));
+    g_assert(list != NULL);
+    index = (RastaChoiceIndex *)g_object_get_data(G_OBJECT(dialog),
+                                                  "index");
+    g_assert(index != NULL);
 
+    id = rasta_choice_index_add(index, item);
     gtk_list_store_append(list, &iter);
-    g_value_init(&gval, G_TYPE_STRING);
-    g_value_set_string(&gval, item);
-    gtk_list_store_set_value(list, &iter, 0, &gval);
+    gtk_list_store_set(list, &iter, 0, item, 1, id, -1);
     if (selected != FALSE)
-        gtk_tree_selection_select_iter(sel, &iter);
+        main_ctxt->child_select = id;
 }  /* add_choice_item() */
 
 
+/*
+ * static gboolean choice_dialog_visible(GtkTreeModel *model,
+ *                                       GtkTreeIter *iter,
+ *                                       gpointer user_data)
+ *
+ * Tells the filter model whether a row matches the filter entry.
+ */
+static gboolean choice_dialog_visible(GtkTreeModel *model,
+                                      GtkTreeIter *iter,
+                                      gpointer user_data)
+{
+    guchar *visible;
+    guint id;
+
+    g_return_val_if_fail(user_data != NULL, TRUE);
+
+    visible = (guchar *)g_object_get_data(G_OBJECT(user_data),
+                                          "visible");
+    if (visible == NULL)
+        return(TRUE);
+
+    gtk_tree_model_get(model, iter, 1, &id, -1);
+
+    return(visible[id] != 0);
+}  /* choice_dialog_visible() */
+
+
+/*
+ * static void choice_dialog_attach(GtkRastaContext *main_ctxt,
+ *                                  GtkWidget *dialog)
+ *
+ * Shows the loaded items through a filter model and selects the
+ * item marked by add_choice_item().
+ */
+static void choice_dialog_attach(GtkRastaContext *main_ctxt,
+                                 GtkWidget *dialog)
+{
+    GtkWidget *tv;
+    GtkTreeModel *list, *filter;
+    GtkTreeSelection *sel;
+    GtkTreeIter child_iter, iter;
+    GtkTreePath *path;
+
+    g_assert(main_ctxt != NULL);
+    g_assert(dialog != NULL);
+
+    tv = GTK_WIDGET(g_object_get_data(G_OBJECT(dialog), "treeview"));
+    g_assert(tv != NULL);
+    list = GTK_TREE_MODEL(g_object_get_data(G_OBJECT(dialog), "store"));
+    g_assert(list != NULL);
+
+    filter = gtk_tree_model_filter_new(list, NULL);
+    gtk_tree_model_filter_set_visible_func(GTK_TREE_MODEL_FILTER(filter),
+                                           choice_dialog_visible,
+                                           dialog, NULL);
+    gtk_tree_view_set_model(GTK_TREE_VIEW(tv), filter);
+    g_object_unref(filter);
+
+    if ((main_ctxt->child_select >= 0) &&
+        (gtk_tree_model_iter_nth_child(list, &child_iter, NULL,
+                                       main_ctxt->child_select) != FALSE))
+    {
+        gtk_tree_model_filter_convert_child_iter_to_iter(GTK_TREE_MODEL_FILTER(filter),
+                                                         &iter,
+                                                         &child_iter);
+        sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
+        gtk_tree_selection_select_iter(sel, &iter);
+        path = gtk_tree_model_get_path(filter, &iter);
+        gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tv),
+                                     path, NULL,
+                                     FALSE, 0.0, 0.0);
+        gtk_tree_path_free(path);
+    }
+}  /* choice_dialog_attach() */
+
+
+/*
+ * static void do_choice_filter_changed(GtkWidget *widget,
+ *                                      gpointer user_data)
+ *
+ * Narrows the choice dialog to the items containing the filter
+ * text.
+ */
+static void do_choice_filter_changed(GtkWidget *widget,
+                                     gpointer user_data)
+{
+    GtkRastaContext *main_ctxt;
+    GtkWidget *dialog, *tv;
+    GtkTreeModel *filter;
+    RastaChoiceIndex *index;
+    const gchar *text;
+    guchar *visible;
+    guint *matches;
+    guint i, n_matches;
+
+    g_return_if_fail(user_data != NULL);
+
+    main_ctxt = (GtkRastaContext *)user_data;
+    dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
+                                          "dialog"));
+    g_assert(dialog != NULL);
+    index = (RastaChoiceIndex *)g_object_get_data(G_OBJECT(dialog),
+                                                  "index");
+    g_assert(index != NULL);
+
+    visible = NULL;
+    text = gtk_entry_get_text(GTK_ENTRY(widget));
+    if ((text != NULL) && (text[0] != '\0'))
+    {
+        visible = g_new0(guchar, rasta_choice_index_size(index) + 1);
+        matches = rasta_choice_index_find(index, text, &n_matches);
+        for (i = 0; i < n_matches; i++)
+            visible[matches[i]] = 1;
+        g_free(matches);
+    }
+    g_object_set_data_full(G_OBJECT(dialog), "visible",
+                           visible, g_free);
+
+    tv = GTK_WIDGET(g_object_get_data(G_OBJECT(dialog), "treeview"));
+    g_assert(tv != NULL);
+    filter = gtk_tree_view_get_model(GTK_TREE_VIEW(tv));
+    if (filter != NULL)
+        gtk_tree_model_filter_refilter(GTK_TREE_MODEL_FILTER(filter));
+}  /* do_choice_filter_changed() */
+
+
 /*
  * static void do_list_response(GtkWidget *widget,
  *                              gint response,
@@ -2853,7 +2659,7 @@ static void do_ring_response(GtkWidget *widget,
 static void pop_choice_dialog(GtkRastaContext *main_ctxt,
                               gboolean multiple)
 {
-    GtkWidget *dialog, *tv, *scroll;
+    GtkWidget *dialog, *tv, *scroll, *entry;
     GtkListStore *list;
     GtkTreeViewColumn *column;
     GtkTreeSelection *sel;
@@ -2869,9 +2675,9 @@ static void pop_choice_dialog(GtkRastaContext *main_ctxt,
                                    GTK_POLICY_AUTOMATIC,
                                    GTK_POLICY_AUTOMATIC);
 
-    list = gtk_list_store_new(1, G_TYPE_STRING);
-    tv = gtk_tree_view_new_with_model(GTK_TREE_MODEL(list));
-    g_object_unref(list);
+    /* Column 1 is the item's id in the choice index */
+    list = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_UINT);
+    tv = gtk_tree_view_new();
 
     sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
     gtk_tree_selection_set_mode(sel,
@@ -2908,10 +2714,22 @@ static void pop_choice_dialog(GtkRastaContext *main_ctxt,
                                     NULL);
     gtk_window_set_default_size(GTK_WINDOW(dialog), 300, 200);
 
+    entry = gtk_entry_new();
+    g_signal_connect(G_OBJECT(entry), "changed",
+                     G_CALLBACK(do_choice_filter_changed),
+                     main_ctxt);
+    gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), entry,
+                       FALSE, FALSE, 2);
     gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), scroll,
                        TRUE, TRUE, 2);
 
     g_object_set_data(G_OBJECT(dialog), "treeview", tv);
+    g_object_set_data_full(G_OBJECT(dialog), "store", list,
+                           g_object_unref);
+    g_object_set_data_full(G_OBJECT(dialog), "index",
+                           rasta_choice_index_new(),
+                           (GDestroyNotify)rasta_choice_index_free);
+    main_ctxt->child_select = -1;
 
     g_object_set_data(G_OBJECT(main_ctxt->main_pane),
                       "dialog", dialog);
@@ -2952,16 +2770,11 @@ static void pop_list_dialog(GtkRastaContext *main_ctxt,
  */
 static gboolean ring_dialog_idle(gpointer user_data)
 {
-    GtkWidget *dialog, *entry, *tv;
+    GtkWidget *dialog, *entry;
     GtkRastaContext *main_ctxt;
     REnumeration *en;
     RastaRingValue *value;
-    gchar *ptr;
-    const gchar *cur;
-    GtkTreeSelection *sel;
-    GtkTreeModel *model;
-    GtkTreeIter iter;
-    GtkTreePath *path;
+    const gchar *ptr, *cur;
 
     main_ctxt = (GtkRastaContext *)user_data;
     g_assert(main_ctxt != NULL);
@@ -2978,29 +2791,17 @@ static gboolean ring_dialog_idle(gpointer user_data)
         cur = gtk_entry_get_text(GTK_ENTRY(entry));
         value = RASTA_RING_VALUE(r_enumeration_get_next(en));
         g_assert(value != NULL);
-        ptr = rasta_ring_value_get_text(value);
+        ptr = rasta_ring_value_peek_text(value);
         g_assert(ptr != NULL);
         add_choice_item(main_ctxt, ptr,
                         (cur != NULL) && (strcmp(cur, ptr) == 0));
-        g_free(ptr);
     }
     else
     {
         dialog = GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
                                               "dialog"));
         g_assert(dialog != NULL);
-        tv = GTK_WIDGET(g_object_get_data(G_OBJECT(dialog),
-                                          "treeview"));
-        g_assert(tv != NULL);
-        sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv));
-        if (gtk_tree_selection_get_selected(sel, &model, &iter) != FALSE)
-        {
-            path = gtk_tree_model_get_path(model, &iter);
-            gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(tv),
-                                         path, NULL,
-                                         FALSE, 0.0, 0.0);
-            gtk_tree_path_free(path);
-        }
+        choice_dialog_attach(main_ctxt, dialog);
         g_signal_connect(G_OBJECT(dialog), "response",
                          G_CALLBACK(do_ring_response), main_ctxt);
         gtk_widget_set_sensitive(dialog, TRUE);
@@ -3076,7 +2877,7 @@ static gint ac_start(GtkRastaContext *main_ctxt,
     }
 
     /* Shell needs current encoding */
-    args[2] = g_locale_from_utf8(utf8_command, -1, NULL, NULL, NULL);
+    args[2] = rasta_exec_locale_from_utf8(utf8_command, NULL);
     g_free(utf8_command);
     if ((args[2]== NULL) || (args[2][0] == '\0'))
     {
@@ -3098,9 +2899,6 @@ static gint ac_start(GtkRastaContext *main_ctxt,
     }
     else if (type == RASTA_TTY_NO)
     {
-        main_ctxt->child_out_chan = NULL;
-        main_ctxt->child_err_chan = NULL;
-
         rc = rasta_exec_command_v(&(main_ctxt->child_pid),
                                   NULL, NULL, NULL,
                                   RASTA_EXEC_FD_NULL,
@@ -3111,9 +2909,27 @@ static gint ac_start(GtkRastaContext *main_ctxt,
         g_free(args[2]);
         if (rc != 0)
             return(-ECHILD);
+
+        rasta_profile_action(main_ctxt->ctxt, main_ctxt->child_pid);
+        rc = rasta_exec_watch_child(NULL, main_ctxt->child_pid,
+                                    -1, -1, NULL,
+                                    RASTA_EXEC_STREAM_NONE,
+                                    NULL, ac_done, main_ctxt);
+        g_assert(rc == 0);
     }
     else if (type == RASTA_TTY_YES)
     {
+        if (main_ctxt->log_filename != NULL)
+        {
+            main_ctxt->child_log = fopen(main_ctxt->log_filename, "a");
+            if (main_ctxt->child_log == NULL)
+            {
+                /* TIMBOIZE */
+                pop_error(main_ctxt,
+                          "Unable to open the output log, output will not be saved.");
+            }
+        }
+
         rc = rasta_exec_command_v(&(main_ctxt->child_pid),
                                   NULL, &outfd, &errfd,
                                   RASTA_EXEC_FD_NULL,
@@ -3122,41 +2938,32 @@ static gint ac_start(GtkRastaContext *main_ctxt,
                                   args);
         g_free(args[2]);
         if (rc != 0)
+        {
+            if (main_ctxt->child_log != NULL)
+            {
+                fclose(main_ctxt->child_log);
+                main_ctxt->child_log = NULL;
+            }
             return(-ECHILD);
+        }
 
-        encoding = rasta_action_screen_get_encoding(screen);
-
-        main_ctxt->child_out_chan = g_io_channel_unix_new(outfd);
-        g_io_channel_set_flags(main_ctxt->child_out_chan,
-                               G_IO_FLAG_NONBLOCK,
-                               NULL);
-        g_io_channel_set_encoding(main_ctxt->child_out_chan, encoding, NULL);
-        g_io_add_watch_full(main_ctxt->child_out_chan,
-                            G_PRIORITY_LOW,
-                            G_IO_IN | G_IO_HUP | G_IO_ERR,
-                            ac_out_func,
-                            main_ctxt,
-                            NULL);
-        g_io_channel_unref(main_ctxt->child_out_chan);
-
-        main_ctxt->child_err_chan = g_io_channel_unix_new(errfd);
-        g_io_channel_set_flags(main_ctxt->child_err_chan,
-                               G_IO_FLAG_NONBLOCK,
-                               NULL);
-        g_io_channel_set_encoding(main_ctxt->child_err_chan, encoding, NULL);
-        g_io_add_watch_full(main_ctxt->child_err_chan,
-                            G_PRIORITY_LOW,
-                            G_IO_IN | G_IO_HUP | G_IO_ERR,
-                            ac_err_func,
-                            main_ctxt,
-                            NULL);
-        g_io_channel_unref(main_ctxt->child_err_chan);
+        rasta_profile_action(main_ctxt->ctxt, main_ctxt->child_pid);
+        main_ctxt->child_out = g_string_new(NULL);
+        main_ctxt->child_err = g_string_new(NULL);
+        main_ctxt->child_pending = g_string_new(NULL);
+        main_ctxt->child_bytes = 0;
+        main_ctxt->child_tags = 0;
 
+        encoding = rasta_action_screen_get_encoding(screen);
+        rc = rasta_exec_watch_child(NULL, main_ctxt->child_pid,
+                                    outfd, errfd, encoding,
+                                    RASTA_EXEC_STREAM_STDOUT |
+                                    RASTA_EXEC_STREAM_STDERR,
+                                    ac_output, ac_done, main_ctxt);
+        g_assert(rc == 0);
         g_free(encoding);
     }
 
-    g_timeout_add(100, ac_timeout, main_ctxt);
-
     return(TRUE);
 }  /* ac_start() */
 
@@ -3202,29 +3009,105 @@ static void ac_tag_output(GtkRastaContext *main_ctxt,
 /*
  * static void ac_maybe_output(GtkRastaContext *main_ctxt,
  *                             GString *data,
+ *                             const gchar *new_data,
+ *                             gsize len,
  *                             gboolean done)
  *
- * Checks data for any complete lines of text.  If there are any, it
- * outputs them to the output widget.  If done == TRUE, it outputs
- * all data, disregarding the newline check.
+ * Adds new_data to the partial line in data and moves any complete
+ * lines to the pending output, scheduling a flush.  If done == TRUE,
+ * it moves all data, disregarding the newline check.  data never
+ * holds a newline between calls, so only new_data is searched.
  */
 static void ac_maybe_output(GtkRastaContext *main_ctxt,
                             GString *data,
+                            const gchar *new_data,
+                            gsize len,
                             gboolean done)
+{
+    const gchar *ptr;
+    GString *pending;
+
+    g_assert(main_ctxt != NULL);
+    g_assert(data != NULL);
+
+    pending = main_ctxt->child_pending;
+    g_assert(pending != NULL);
+
+    for (ptr = new_data + len; ptr > new_data; ptr--)
+    {
+        if (ptr[-1] == '\n')
+            break;
+    }
+
+    if (ptr > new_data)
+    {
+        g_string_append_len(pending, data->str, data->len);
+        g_string_append_len(pending, new_data, ptr - new_data);
+        g_string_truncate(data, 0);
+        g_string_append_len(data, ptr, new_data + len - ptr);
+    }
+    else if (len > 0)
+        g_string_append_len(data, new_data, len);
+
+    /* Don't let a runaway line grow without bound */
+    if ((done != FALSE) || (data->len >= AC_MAX_PARTIAL))
+    {
+        if (data->len > 0)
+        {
+            g_string_append_len(pending, data->str, data->len);
+            if (done != FALSE)
+                g_string_append_c(pending, '\n');
+            g_string_truncate(data, 0);
+        }
+    }
+
+    if ((pending->len > 0) && (main_ctxt->child_flush == 0))
+        main_ctxt->child_flush = g_timeout_add(AC_FLUSH_INTERVAL,
+                                               ac_flush_timeout,
+                                               main_ctxt);
+}  /* ac_maybe_output() */
+
+
+/*
+ * static gboolean ac_flush_timeout(gpointer user_data)
+ *
+ * One-shot timeout that limits how often action output is drawn
+ */
+static gboolean ac_flush_timeout(gpointer user_data)
+{
+    GtkRastaContext *main_ctxt;
+
+    g_return_val_if_fail(user_data != NULL, FALSE);
+
+    main_ctxt = (GtkRastaContext *)user_data;
+    main_ctxt->child_flush = 0;
+    ac_flush(main_ctxt);
+
+    return(FALSE);
+}  /* ac_flush_timeout() */
+
+
+/*
+ * static void ac_flush(GtkRastaContext *main_ctxt)
+ *
+ * Appends the pending output to the output widget, then drops the
+ * oldest lines until the buffer is back within the scrollback
+ * limits.
+ */
+static void ac_flush(GtkRastaContext *main_ctxt)
 {
     GtkWidget *screen_frame, *panes, *action_pane, *output;
     GtkTextBuffer *buf;
-    GtkTextIter iter;
+    GtkTextIter start, iter;
     GtkTextMark *mark;
-    gunichar c = '\n';
-    gint len;
-    gchar *str, *ptr;
+    GString *pending;
+    gint lines, drop_lines;
+    gsize excess, removed;
 
     g_assert(main_ctxt != NULL);
-    g_assert(data != NULL);
-    g_assert(data->str != NULL);
 
-    if (data->len == 0)
+    pending = main_ctxt->child_pending;
+    if ((pending == NULL) || (pending->len == 0))
         return;
 
     screen_frame =
@@ -3246,292 +3129,171 @@ static void ac_maybe_output(GtkRastaContext *main_ctxt,
 
     buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(output));
 
-    if (done == TRUE)
+    d_print("Adding text, len = %ld\n", (glong)pending->len);
+    gtk_text_buffer_get_end_iter(buf, &iter);
+    gtk_text_buffer_insert(buf, &iter, pending->str, pending->len);
+    main_ctxt->child_bytes += pending->len;
+    g_string_truncate(pending, 0);
+
+    lines = gtk_text_buffer_get_line_count(buf);
+    drop_lines = 0;
+    if ((main_ctxt->scrollback_lines > 0) &&
+        (lines > (gint)main_ctxt->scrollback_lines))
+        drop_lines = lines - main_ctxt->scrollback_lines;
+    excess = 0;
+    if ((main_ctxt->scrollback_bytes > 0) &&
+        (main_ctxt->child_bytes > main_ctxt->scrollback_bytes))
+        excess = main_ctxt->child_bytes - main_ctxt->scrollback_bytes;
+
+    if ((drop_lines > 0) || (excess > 0))
     {
-        if (data->str[data->len - 1] == '\n')
-            str = g_strdup(data->str);
-        else
-            str = g_strdup_printf("%s\n", data->str);
-        g_string_truncate(data, 0);
-    }
-    else
-    {
-        str = NULL;
-        ptr = g_utf8_strchr(data->str, -1, c);
-        while (ptr != NULL)
-        {
-            str = ptr;
-            ptr = g_utf8_strchr(str + 1, -1, c);
-        }
-
-        if (str != NULL)
+        gtk_text_buffer_get_start_iter(buf, &start);
+        iter = start;
+        removed = 0;
+        while ((drop_lines > 0) || (removed < excess))
         {
-            len = str - data->str + 1;
-            str = g_new(gchar, len + 1);
-            memmove(str, data->str, len);
-            str[len] = '\0';
-            g_string_erase(data, 0, len);
+            removed += gtk_text_iter_get_bytes_in_line(&iter);
+            drop_lines--;
+            if (gtk_text_iter_forward_line(&iter) == FALSE)
+                break;
         }
+        gtk_text_buffer_delete(buf, &start, &iter);
+        main_ctxt->child_bytes -= MIN(removed, main_ctxt->child_bytes);
     }
 
-    if (str == NULL)
-        return;
-
-    d_print("Adding text, len = %ld\n", g_utf8_strlen(str, -1));
-    /* FIXME: text_view scroll is fixed, can we do this better? */
     mark = gtk_text_buffer_get_mark(buf, "end");
-    if (gtk_text_buffer_get_modified(buf) == FALSE)
-    {
-        gtk_text_buffer_set_text(buf, str, -1);
-        gtk_text_buffer_get_end_iter(buf, &iter);
-        gtk_text_buffer_move_mark(buf, mark, &iter);
-    }
-    else
-    {
-        gtk_text_buffer_get_iter_at_mark(buf, &iter, mark); 
-        gtk_text_buffer_insert(buf, &iter, str, -1);
-    }
     gtk_text_view_scroll_mark_onscreen(GTK_TEXT_VIEW(output), mark);
-    g_free(str);
-}  /* ac_maybe_output() */
+}  /* ac_flush() */
 
 
 /*
- * static gboolean ac_out_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
+ * static void ac_output(RastaExecStream stream,
+ *                       const gchar *data,
+ *                       gsize len,
+ *                       gpointer user_data)
  *
- * Handles STDOUT output from an action command
+ * Handles STDOUT and STDERR output from an action command as it
+ * arrives
  */
-static gboolean ac_out_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
+static void ac_output(RastaExecStream stream,
+                      const gchar *data,
+                      gsize len,
+                      gpointer user_data)
 {
     GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *out = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
+    GString **buf;
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
-
-    if (out == NULL)
-        out = g_string_new(NULL);
-
-    if (buffer == NULL)
-    {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
-    }
+    g_return_if_fail(user_data != NULL);
 
     main_ctxt = (GtkRastaContext *)user_data;
-    cont = TRUE;
-    err = NULL;
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
-    {
-        case G_IO_STATUS_EOF:
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
+    buf = (stream == RASTA_EXEC_STREAM_STDOUT) ?
+          &(main_ctxt->child_out) :
+          &(main_ctxt->child_err);
+    g_assert(*buf != NULL);
 
-        case G_IO_STATUS_NORMAL:
-            g_assert(bytes_read > 0);
-            g_string_append_len(out, buffer, bytes_read);
-            ac_maybe_output(main_ctxt, out, FALSE);
-            ac_tag_output(main_ctxt, "stdout");
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            break;
-
-        case G_IO_STATUS_ERROR:
-            g_error_free(err);
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
-
-        default:
-            g_assert_not_reached();
+    if (data != NULL)
+    {
+        if (main_ctxt->child_log != NULL)
+            fwrite(data, 1, len, main_ctxt->child_log);
+        ac_maybe_output(main_ctxt, *buf, data, len, FALSE);
+        if ((main_ctxt->child_tags & stream) == 0)
+        {
+            main_ctxt->child_tags |= stream;
+            ac_tag_output(main_ctxt,
+                          (stream == RASTA_EXEC_STREAM_STDOUT) ?
+                          "stdout" : "stderr");
+        }
     }
-
-    if (cont == FALSE)
+    else
     {
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_out_chan = NULL;
-        ac_maybe_output(main_ctxt, out, TRUE);
-        g_string_free(out, TRUE);
-        out = NULL;
+        ac_maybe_output(main_ctxt, *buf, NULL, 0, TRUE);
+        g_string_free(*buf, TRUE);
+        *buf = NULL;
     }
-    return(cont);
-}  /* ac_out_func() */
+}  /* ac_output() */
 
 
 /*
- * static gboolean ac_err_func(GIOChannel *chan,
- *                             GIOCondition cond,
- *                             gpointer user_data)
+ * static void ac_done(gint status,
+ *                     const gchar *out_data,
+ *                     const gchar *err_data,
+ *                     gpointer user_data)
  *
- * Handles STDERR output from an action command
+ * Called when an action command has exited
  */
-static gboolean ac_err_func(GIOChannel *chan,
-                            GIOCondition cond,
-                            gpointer user_data)
+static void ac_done(gint status,
+                    const gchar *out_data,
+                    const gchar *err_data,
+                    gpointer user_data)
 {
     GtkRastaContext *main_ctxt;
-    GIOStatus rc;
-    gsize bytes_read;
-    gboolean cont;
-    GError *err;
-    static GString *ers = NULL;
-    static gchar *buffer = NULL;
-    static size_t page_size = 0;
+    RastaScreen *screen;
+    GtkWidget *screen_frame, *panes, *action_pane, *label;
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
+    g_return_if_fail(user_data != NULL);
 
-    if (ers == NULL)
-        ers = g_string_new(NULL);
+    main_ctxt = (GtkRastaContext *)user_data;
+    main_ctxt->child_pid = -1;
 
-    if (buffer == NULL)
+    /* Show whatever is left right away */
+    if (main_ctxt->child_flush != 0)
     {
-        page_size = getpagesize();
-        buffer = g_new0(gchar, page_size * NUM_READ_PAGES);
+        g_source_remove(main_ctxt->child_flush);
+        main_ctxt->child_flush = 0;
     }
-
-    cont = TRUE;
-    main_ctxt = (GtkRastaContext *)user_data;
-    err = NULL;
-    rc = g_io_channel_read_chars(chan, buffer,
-                                 page_size * NUM_READ_PAGES,
-                                 &bytes_read, &err);
-    switch (rc)
+    ac_flush(main_ctxt);
+    if (main_ctxt->child_pending != NULL)
     {
-        case G_IO_STATUS_EOF:
-            cont = FALSE;
-            if (bytes_read < 1)
-                break;
-            /* Fall through with read data */
-
-        case G_IO_STATUS_NORMAL:
-            g_assert(bytes_read > 0);
-            g_string_append_len(ers, buffer, bytes_read);
-            ac_maybe_output(main_ctxt, ers, FALSE);
-            ac_tag_output(main_ctxt, "stderr");
-            break;
-
-        case G_IO_STATUS_AGAIN:
-            /* Do nothing */
-            break;
-
-        case G_IO_STATUS_ERROR:
-            cont = FALSE;
-            /* FIXME: Flag an error? */
-            break;
+        g_string_free(main_ctxt->child_pending, TRUE);
+        main_ctxt->child_pending = NULL;
     }
-
-    if (cont == FALSE)
+    if (main_ctxt->child_log != NULL)
     {
-        g_io_channel_shutdown(chan, FALSE, NULL);
-        g_free(buffer);
-        buffer = NULL;
-        main_ctxt->child_err_chan = NULL;
-        ac_maybe_output(main_ctxt, ers, TRUE);
-        g_string_free(ers, TRUE);
-        ers = NULL;
+        fclose(main_ctxt->child_log);
+        main_ctxt->child_log = NULL;
     }
-    return(cont);
-}  /* ac_err_func() */
 
+    screen = rasta_context_get_screen(main_ctxt->ctxt);
 
-/*
- * static gboolean ac_timeout(gpointer user_data)
- *
- * Checks for action command completion
- */
-static gboolean ac_timeout(gpointer user_data)
-{
-    gint rc;
-    GtkRastaContext *main_ctxt;
-    RastaScreen *screen;
-    GtkWidget *screen_frame, *panes, *action_pane, *label;
+    screen_frame =
+        GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
+                                     "screens"));
+    g_assert(screen_frame != NULL);
 
-    g_return_val_if_fail(user_data != NULL, FALSE);
+    panes = GTK_WIDGET(g_object_get_data(G_OBJECT(screen_frame),
+                                         "panes"));
+    g_assert(panes != NULL);
 
-    main_ctxt = (GtkRastaContext *)user_data;
+    action_pane = GTK_WIDGET(g_object_get_data(G_OBJECT(panes),
+                                               "action_pane"));
+    g_assert(action_pane != NULL);
 
-    if (main_ctxt->child_pid > 0)
+    label = GTK_WIDGET(g_object_get_data(G_OBJECT(action_pane),
+                                         "status"));
+
+    if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
     {
-        rc = waitpid(main_ctxt->child_pid,
-                     &(main_ctxt->child_status),
-                     WNOHANG);
-        if (rc > 0)
-            main_ctxt->child_pid = -1;
-        else if ((rc < 0) && (errno == ECHILD))
-            g_assert_not_reached();
+        /* TIMBOIZE */
+        gtk_label_set_text(GTK_LABEL(label),
+                           "Status: Success");
     }
-
-    if ((main_ctxt->child_pid < 0) &&
-        (main_ctxt->child_out_chan == NULL) &&
-        (main_ctxt->child_err_chan == NULL))
+    else
     {
-        /* Clear our timeout before doing work */
-        g_source_remove_by_user_data(user_data);
-
-        screen = rasta_context_get_screen(main_ctxt->ctxt);
-
-        screen_frame =
-            GTK_WIDGET(g_object_get_data(G_OBJECT(main_ctxt->main_pane),
-                                         "screens"));
-        g_assert(screen_frame != NULL);
-    
-        panes = GTK_WIDGET(g_object_get_data(G_OBJECT(screen_frame),
-                                             "panes"));
-        g_assert(panes != NULL);
-    
-        action_pane = GTK_WIDGET(g_object_get_data(G_OBJECT(panes),
-                                                   "action_pane"));
-        g_assert(action_pane != NULL);
-    
-        label = GTK_WIDGET(g_object_get_data(G_OBJECT(action_pane),
-                                             "status"));
-
-        if (WIFEXITED(main_ctxt->child_status) &&
-            (WEXITSTATUS(main_ctxt->child_status) == 0))
+        /* TIMBOIZE */
+        gtk_label_set_text(GTK_LABEL(label),
+                           "Status: Failed");
+        if (WIFEXITED(status))
         {
-            /* TIMBOIZE */
-            gtk_label_set_text(GTK_LABEL(label),
-                               "Status: Success");
+            d_print("Exit status: %d\n", WEXITSTATUS(status));
         }
-        else
+        else if (WIFSIGNALED(status))
         {
-            /* TIMBOIZE */
-            gtk_label_set_text(GTK_LABEL(label),
-                               "Status: Failed");
-            if (WIFEXITED(main_ctxt->child_status))
-            {
-                d_print("Exit status: %d\n", WEXITSTATUS(main_ctxt->child_status));
-            }
-            else if (WIFSIGNALED(main_ctxt->child_status))
-            {
-                d_print("Exit signal: %d\n", WTERMSIG(main_ctxt->child_status));
-            }
+            d_print("Exit signal: %d\n", WTERMSIG(status));
         }
-
-        finish_activity(main_ctxt);
-        return(FALSE);
     }
 
-    return(TRUE);
-}  /* ac_timeout() */
+    finish_activity(main_ctxt);
+}  /* ac_done() */
 
 
 /*
@@ -4123,9 +3885,10 @@ static void do_dialog_screen_next(GtkRastaContext *main_ctxt)
     GList *children, *elem;
     RastaDialogFieldType type;
     RastaDialogField *field;
-    REnumeration *er;
+    REnumeration er;
     RastaRingValue *r_item;
-    gchar *name, *error, *text, *format, *t_o, *t_n;
+    const gchar *text, *check;
+    gchar *name, *error, *t_o, *t_n;
     gchar *orig_value = NULL;
     gchar *value = NULL;
 #ifdef ENABLE_DEPRECATED
@@ -4191,22 +3954,20 @@ static void do_dialog_screen_next(GtkRastaContext *main_ctxt)
                                                      "entry"));
                 value = gtk_editable_get_chars(GTK_EDITABLE(entry),
                                                0, -1);
-                er = rasta_dialog_field_enumerate_ring(field);
-                while (r_enumeration_has_more(er))
+                rasta_dialog_field_init_ring_cursor(field, &er);
+                while (r_enumeration_has_more(&er))
                 {
                     r_item =
-                        RASTA_RING_VALUE(r_enumeration_get_next(er));
+                        RASTA_RING_VALUE(r_enumeration_get_next(&er));
                     g_assert(r_item != NULL);
-                    text = rasta_ring_value_get_text(r_item);
+                    text = rasta_ring_value_peek_text(r_item);
                     if (strcmp(text, value) == 0)
                     {
-                        g_free(text);
                         g_free(value);
                         value = rasta_ring_value_get_value(r_item);
                         break;
                     }
                 }
-                r_enumeration_free(er);
                 break;
 
             case RASTA_FIELD_ENTRY:
@@ -4219,13 +3980,13 @@ static void do_dialog_screen_next(GtkRastaContext *main_ctxt)
                     rasta_entry_dialog_field_is_numeric(field))
                 {
                     /* NOTE: widget only enforces numeric */
-                    format = rasta_entry_dialog_field_get_format(field);
-                    rc = rasta_verify_number_format(format, value);
-                    g_free(format);
+                    check = value;
+                    rc = rasta_dialog_field_validate_many(field, &check,
+                                                          1, NULL);
                     if (rc != 0)
                     {
                         /* TIMBOIZE */
-                        text = rasta_dialog_field_get_text(field);
+                        text = rasta_dialog_field_peek_text(field);
                         switch (rc)
                         {
                             case -ERANGE:
@@ -4247,7 +4008,6 @@ static void do_dialog_screen_next(GtkRastaContext *main_ctxt)
                                                     text);
                                 break;
                         }
-                        g_free(text);
                         g_free(value);
                         pop_error(main_ctxt, error);
                         g_free(error);
@@ -4339,11 +4099,10 @@ static void do_dialog_screen_next(GtkRastaContext *main_ctxt)
             ((value == NULL) || (value[0] == '\0')))
         {
             g_free(value);
-            text = rasta_dialog_field_get_text(field);
+            text = rasta_dialog_field_peek_text(field);
             /* TIMBOIZE */
             error = g_strdup_printf("Field \"%s\" is required.",
                                     text);
-            g_free(text);
             pop_error(main_ctxt, error);
             g_free(error);
             return;
@@ -4425,6 +4184,29 @@ static void do_menu_screen_next(GtkRastaContext *main_ctxt)
 }  /* do_menu_screen_next() */
 
 
+/*
+ * static gulong load_option_count(const gchar *arg, gulong max)
+ *
+ * Parses a numeric option argument.  It must be all decimal digits
+ * and no more than max, otherwise this prints the usage and exits.
+ */
+static gulong load_option_count(const gchar *arg, gulong max)
+{
+    gulong val;
+    gchar *ptr;
+
+    if ((arg == NULL) || !g_ascii_isdigit(arg[0]))
+        print_usage(1);
+
+    errno = 0;
+    val = strtoul(arg, &ptr, 10);
+    if ((*ptr != '\0') || (errno == ERANGE) || (val > max))
+        print_usage(1);
+
+    return(val);
+}  /* load_option_count() */
+
+
 /*
  * static gboolean load_options(gint argc, gchar *argv[],
  *                              GtkRastaContext *main_ctxt)
@@ -4461,6 +4243,39 @@ static gboolean load_options(gint argc, gchar *argv[],
                 return(FALSE);
             main_ctxt->filename = g_strdup(argv[i]);
         }
+        else if (strcmp(argv[i], "--log") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(FALSE);
+            main_ctxt->log_filename = g_strdup(argv[i]);
+        }
+        else if (strcmp(argv[i], "--trace") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(FALSE);
+            main_ctxt->trace_filename = g_strdup(argv[i]);
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(FALSE);
+            main_ctxt->profile_filename = g_strdup(argv[i]);
+        }
+        else if (strcmp(argv[i], "--scrollback") == 0)
+        {
+            i++;
+            main_ctxt->scrollback_lines =
+                (guint)load_option_count(argv[i], G_MAXUINT);
+        }
+        else if (strcmp(argv[i], "--scrollback-bytes") == 0)
+        {
+            i++;
+            main_ctxt->scrollback_bytes =
+                (gsize)load_option_count(argv[i], G_MAXSIZE);
+        }
         else
         {
             fprintf(stderr, "Invalid option: \"%s\"\n", argv[i]);
@@ -4485,8 +4300,11 @@ gint main(gint argc, gchar *argv[])
     GtkWidget *top, *box, *label;
     GtkRastaContext *main_ctxt;
     GtkTooltips *tips;
+    gint rc;
 
     main_ctxt = g_new0(GtkRastaContext, 1);
+    main_ctxt->scrollback_lines = AC_SCROLLBACK_LINES;
+    main_ctxt->scrollback_bytes = AC_SCROLLBACK_BYTES;
 
     gtk_set_locale();
     gtk_init(&argc, &argv);
@@ -4494,6 +4312,21 @@ gint main(gint argc, gchar *argv[])
     if (load_options(argc, argv, main_ctxt) == FALSE)
         print_usage(-EINVAL);
 
+    if (main_ctxt->trace_filename != NULL)
+    {
+        rc = rasta_trace_chrome_start(main_ctxt->trace_filename);
+        if (rc != 0)
+        {
+            fprintf(stderr, "Unable to open trace file \"%s\": %s\n",
+                    main_ctxt->trace_filename, g_strerror(-rc));
+            return(rc);
+        }
+    }
+
+    if (main_ctxt->profile_filename != NULL)
+        rasta_profile_start(main_ctxt->profile_filename,
+                            RASTA_PROFILE_INTERVAL);
+
     top = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_default_size(GTK_WINDOW(top), 600, 400);
     gtk_window_set_title(GTK_WINDOW(top), "GtkRasta");
@@ -4528,6 +4361,9 @@ gint main(gint argc, gchar *argv[])
     g_idle_add(init_start_func, main_ctxt);
     gtk_main();
 
+    rasta_trace_chrome_stop();
+    rasta_profile_stop();
+
     return(0);
 }  /* main() */
 
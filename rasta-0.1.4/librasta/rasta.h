@@ -47,6 +47,8 @@ extern "C" {
 #define         RASTA_DTD               "rasta.dtd"
 #define         RASTAMODIFY_DTD         "rastamodify.dtd"
 #define         RASTASTATE_DTD          "rastastate.dtd"
+#define         RASTA_PROFILE_FILE      ".rastaprof"
+#define         RASTA_PROFILE_INTERVAL  300     /* Seconds */
 #define         RASTA_CONTEXT(x)        ((RastaContext *)(x))
 #define         RASTA_SCREEN(x)         ((RastaScreen *)(x))
 #define         RASTA_ANY_SCREEN(x)     ((RastaAnyScreen *)(x))
@@ -72,6 +74,10 @@ typedef struct  _RastaRingValue         RastaRingValue;
 typedef struct _REnumeration		REnumeration;
 typedef gpointer (*REnumerationFunc)	(gpointer context);
 
+typedef struct _RastaExecJob            RastaExecJob;
+typedef struct _RastaChoiceIndex        RastaChoiceIndex;
+typedef struct _RastaTraceEvent         RastaTraceEvent;
+
 
 
 /*
@@ -125,6 +131,82 @@ typedef enum
     RASTA_EXEC_FD_NULL,         /* Child fd redirected to /dev/null */
 } RastaExecFDProtocol;
 
+typedef enum
+{
+    RASTA_EXEC_STREAM_NONE   = 0,       /* Collect everything */
+    RASTA_EXEC_STREAM_STDOUT = 1 << 0,  /* Hand stdout over as it arrives */
+    RASTA_EXEC_STREAM_STDERR = 1 << 1   /* Hand stderr over as it arrives */
+} RastaExecStream;
+
+/* Needs the RastaExecStream enum */
+typedef void (*RastaExecOutputFunc)     (RastaExecStream stream,
+                                         const gchar *data,
+                                         gsize len,
+                                         gpointer user_data);
+typedef void (*RastaExecDoneFunc)       (gint status,
+                                         const gchar *out_data,
+                                         const gchar *err_data,
+                                         gpointer user_data);
+
+typedef enum
+{
+    RASTA_TRACE_PARSE,          /* Reading a description or state */
+    RASTA_TRACE_VALIDATE,       /* Checking a document against the DTD */
+    RASTA_TRACE_SCREEN_LOAD,    /* Finding and building a screen */
+    RASTA_TRACE_SYMBOL_SUBST,   /* Substituting symbols into a command */
+    RASTA_TRACE_SPAWN,          /* Starting a child process */
+    RASTA_TRACE_COMMAND         /* A child process, start to exit */
+} RastaTracePhase;
+
+/* Needs the RastaTracePhase enum */
+typedef void (*RastaTraceFunc)          (const RastaTraceEvent *event,
+                                         gpointer user_data);
+
+typedef enum
+{
+    RASTA_STATE_XML       = 0,          /* RASTASTATE document */
+    RASTA_STATE_BINARY    = 1 << 0,     /* Compact binary encoding */
+    RASTA_STATE_LIVE_ONLY = 1 << 1      /* Drop symbols nothing can use */
+} RastaStateFlags;
+
+
+
+/*
+ * Structures
+ */
+
+/*
+ * The contents of an REnumeration are private.  The structure is only
+ * public so that array cursors (see r_enumeration_init_array()) can
+ * live on the stack.
+ */
+struct _REnumeration
+{
+    gpointer context;
+    REnumerationFunc has_more_func;
+    REnumerationFunc get_next_func;
+    GDestroyNotify notify_func;
+    gpointer *items;            /* NULL unless array backed */
+    guint n_items;
+    guint position;
+    gboolean allocated;         /* FALSE for caller-owned cursors */
+};
+
+/*
+ * Handed to a RastaTraceFunc.  The strings belong to librasta and
+ * are only valid during the call.
+ */
+struct _RastaTraceEvent
+{
+    RastaTracePhase phase;
+    const gchar *screen_id;     /* Current screen, or NULL */
+    const gchar *detail;        /* File, DTD or command line, or NULL */
+    guint64 start_ns;           /* Wall clock time at the start */
+    guint64 duration_ns;
+    gsize bytes;                /* Input parsed or output read */
+    pid_t pid;                  /* Child for SPAWN and COMMAND, else 0 */
+};
+
 
 
 /*
@@ -152,7 +234,21 @@ gint rasta_context_save_state(RastaContext *ctxt,
 gint rasta_context_save_state_memory(RastaContext *ctxt,
                                      gchar **state_text,
                                      gint *state_size);
+gint rasta_context_save_state_full(RastaContext *ctxt,
+                                   const gchar *filename,
+                                   RastaStateFlags flags);
+gint rasta_context_save_state_fd(RastaContext *ctxt,
+                                 gint fd,
+                                 RastaStateFlags flags);
+gint rasta_context_save_state_memory_full(RastaContext *ctxt,
+                                          gchar **state_text,
+                                          gint *state_size,
+                                          RastaStateFlags flags);
 void rasta_context_destroy(RastaContext *ctxt);
+
+/* Description reloading */
+gint rasta_watch_description(const gchar *filename);
+void rasta_unwatch_description(const gchar *filename);
                                
 /* Symbol table */
 void rasta_symbol_put(RastaContext *ctxt,
@@ -166,30 +262,50 @@ RastaScreen *rasta_context_get_screen(RastaContext *ctxt);
 gboolean rasta_context_is_initial_screen(RastaContext *ctxt);
 RastaScreenType rasta_screen_get_type(RastaScreen *screen);
 gchar *rasta_screen_get_title(RastaScreen *screen);
+const gchar *rasta_screen_peek_title(RastaScreen *screen);
 void rasta_screen_previous(RastaContext *ctxt);
 
 /* Menu screen functions */
+void rasta_menu_screen_init_cursor(RastaContext *ctxt,
+                                   RastaScreen *screen,
+                                   REnumeration *cursor);
 REnumeration *rasta_menu_screen_enumerate_items(RastaContext *ctxt,
                                                 RastaScreen *screen);
 gchar *rasta_menu_item_get_text(RastaMenuItem *menu_item);
 gchar *rasta_menu_item_get_id(RastaMenuItem *menu_item);
 gchar *rasta_menu_item_get_help(RastaMenuItem *menu_item);
+const gchar *rasta_menu_item_peek_text(RastaMenuItem *menu_item);
+const gchar *rasta_menu_item_peek_id(RastaMenuItem *menu_item);
+const gchar *rasta_menu_item_peek_help(RastaMenuItem *menu_item);
 void rasta_menu_screen_next(RastaContext *ctxt, const gchar *next_id);
 
 /* Dialog screen functions */
+void rasta_dialog_screen_init_cursor(RastaContext *ctxt,
+                                     RastaScreen *screen,
+                                     REnumeration *cursor);
 REnumeration *rasta_dialog_screen_enumerate_fields(RastaContext *ctxt,
                                                    RastaScreen *screen);
 RastaDialogFieldType rasta_dialog_field_get_type(RastaDialogField *field);
 gchar *rasta_dialog_field_get_text(RastaDialogField *field);
 gchar *rasta_dialog_field_get_symbol_name(RastaDialogField *field);
+const gchar *rasta_dialog_field_peek_text(RastaDialogField *field);
+const gchar *rasta_dialog_field_peek_symbol_name(RastaDialogField *field);
 gboolean rasta_dialog_field_is_required(RastaDialogField *field);
 gboolean rasta_entry_dialog_field_is_hidden(RastaDialogField *field);
 gboolean rasta_entry_dialog_field_is_numeric(RastaDialogField *field);
 gchar *rasta_entry_dialog_field_get_format(RastaDialogField *field);
 gint rasta_verify_number_format(const gchar *format,
                                 const gchar *test_val);
+gint rasta_dialog_field_validate_many(RastaDialogField *field,
+                                      const gchar * const *values,
+                                      guint n_values,
+                                      gint *results);
+void rasta_get_number_locale(gunichar *decimal_point,
+                             gunichar *negative_sign,
+                             gunichar *positive_sign);
 guint rasta_entry_dialog_field_get_length(RastaDialogField *field);
 gchar *rasta_dialog_field_get_help(RastaDialogField *field);
+const gchar *rasta_dialog_field_peek_help(RastaDialogField *field);
 void rasta_dialog_screen_next(RastaContext *ctxt);
 
 void rasta_hidden_screen_next(RastaContext *ctxt);
@@ -209,8 +325,12 @@ void rasta_initcommand_failed(RastaContext *ctxt,
                               RastaScreen *screen);
 
 REnumeration *rasta_dialog_field_enumerate_ring(RastaDialogField *field);
+void rasta_dialog_field_init_ring_cursor(RastaDialogField *field,
+                                         REnumeration *cursor);
 gchar *rasta_ring_value_get_text(RastaRingValue *value);
 gchar *rasta_ring_value_get_value(RastaRingValue *value);
+const gchar *rasta_ring_value_peek_text(RastaRingValue *value);
+const gchar *rasta_ring_value_peek_value(RastaRingValue *value);
 
 gboolean rasta_listcommand_is_single_column(RastaDialogField *field);
 gchar *rasta_listcommand_get_encoding(RastaDialogField *field);
@@ -246,6 +366,45 @@ gint rasta_exec_command_l(pid_t *pid,
                           RastaExecFDProtocol err_prot,
                           const gchar *command,
                           ...);
+gint rasta_exec_watch_child(GMainContext *context,
+                            pid_t pid,
+                            gint outfd,
+                            gint errfd,
+                            const gchar *encoding,
+                            RastaExecStream streams,
+                            RastaExecOutputFunc output_func,
+                            RastaExecDoneFunc done_func,
+                            gpointer user_data);
+gchar *rasta_exec_locale_from_utf8(const gchar *utf8_str, GError **error);
+gboolean rasta_get_charset(const gchar **charset);
+
+/* Choice index functions */
+RastaChoiceIndex *rasta_choice_index_new();
+void rasta_choice_index_free(RastaChoiceIndex *index);
+guint rasta_choice_index_add(RastaChoiceIndex *index,
+                             const gchar *item);
+guint rasta_choice_index_size(RastaChoiceIndex *index);
+guint *rasta_choice_index_find_prefix(RastaChoiceIndex *index,
+                                      const gchar *prefix,
+                                      guint *n_matches);
+guint *rasta_choice_index_find(RastaChoiceIndex *index,
+                               const gchar *text,
+                               guint *n_matches);
+
+/* Tracing functions */
+void rasta_set_trace_handler(RastaTraceFunc func,
+                             gpointer user_data);
+const gchar *rasta_trace_phase_name(RastaTracePhase phase);
+void rasta_trace_child_exited(pid_t pid, gint status, gsize bytes);
+gint rasta_trace_chrome_start(const gchar *filename);
+void rasta_trace_chrome_stop();
+
+/* Profiling functions */
+gint rasta_profile_start(const gchar *filename,
+                         guint interval);
+gint rasta_profile_flush();
+void rasta_profile_stop();
+void rasta_profile_action(RastaContext *ctxt, pid_t pid);
 
 /* Enumeration functions */
 REnumeration* r_enumeration_new(gpointer context,
@@ -253,8 +412,15 @@ REnumeration* r_enumeration_new(gpointer context,
                                 REnumerationFunc get_next_func,
                                 GDestroyNotify notify_func);
 REnumeration* r_enumeration_new_from_list(GList *init_list);
+REnumeration* r_enumeration_new_from_array(gpointer *items,
+                                           guint n_items);
+void r_enumeration_init_array(REnumeration *enumeration,
+                              gpointer *items,
+                              guint n_items);
 gboolean r_enumeration_has_more(REnumeration *enumeration);
 gpointer r_enumeration_get_next(REnumeration *enumeration);
+gint r_enumeration_count(REnumeration *enumeration);
+gpointer r_enumeration_nth(REnumeration *enumeration, guint n);
 void r_enumeration_free(REnumeration *enumeration);
 
 #ifdef __cplusplus
@@ -37,6 +37,7 @@
 #include "rastascreen.h"
 #include "rastaaction.h"
 #include "rastatraverse.h"
+#include "rastaprofile.h"
 #include "rastaexec.h"
 
 
@@ -235,10 +236,7 @@ gchar *rasta_action_screen_get_encoding(RastaScreen *screen)
 
     encoding = RASTA_ACTION_SCREEN(screen)->encoding;
 
-    if (strcmp(encoding, "system") == 0)
-        g_get_charset(&encoding);
-
-    return(g_strdup(encoding));
+    return(g_strdup(rasta_exec_resolve_encoding(encoding)));
 }  /* rasta_action_screen_get_encoding() */
 
 
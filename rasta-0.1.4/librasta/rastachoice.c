@@ -0,0 +1,417 @@
+/*
+ * rastachoice.c
+ *
+ * Code for searchable indexes of list choices
+ *
+ * Copyright (c) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+
+#include "rasta.h"
+
+
+
+/*
+ * Defines
+ */
+#define CHOICE_GRAM_LEN 3
+#define CHOICE_GRAM(s) ((((guint32)(guchar)(s)[0]) << 16) | \
+                        (((guint32)(guchar)(s)[1]) << 8) | \
+                        ((guint32)(guchar)(s)[2]))
+
+
+
+/*
+ * Structures
+ */
+
+/*
+ * Items are known by their id, the order they were added in.  The
+ * index keeps a case-folded copy of each item.  Prefix lookups
+ * binary search the ids sorted by key, which behaves like walking a
+ * prefix trie without a node per character.  The sort is brought up
+ * to date lazily, so adding stays cheap while a list streams in.
+ * Substring lookups use the trigram postings to pick candidates.
+ */
+struct _RastaChoiceIndex
+{
+    GPtrArray *keys;            /* Folded text, by id */
+    guint *sorted;              /* ids in key order */
+    guint n_sorted;
+    GHashTable *grams;          /* trigram -> GArray of ids */
+};
+
+
+
+/*
+ * Prototypes
+ */
+static gchar *rasta_choice_fold(const gchar *text);
+static gint rasta_choice_compare(gconstpointer a,
+                                 gconstpointer b,
+                                 gpointer user_data);
+static void rasta_choice_index_sort(RastaChoiceIndex *index);
+static void rasta_choice_free_gram(gpointer key,
+                                   gpointer value,
+                                   gpointer user_data);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static gchar *rasta_choice_fold(const gchar *text)
+ *
+ * Returns the case-folded form of text used for matching.
+ * LISTCOMMAND output is not always UTF-8, so invalid text is only
+ * folded as ASCII.
+ */
+static gchar *rasta_choice_fold(const gchar *text)
+{
+    if (g_utf8_validate(text, -1, NULL) != FALSE)
+        return(g_utf8_casefold(text, -1));
+
+    return(g_ascii_strdown(text, -1));
+}  /* rasta_choice_fold() */
+
+
+/*
+ * static gint rasta_choice_compare(gconstpointer a,
+ *                                  gconstpointer b,
+ *                                  gpointer user_data)
+ *
+ * Orders two ids by their keys, then by id.
+ */
+static gint rasta_choice_compare(gconstpointer a,
+                                 gconstpointer b,
+                                 gpointer user_data)
+{
+    GPtrArray *keys;
+    guint id_a, id_b;
+    gint rc;
+
+    keys = (GPtrArray *)user_data;
+    id_a = *(const guint *)a;
+    id_b = *(const guint *)b;
+
+    rc = strcmp(g_ptr_array_index(keys, id_a),
+                g_ptr_array_index(keys, id_b));
+    if (rc == 0)
+        rc = (id_a < id_b) ? -1 : (id_a > id_b);
+
+    return(rc);
+}  /* rasta_choice_compare() */
+
+
+/*
+ * static void rasta_choice_index_sort(RastaChoiceIndex *index)
+ *
+ * Brings the sorted id array up to date.  Only the items added since
+ * the last sort are sorted; they are then merged with the rest.
+ */
+static void rasta_choice_index_sort(RastaChoiceIndex *index)
+{
+    guint *merged, *tail;
+    guint i, j, k, n_keys, n_tail;
+
+    n_keys = index->keys->len;
+    if (index->n_sorted == n_keys)
+        return;
+
+    n_tail = n_keys - index->n_sorted;
+    tail = g_new(guint, n_tail);
+    for (i = 0; i < n_tail; i++)
+        tail[i] = index->n_sorted + i;
+    g_qsort_with_data(tail, n_tail, sizeof(guint),
+                      rasta_choice_compare, index->keys);
+
+    merged = g_new(guint, n_keys);
+    i = j = k = 0;
+    while ((i < index->n_sorted) && (j < n_tail))
+    {
+        if (rasta_choice_compare(&(index->sorted[i]), &(tail[j]),
+                                 index->keys) <= 0)
+            merged[k++] = index->sorted[i++];
+        else
+            merged[k++] = tail[j++];
+    }
+    while (i < index->n_sorted)
+        merged[k++] = index->sorted[i++];
+    while (j < n_tail)
+        merged[k++] = tail[j++];
+
+    g_free(tail);
+    g_free(index->sorted);
+    index->sorted = merged;
+    index->n_sorted = n_keys;
+}  /* rasta_choice_index_sort() */
+
+
+/*
+ * RastaChoiceIndex *rasta_choice_index_new()
+ *
+ * Creates a new, empty choice index.
+ */
+RastaChoiceIndex *rasta_choice_index_new()
+{
+    RastaChoiceIndex *index;
+
+    index = g_new0(RastaChoiceIndex, 1);
+    if (index == NULL)
+        return(NULL);
+
+    index->keys = g_ptr_array_new();
+    index->grams = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return(index);
+}  /* rasta_choice_index_new() */
+
+
+/*
+ * static void rasta_choice_free_gram(gpointer key,
+ *                                    gpointer value,
+ *                                    gpointer user_data)
+ *
+ * Frees one trigram's postings.
+ */
+static void rasta_choice_free_gram(gpointer key,
+                                   gpointer value,
+                                   gpointer user_data)
+{
+    g_array_free((GArray *)value, TRUE);
+}  /* rasta_choice_free_gram() */
+
+
+/*
+ * void rasta_choice_index_free(RastaChoiceIndex *index)
+ *
+ * Frees a choice index.
+ */
+void rasta_choice_index_free(RastaChoiceIndex *index)
+{
+    guint i;
+
+    g_return_if_fail(index != NULL);
+
+    for (i = 0; i < index->keys->len; i++)
+        g_free(g_ptr_array_index(index->keys, i));
+    g_ptr_array_free(index->keys, TRUE);
+
+    g_hash_table_foreach(index->grams, rasta_choice_free_gram, NULL);
+    g_hash_table_destroy(index->grams);
+
+    g_free(index->sorted);
+    g_free(index);
+}  /* rasta_choice_index_free() */
+
+
+/*
+ * guint rasta_choice_index_add(RastaChoiceIndex *index,
+ *                              const gchar *item)
+ *
+ * Adds an item to the index, returning its id.  Ids count up from 0
+ * in the order items are added, so they match the position of the
+ * item in the caller's list.
+ */
+guint rasta_choice_index_add(RastaChoiceIndex *index,
+                             const gchar *item)
+{
+    gchar *key;
+    guint id, len, i;
+    guint32 gram;
+    GArray *postings;
+
+    g_return_val_if_fail(index != NULL, 0);
+    g_return_val_if_fail(item != NULL, 0);
+
+    id = index->keys->len;
+    key = rasta_choice_fold(item);
+    g_ptr_array_add(index->keys, key);
+
+    len = strlen(key);
+    for (i = 0; (i + CHOICE_GRAM_LEN) <= len; i++)
+    {
+        gram = CHOICE_GRAM(key + i);
+        postings = g_hash_table_lookup(index->grams,
+                                       GUINT_TO_POINTER(gram));
+        if (postings == NULL)
+        {
+            postings = g_array_new(FALSE, FALSE, sizeof(guint));
+            g_hash_table_insert(index->grams, GUINT_TO_POINTER(gram),
+                                postings);
+        }
+
+        /* Ids only grow, so a repeat is always the last entry */
+        if ((postings->len == 0) ||
+            (g_array_index(postings, guint, postings->len - 1) != id))
+            g_array_append_val(postings, id);
+    }
+
+    return(id);
+}  /* rasta_choice_index_add() */
+
+
+/*
+ * guint rasta_choice_index_size(RastaChoiceIndex *index)
+ *
+ * Returns the number of items in the index.
+ */
+guint rasta_choice_index_size(RastaChoiceIndex *index)
+{
+    g_return_val_if_fail(index != NULL, 0);
+
+    return(index->keys->len);
+}  /* rasta_choice_index_size() */
+
+
+/*
+ * guint *rasta_choice_index_find_prefix(RastaChoiceIndex *index,
+ *                                       const gchar *prefix,
+ *                                       guint *n_matches)
+ *
+ * Finds the items starting with prefix, ignoring case.  Returns a
+ * newly allocated array of ids in alphabetical order of the items,
+ * or NULL if nothing matches.  The number of ids is set in
+ * n_matches.
+ */
+guint *rasta_choice_index_find_prefix(RastaChoiceIndex *index,
+                                      const gchar *prefix,
+                                      guint *n_matches)
+{
+    gchar *key;
+    guint *matches;
+    guint lo, hi, mid, end, len;
+
+    g_return_val_if_fail(index != NULL, NULL);
+    g_return_val_if_fail(prefix != NULL, NULL);
+    g_return_val_if_fail(n_matches != NULL, NULL);
+
+    *n_matches = 0;
+    rasta_choice_index_sort(index);
+
+    key = rasta_choice_fold(prefix);
+    len = strlen(key);
+
+    /* First key >= prefix */
+    lo = 0;
+    hi = index->n_sorted;
+    while (lo < hi)
+    {
+        mid = lo + ((hi - lo) / 2);
+        if (strcmp(g_ptr_array_index(index->keys, index->sorted[mid]),
+                   key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (end = lo; end < index->n_sorted; end++)
+    {
+        if (strncmp(g_ptr_array_index(index->keys, index->sorted[end]),
+                    key, len) != 0)
+            break;
+    }
+    g_free(key);
+
+    if (end == lo)
+        return(NULL);
+
+    *n_matches = end - lo;
+    matches = g_new(guint, *n_matches);
+    memcpy(matches, index->sorted + lo, *n_matches * sizeof(guint));
+
+    return(matches);
+}  /* rasta_choice_index_find_prefix() */
+
+
+/*
+ * guint *rasta_choice_index_find(RastaChoiceIndex *index,
+ *                                const gchar *text,
+ *                                guint *n_matches)
+ *
+ * Finds the items containing text, ignoring case.  Returns a newly
+ * allocated array of ids in list order, or NULL if nothing matches.
+ * The number of ids is set in n_matches.
+ */
+guint *rasta_choice_index_find(RastaChoiceIndex *index,
+                               const gchar *text,
+                               guint *n_matches)
+{
+    gchar *key;
+    GArray *found, *postings, *best;
+    guint i, id, len;
+
+    g_return_val_if_fail(index != NULL, NULL);
+    g_return_val_if_fail(text != NULL, NULL);
+    g_return_val_if_fail(n_matches != NULL, NULL);
+
+    *n_matches = 0;
+    key = rasta_choice_fold(text);
+    len = strlen(key);
+    found = g_array_new(FALSE, FALSE, sizeof(guint));
+
+    if (len < CHOICE_GRAM_LEN)
+    {
+        /* Too short for the trigrams, a plain scan is fast enough */
+        for (id = 0; id < index->keys->len; id++)
+        {
+            if (strstr(g_ptr_array_index(index->keys, id), key) != NULL)
+                g_array_append_val(found, id);
+        }
+    }
+    else
+    {
+        /* Verify the candidates from the rarest trigram */
+        best = NULL;
+        for (i = 0; (i + CHOICE_GRAM_LEN) <= len; i++)
+        {
+            postings = g_hash_table_lookup(index->grams,
+                                           GUINT_TO_POINTER(CHOICE_GRAM(key + i)));
+            if (postings == NULL)
+            {
+                best = NULL;
+                break;
+            }
+            if ((best == NULL) || (postings->len < best->len))
+                best = postings;
+        }
+
+        for (i = 0; (best != NULL) && (i < best->len); i++)
+        {
+            id = g_array_index(best, guint, i);
+            if (strstr(g_ptr_array_index(index->keys, id), key) != NULL)
+                g_array_append_val(found, id);
+        }
+    }
+
+    g_free(key);
+
+    *n_matches = found->len;
+    return((guint *)g_array_free(found, found->len == 0));
+}  /* rasta_choice_index_find() */
@@ -26,6 +26,11 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <glib.h>
 #include <libxml/parser.h>
@@ -38,6 +43,10 @@
 #include "rastatraverse.h"
 #include "rastascope.h"
 #include "rastascreen.h"
+#include "rastamenu.h"
+#include "rastaprofile.h"
+#include "rastatrace.h"
+#include "rastastate.h"
 
 
 
@@ -48,16 +57,25 @@ static gint validate_dtd(xmlDocPtr doc,
                          const xmlChar *name,
                          const xmlChar *id);
 static gboolean rasta_context_init_screens(RastaContext *ctxt);
+static void rasta_context_clear_screens(RastaContext *ctxt);
 static xmlNodePtr rasta_context_validate_state(RastaContext *ctxt,
                                                xmlDocPtr state_doc);
 static gint rasta_context_prepare_state(RastaContext *ctxt,
                                         xmlDocPtr state_doc);
 static gint rasta_context_travel_state(RastaContext *ctxt,
                                        xmlDocPtr state_doc,
-                                       xmlNodePtr cur);
+                                       xmlNodePtr cur,
+                                       gboolean direct);
+static guint rasta_context_parse_steps(const gchar *path,
+                                       guint *steps);
 static void rasta_context_revert_state(RastaContext *ctxt);
-static gint rasta_context_build_state_xml(RastaContext *ctxt,
-                                          xmlDocPtr *doc);
+static gint rasta_context_prepare_binary_state(RastaContext *ctxt,
+                                               const gchar *data,
+                                               gsize len);
+static gint rasta_context_parse_xml_state_chunk(RastaContext *ctxt,
+                                                gpointer data_chunk,
+                                                gint size,
+                                                gboolean terminate);
 
 
 /*
@@ -92,6 +110,8 @@ static gint validate_dtd(xmlDocPtr doc,
     xmlValidCtxt val = {0, };
     xmlDtdPtr dtd;
     xmlNodePtr cur;
+    guint64 start;
+    gint rc;
 
     dtd = xmlGetIntSubset(doc);
     if (dtd && ((xmlStrcmp(dtd->name, name) != 0) ||
@@ -119,7 +139,13 @@ static gint validate_dtd(xmlDocPtr doc,
     val.userData = NULL;
     val.error = NULL;
     val.warning = NULL;
-    return(!xmlValidateDocument(&val, doc));
+
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
+    rc = !xmlValidateDocument(&val, doc);
+    rasta_trace_emit(RASTA_TRACE_VALIDATE, NULL, (const gchar *)id,
+                     start, 0, 0);
+
+    return(rc);
 }  /* validate_dtd() */
 
 
@@ -132,6 +158,7 @@ static gint validate_dtd(xmlDocPtr doc,
 RastaContext *rasta_context_init(const gchar *filename,
                                  const gchar *fastpath)
 {
+    xmlDocPtr doc;
     RastaContext *new_ctxt;
 
     g_return_val_if_fail(filename != NULL, NULL);
@@ -143,25 +170,29 @@ RastaContext *rasta_context_init(const gchar *filename,
     new_ctxt->state = RASTA_CONTEXT_UNINITIALIZED;
     new_ctxt->filename = g_strdup(filename);
     new_ctxt->fastpath = g_strdup(fastpath);
+    new_ctxt->doc = NULL;
+    new_ctxt->snapshot = NULL;
     new_ctxt->parser = NULL;
+    new_ctxt->state_buffer = NULL;
     new_ctxt->scopes = NULL;
+    new_ctxt->ns = NULL;
     new_ctxt->screens = NULL;
+    new_ctxt->path_root = NULL;
     new_ctxt->screen_cache = NULL;
-    
-    new_ctxt->doc = xmlParseFile(new_ctxt->filename);
-    if (new_ctxt->doc == NULL)
-    {
-        rasta_context_destroy(new_ctxt);
-        return(NULL);
-    }
 
-    if (validate_dtd(new_ctxt->doc, "RASTA",
-                     "file://" _RASTA_DATA_DIR
-                     G_DIR_SEPARATOR_S RASTA_DTD) != 0)
+    /* A watched description is already parsed */
+    new_ctxt->snapshot = rasta_watch_get_snapshot(new_ctxt->filename);
+    if (new_ctxt->snapshot == NULL)
     {
-        rasta_context_destroy(new_ctxt);
-        return(NULL);
+        doc = rasta_context_load_doc(new_ctxt->filename);
+        if (doc == NULL)
+        {
+            rasta_context_destroy(new_ctxt);
+            return(NULL);
+        }
+        new_ctxt->snapshot = rasta_snapshot_new(doc);
     }
+    new_ctxt->doc = new_ctxt->snapshot->doc;
 
     new_ctxt->state = RASTA_CONTEXT_INITIALIZED;
 
@@ -197,8 +228,12 @@ RastaContext *rasta_context_init_push(const gchar *filename,
     new_ctxt->filename = g_strdup(filename);
     new_ctxt->fastpath = g_strdup(fastpath);
     new_ctxt->doc = NULL;
+    new_ctxt->snapshot = NULL;
+    new_ctxt->state_buffer = NULL;
     new_ctxt->scopes = NULL;
+    new_ctxt->ns = NULL;
     new_ctxt->screens = NULL;
+    new_ctxt->path_root = NULL;
     new_ctxt->screen_cache = NULL;
     
     new_ctxt->parser = xmlCreatePushParserCtxt(NULL, NULL,
@@ -227,14 +262,17 @@ gint rasta_context_parse_chunk(RastaContext *ctxt,
                                gint size)
 {
     gint rc;
+    guint64 start;
 
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
     g_return_val_if_fail(ctxt->parser != NULL, -EINVAL);
     g_return_val_if_fail(size > -1, -EINVAL);
     g_return_val_if_fail((size == 0) || (data_chunk != NULL), -EINVAL);
 
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
     rc = xmlParseChunk(ctxt->parser, data_chunk, size,
                        (size == 0) ? 1 : 0);
+    rasta_trace_emit(RASTA_TRACE_PARSE, NULL, NULL, start, size, 0);
 
     if (rc != 0)
     {
@@ -259,6 +297,7 @@ gint rasta_context_parse_chunk(RastaContext *ctxt,
         }
         else
         {
+            ctxt->snapshot = rasta_snapshot_new(ctxt->doc);
             ctxt->state = RASTA_CONTEXT_INITIALIZED;
             if (rasta_context_init_screens(ctxt) == FALSE)
             {
@@ -285,17 +324,166 @@ void rasta_context_destroy(RastaContext *ctxt)
     if (ctxt->parser != NULL)
     {
         if (ctxt->parser->myDoc != NULL)
-            ctxt->doc = ctxt->parser->myDoc;
+        {
+            if (ctxt->snapshot != NULL)  /* Half-loaded state */
+                xmlFreeDoc(ctxt->parser->myDoc);
+            else
+                ctxt->doc = ctxt->parser->myDoc;
+        }
         xmlFreeParserCtxt(ctxt->parser);
     }
-    if (ctxt->doc != NULL)
+    if (ctxt->state_buffer != NULL)
+        g_string_free(ctxt->state_buffer, TRUE);
+    rasta_context_clear_screens(ctxt);
+    if (ctxt->snapshot != NULL)
+        rasta_snapshot_unref(ctxt->snapshot);
+    else if (ctxt->doc != NULL)
         xmlFreeDoc(ctxt->doc);
     g_free(ctxt->filename);
     g_free(ctxt->fastpath);
-    /* FIXME: Clear scopes */
 }  /* rasta_context_destroy() */
 
 
+/*
+ * static void rasta_context_clear_screens(RastaContext *ctxt)
+ *
+ * Drops the scopes and caches built from the context's document
+ */
+static void rasta_context_clear_screens(RastaContext *ctxt)
+{
+    rasta_scope_clear(ctxt);
+    if (ctxt->screen_cache != NULL)
+    {
+        g_hash_table_destroy(ctxt->screen_cache);
+        ctxt->screen_cache = NULL;
+    }
+}  /* rasta_context_clear_screens() */
+
+
+/*
+ * xmlDocPtr rasta_context_load_doc(const gchar *filename)
+ *
+ * Parses and validates a description file.  The root is checked
+ * too, so that a reloaded description is one a context can
+ * actually start from.  Returns NULL if the file is unusable.
+ */
+xmlDocPtr rasta_context_load_doc(const gchar *filename)
+{
+    xmlDocPtr doc;
+    guint64 start;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
+    doc = xmlParseFile(filename);
+    if (start != 0)
+        rasta_trace_emit(RASTA_TRACE_PARSE, NULL, filename, start,
+                         rasta_trace_file_size(filename), 0);
+    if (doc == NULL)
+        return(NULL);
+
+    return(rasta_context_check_doc(doc));
+}  /* rasta_context_load_doc() */
+
+
+/*
+ * xmlDocPtr rasta_context_check_doc(xmlDocPtr doc)
+ *
+ * Validates a parsed description, as rasta_context_load_doc()
+ * does.  Returns doc, or frees it and returns NULL if it is
+ * unusable.
+ */
+xmlDocPtr rasta_context_check_doc(xmlDocPtr doc)
+{
+    RastaContext check;
+
+    g_return_val_if_fail(doc != NULL, NULL);
+
+    if (validate_dtd(doc, "RASTA",
+                     "file://" _RASTA_DATA_DIR
+                     G_DIR_SEPARATOR_S RASTA_DTD) != 0)
+    {
+        xmlFreeDoc(doc);
+        return(NULL);
+    }
+
+    memset(&check, 0, sizeof(check));
+    check.doc = doc;
+    if (rasta_validate_root(&check) == FALSE)
+    {
+        xmlFreeDoc(doc);
+        return(NULL);
+    }
+
+    return(doc);
+}  /* rasta_context_check_doc() */
+
+
+/*
+ * gboolean rasta_context_reload(RastaContext *ctxt)
+ *
+ * Moves a context sitting at its initial screen onto the newest
+ * copy of a watched description.  The initial screen is found in
+ * the new document first.  If it can't be, say because the
+ * context's fastpath screen was removed, the context stays on the
+ * old document.  Otherwise everything built from the old document
+ * is dropped.  The old document goes away once no context holds
+ * it.  Returns TRUE if the context changed.
+ */
+gboolean rasta_context_reload(RastaContext *ctxt)
+{
+    RastaSnapshot *snapshot;
+    RastaContext old;
+    RastaScreen *screen;
+    gboolean rc;
+
+    g_return_val_if_fail(ctxt != NULL, FALSE);
+
+    if ((ctxt->snapshot == NULL) || (ctxt->parser != NULL))
+        return(FALSE);
+
+    snapshot = rasta_watch_get_snapshot(ctxt->filename);
+    if (snapshot == NULL)
+        return(FALSE);
+    if (snapshot == ctxt->snapshot)
+    {
+        rasta_snapshot_unref(snapshot);
+        return(FALSE);
+    }
+
+    /* Set the old document aside until the new one has a screen */
+    old = *ctxt;
+    ctxt->snapshot = snapshot;
+    ctxt->doc = snapshot->doc;
+    ctxt->ns = NULL;
+    ctxt->screens = NULL;
+    ctxt->path_root = NULL;
+    ctxt->scopes = NULL;
+    ctxt->screen_cache = NULL;
+    ctxt->state = RASTA_CONTEXT_INITIALIZED;
+
+    rc = rasta_context_init_screens(ctxt);
+    screen = NULL;
+    if ((rc != FALSE) && (ctxt->scopes != NULL))
+        screen = rasta_scope_get_screen(rasta_scope_get_current(ctxt));
+    if ((screen == NULL) || (screen->type == RASTA_SCREEN_NONE))
+    {
+        /* A placeholder screen is made without the screen cache */
+        if (ctxt->screen_cache == NULL)
+            g_free(screen);
+        rasta_context_clear_screens(ctxt);
+        rasta_snapshot_unref(snapshot);
+        *ctxt = old;
+        return(FALSE);
+    }
+
+    rasta_context_clear_screens(&old);
+    rasta_snapshot_unref(old.snapshot);
+
+    return(TRUE);
+}  /* rasta_context_reload() */
+
+
 /*
  * static gboolean rasta_context_init_screens(RastaContext *ctxt)
  *
@@ -335,23 +523,46 @@ static gboolean rasta_context_init_screens(RastaContext *ctxt)
  *                                        const gchar *filename)
  *
  * Moves a RastaContext to a given state.  The RastaContext must
- * be in its initial state with no fastpath.
+ * be in its initial state with no fastpath.  The file may hold
+ * either a RASTASTATE document or a binary state.
  */
 gint rasta_context_load_state(RastaContext *ctxt,
                               const gchar *filename)
 {
     gint rc;
+    gchar *data;
+    gsize len;
     xmlDocPtr state_doc;
+    guint64 start;
 
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
     g_return_val_if_fail(ctxt->parser == NULL, -EINVAL);
+    g_return_val_if_fail(ctxt->state_buffer == NULL, -EINVAL);
     g_return_val_if_fail(ctxt->fastpath == NULL, -EINVAL);
     g_return_val_if_fail(rasta_context_is_initial_screen(ctxt),
                          -EINVAL);
     g_return_val_if_fail(filename != NULL, -EINVAL);
     g_return_val_if_fail(filename[0] != '\0', -EINVAL);
 
-    state_doc = xmlParseFile(filename);
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
+    if (g_file_get_contents(filename, &data, &len, NULL) == FALSE)
+        return(-EBADF);
+
+    if (rasta_state_is_binary(data, len))
+    {
+        rc = rasta_context_prepare_binary_state(ctxt, data, len);
+        if (start != 0)
+            rasta_trace_emit(RASTA_TRACE_PARSE, NULL, filename, start,
+                             len, 0);
+        g_free(data);
+        return(rc);
+    }
+
+    state_doc = xmlParseMemory(data, len);
+    g_free(data);
+    if (start != 0)
+        rasta_trace_emit(RASTA_TRACE_PARSE, NULL, filename, start,
+                         len, 0);
     if (state_doc == NULL)
         return(-EBADF);
 
@@ -379,6 +590,7 @@ gint rasta_context_load_state_push(RastaContext *ctxt,
 {
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
     g_return_val_if_fail(ctxt->parser == NULL, -EINVAL);
+    g_return_val_if_fail(ctxt->state_buffer == NULL, -EINVAL);
     g_return_val_if_fail(ctxt->fastpath == NULL, -EINVAL);
     g_return_val_if_fail(rasta_context_is_initial_screen(ctxt),
                          -EINVAL);
@@ -391,34 +603,35 @@ gint rasta_context_load_state_push(RastaContext *ctxt,
     if (ctxt->parser == NULL)
         return(-EBADF);
 
+    /* Held back until we know whether this is XML */
+    ctxt->state_buffer = g_string_new(NULL);
+
     return(0);
 }  /* rasta_context_load_state_push() */
 
 
 /*
+ * static gint rasta_context_parse_xml_state_chunk(RastaContext *ctxt,
+ *                                                 gpointer data_chunk,
+ *                                                 gint size,
+ *                                                 gboolean terminate)
  *
- * gint rasta_context_parse_state_chunk(RastaContext *ctxt,
- *                                      gpointer data_chunk,
- *                                      gint size)
- *
- * Parses a chunk of data; a data size of 0 indicates end of file.
+ * Hands a chunk of a RASTASTATE document to the push parser, and
+ * moves the context once the document is complete.
  */
-gint rasta_context_parse_state_chunk(RastaContext *ctxt,
-                                     gpointer data_chunk,
-                                     gint size)
+static gint rasta_context_parse_xml_state_chunk(RastaContext *ctxt,
+                                                gpointer data_chunk,
+                                                gint size,
+                                                gboolean terminate)
 {
     gint rc;
     xmlDocPtr state_doc;
+    guint64 start;
 
-    g_return_val_if_fail(ctxt != NULL, -EINVAL);
-    g_return_val_if_fail(ctxt->parser != NULL, -EINVAL);
-    g_return_val_if_fail(rasta_context_is_initial_screen(ctxt),
-                         -EINVAL);
-    g_return_val_if_fail(size > -1, -EINVAL);
-    g_return_val_if_fail((size == 0) || (data_chunk != NULL), -EINVAL);
-
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
     rc = xmlParseChunk(ctxt->parser, data_chunk, size,
-                       (size == 0) ? 1 : 0);
+                       terminate ? 1 : 0);
+    rasta_trace_emit(RASTA_TRACE_PARSE, NULL, NULL, start, size, 0);
 
     if (rc != 0)
     {
@@ -427,7 +640,7 @@ gint rasta_context_parse_state_chunk(RastaContext *ctxt,
         xmlFreeParserCtxt(ctxt->parser);
         ctxt->parser = NULL;
     }
-    else if (size == 0)
+    else if (terminate != FALSE)
     {
         state_doc = ctxt->parser->myDoc;
         xmlFreeParserCtxt(ctxt->parser);
@@ -442,6 +655,69 @@ gint rasta_context_parse_state_chunk(RastaContext *ctxt,
         xmlFreeDoc(state_doc);
     }
 
+    return(rc);
+}  /* rasta_context_parse_xml_state_chunk() */
+
+
+/*
+ *
+ * gint rasta_context_parse_state_chunk(RastaContext *ctxt,
+ *                                      gpointer data_chunk,
+ *                                      gint size)
+ *
+ * Parses a chunk of data; a data size of 0 indicates end of file.
+ * The first few bytes are held back to tell a binary state from a
+ * RASTASTATE document.  A binary state is collected and decoded at
+ * end of file.
+ */
+gint rasta_context_parse_state_chunk(RastaContext *ctxt,
+                                     gpointer data_chunk,
+                                     gint size)
+{
+    gint rc;
+    GString *held;
+    guint64 start;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail((ctxt->parser != NULL) ||
+                         (ctxt->state_buffer != NULL), -EINVAL);
+    g_return_val_if_fail(rasta_context_is_initial_screen(ctxt),
+                         -EINVAL);
+    g_return_val_if_fail(size > -1, -EINVAL);
+    g_return_val_if_fail((size == 0) || (data_chunk != NULL), -EINVAL);
+
+    if (ctxt->state_buffer == NULL)
+        return(rasta_context_parse_xml_state_chunk(ctxt, data_chunk,
+                                                   size, size == 0));
+
+    held = ctxt->state_buffer;
+    g_string_append_len(held, data_chunk, size);
+    if ((size != 0) && (held->len < RASTA_STATE_MAGIC_LEN))
+        return(0);
+
+    if (rasta_state_is_binary(held->str, held->len))
+    {
+        if (ctxt->parser != NULL)
+        {
+            xmlFreeParserCtxt(ctxt->parser);
+            ctxt->parser = NULL;
+        }
+        if (size != 0)
+            return(0);
+
+        start = RASTA_TRACING() ? rasta_trace_now() : 0;
+        rc = rasta_context_prepare_binary_state(ctxt, held->str,
+                                                held->len);
+        rasta_trace_emit(RASTA_TRACE_PARSE, NULL, NULL, start,
+                         held->len, 0);
+    }
+    else
+        rc = rasta_context_parse_xml_state_chunk(ctxt, held->str,
+                                                 held->len, size == 0);
+
+    ctxt->state_buffer = NULL;
+    g_string_free(held, TRUE);
+
     return(rc);
 }  /* rasta_context_parse_state_chunk() */
 
@@ -458,7 +734,8 @@ static xmlNodePtr rasta_context_validate_state(RastaContext *ctxt,
     xmlNodePtr cur;
     xmlNsPtr ns;
     RastaScope *scope;
-    gchar *id, *attr;
+    const gchar *id;
+    gchar *attr;
 
     g_return_val_if_fail(ctxt != NULL, NULL);
     g_return_val_if_fail(state_doc != NULL, NULL);
@@ -486,16 +763,11 @@ static xmlNodePtr rasta_context_validate_state(RastaContext *ctxt,
             {
                 scope = rasta_scope_get_current(ctxt);
                 g_assert(scope != NULL);
-                id = rasta_scope_get_id(scope);
-                if (id != NULL)
+                id = rasta_scope_peek_id(scope);
+                if ((id != NULL) && (xmlStrcmp(id, attr) == 0))
                 {
-                    if (xmlStrcmp(id, attr) == 0)
-                    {
-                        g_free(id);
-                        g_free(attr);
-                        break;
-                    }
-                    g_free(id);
+                    g_free(attr);
+                    break;
                 }
                 g_free(attr);
             }
@@ -507,21 +779,190 @@ static xmlNodePtr rasta_context_validate_state(RastaContext *ctxt,
 }  /* rasta_context_validate_state() */
 
 
+/*
+ * gint rasta_context_travel_scope(RastaContext *ctxt,
+ *                                 const gchar *name)
+ *
+ * Moves from the current screen to the next one on the way to a
+ * saved state.  name is the id the saved state recorded for it.
+ */
+gint rasta_context_travel_scope(RastaContext *ctxt,
+                                const gchar *name)
+{
+    const gchar *id;
+    RastaScreen *screen;
+    RastaScope *scope;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(name != NULL, -EINVAL);
+
+    /* The scope may have been restored directly */
+    rasta_context_restore_finish(ctxt);
+
+    screen = rasta_context_get_screen(ctxt);
+    switch (screen->type)
+    {
+        case RASTA_SCREEN_MENU:
+            rasta_menu_screen_next(ctxt, name);
+            break;
+
+        case RASTA_SCREEN_DIALOG:
+            rasta_dialog_screen_next(ctxt);
+            break;
+
+        case RASTA_SCREEN_HIDDEN:
+            rasta_hidden_screen_next(ctxt);
+            break;
+
+        case RASTA_SCREEN_ACTION:
+        default:
+            return(-EBADF);
+            break;
+    }
+
+    /* We've jumped the state, no initcommand */
+    if (ctxt->state == RASTA_CONTEXT_INITCOMMAND)
+        ctxt->state = RASTA_CONTEXT_SCREEN;
+
+    scope = rasta_scope_get_current(ctxt);
+    if (scope == NULL)
+        return(-EBADF);
+    id = rasta_scope_peek_id(scope);
+    if (id == NULL)
+        return(-EBADF);
+
+    if (xmlStrcmp(name, id) != 0)
+        return(-EBADF);
+
+    return(0);
+}  /* rasta_context_travel_scope() */
+
+
+/*
+ * gint rasta_context_restore_scope(RastaContext *ctxt,
+ *                                  const gchar *name,
+ *                                  const guint *steps,
+ *                                  guint n_steps)
+ *
+ * Like rasta_context_travel_scope(), but pushes the path node the
+ * saved state recorded instead of navigating to it.  Nothing is
+ * traversed, loaded or initialized; the screen of the new scope is
+ * left for rasta_context_restore_finish(), or for
+ * rasta_screen_previous() to load if we back up to it.  Returns
+ * -ESTALE if the steps don't lead to a path node called name, as
+ * when the description has changed since the state was saved.
+ */
+gint rasta_context_restore_scope(RastaContext *ctxt,
+                                 const gchar *name,
+                                 const guint *steps,
+                                 guint n_steps)
+{
+    const gchar *id;
+    xmlNodePtr node;
+    RastaScope *scope;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(name != NULL, -EINVAL);
+
+    scope = rasta_scope_get_current(ctxt);
+    node = rasta_scope_get_path_node(scope);
+    if (node == NULL)
+        return(-ESTALE);
+    node = rasta_traverse_follow(ctxt, node, steps, n_steps);
+    if (node == NULL)
+        return(-ESTALE);
+
+    rasta_scope_push(ctxt, node);
+    scope = rasta_scope_get_current(ctxt);
+    if (rasta_scope_get_path_node(scope) != node)
+        return(-ESTALE);  /* Bad NAME, not pushed */
+
+    id = rasta_scope_peek_id(scope);
+    if ((id == NULL) || (xmlStrcmp(name, id) != 0))
+        return(-ESTALE);
+
+    return(0);
+}  /* rasta_context_restore_scope() */
+
+
+/*
+ * void rasta_context_restore_finish(RastaContext *ctxt)
+ *
+ * Loads and initializes the current screen if its scope was
+ * restored directly.  As with travelling, no initcommand is run.
+ */
+void rasta_context_restore_finish(RastaContext *ctxt)
+{
+    RastaScope *scope;
+
+    g_return_if_fail(ctxt != NULL);
+
+    scope = rasta_scope_get_current(ctxt);
+    if (rasta_scope_get_screen(scope) != NULL)
+        return;
+
+    if (ctxt->state == RASTA_CONTEXT_INITCOMMAND)
+        ctxt->state = RASTA_CONTEXT_SCREEN;
+
+    rasta_screen_prepare(ctxt);
+
+    if (ctxt->state == RASTA_CONTEXT_INITCOMMAND)
+        ctxt->state = RASTA_CONTEXT_SCREEN;
+}  /* rasta_context_restore_finish() */
+
+
+/*
+ * static guint rasta_context_parse_steps(const gchar *path,
+ *                                        guint *steps)
+ *
+ * Parses the PATH attribute of a state SCOPE into steps, which
+ * must hold RASTA_TRAVERSE_STEPS_MAX entries.  Returns the number
+ * of steps, or 0 if there is no usable PATH.
+ */
+static guint rasta_context_parse_steps(const gchar *path,
+                                       guint *steps)
+{
+    guint n_steps;
+    gchar *end;
+
+    if (path == NULL)
+        return(0);
+
+    n_steps = 0;
+    while (*path != '\0')
+    {
+        if (n_steps == RASTA_TRAVERSE_STEPS_MAX)
+            return(0);
+        steps[n_steps++] = strtoul(path, &end, 10);
+        if (end == path)
+            return(0);
+        for (path = end; *path == ' '; path++)
+            ;
+    }
+
+    return(n_steps);
+}  /* rasta_context_parse_steps() */
+
+
 /*
  * static gint rasta_context_travel_state(RastaContext *ctxt,
  *                                        xmlDocPtr state_doc,
- *                                        xmlNodePtr cur)
+ *                                        xmlNodePtr cur,
+ *                                        gboolean direct)
  *
- * Walks a state document moving the context to the screens.
+ * Walks a state document moving the context to the screens.  If
+ * direct is TRUE, scopes with a PATH are restored directly.
  */
 static gint rasta_context_travel_state(RastaContext *ctxt,
                                        xmlDocPtr state_doc,
-                                       xmlNodePtr cur)
+                                       xmlNodePtr cur,
+                                       gboolean direct)
 {
+    gint rc;
+    guint steps[RASTA_TRAVERSE_STEPS_MAX];
+    guint n_steps;
     xmlNsPtr ns;
-    gchar *id, *name, *val;
-    RastaScreen *screen;
-    RastaScope *scope;
+    gchar *name, *val, *path;
 
     ns = cur->ns;
     cur = cur->children;
@@ -558,54 +999,23 @@ static gint rasta_context_travel_state(RastaContext *ctxt,
                     return(-EBADF);
                 }
 
-                screen = rasta_context_get_screen(ctxt);
-                switch (screen->type)
-                {
-                    case RASTA_SCREEN_MENU:
-                        rasta_menu_screen_next(ctxt, name);
-                        break;
-
-                    case RASTA_SCREEN_DIALOG:
-                        rasta_dialog_screen_next(ctxt);
-                        break;
-
-                    case RASTA_SCREEN_HIDDEN:
-                        rasta_hidden_screen_next(ctxt);
-                        break;
-
-                    case RASTA_SCREEN_ACTION:
-                    default:
-                        g_free(name);
-                        return(-EBADF);
-                        break;
-                }
-
-                /* We've jumped the state, no initcommand */
-                if (ctxt->state == RASTA_CONTEXT_INITCOMMAND)
-                    ctxt->state = RASTA_CONTEXT_SCREEN;
-
-                scope = rasta_scope_get_current(ctxt);
-                if (scope == NULL)
+                n_steps = 0;
+                if (direct != FALSE)
                 {
-                    g_free(name);
-                    return(-EBADF);
-                }
-                id = rasta_scope_get_id(scope);
-                if (id == NULL)
-                {
-                    g_free(name);
-                    return(-EBADF);
-                }
-                
-                if (xmlStrcmp(name, id) != 0)
-                {
-                    g_free(name);
-                    g_free(id);
-                    return(-EBADF);
+                    path = xmlGetProp(cur, "PATH");
+                    n_steps = rasta_context_parse_steps(path, steps);
+                    if (path != NULL)
+                        g_free(path);
                 }
 
+                if (n_steps > 0)
+                    rc = rasta_context_restore_scope(ctxt, name,
+                                                     steps, n_steps);
+                else
+                    rc = rasta_context_travel_scope(ctxt, name);
                 g_free(name);
-                g_free(id);
+                if (rc != 0)
+                    return(rc);
 
                 cur = cur->children;
                 continue;
@@ -613,6 +1023,9 @@ static gint rasta_context_travel_state(RastaContext *ctxt,
         }
         cur = cur->next;
     }
+
+    rasta_context_restore_finish(ctxt);
+
     return(0);
 }  /* rasta_context_travel_state() */
 
@@ -634,7 +1047,9 @@ static void rasta_context_revert_state(RastaContext *ctxt)
  *                                         xmlDocPtr state_doc)
  *
  * Given a state definition, attempts to move the ctxt to the new
- * state.
+ * state.  The path nodes the state recorded are tried first.  If
+ * they no longer match the description, the state is replayed by
+ * navigating from the initial screen instead.
  */
 static gint rasta_context_prepare_state(RastaContext *ctxt,
                                         xmlDocPtr state_doc)
@@ -649,7 +1064,12 @@ static gint rasta_context_prepare_state(RastaContext *ctxt,
     if (cur == NULL)
         return(-EBADF);
 
-    rc = rasta_context_travel_state(ctxt, state_doc, cur);
+    rc = rasta_context_travel_state(ctxt, state_doc, cur, TRUE);
+    if (rc == -ESTALE)
+    {
+        rasta_context_revert_state(ctxt);
+        rc = rasta_context_travel_state(ctxt, state_doc, cur, FALSE);
+    }
     if (rc != 0)
         rasta_context_revert_state(ctxt);
 
@@ -658,34 +1078,29 @@ static gint rasta_context_prepare_state(RastaContext *ctxt,
 
 
 /*
- * static gint rasta_context_build_state_xml(RastaContext *ctxt,
- *                                       xmlDocPtr *doc)
+ * static gint rasta_context_prepare_binary_state(RastaContext *ctxt,
+ *                                                const gchar *data,
+ *                                                gsize len)
  *
- * Builds state XML and returns the XML document in the doc pointer.
+ * Like rasta_context_prepare_state(), for a binary state.
  */
-static gint rasta_context_build_state_xml(RastaContext *ctxt,
-                                          xmlDocPtr *doc)
+static gint rasta_context_prepare_binary_state(RastaContext *ctxt,
+                                               const gchar *data,
+                                               gsize len)
 {
     gint rc;
-    xmlDocPtr new_doc;
-    xmlDtdPtr dtd;
-    xmlNsPtr ns;
-    xmlNodePtr cur;
-
-    new_doc = xmlNewDoc("1.0");
-    dtd = xmlCreateIntSubset(new_doc, "RASTASTATE", NULL,
-                             "file://" _RASTA_DATA_DIR
-                             G_DIR_SEPARATOR_S RASTASTATE_DTD);
-    cur = xmlNewNode(NULL, "RASTASTATE");
-    ns = xmlNewNs(cur, RASTA_NAMESPACE, NULL);
-    xmlDocSetRootElement(new_doc, cur);
 
-    rc = rasta_scope_add_state_xml(ctxt, new_doc);
-
-    *doc = new_doc;
+    rc = rasta_state_load_binary(ctxt, data, len, TRUE);
+    if (rc == -ESTALE)
+    {
+        rasta_context_revert_state(ctxt);
+        rc = rasta_state_load_binary(ctxt, data, len, FALSE);
+    }
+    if (rc != 0)
+        rasta_context_revert_state(ctxt);
 
     return(rc);
-}  /* rasta_context_build_state_xml() */
+}  /* rasta_context_prepare_binary_state() */
 
 
 /*
@@ -697,23 +1112,64 @@ static gint rasta_context_build_state_xml(RastaContext *ctxt,
 gint rasta_context_save_state(RastaContext *ctxt,
                               const gchar *filename)
 {
-    gint rc;
-    xmlDocPtr doc;
-    FILE *f;
+    return(rasta_context_save_state_full(ctxt, filename,
+                                         RASTA_STATE_XML));
+}  /* rasta_context_save_state() */
 
-    rc = rasta_context_build_state_xml(ctxt, &doc);
-    if (rc != 0)
-        return(rc);
 
-    f = fopen(filename, "w");
-    if (f == NULL)
+/*
+ * gint rasta_context_save_state_full(RastaContext *ctxt,
+ *                                    const gchar *filename,
+ *                                    RastaStateFlags flags)
+ *
+ * Writes the state to the given filename in the format flags asks
+ * for.  RASTA_STATE_LIVE_ONLY leaves out symbols that no screen the
+ * user can still reach from a scope refers to; loading such a state
+ * gives the same results from there on.
+ */
+gint rasta_context_save_state_full(RastaContext *ctxt,
+                                   const gchar *filename,
+                                   RastaStateFlags flags)
+{
+    gint rc, fd;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(filename != NULL, -EINVAL);
+
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
         return(-errno);
 
-    rc = xmlDocDump(f, doc);
-    fclose(f);
+    rc = rasta_context_save_state_fd(ctxt, fd, flags);
+    if ((close(fd) != 0) && (rc == 0))
+        rc = -errno;
 
     return(rc);
-}  /* rasta_context_save_state() */
+}  /* rasta_context_save_state_full() */
+
+
+/*
+ * gint rasta_context_save_state_fd(RastaContext *ctxt,
+ *                                  gint fd,
+ *                                  RastaStateFlags flags)
+ *
+ * Writes the state to fd as it walks the scopes, without building
+ * a document first.  fd is left open.
+ */
+gint rasta_context_save_state_fd(RastaContext *ctxt,
+                                 gint fd,
+                                 RastaStateFlags flags)
+{
+    RastaStateWriter writer;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(fd > -1, -EINVAL);
+
+    rasta_state_writer_init(&writer, fd, flags);
+    rasta_state_write_context(&writer, ctxt);
+
+    return(rasta_state_writer_finish(&writer));
+}  /* rasta_context_save_state_fd() */
 
 
 /*
@@ -728,17 +1184,55 @@ gint rasta_context_save_state(RastaContext *ctxt,
 gint rasta_context_save_state_memory(RastaContext *ctxt,
                                      gchar **state_text,
                                      gint *state_size)
+{
+    return(rasta_context_save_state_memory_full(ctxt, state_text,
+                                                state_size,
+                                                RASTA_STATE_XML));
+}  /* rasta_context_save_state_memory() */
+
+
+/*
+ * gint rasta_context_save_state_memory_full(RastaContext *ctxt,
+ *                                           gchar **state_text,
+ *                                           gint *state_size,
+ *                                           RastaStateFlags flags)
+ *
+ * As rasta_context_save_state_memory(), in the format flags asks
+ * for.  A binary state may contain NULs, so use state_size.  Free
+ * state_text with xmlFree().
+ */
+gint rasta_context_save_state_memory_full(RastaContext *ctxt,
+                                          gchar **state_text,
+                                          gint *state_size,
+                                          RastaStateFlags flags)
 {
     gint rc;
-    xmlDocPtr doc;
+    RastaStateWriter writer;
 
-    rc = rasta_context_build_state_xml(ctxt, &doc);
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(state_text != NULL, -EINVAL);
+    g_return_val_if_fail(state_size != NULL, -EINVAL);
+
+    rasta_state_writer_init(&writer, -1, flags);
+    rasta_state_write_context(&writer, ctxt);
+    rc = rasta_state_writer_finish(&writer);
 
     if (rc == 0)
-        xmlDocDumpMemory(doc, (xmlChar **)state_text, state_size);
+    {
+        /* Callers free it with xmlFree(), as they always have */
+        *state_text = xmlMalloc(writer.buf->len + 1);
+        if (*state_text == NULL)
+            rc = -ENOMEM;
+        else
+        {
+            memcpy(*state_text, writer.buf->str, writer.buf->len + 1);
+            *state_size = writer.buf->len;
+        }
+    }
+    g_string_free(writer.buf, TRUE);
 
     return(rc);
-}  /* rasta_context_save_state_memory() */
+}  /* rasta_context_save_state_memory_full() */
 
 
 /*
@@ -27,6 +27,8 @@
 #ifndef _RASTA_CONTEXT_H
 #define _RASTA_CONTEXT_H
 
+#include "rastareload.h"
+
 
 /*
  * Typedefs
@@ -54,10 +56,12 @@ enum _RastaContextState
 struct _RastaContext
 {
     xmlDocPtr doc;                 /* Document structure */
+    RastaSnapshot *snapshot;       /* Owner of doc once parsed */
     xmlNsPtr ns;                   /* Document namespace */
     xmlNodePtr screens;            /* Parent of screens */
     xmlNodePtr path_root;          /* Parent of the path */
     xmlParserCtxtPtr parser;       /* Parser structure */
+    GString *state_buffer;         /* Pushed state not yet parsed */
     GList *scopes;                 /* Scope stack */
     GHashTable *screen_cache;      /* Cache of loaded screens */
     gchar *filename;               /* Name of the XML data file */
@@ -65,5 +69,21 @@ struct _RastaContext
     RastaContextState state;       /* State flags */
 };
 
+
+
+/*
+ * Prototypes
+ */
+xmlDocPtr rasta_context_load_doc(const gchar *filename);
+xmlDocPtr rasta_context_check_doc(xmlDocPtr doc);
+gboolean rasta_context_reload(RastaContext *ctxt);
+gint rasta_context_travel_scope(RastaContext *ctxt,
+                                const gchar *name);
+gint rasta_context_restore_scope(RastaContext *ctxt,
+                                 const gchar *name,
+                                 const guint *steps,
+                                 guint n_steps);
+void rasta_context_restore_finish(RastaContext *ctxt);
+
 #endif /* _RASTA_CONTEXT_H */
 
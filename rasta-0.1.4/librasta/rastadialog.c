@@ -43,7 +43,9 @@
 #include "rastadialog.h"
 #include "rastatraverse.h"
 #include "rastascope.h"
+#include "rastaprofile.h"
 #include "rastaexec.h"
+#include "rastatrace.h"
 
 
 
@@ -78,6 +80,8 @@ typedef struct _RastaEntryListDialogField   RastaEntryDialogField;
 typedef struct _RastaEntryListDialogField   RastaListDialogField;
 typedef struct _RastaFileDialogField        RastaFileDialogField;
 typedef struct _RastaRingDialogField        RastaRingDialogField;
+typedef struct _RastaNumberFormat           RastaNumberFormat;
+typedef struct _RastaNumberLocale           RastaNumberLocale;
 
 #ifdef ENABLE_DEPRECATED
 typedef struct _RastaInetAddrDialogField    RastaInetAddrDialogField;
@@ -89,6 +93,31 @@ typedef struct _RastaVolumeDialogField      RastaVolumeDialogField;
 /*
  * Structures
  */
+
+/*
+ * A FORMAT attribute, parsed.  Limits of -1 are unbounded.
+ */
+struct _RastaNumberFormat
+{
+    gint rc;                    /* -EINVAL if FORMAT didn't parse */
+    gboolean any;               /* Empty FORMAT, any number will do */
+    gint width[2];              /* Min,max digits before the point */
+    gint precision[2];          /* Min,max digits after it */
+};
+
+/*
+ * The locale's number characters, converted to UTF-8.  They are
+ * read again whenever LC_NUMERIC or LC_CTYPE changes.
+ */
+struct _RastaNumberLocale
+{
+    gchar *numeric;             /* LC_NUMERIC they were read in */
+    gchar *ctype;               /* LC_CTYPE they were converted in */
+    gunichar dp;                /* Decimal point */
+    gunichar ns;                /* Negative sign */
+    gunichar ps;                /* Positive sign */
+};
+
 struct _RastaAnyDialogField
 {
     RastaDialogFieldType type;
@@ -96,6 +125,7 @@ struct _RastaAnyDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 struct _RastaReadonlyDialogField
@@ -105,6 +135,7 @@ struct _RastaReadonlyDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 struct _RastaDescriptionDialogField
@@ -114,6 +145,7 @@ struct _RastaDescriptionDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 struct _RastaFileDialogField
@@ -123,6 +155,7 @@ struct _RastaFileDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 struct _RastaRingDialogField
@@ -132,7 +165,8 @@ struct _RastaRingDialogField
     gchar *name;
     gchar *text;
     gchar *help;
-    GList *ring_values;
+    xmlNodePtr help_node;       /* Set until help is loaded */
+    GPtrArray *ring_values;
 };
 
 struct _RastaEntryListDialogField
@@ -142,10 +176,12 @@ struct _RastaEntryListDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
     guint max_length;
     gboolean numeric;
     gboolean hidden;
     gchar *format;
+    RastaNumberFormat number;   /* format, parsed */
     gboolean multiple;
     gboolean single_column;
     RastaEscapeStyleType escape_style;
@@ -160,6 +196,7 @@ struct _RastaInetAddrDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
     guint max_length;
 };
 
@@ -170,6 +207,7 @@ struct _RastaVolumeDialogField
     gchar *name;
     gchar *text;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 struct _RastaRingValue
@@ -207,6 +245,7 @@ union _RastaDialogField
  */
 static RastaDialogField *rasta_dialog_field_new(RastaContext *ctxt,
                                                 xmlNodePtr node);
+static void rasta_dialog_field_free(RastaDialogField *field);
 static gboolean
 rasta_readonly_dialog_field_new(RastaContext *ctxt,
                                 RastaDialogField *field,
@@ -249,8 +288,23 @@ rasta_volume_dialog_field_new(RastaContext *ctxt,
 
 static RastaRingValue *rasta_ring_value_new(RastaContext *ctxt,
                                           xmlNodePtr node);
-static gint rasta_split_format_limit(const gchar *limit,
-                                     gint format_vals[2]);
+static gint rasta_number_limit_parse(const gchar *limit,
+                                     const gchar *end,
+                                     gint limit_vals[2]);
+static void rasta_number_format_parse(RastaNumberFormat *number,
+                                      const gchar *format);
+static const RastaNumberLocale *rasta_number_locale_get(void);
+static gunichar rasta_number_locale_char(const gchar *str,
+                                         const gchar *def);
+static gint rasta_number_format_check(const RastaNumberFormat *number,
+                                      const gchar *test_val);
+
+
+
+/*
+ * Globals
+ */
+static RastaNumberLocale number_locale = {NULL, NULL, 0, 0, 0};
 
 
 
@@ -392,7 +446,10 @@ rasta_entry_dialog_field_new(RastaContext *ctxt,
         e_field->numeric = FALSE;
 
     if (e_field->numeric == TRUE)
+    {
         e_field->format = xmlGetProp(node, "FORMAT");
+        rasta_number_format_parse(&e_field->number, e_field->format);
+    }
     else
     {
         max_length = xmlGetProp(node, "LENGTH");
@@ -453,7 +510,7 @@ rasta_ring_dialog_field_new(RastaContext *ctxt,
 
     r_field = RASTA_RING_DIALOG_FIELD(field);
 
-    r_field->ring_values = NULL;
+    r_field->ring_values = g_ptr_array_new();
     cur = node->children;
     while (cur != NULL)
     {
@@ -463,8 +520,7 @@ rasta_ring_dialog_field_new(RastaContext *ctxt,
             {
                 item = rasta_ring_value_new(ctxt, cur);
                 if (item != NULL)
-                    r_field->ring_values =
-                        g_list_append(r_field->ring_values, item);
+                    g_ptr_array_add(r_field->ring_values, item);
             }
         }
         
@@ -674,7 +730,8 @@ static RastaDialogField *rasta_dialog_field_new(RastaContext *ctxt,
     else
         any->required = FALSE;
 
-    any->help = rasta_query_help(ctxt, node);
+    any->help = NULL;
+    any->help_node = node;
 
     ptr = xmlGetProp(node, "TYPE");
     if (ptr == NULL)
@@ -742,7 +799,7 @@ void rasta_dialog_screen_load(RastaContext *ctxt,
     
     d_screen = RASTA_DIALOG_SCREEN(screen);
     d_screen->title = xmlGetProp(screen_node, "TEXT");
-    d_screen->fields = NULL;
+    d_screen->fields = g_ptr_array_new();
     d_screen->init_command = NULL;
     d_screen->help = rasta_query_help(ctxt, screen_node);
 
@@ -755,8 +812,7 @@ void rasta_dialog_screen_load(RastaContext *ctxt,
             {
                 field = rasta_dialog_field_new(ctxt, cur);
                 if (field != NULL)
-                    d_screen->fields =
-                        g_list_append(d_screen->fields, field);
+                    g_ptr_array_add(d_screen->fields, field);
             }
             else if (xmlStrcmp(cur->name, "INITCOMMAND") == 0)
             {
@@ -788,6 +844,74 @@ void rasta_dialog_screen_load(RastaContext *ctxt,
 }  /* rasta_dialog_screen_load() */
 
 
+/*
+ * static void rasta_dialog_field_free(RastaDialogField *field)
+ *
+ * Frees a field loaded by rasta_dialog_field_new()
+ */
+static void rasta_dialog_field_free(RastaDialogField *field)
+{
+    RastaAnyDialogField *any;
+    RastaEntryListDialogField *el_field;
+    RastaRingDialogField *r_field;
+    RastaRingValue *item;
+    guint i;
+
+    g_return_if_fail(field != NULL);
+
+    if ((field->type == RASTA_FIELD_ENTRY) ||
+        (field->type == RASTA_FIELD_LIST) ||
+        (field->type == RASTA_FIELD_ENTRYLIST))
+    {
+        el_field = RASTA_ENTRY_LIST_DIALOG_FIELD(field);
+        g_free(el_field->format);
+        g_free(el_field->list_command);
+        g_free(el_field->encoding);
+    }
+    else if (field->type == RASTA_FIELD_RING)
+    {
+        r_field = RASTA_RING_DIALOG_FIELD(field);
+        for (i = 0; i < r_field->ring_values->len; i++)
+        {
+            item = (RastaRingValue *)g_ptr_array_index(r_field->ring_values,
+                                                       i);
+            g_free(item->text);
+            g_free(item->value);
+            g_free(item);
+        }
+        g_ptr_array_free(r_field->ring_values, TRUE);
+    }
+
+    any = RASTA_ANY_DIALOG_FIELD(field);
+    g_free(any->name);
+    g_free(any->text);
+    g_free(any->help);
+    g_free(field);
+}  /* rasta_dialog_field_free() */
+
+
+/*
+ * void rasta_dialog_screen_free(RastaScreen *screen)
+ *
+ * Frees what rasta_dialog_screen_load() put in the screen.  The
+ * screen itself belongs to the caller.
+ */
+void rasta_dialog_screen_free(RastaScreen *screen)
+{
+    RastaDialogScreen *d_screen;
+    guint i;
+
+    g_return_if_fail(screen != NULL);
+
+    d_screen = RASTA_DIALOG_SCREEN(screen);
+    for (i = 0; i < d_screen->fields->len; i++)
+        rasta_dialog_field_free(g_ptr_array_index(d_screen->fields, i));
+    g_ptr_array_free(d_screen->fields, TRUE);
+    g_free(d_screen->init_command);
+    g_free(d_screen->encoding);
+}  /* rasta_dialog_screen_free() */
+
+
 /*
  * void rasta_dialog_screen_init(RastaContext *ctxt,
  *                               RastaScreen *screen)
@@ -845,23 +969,65 @@ REnumeration *rasta_dialog_screen_enumerate_fields(RastaContext *ctxt,
 
     d_screen = RASTA_DIALOG_SCREEN(screen);
 
-    enumer = r_enumeration_new_from_list(d_screen->fields);
+    enumer = r_enumeration_new_from_array(d_screen->fields->pdata,
+                                          d_screen->fields->len);
 
     return(enumer);
 }  /* rasta_dialog_screen_enumerate_fields() */
 
 
+/*
+ * void rasta_dialog_screen_init_cursor(RastaContext *ctxt,
+ *                                      RastaScreen *screen,
+ *                                      REnumeration *cursor)
+ *
+ * Initializes a caller-owned cursor over the dialog fields.  The
+ * cursor needs no freeing.
+ */
+void rasta_dialog_screen_init_cursor(RastaContext *ctxt,
+                                     RastaScreen *screen,
+                                     REnumeration *cursor)
+{
+    RastaDialogScreen *d_screen;
+
+    g_return_if_fail(cursor != NULL);
+    r_enumeration_init_array(cursor, NULL, 0);
+
+    g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(screen != NULL);
+    g_return_if_fail(screen->type == RASTA_SCREEN_DIALOG);
+    g_return_if_fail(ctxt->state == RASTA_CONTEXT_SCREEN);
+
+    d_screen = RASTA_DIALOG_SCREEN(screen);
+
+    r_enumeration_init_array(cursor, d_screen->fields->pdata,
+                             d_screen->fields->len);
+}  /* rasta_dialog_screen_init_cursor() */
+
+
 /*
  * gchar *rasta_dialog_field_get_text(RastaDialogField *field)
  *
  * Returns the text of the dialog field
  */
 gchar *rasta_dialog_field_get_text(RastaDialogField *field)
+{
+    return(g_strdup(rasta_dialog_field_peek_text(field)));
+}  /* rasta_dialog_field_get_text() */
+
+
+/*
+ * const gchar *rasta_dialog_field_peek_text(RastaDialogField *field)
+ *
+ * Returns the text of the dialog field without copying it.  The
+ * string belongs to the screen and must not be freed.
+ */
+const gchar *rasta_dialog_field_peek_text(RastaDialogField *field)
 {
     g_return_val_if_fail(field != NULL, NULL);
 
-    return(g_strdup(RASTA_ANY_DIALOG_FIELD(field)->text));
-}  /* rasta_dialog_field_get_text() */
+    return(RASTA_ANY_DIALOG_FIELD(field)->text);
+}  /* rasta_dialog_field_peek_text() */
 
 
 /*
@@ -870,11 +1036,24 @@ gchar *rasta_dialog_field_get_text(RastaDialogField *field)
  * Returns the name of the dialog field's associated symbol
  */
 gchar *rasta_dialog_field_get_symbol_name(RastaDialogField *field)
+{
+    return(g_strdup(rasta_dialog_field_peek_symbol_name(field)));
+}  /* rasta_dialog_field_get_symbol_name() */
+
+
+/*
+ * const gchar *
+ * rasta_dialog_field_peek_symbol_name(RastaDialogField *field)
+ *
+ * Returns the name of the dialog field's associated symbol without
+ * copying it.
+ */
+const gchar *rasta_dialog_field_peek_symbol_name(RastaDialogField *field)
 {
     g_return_val_if_fail(field != NULL, NULL);
 
-    return(g_strdup(RASTA_ANY_DIALOG_FIELD(field)->name));
-}  /* rasta_dialog_field_get_symbol_name() */
+    return(RASTA_ANY_DIALOG_FIELD(field)->name);
+}  /* rasta_dialog_field_peek_symbol_name() */
 
 
 /*
@@ -940,10 +1119,32 @@ gboolean rasta_entry_dialog_field_is_numeric(RastaDialogField *field)
  */
 gchar *rasta_dialog_field_get_help(RastaDialogField *field)
 {
+    return(g_strdup(rasta_dialog_field_peek_help(field)));
+}  /* rasta_dialog_field_get_help() */
+
+
+/*
+ * const gchar *rasta_dialog_field_peek_help(RastaDialogField *field)
+ *
+ * Returns the help text associated with the field without copying
+ * it.  Help is rarely asked for, so it is only read from the
+ * document the first time.
+ */
+const gchar *rasta_dialog_field_peek_help(RastaDialogField *field)
+{
+    RastaAnyDialogField *any;
+
     g_return_val_if_fail(field != NULL, NULL);
 
-    return(g_strdup(RASTA_ANY_DIALOG_FIELD(field)->help));
-}  /* rasta_dialog_field_get_help() */
+    any = RASTA_ANY_DIALOG_FIELD(field);
+    if (any->help_node != NULL)
+    {
+        any->help = rasta_query_help(NULL, any->help_node);
+        any->help_node = NULL;
+    }
+
+    return(any->help);
+}  /* rasta_dialog_field_peek_help() */
 
 
 /*
@@ -960,66 +1161,277 @@ gchar *rasta_entry_dialog_field_get_format(RastaDialogField *field)
 
 
 /*
- * static gint rasta_split_format_limit(const gchar *limits,
- *                                      gint format_vals[2])
+ * static gint rasta_number_limit_parse(const gchar *limit,
+ *                                      const gchar *end,
+ *                                      gint limit_vals[2])
  *
  * A format limit is of the form 'min,max'.  Valid forms are
- * 'min' ',max' 'min,max'.  Eg, '3' ',8' '3,8'.
+ * 'min' ',max' 'min,max'.  Eg, '3' ',8' '3,8'.  The limit runs from
+ * limit up to end.  An empty limit leaves limit_vals alone.
  */
-static gint rasta_split_format_limit(const gchar *limit,
-                                     gint format_vals[2])
+static gint rasta_number_limit_parse(const gchar *limit,
+                                     const gchar *end,
+                                     gint limit_vals[2])
 {
-    gint rc = 0, test_res[2] = {-1, -1};
+    const gchar *comma;
     gchar *ptr;
-    gchar **test;
+    gint min, max;
+
+    if (limit == end)
+        return(0);
+
+    comma = memchr(limit, ',', end - limit);
+    if (comma == NULL)
+        comma = end;
+
+    min = (gint)strtol(limit, &ptr, 10);
+    if (ptr != comma)
+        return(-EINVAL);
+
+    max = -1;
+    if ((comma != end) && ((comma + 1) != end))
+    {
+        max = (gint)strtol(comma + 1, &ptr, 10);
+        if (ptr != end)
+            return(-EINVAL);
+    }
+
+    limit_vals[0] = min;
+    limit_vals[1] = max;
+
+    return(0);
+}  /* rasta_number_limit_parse() */
+
+
+/*
+ * static void rasta_number_format_parse(RastaNumberFormat *number,
+ *                                       const gchar *format)
+ *
+ * Parses a FORMAT attribute into number.  See
+ * rasta_verify_number_format() for the syntax.  A NULL or empty
+ * format allows any number.
+ */
+static void rasta_number_format_parse(RastaNumberFormat *number,
+                                      const gchar *format)
+{
+    const gchar *point, *end;
+
+    number->rc = 0;
+    number->any = FALSE;
+    number->width[0] = 0;
+    number->width[1] = -1;
+    number->precision[0] = 0;
+    number->precision[1] = 0;
+
+    if ((format == NULL) || (format[0] == '\0'))
+    {
+        number->any = TRUE;
+        return;
+    }
+
+    end = format + strlen(format);
+    point = strchr(format, '.');
+    if (point == NULL)
+        point = end;
+
+    number->rc = rasta_number_limit_parse(format, point, number->width);
+    if ((number->rc == 0) && (point != end))
+        number->rc = rasta_number_limit_parse(point + 1, end,
+                                              number->precision);
+}  /* rasta_number_format_parse() */
+
+
+/*
+ * static gunichar rasta_number_locale_char(const gchar *str,
+ *                                          const gchar *def)
+ *
+ * Returns the first character of the locale string str, or of def
+ * if str is empty or can't be converted.
+ */
+static gunichar rasta_number_locale_char(const gchar *str,
+                                         const gchar *def)
+{
+    gchar *tmp;
+    gunichar c;
+
+    if ((str == NULL) || (str[0] == '\0'))
+        return(g_utf8_get_char(def));
+
+    tmp = g_locale_to_utf8(str, -1, NULL, NULL, NULL);
+    if (tmp == NULL)
+        return(g_utf8_get_char(def));
+
+    c = g_utf8_get_char(tmp);
+    g_free(tmp);
+
+    return(c);
+}  /* rasta_number_locale_char() */
+
+
+/*
+ * static const RastaNumberLocale *rasta_number_locale_get(void)
+ *
+ * Returns the locale's number characters, reading them again only
+ * if the locale has changed since last time.
+ */
+static const RastaNumberLocale *rasta_number_locale_get(void)
+{
+    const gchar *name;
+    struct lconv *lc;
+
+    /* setlocale() may reuse its buffer, so check one at a time */
+    if ((number_locale.numeric != NULL) && (number_locale.ctype != NULL))
+    {
+        name = setlocale(LC_NUMERIC, NULL);
+        if ((name != NULL) && (strcmp(name, number_locale.numeric) == 0))
+        {
+            name = setlocale(LC_CTYPE, NULL);
+            if ((name != NULL) &&
+                (strcmp(name, number_locale.ctype) == 0))
+                return(&number_locale);
+        }
+    }
+
+    g_free(number_locale.numeric);
+    number_locale.numeric = g_strdup(setlocale(LC_NUMERIC, NULL));
+    g_free(number_locale.ctype);
+    number_locale.ctype = g_strdup(setlocale(LC_CTYPE, NULL));
+
+    lc = localeconv();
+    number_locale.dp = rasta_number_locale_char(lc->decimal_point, ".");
+    number_locale.ns = rasta_number_locale_char(lc->negative_sign, "-");
+    number_locale.ps = rasta_number_locale_char(lc->positive_sign, "+");
+
+    return(&number_locale);
+}  /* rasta_number_locale_get() */
 
-    g_return_val_if_fail(limit != NULL, FALSE);
 
-    if (g_utf8_strlen(limit, -1) == 0)
+/*
+ * void rasta_get_number_locale(gunichar *decimal_point,
+ *                              gunichar *negative_sign,
+ *                              gunichar *positive_sign)
+ *
+ * Returns the characters the current locale uses in numbers, as
+ * rasta_verify_number_format() sees them.  They are cached until
+ * the locale changes, so front-ends checking keystrokes in numeric
+ * fields can ask each time.  Any argument may be NULL.
+ */
+void rasta_get_number_locale(gunichar *decimal_point,
+                             gunichar *negative_sign,
+                             gunichar *positive_sign)
+{
+    const RastaNumberLocale *loc;
+
+    loc = rasta_number_locale_get();
+
+    if (decimal_point != NULL)
+        *decimal_point = loc->dp;
+    if (negative_sign != NULL)
+        *negative_sign = loc->ns;
+    if (positive_sign != NULL)
+        *positive_sign = loc->ps;
+}  /* rasta_get_number_locale() */
+
+
+/*
+ * static gint rasta_number_format_check(const RastaNumberFormat *number,
+ *                                       const gchar *test_val)
+ *
+ * Checks test_val against a parsed format.  Returns as
+ * rasta_verify_number_format().
+ */
+static gint rasta_number_format_check(const RastaNumberFormat *number,
+                                      const gchar *test_val)
+{
+    const RastaNumberLocale *loc;
+    const gchar *ptr;
+    gchar *end;
+    gunichar c;
+    gint llen, rlen;
+    gboolean have_dp;
+
+    if (number->rc != 0)
+        return(number->rc);
+    if (number->any != FALSE)
         return(0);
 
-    test = g_strsplit(limit, ",", 2);
-    if (test == NULL)
-        return(-ENOMEM);
+    loc = rasta_number_locale_get();
 
-    if (test[0] != NULL)
+    /* [sign]digits[point digits] is all anyone types */
+    llen = rlen = 0;
+    have_dp = FALSE;
+    ptr = test_val;
+    if (*ptr != '\0')
     {
-        if (g_utf8_strlen(test[0], -1) >= 0)
+        c = g_utf8_get_char(ptr);
+        if ((c == loc->ns) || (c == loc->ps))
+            ptr = g_utf8_next_char(ptr);
+    }
+    while (*ptr != '\0')
+    {
+        if (g_ascii_isdigit(*ptr))
         {
-            test_res[0] = (gint)strtol(test[0], &ptr, 10);
-            if (*ptr != '\0')
-            {
-                g_strfreev(test);
-                rc = -EINVAL;
-            }
+            if (have_dp == FALSE)
+                llen++;
             else
-                rc = 0;
+                rlen++;
+            ptr++;
+            continue;
         }
+
+        c = g_utf8_get_char(ptr);
+        if ((c != loc->dp) || (have_dp != FALSE))
+            break;
+        have_dp = TRUE;
+        ptr = g_utf8_next_char(ptr);
     }
-    else
-        rc = -ENOMEM;
 
-    if ((rc == 0) && 
-        (test[1] != NULL) &&
-        (g_utf8_strlen(test[1], -1) > 0))
+    if (*ptr != '\0')
     {
-        test_res[1] = (gint)strtol(test[1], &ptr, 10);
-        if (*ptr != '\0')
+        /* Anything else g_strtod() takes is counted the long way */
+        g_strtod(test_val, &end);
+        if ((end == NULL) || (*end != '\0'))
+            return(-ERANGE);
+
+        llen = rlen = 0;
+        have_dp = FALSE;
+        for (ptr = test_val; *ptr != '\0'; ptr = g_utf8_next_char(ptr))
         {
-            g_strfreev(test);
-            rc = -EINVAL;
+            c = g_utf8_get_char(ptr);
+            if ((c == loc->ns) || (c == loc->ps))
+            {
+                if (ptr != test_val)
+                    return(-ERANGE);
+            }
+            else if (c == loc->dp)
+            {
+                if (have_dp != FALSE)
+                    return(-ERANGE);
+                have_dp = TRUE;
+            }
+            else if (have_dp == FALSE)
+                llen++;
+            else
+                rlen++;
         }
     }
+    else if ((llen == 0) && (rlen == 0) && (test_val[0] != '\0'))
+        return(-ERANGE);  /* A lone sign or point */
 
-    g_strfreev(test);
-
-    if (rc == 0)
-    { 
-        format_vals[0] = test_res[0];
-        format_vals[1] = test_res[1];
+    if ((llen < number->width[0]) ||
+        ((number->width[1] > -1) && (llen > number->width[1])))
+        return(-ERANGE);
+    if (have_dp == TRUE)
+    {
+        if ((rlen < number->precision[0]) ||
+            ((number->precision[1] > -1) && (rlen > number->precision[1])))
+            return(-ERANGE);
     }
-    return(rc);
-}  /* rasta_split_format_limit() */
+    else if (number->precision[0] > 0)
+        return(-ERANGE);
+
+    return(0);
+}  /* rasta_number_format_check() */
 
 
 /*
@@ -1034,143 +1446,86 @@ static gint rasta_split_format_limit(const gchar *limit,
  * 'limit' 'limit.' '.limit' 'limit.limit'.  For example:
  * '9'     '9.2'    '.3,9'   '3,9.0,2'
  * The valid syntax for limits is described in the function
- * documentation for rasta_split_format_limit()
+ * documentation for rasta_number_limit_parse()
  *
  * NOTE that formats are specified in the C locale, with "." as the
  * decimal point and "," as the thousands separator.  The actual
  * data entered, however, is in the local locale.
  *
- * The return values are 0 for a valid number, -ERANGE for an invalid
- * number, -EINVAL for an invalid format string, and -ENOMEM if there
- * was an allocation error in the internal processing
+ * The return values are 0 for a valid number (or an empty format),
+ * -ERANGE for an invalid number, and -EINVAL for an invalid format
+ * string.  Callers checking many values against one field should
+ * use rasta_dialog_field_validate_many(), which doesn't parse the
+ * format each time.
  */
 gint rasta_verify_number_format(const gchar *format,
                                 const gchar *test_val)
 {
-    gint rc = 0, format_w[2] = {0, -1}, format_p[2] = {0, 0};
-    gint rlen, llen;
-    gdouble test_d;
-    gchar **split;
-    gchar *tmp;
-    const gchar *ptr;
-    struct lconv *lc;
-    gunichar dp, ts, ns, ps, c;
-    gboolean done, have_dp;
+    RastaNumberFormat number;
 
     g_return_val_if_fail(format != NULL, -EINVAL);
     g_return_val_if_fail(test_val != NULL, -EINVAL);
     g_return_val_if_fail(g_utf8_validate(test_val, -1, NULL) != FALSE,
                          -EINVAL);
-    
-    /* empty == always valid */
-    if (g_utf8_strlen(format, -1) == 0)
-        return(TRUE);
 
-    lc = localeconv();
+    rasta_number_format_parse(&number, format);
 
-    if (lc->decimal_point)
-    {
-        tmp = g_locale_to_utf8(lc->decimal_point, -1, NULL, NULL, NULL);
-        dp = g_utf8_get_char(tmp);
-        g_free(tmp);
-    }
-    else
-        dp = g_utf8_get_char(".");
-
-    if (lc->thousands_sep)
-    {
-        tmp = g_locale_to_utf8(lc->thousands_sep, -1, NULL, NULL, NULL);
-        ts = g_utf8_get_char(tmp);
-        g_free(tmp);
-    }
-    else
-        ts = g_utf8_get_char(",");
-
-    if (lc->positive_sign)
-    {
-        tmp = g_locale_to_utf8(lc->positive_sign, -1, NULL, NULL, NULL);
-        ps = g_utf8_get_char(tmp);
-        g_free(tmp);
-    }
-    else
-        ps = g_utf8_get_char("+");
+    return(rasta_number_format_check(&number, test_val));
+}  /* rasta_verify_number_format() */
 
-    if (lc->negative_sign)
-    {
-        tmp = g_locale_to_utf8(lc->negative_sign, -1, NULL, NULL, NULL);
-        ns = g_utf8_get_char(tmp);
-        g_free(tmp);
-    }
-    else
-        ns = g_utf8_get_char("-");
 
-    split = g_strsplit(format, ".", 2);
-    if (split == NULL)
-        return(-ENOMEM);
-    if (split[0] != NULL)
-    {
-        rc = rasta_split_format_limit(split[0], format_w);
-        if ((rc == 0) && split[1] != NULL)
-            rc = rasta_split_format_limit(split[1], format_p);
-    }
-    else
-        rc = -ENOMEM;
+/*
+ * gint rasta_dialog_field_validate_many(RastaDialogField *field,
+ *                                       const gchar * const *values,
+ *                                       guint n_values,
+ *                                       gint *results)
+ *
+ * Checks n_values candidate values for field in one go.  Numeric
+ * entry fields check each value against their FORMAT, parsed once
+ * when the field was loaded; any value suits other fields.  If
+ * results isn't NULL, results[i] is set to the outcome for
+ * values[i], as rasta_verify_number_format() returns it.  Returns
+ * 0 if every value is valid, or else the first failure.  A value
+ * that isn't UTF-8 fails with -EINVAL.
+ */
+gint rasta_dialog_field_validate_many(RastaDialogField *field,
+                                      const gchar * const *values,
+                                      guint n_values,
+                                      gint *results)
+{
+    RastaEntryDialogField *e_field;
+    gint rc, first;
+    guint i;
+    gboolean numeric;
 
-    g_strfreev(split);
-    
-    if (rc != 0)
-        return(rc);
+    g_return_val_if_fail(field != NULL, -EINVAL);
+    g_return_val_if_fail((values != NULL) || (n_values == 0), -EINVAL);
 
-    test_d = g_strtod(test_val, &tmp);
-    if ((tmp == NULL) || (*tmp != '\0'))
-        return(-ERANGE);
+    e_field = RASTA_ENTRY_DIALOG_FIELD(field);
+    numeric = (((field->type == RASTA_FIELD_ENTRY) ||
+                (field->type == RASTA_FIELD_ENTRYLIST)) &&
+               (e_field->numeric != FALSE));
 
-    done = FALSE;
-    rlen = llen = 0;
-    have_dp = FALSE;
-    ptr = test_val;
-    while (done == FALSE)
+    first = 0;
+    for (i = 0; i < n_values; i++)
     {
-        if (*ptr != '\0')
-        {
-            c = g_utf8_get_char(ptr);
-            if ((c == ns) || (c == ps))
-            {
-                if (ptr != test_val)
-                    g_assert_not_reached();
-                /* Skip sign */
-            }
-            else if (c == dp)
-            {
-                if (have_dp == TRUE)
-                    g_assert_not_reached();
-                have_dp = TRUE;
-            }
-            else if (have_dp == FALSE)
-                llen++;
-            else
-                rlen++;
-            ptr = g_utf8_next_char(ptr);
-        }
+        if (values[i] == NULL)
+            rc = -EINVAL;
+        else if (numeric == FALSE)
+            rc = 0;
+        else if (g_utf8_validate(values[i], -1, NULL) == FALSE)
+            rc = -EINVAL;
         else
-            done = TRUE;
-    }
+            rc = rasta_number_format_check(&e_field->number, values[i]);
 
-    rc = 0;
-    if ((llen < format_w[0]) ||
-        ((format_w[1] > -1) && (llen > format_w[1])))
-        rc = -ERANGE;
-    if (have_dp == TRUE)
-    {
-        if ((rlen < format_p[0]) ||
-            ((format_p[1] > -1) && (rlen > format_p[1])))
-            rc = -ERANGE;
+        if (results != NULL)
+            results[i] = rc;
+        if ((rc != 0) && (first == 0))
+            first = rc;
     }
-    else if (format_p[0] > 0)
-        rc = -ERANGE;
 
-    return(rc);
-}  /* rasta_verify_number_format() */
+    return(first);
+}  /* rasta_dialog_field_validate_many() */
 
 
 /*
@@ -1224,42 +1579,91 @@ rasta_dialog_field_enumerate_ring(RastaDialogField *field)
 
     r_field = RASTA_RING_DIALOG_FIELD(field);
 
-    enumer = r_enumeration_new_from_list(r_field->ring_values);
+    enumer = r_enumeration_new_from_array(r_field->ring_values->pdata,
+                                          r_field->ring_values->len);
 
     return(enumer);
 }  /* rasta_dialog_field_enumerate_ring() */
 
 
+/*
+ * void rasta_dialog_field_init_ring_cursor(RastaDialogField *field,
+ *                                          REnumeration *cursor)
+ *
+ * Initializes a caller-owned cursor over the ring items.  The cursor
+ * needs no freeing.
+ */
+void rasta_dialog_field_init_ring_cursor(RastaDialogField *field,
+                                         REnumeration *cursor)
+{
+    RastaRingDialogField *r_field;
+
+    g_return_if_fail(cursor != NULL);
+    r_enumeration_init_array(cursor, NULL, 0);
+
+    g_return_if_fail(field != NULL);
+    g_return_if_fail(field->type == RASTA_FIELD_RING);
+
+    r_field = RASTA_RING_DIALOG_FIELD(field);
+
+    r_enumeration_init_array(cursor, r_field->ring_values->pdata,
+                             r_field->ring_values->len);
+}  /* rasta_dialog_field_init_ring_cursor() */
+
+
 /*
  * gchar *rasta_ring_value_get_text(RastaRingValue *value)
  *
  * Returns the text of the ring value
  */
 gchar *rasta_ring_value_get_text(RastaRingValue *value)
+{
+    return(g_strdup(rasta_ring_value_peek_text(value)));
+}  /* rasta_ring_value_get_text() */
+
+
+/*
+ * const gchar *rasta_ring_value_peek_text(RastaRingValue *value)
+ *
+ * Returns the text of the ring value without copying it.
+ */
+const gchar *rasta_ring_value_peek_text(RastaRingValue *value)
 {
     g_return_val_if_fail(value != NULL, NULL);
 
-    return(g_strdup(value->text));
-}  /* rasta_ring_value_get_text() */
+    return(value->text);
+}  /* rasta_ring_value_peek_text() */
 
 
 /*
  * gchar *rasta_ring_value_get_value(RastaRingValue *value)
  *
- * Returns the text of the ring value
+ * Returns the value of the ring value
  */
 gchar *rasta_ring_value_get_value(RastaRingValue *value)
+{
+    return(g_strdup(rasta_ring_value_peek_value(value)));
+}  /* rasta_ring_value_get_value() */
+
+
+/*
+ * const gchar *rasta_ring_value_peek_value(RastaRingValue *value)
+ *
+ * Returns the value of the ring value without copying it.
+ */
+const gchar *rasta_ring_value_peek_value(RastaRingValue *value)
 {
     g_return_val_if_fail(value != NULL, NULL);
 
-    return(g_strdup(value->value));
-}  /* rasta_ring_value_get_value() */
+    return(value->value);
+}  /* rasta_ring_value_peek_value() */
 
 
 /*
  * gchar *rasta_listcommand_get_encoding(RastaDialogField *field)
  *
- * Returns the encoding for the listcommand
+ * Returns the encoding for the listcommand.  "system" is resolved
+ * to the locale's charset.
  */
 gchar *rasta_listcommand_get_encoding(RastaDialogField *field)
 {
@@ -1271,10 +1675,7 @@ gchar *rasta_listcommand_get_encoding(RastaDialogField *field)
 
     encoding = RASTA_LIST_DIALOG_FIELD(field)->encoding;
 
-    if (strcmp(encoding, "system") == 0)
-        g_get_charset(&encoding);
-
-    return(g_strdup(encoding));
+    return(g_strdup(rasta_exec_resolve_encoding(encoding)));
 }  /* rasta_listcommand_get_encoding() */
 
 
@@ -1332,6 +1733,7 @@ gint rasta_listcommand_run(RastaContext *ctxt,
     gint rc, l_outfd, l_errfd;
     pid_t l_pid;
     RastaListDialogField *l_field;
+    const gchar *screen_id;
     gchar *utf8_cmd, *locale_cmd;
     gchar *argv[] =
     {
@@ -1356,18 +1758,21 @@ gint rasta_listcommand_run(RastaContext *ctxt,
     if (utf8_cmd == NULL)
         return(-ENOMEM);
 
-    locale_cmd = g_locale_from_utf8(utf8_cmd, -1, NULL, NULL, NULL);
+    locale_cmd = rasta_exec_locale_from_utf8(utf8_cmd, NULL);
     g_free(utf8_cmd);
     if (locale_cmd == NULL)
         return(-ENOMEM);
 
     argv[2] = locale_cmd;
-    rc = rasta_exec_command_v(&l_pid,
-                              NULL, &l_outfd, &l_errfd,
-                              RASTA_EXEC_FD_NULL,
-                              RASTA_EXEC_FD_PIPE,
-                              RASTA_EXEC_FD_PIPE,
-                              argv);
+    screen_id = RASTA_TIMING_CHILDREN() ? rasta_trace_screen_id(ctxt) : NULL;
+    rc = rasta_exec_command_screen(screen_id,
+                                   RASTA_PROFILE_LISTCOMMAND,
+                                   &l_pid,
+                                   NULL, &l_outfd, &l_errfd,
+                                   RASTA_EXEC_FD_NULL,
+                                   RASTA_EXEC_FD_PIPE,
+                                   RASTA_EXEC_FD_PIPE,
+                                   argv);
 
     g_free(locale_cmd);
 
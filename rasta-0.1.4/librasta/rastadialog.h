@@ -36,5 +36,6 @@ void rasta_dialog_screen_load(RastaContext *ctxt,
                               xmlNodePtr screen_node);
 void rasta_dialog_screen_init(RastaContext *ctxt,
                               RastaScreen *screen);
+void rasta_dialog_screen_free(RastaScreen *screen);
 
 #endif /* _RASTA_DIALOG_H */
@@ -33,7 +33,25 @@
 #include <unistd.h>
 
 #include "rasta.h"
+#include "rastaprofile.h"
 #include "rastaexec.h"
+#include "rastatrace.h"
+
+
+
+/*
+ * Defines
+ */
+#define EXEC_READ_PAGES 4
+
+/* Characters rasta_escape_double() puts a backslash in front of */
+#define ESCAPE_DOUBLE_CHARS "\"*[]\\"
+
+/* Bytes of a partial character carried between pipe reads */
+#define EXEC_PENDING_MAX 16
+
+/* U+FFFD, written in place of a character cut short by EOF */
+#define EXEC_REPLACEMENT "\357\277\275"
 
 
 
@@ -41,6 +59,37 @@
  * Prototypes
  */
 static void child_pgrp(gpointer user_data);
+static void exec_job_add_channel(GMainContext *context,
+                                 RastaExecJob *job,
+                                 gint index,
+                                 gint fd,
+                                 const gchar *encoding);
+static gboolean exec_job_read(GIOChannel *chan,
+                              GIOCondition cond,
+                              gpointer user_data);
+static void exec_job_exited(GPid pid, gint status, gpointer user_data);
+static void exec_job_maybe_done(RastaExecJob *job);
+static gint exec_job_convert(RastaExecJob *job,
+                             gint index,
+                             const gchar *data,
+                             gsize len);
+static void exec_job_flush(RastaExecJob *job,
+                           gint index,
+                           RastaExecStream stream);
+static gboolean exec_encoding_is_utf8(const gchar *encoding);
+static GIConv exec_converter_get(const gchar *to, const gchar *from);
+static void exec_converter_put(const gchar *to,
+                               const gchar *from,
+                               GIConv cd);
+
+
+
+/*
+ * Globals
+ */
+static gchar *system_charset = NULL;    /* Resolved on first use */
+static gboolean system_is_utf8 = FALSE;
+static GHashTable *converters = NULL;   /* "to\nfrom" -> idle GIConvs */
 
 
 
@@ -92,12 +141,46 @@ gint rasta_exec_command_v(pid_t *pid,
                           RastaExecFDProtocol out_prot,
                           RastaExecFDProtocol err_prot,
                           gchar * args[])
+{
+    return(rasta_exec_command_screen(NULL, RASTA_PROFILE_OTHER,
+                                     pid, infd, outfd, errfd,
+                                     in_prot, out_prot, err_prot,
+                                     args));
+}  /* rasta_exec_command_v() */
+
+
+/*
+ * gint rasta_exec_command_screen(const gchar *screen_id,
+ *                                RastaProfileKind kind,
+ *                                pid_t *pid,
+ *                                gint *infd,
+ *                                gint *outfd,
+ *                                gint *errfd,
+ *                                RastaExecFDProtocol in_prot,
+ *                                RastaExecFDProtocol out_prot,
+ *                                RastaExecFDProtocol err_prot,
+ *                                gchar * args[])
+ *
+ * rasta_exec_command_v() for commands run on behalf of a screen.
+ * screen_id and kind only label the child for tracing and profiling.
+ */
+gint rasta_exec_command_screen(const gchar *screen_id,
+                               RastaProfileKind kind,
+                               pid_t *pid,
+                               gint *infd,
+                               gint *outfd,
+                               gint *errfd,
+                               RastaExecFDProtocol in_prot,
+                               RastaExecFDProtocol out_prot,
+                               RastaExecFDProtocol err_prot,
+                               gchar * args[])
 {
     pid_t n_pid;  /* Never pass an empty pid */
     gint rc = 0;
     gboolean res;
     GError *err = NULL;
     GSpawnFlags flags;
+    guint64 start;
 
     flags = G_SPAWN_DO_NOT_REAP_CHILD;
     switch (in_prot)
@@ -163,6 +246,7 @@ gint rasta_exec_command_v(pid_t *pid,
             break;
     }
 
+    start = RASTA_TIMING_CHILDREN() ? rasta_trace_now() : 0;
     res = g_spawn_async_with_pipes(NULL,
                                    args,
                                    NULL,
@@ -178,12 +262,17 @@ gint rasta_exec_command_v(pid_t *pid,
     {
         rc = err->code ? -(err->code) : -1;
         g_clear_error(&err);
+        rasta_profile_command(screen_id, kind, 0, 0, TRUE);
+    }
+    else
+    {
+        rasta_trace_spawned(n_pid, screen_id, kind, args, start);
+        if (pid != NULL)
+            *pid = n_pid;
     }
-    else if (pid != NULL)
-        *pid = n_pid;
 
     return(rc);
-}  /* rasta_exec_command_v() */
+}  /* rasta_exec_command_screen() */
 
 
 /*
@@ -245,84 +334,686 @@ gint rasta_exec_command_l(pid_t *pid,
     g_strfreev(new_args);
     
     return(rc);
-}
+}  /* rasta_exec_command_l() */
 
-typedef gchar * (*EscapeFunc) (const gchar *str);
 
-gchar *rasta_escape_none(const gchar *str)
+/*
+ * static gboolean exec_encoding_is_utf8(const gchar *encoding)
+ *
+ * Returns whether encoding names UTF-8.
+ */
+static gboolean exec_encoding_is_utf8(const gchar *encoding)
 {
-    return g_strdup(str);
-}
+    return((g_ascii_strcasecmp(encoding, "UTF-8") == 0) ||
+           (g_ascii_strcasecmp(encoding, "UTF8") == 0));
+}  /* exec_encoding_is_utf8() */
 
-gchar *rasta_escape_single(const gchar *str)
+
+/*
+ * gboolean rasta_get_charset(const gchar **charset)
+ *
+ * As g_get_charset(), but the answer is worked out once per process
+ * and every spelling of UTF-8 comes back as "UTF-8".  Programs must
+ * call setlocale() before their first librasta call, as they do
+ * anyway.  Returns TRUE if the charset is UTF-8.
+ */
+gboolean rasta_get_charset(const gchar **charset)
 {
-    GString *buf;
-    gint i, len;
-    gchar *ret;
+    const gchar *name;
 
-    len = strlen(str);
- 
-    buf = g_string_sized_new(len);
+    if (system_charset == NULL)
+    {
+        system_is_utf8 = g_get_charset(&name);
+        if (system_is_utf8 == FALSE)
+            system_is_utf8 = exec_encoding_is_utf8(name);
+        system_charset = g_strdup(system_is_utf8 ? "UTF-8" : name);
+    }
 
-    for (i = 0; i < len; i++)
+    if (charset != NULL)
+        *charset = system_charset;
+
+    return(system_is_utf8);
+}  /* rasta_get_charset() */
+
+
+/*
+ * const gchar *rasta_exec_resolve_encoding(const gchar *encoding)
+ *
+ * Returns the encoding an OUTPUTENCODING value stands for.
+ * "system" is the locale's charset, and UTF-8 is always spelled
+ * "UTF-8" so that GIOChannel knows it needs no converter.
+ */
+const gchar *rasta_exec_resolve_encoding(const gchar *encoding)
+{
+    const gchar *charset;
+
+    if (encoding == NULL)
+        return(NULL);
+
+    if (strcmp(encoding, "system") == 0)
     {
-        if (str[i] == '\'')
-	    g_string_append(buf, "'\\''");
-	else
-	    g_string_append_c(buf, str[i]);
+        rasta_get_charset(&charset);
+        return(charset);
     }
 
-    ret = g_strdup(buf->str);
-    g_string_free(buf, TRUE);
+    if (exec_encoding_is_utf8(encoding))
+        return("UTF-8");
 
-    return ret;
-}
+    return(encoding);
+}  /* rasta_exec_resolve_encoding() */
 
-gchar *rasta_escape_double(const gchar *str)
+
+/*
+ * static GIConv exec_converter_get(const gchar *to, const gchar *from)
+ *
+ * Returns a converter from one encoding to another, reusing an idle
+ * one if there is one.  Converters keep state, so each is used by
+ * one caller at a time and given back with exec_converter_put().
+ * Returns (GIConv)-1 if the pair isn't supported.
+ */
+static GIConv exec_converter_get(const gchar *to, const gchar *from)
 {
-    GString *buf;
-    gint i, len;
+    GSList *idle;
+    GIConv cd;
+    gchar *key;
+
+    if (converters == NULL)
+        converters = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           g_free, NULL);
+
+    key = g_strconcat(to, "\n", from, NULL);
+    idle = (GSList *)g_hash_table_lookup(converters, key);
+    if (idle == NULL)
+    {
+        g_free(key);
+        return(g_iconv_open(to, from));
+    }
+
+    cd = (GIConv)idle->data;
+    g_hash_table_insert(converters, key, g_slist_delete_link(idle, idle));
+
+    return(cd);
+}  /* exec_converter_get() */
+
+
+/*
+ * static void exec_converter_put(const gchar *to,
+ *                                const gchar *from,
+ *                                GIConv cd)
+ *
+ * Resets a converter from exec_converter_get() and keeps it for the
+ * next caller.
+ */
+static void exec_converter_put(const gchar *to,
+                               const gchar *from,
+                               GIConv cd)
+{
+    GSList *idle;
+    gchar *key;
+
+    g_iconv(cd, NULL, NULL, NULL, NULL);
+
+    key = g_strconcat(to, "\n", from, NULL);
+    idle = (GSList *)g_hash_table_lookup(converters, key);
+    g_hash_table_insert(converters, key, g_slist_prepend(idle, cd));
+}  /* exec_converter_put() */
+
+
+/*
+ * gchar *rasta_exec_locale_from_utf8(const gchar *utf8_str,
+ *                                    GError **error)
+ *
+ * As g_locale_from_utf8(), for commands on their way to the shell.
+ * On a UTF-8 locale the string is only checked and copied.
+ * Otherwise the converter is kept between calls.  Returns NULL and
+ * sets error if utf8_str can't be converted.
+ */
+gchar *rasta_exec_locale_from_utf8(const gchar *utf8_str, GError **error)
+{
+    const gchar *charset, *end;
     gchar *ret;
+    GIConv cd;
 
-    len = strlen(str);
- 
-    buf = g_string_sized_new(len);
+    g_return_val_if_fail(utf8_str != NULL, NULL);
 
-    for (i = 0; i < len; i++)
+    if (rasta_get_charset(&charset) != FALSE)
     {
-        switch (str[i])
+        if (g_utf8_validate(utf8_str, -1, &end) == FALSE)
         {
-            case '"':
-	        g_string_append(buf, "\\\"");
-                break;
+            g_set_error(error, G_CONVERT_ERROR,
+                        G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+                        "Invalid byte sequence in conversion input at offset %ld",
+                        (glong)(end - utf8_str));
+            return(NULL);
+        }
+        return(g_strdup(utf8_str));
+    }
 
-            case '*':
-	        g_string_append(buf, "\\*");
-                break;
+    cd = exec_converter_get(charset, "UTF-8");
+    if (cd == (GIConv)-1)
+        return(g_locale_from_utf8(utf8_str, -1, NULL, NULL, error));
 
-            case '[':
-	        g_string_append(buf, "\\[");
-                break;
+    ret = g_convert_with_iconv(utf8_str, -1, cd, NULL, NULL, error);
+    exec_converter_put(charset, "UTF-8", cd);
 
-            case ']':
-	        g_string_append(buf, "\\]");
-                break;
+    return(ret);
+}  /* rasta_exec_locale_from_utf8() */
 
-            case '\\':
-	        g_string_append(buf, "\\\\");
-                break;
 
-            default:
-	        g_string_append_c(buf, str[i]);
+/*
+ * static void exec_job_add_channel(GMainContext *context,
+ *                                  RastaExecJob *job,
+ *                                  gint index,
+ *                                  gint fd,
+ *                                  const gchar *encoding)
+ *
+ * Wraps one of the child's pipes in a channel and attaches a read
+ * watch for it to the given main context.  UTF-8 and binary pipes
+ * are left to the channel.  Anything else is read raw and converted
+ * with a converter kept from earlier children, which saves opening
+ * a new one for every command.
+ */
+static void exec_job_add_channel(GMainContext *context,
+                                 RastaExecJob *job,
+                                 gint index,
+                                 gint fd,
+                                 const gchar *encoding)
+{
+    GSource *source;
+
+    if (fd < 0)
+        return;
+
+    job->chan[index] = g_io_channel_unix_new(fd);
+    g_io_channel_set_close_on_unref(job->chan[index], TRUE);
+    g_io_channel_set_flags(job->chan[index], G_IO_FLAG_NONBLOCK, NULL);
+
+    if ((encoding != NULL) && (strcmp(encoding, "UTF-8") != 0))
+        job->conv[index] = exec_converter_get("UTF-8", encoding);
+    if (job->conv[index] != (GIConv)-1)
+    {
+        g_io_channel_set_encoding(job->chan[index], NULL, NULL);
+        job->pending[index] = g_string_new(NULL);
+        if (job->converted == NULL)
+            job->converted = g_string_new(NULL);
+    }
+    else
+        g_io_channel_set_encoding(job->chan[index], encoding, NULL);
+
+    source = g_io_create_watch(job->chan[index],
+                               G_IO_IN | G_IO_HUP | G_IO_ERR);
+    g_source_set_priority(source, G_PRIORITY_LOW);
+    g_source_set_callback(source, (GSourceFunc)exec_job_read,
+                          job, NULL);
+    g_source_attach(source, context);
+    g_source_unref(source);
+}  /* exec_job_add_channel() */
+
+
+/*
+ * static gboolean exec_job_read(GIOChannel *chan,
+ *                               GIOCondition cond,
+ *                               gpointer user_data)
+ *
+ * Reads whatever is waiting on one of the child's pipes.  The data
+ * is either handed straight to the output function or collected for
+ * the completion callback, depending on the job's streams.
+ */
+static gboolean exec_job_read(GIOChannel *chan,
+                              GIOCondition cond,
+                              gpointer user_data)
+{
+    RastaExecJob *job;
+    RastaExecStream stream;
+    GIOStatus rc;
+    gsize bytes_read, len;
+    gboolean cont;
+    gint index;
+    gchar *data;
+
+    g_return_val_if_fail(user_data != NULL, FALSE);
+
+    job = (RastaExecJob *)user_data;
+    index = (chan == job->chan[0]) ? 0 : 1;
+    stream = index ? RASTA_EXEC_STREAM_STDERR : RASTA_EXEC_STREAM_STDOUT;
+
+    cont = TRUE;
+    rc = g_io_channel_read_chars(chan, job->buffer, job->buffer_size,
+                                 &bytes_read, NULL);
+    switch (rc)
+    {
+        case G_IO_STATUS_EOF:
+            cont = FALSE;
+            if (bytes_read < 1)
                 break;
-        }
+            /* Fall through with read data */
+
+        case G_IO_STATUS_NORMAL:
+            g_assert(bytes_read > 0);
+            job->bytes_read += bytes_read;
+            data = job->buffer;
+            len = bytes_read;
+            if (job->conv[index] != (GIConv)-1)
+            {
+                if (exec_job_convert(job, index, data, len) != 0)
+                {
+                    cont = FALSE;
+                    break;
+                }
+                data = job->converted->str;
+                len = job->converted->len;
+            }
+            if (len < 1)
+                break;  /* Only part of a character so far */
+            if (job->streams & stream)
+                job->output_func(stream, data, len, job->user_data);
+            else
+                g_string_append_len(job->data[index], data, len);
+            break;
+
+        case G_IO_STATUS_AGAIN:
+            /* Do nothing */
+            break;
+
+        case G_IO_STATUS_ERROR:
+            cont = FALSE;
+            /* FIXME: Flag an error? */
+            break;
+
+        default:
+            g_assert_not_reached();
+            break;
+    }
+
+    if (cont == FALSE)
+    {
+        exec_job_flush(job, index, stream);
+        if (job->streams & stream)
+            job->output_func(stream, NULL, 0, job->user_data);
+        g_io_channel_shutdown(chan, FALSE, NULL);
+        g_io_channel_unref(chan);
+        job->chan[index] = NULL;
+        exec_job_maybe_done(job);
     }
 
-    ret = g_strdup(buf->str);
-    g_string_free(buf, TRUE);
+    return(cont);
+}  /* exec_job_read() */
+
+
+/*
+ * static void exec_job_exited(GPid pid, gint status, gpointer user_data)
+ *
+ * Child watch handler.  The main loop has already reaped the child.
+ */
+static void exec_job_exited(GPid pid, gint status, gpointer user_data)
+{
+    RastaExecJob *job;
+
+    g_return_if_fail(user_data != NULL);
+
+    job = (RastaExecJob *)user_data;
+    job->status = status;
+    job->exited = TRUE;
+    exec_job_maybe_done(job);
+}  /* exec_job_exited() */
+
+
+/*
+ * static void exec_job_maybe_done(RastaExecJob *job)
+ *
+ * Fires the completion callback once the child has exited and both
+ * pipes have drained, then frees the job.
+ */
+static void exec_job_maybe_done(RastaExecJob *job)
+{
+    gchar *out_data, *err_data;
+    gint index;
+
+    if ((job->exited == FALSE) ||
+        (job->chan[0] != NULL) ||
+        (job->chan[1] != NULL))
+        return;
+
+    rasta_trace_child_exited(job->pid, job->status, job->bytes_read);
+
+    out_data = job->data[0]->len ? job->data[0]->str : NULL;
+    err_data = job->data[1]->len ? job->data[1]->str : NULL;
+    job->done_func(job->status, out_data, err_data, job->user_data);
+
+    for (index = 0; index < 2; index++)
+    {
+        if (job->conv[index] != (GIConv)-1)
+            exec_converter_put("UTF-8", job->encoding, job->conv[index]);
+        if (job->pending[index] != NULL)
+            g_string_free(job->pending[index], TRUE);
+    }
+    if (job->converted != NULL)
+        g_string_free(job->converted, TRUE);
+
+    g_string_free(job->data[0], TRUE);
+    g_string_free(job->data[1], TRUE);
+    g_free(job->encoding);
+    g_free(job->buffer);
+    g_free(job);
+}  /* exec_job_maybe_done() */
+
+
+/*
+ * static gint exec_job_convert(RastaExecJob *job,
+ *                              gint index,
+ *                              const gchar *data,
+ *                              gsize len)
+ *
+ * Converts len bytes read from one of the child's pipes into
+ * job->converted.  A character split across reads is held back
+ * until the rest of it arrives.  Returns 0 if successful, -EILSEQ
+ * if the data isn't in the pipe's encoding.
+ */
+static gint exec_job_convert(RastaExecJob *job,
+                             gint index,
+                             const gchar *data,
+                             gsize len)
+{
+    GString *pending, *out;
+    gchar *inbuf, *outbuf;
+    gsize inleft, outleft, done, res;
+    gint err;
+    gboolean carried;
+
+    pending = job->pending[index];
+    out = job->converted;
+
+    carried = (pending->len > 0);
+    if (carried != FALSE)
+    {
+        g_string_append_len(pending, data, len);
+        inbuf = pending->str;
+        inleft = pending->len;
+    }
+    else
+    {
+        inbuf = (gchar *)data;
+        inleft = len;
+    }
+
+    g_string_truncate(out, 0);
+    err = 0;
+    while ((inleft > 0) && (err == 0))
+    {
+        done = out->len;
+        g_string_set_size(out, done + (inleft * 2) + 16);
+        outbuf = out->str + done;
+        outleft = out->len - done;
+
+        res = g_iconv(job->conv[index], &inbuf, &inleft, &outbuf, &outleft);
+        err = (res == (gsize)-1) ? errno : 0;
+        g_string_set_size(out, outbuf - out->str);
+
+        if (err == E2BIG)
+            err = 0;
+    }
+
+    if ((err != 0) && ((err != EINVAL) || (inleft > EXEC_PENDING_MAX)))
+        return(-EILSEQ);
+
+    /* Keep whatever is left of a partial character */
+    if (carried != FALSE)
+        g_string_erase(pending, 0, inbuf - pending->str);
+    else if (inleft > 0)
+        g_string_append_len(pending, inbuf, inleft);
+
+    return(0);
+}  /* exec_job_convert() */
+
+
+/*
+ * static void exec_job_flush(RastaExecJob *job,
+ *                            gint index,
+ *                            RastaExecStream stream)
+ *
+ * Called when one of the child's pipes closes.  Bytes still held in
+ * job->pending[index] are a character the pipe ended in the middle
+ * of, or input that failed to convert.  Rather than dropping them
+ * without a trace, a U+FFFD replacement character is passed on in
+ * their place, so the output visibly ends short.
+ */
+static void exec_job_flush(RastaExecJob *job,
+                           gint index,
+                           RastaExecStream stream)
+{
+    if ((job->pending[index] == NULL) || (job->pending[index]->len < 1))
+        return;
+
+    g_string_truncate(job->pending[index], 0);
+    if (job->streams & stream)
+        job->output_func(stream, EXEC_REPLACEMENT,
+                         strlen(EXEC_REPLACEMENT), job->user_data);
+    else
+        g_string_append(job->data[index], EXEC_REPLACEMENT);
+}  /* exec_job_flush() */
+
+
+/*
+ * gint rasta_exec_watch_child(GMainContext *context,
+ *                             pid_t pid,
+ *                             gint outfd,
+ *                             gint errfd,
+ *                             const gchar *encoding,
+ *                             RastaExecStream streams,
+ *                             RastaExecOutputFunc output_func,
+ *                             RastaExecDoneFunc done_func,
+ *                             gpointer user_data)
+ *
+ * Watches a child started by rasta_exec_command_v() or one of the
+ * *_run() functions from the given main context (NULL for the
+ * default context).  outfd and errfd are the child's pipes, or -1 if
+ * there is no pipe for that stream.  Pipe data is converted from
+ * encoding.  Streams named in streams are passed to output_func as
+ * they arrive, followed by a single call with NULL data when the
+ * pipe closes.  Other streams are collected.
+ *
+ * done_func is called exactly once, when the child has exited and
+ * both pipes have closed, with the wait status from waitpid(2) and
+ * the collected output (NULL if empty or streamed).  The child is
+ * reaped by the main loop; the caller must not call waitpid(2) on it.
+ *
+ * Returns 0 if successful, otherwise returns -ERROR.
+ */
+gint rasta_exec_watch_child(GMainContext *context,
+                            pid_t pid,
+                            gint outfd,
+                            gint errfd,
+                            const gchar *encoding,
+                            RastaExecStream streams,
+                            RastaExecOutputFunc output_func,
+                            RastaExecDoneFunc done_func,
+                            gpointer user_data)
+{
+    RastaExecJob *job;
+    GSource *source;
+
+    g_return_val_if_fail(pid > 0, -EINVAL);
+    g_return_val_if_fail(done_func != NULL, -EINVAL);
+    g_return_val_if_fail((streams == RASTA_EXEC_STREAM_NONE) ||
+                         (output_func != NULL), -EINVAL);
+
+    job = g_new0(RastaExecJob, 1);
+    if (job == NULL)
+        return(-ENOMEM);
+
+    job->pid = pid;
+    job->streams = streams;
+    job->output_func = output_func;
+    job->done_func = done_func;
+    job->user_data = user_data;
+    job->data[0] = g_string_new(NULL);
+    job->data[1] = g_string_new(NULL);
+    job->buffer_size = getpagesize() * EXEC_READ_PAGES;
+    job->buffer = g_new(gchar, job->buffer_size);
+    job->encoding = g_strdup(rasta_exec_resolve_encoding(encoding));
+    job->conv[0] = (GIConv)-1;
+    job->conv[1] = (GIConv)-1;
+
+    exec_job_add_channel(context, job, 0, outfd, job->encoding);
+    exec_job_add_channel(context, job, 1, errfd, job->encoding);
+
+    source = g_child_watch_source_new(pid);
+    g_source_set_callback(source, (GSourceFunc)exec_job_exited,
+                          job, NULL);
+    g_source_attach(source, context);
+    g_source_unref(source);
+
+    return(0);
+}  /* rasta_exec_watch_child() */
+
+typedef void (*EscapeFunc) (GString *buf, const gchar *str);
+
+/*
+ * gchar *rasta_escape_none(const gchar *str)
+ *
+ * Returns a copy of str.
+ */
+gchar *rasta_escape_none(const gchar *str)
+{
+    return g_strdup(str);
+}  /* rasta_escape_none() */
+
+
+/*
+ * void rasta_escape_none_append(GString *buf, const gchar *str)
+ *
+ * Appends str to buf as it is.
+ */
+void rasta_escape_none_append(GString *buf, const gchar *str)
+{
+    g_string_append(buf, str);
+}  /* rasta_escape_none_append() */
+
+
+/*
+ * gchar *rasta_escape_single(const gchar *str)
+ *
+ * Returns str quoted for use inside single quotes.  Each ' becomes
+ * '\''.  The quotes are found with strchr(), which libc scans a
+ * word or vector at a time, and the result is allocated at its
+ * exact size.  A string without quotes is just copied.
+ */
+gchar *rasta_escape_single(const gchar *str)
+{
+    const gchar *ptr, *quote;
+    gchar *ret, *out;
+    gsize count, len;
+
+    count = 0;
+    for (ptr = strchr(str, '\''); ptr != NULL; ptr = strchr(ptr + 1, '\''))
+        count++;
+    if (count == 0)
+        return g_strdup(str);
+
+    len = strlen(str);
+    ret = g_new(gchar, len + (count * 3) + 1);
+
+    out = ret;
+    ptr = str;
+    while ((quote = strchr(ptr, '\'')) != NULL)
+    {
+        memcpy(out, ptr, quote - ptr);
+        out += quote - ptr;
+        memcpy(out, "'\\''", 4);
+        out += 4;
+        ptr = quote + 1;
+    }
+    strcpy(out, ptr);
 
     return ret;
-}
+}  /* rasta_escape_single() */
+
+
+/*
+ * void rasta_escape_single_append(GString *buf, const gchar *str)
+ *
+ * Appends str to buf as rasta_escape_single() would return it,
+ * without the intermediate copy.
+ */
+void rasta_escape_single_append(GString *buf, const gchar *str)
+{
+    const gchar *quote;
+
+    while ((quote = strchr(str, '\'')) != NULL)
+    {
+        g_string_append_len(buf, str, quote - str);
+        g_string_append_len(buf, "'\\''", 4);
+        str = quote + 1;
+    }
+    g_string_append(buf, str);
+}  /* rasta_escape_single_append() */
+
+
+/*
+ * gchar *rasta_escape_double(const gchar *str)
+ *
+ * Returns str quoted for use inside double quotes.  Each of
+ * " * [ ] and \ gets a backslash in front of it.  As with
+ * rasta_escape_single(), the special characters are found with
+ * strcspn() and the result is allocated at its exact size.
+ */
+gchar *rasta_escape_double(const gchar *str)
+{
+    const gchar *ptr;
+    gchar *ret, *out;
+    gsize count, span;
+
+    count = 0;
+    for (ptr = str + strcspn(str, ESCAPE_DOUBLE_CHARS);
+         *ptr != '\0';
+         ptr += strcspn(ptr + 1, ESCAPE_DOUBLE_CHARS) + 1)
+        count++;
+    if (count == 0)
+        return g_strdup(str);
+
+    ret = g_new(gchar, (ptr - str) + count + 1);
+
+    out = ret;
+    ptr = str;
+    for (;;)
+    {
+        span = strcspn(ptr, ESCAPE_DOUBLE_CHARS);
+        memcpy(out, ptr, span);
+        out += span;
+        ptr += span;
+        if (*ptr == '\0')
+            break;
+        *out++ = '\\';
+        *out++ = *ptr++;
+    }
+    *out = '\0';
+
+    return ret;
+}  /* rasta_escape_double() */
+
+
+/*
+ * void rasta_escape_double_append(GString *buf, const gchar *str)
+ *
+ * Appends str to buf as rasta_escape_double() would return it,
+ * without the intermediate copy.
+ */
+void rasta_escape_double_append(GString *buf, const gchar *str)
+{
+    gsize span;
+
+    for (;;)
+    {
+        span = strcspn(str, ESCAPE_DOUBLE_CHARS);
+        g_string_append_len(buf, str, span);
+        str += span;
+        if (*str == '\0')
+            break;
+        g_string_append_c(buf, '\\');
+        g_string_append_c(buf, *str);
+        str++;
+    }
+}  /* rasta_escape_double_append() */
 
 gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
                                const gchar *str,
@@ -333,19 +1024,20 @@ gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
     gchar *ret;
     gboolean in_sym = FALSE;
     EscapeFunc escape_func = NULL;;
+    guint64 start;
 
     switch (escape)
     {
         case RASTA_ESCAPE_STYLE_NONE:
-            escape_func = rasta_escape_none;
+            escape_func = rasta_escape_none_append;
 	    break;
 
         case RASTA_ESCAPE_STYLE_SINGLE:
-            escape_func = rasta_escape_single;
+            escape_func = rasta_escape_single_append;
 	    break;
 
         case RASTA_ESCAPE_STYLE_DOUBLE:
-            escape_func = rasta_escape_double;
+            escape_func = rasta_escape_double_append;
 	    break;
 
 	default:
@@ -353,6 +1045,7 @@ gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
 	    break;
     }
 
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
     len = strlen(str);
  
     buf = g_string_sized_new(len);
@@ -364,15 +1057,12 @@ gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
         {
             if (str[i] == '#')
             {
-		gchar *val, *escaped_val;
+		gchar *val;
 
                 val = rasta_symbol_lookup(ctxt, sym->str);
                 if (val != NULL)
                 {
-		    escaped_val = escape_func(val);
-                    g_string_append(buf, escaped_val);
-		    
-		    g_free(escaped_val);
+		    escape_func(buf, val);
                     g_free(val);
 		}
 
@@ -402,9 +1092,12 @@ gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
         }
     }
 
-    ret = g_strdup(buf->str);
-    g_string_free(buf, TRUE);
+    ret = g_string_free(buf, FALSE);
     g_string_free(sym, TRUE);
 
+    if (start != 0)
+        rasta_trace_emit(RASTA_TRACE_SYMBOL_SUBST,
+                         rasta_trace_screen_id(ctxt), NULL, start, len, 0);
+
     return ret;
 }
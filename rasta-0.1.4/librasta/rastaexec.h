@@ -30,6 +30,37 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+/*
+ * Structures
+ */
+
+/*
+ * A child being watched by rasta_exec_watch_child().  The pipe
+ * channels are indexed by stream, 0 for stdout and 1 for stderr, and
+ * are NULL once their pipe has closed.
+ */
+struct _RastaExecJob
+{
+    pid_t pid;
+    gint status;
+    gboolean exited;
+    GIOChannel *chan[2];
+    GString *data[2];
+    gchar *encoding;            /* Resolved pipe encoding */
+    GIConv conv[2];             /* Pipe converters, or (GIConv)-1 */
+    GString *pending[2];        /* Partial character between reads */
+    GString *converted;         /* Output of the last conversion */
+    gchar *buffer;
+    gsize buffer_size;
+    gsize bytes_read;           /* Both streams, for tracing */
+    RastaExecStream streams;
+    RastaExecOutputFunc output_func;
+    RastaExecDoneFunc done_func;
+    gpointer user_data;
+};
+
+
+
 /*
  * Prototypes
  */
@@ -38,6 +69,24 @@
 gchar *rasta_escape_none(const gchar *str);
 gchar *rasta_escape_single(const gchar *str);
 gchar *rasta_escape_double(const gchar *str);
+void rasta_escape_none_append(GString *buf, const gchar *str);
+void rasta_escape_single_append(GString *buf, const gchar *str);
+void rasta_escape_double_append(GString *buf, const gchar *str);
+
+/* Encoding functions */
+const gchar *rasta_exec_resolve_encoding(const gchar *encoding);
+
+/* Execution functions */
+gint rasta_exec_command_screen(const gchar *screen_id,
+                               RastaProfileKind kind,
+                               pid_t *pid,
+                               gint *infd,
+                               gint *outfd,
+                               gint *errfd,
+                               RastaExecFDProtocol in_prot,
+                               RastaExecFDProtocol out_prot,
+                               RastaExecFDProtocol err_prot,
+                               gchar * args[]);
 
 /* Symbol replacement functions */
 gchar *rasta_exec_symbol_subst(RastaContext *ctxt,
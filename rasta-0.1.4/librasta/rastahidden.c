@@ -39,6 +39,7 @@
 #include "rastahidden.h"
 #include "rastatraverse.h"
 #include "rastascope.h"
+#include "rastaprofile.h"
 #include "rastaexec.h"
 
 
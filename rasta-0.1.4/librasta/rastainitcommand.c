@@ -41,7 +41,9 @@
 #include "rastascreen.h"
 #include "rastadialog.h"
 #include "rastahidden.h"
+#include "rastaprofile.h"
 #include "rastaexec.h"
+#include "rastatrace.h"
 
 
 
@@ -126,7 +128,8 @@ gboolean rasta_initcommand_is_required(RastaContext *ctxt,
 /*
  * gchar *rasta_initcommand_get_encoding(RastaScreen *screen)
  *
- * Returns the encoding for the initcommand
+ * Returns the encoding for the initcommand.  "system" is resolved
+ * to the locale's charset.
  */
 gchar *rasta_initcommand_get_encoding(RastaScreen *screen)
 {
@@ -141,10 +144,7 @@ gchar *rasta_initcommand_get_encoding(RastaScreen *screen)
     else if (screen->type == RASTA_SCREEN_HIDDEN)
         encoding = RASTA_HIDDEN_SCREEN(screen)->encoding;
 
-    if (strcmp(encoding, "system") == 0)
-        g_get_charset(&encoding);
-
-    return(g_strdup(encoding));
+    return(g_strdup(rasta_exec_resolve_encoding(encoding)));
 }  /* rasta_initcommand_get_encoding() */
 
 
@@ -230,6 +230,7 @@ gint rasta_initcommand_run(RastaContext *ctxt,
     RastaHiddenScreen *h_screen;
     gchar *init_command = NULL;
     RastaEscapeStyleType escape_style = 0;
+    const gchar *screen_id;
     gchar *utf8_cmd, *locale_cmd;
     gchar *argv[] =
     {
@@ -274,18 +275,21 @@ gint rasta_initcommand_run(RastaContext *ctxt,
     if (utf8_cmd == NULL)
         return(-ENOMEM);
 
-    locale_cmd = g_locale_from_utf8(utf8_cmd, -1, NULL, NULL, NULL);
+    locale_cmd = rasta_exec_locale_from_utf8(utf8_cmd, NULL);
     g_free(utf8_cmd);
     if (locale_cmd == NULL)
         return(-ENOMEM);
 
     argv[2] = locale_cmd;
-    rc = rasta_exec_command_v(&l_pid,
-                              NULL, &l_outfd, &l_errfd,
-                              RASTA_EXEC_FD_NULL,
-                              RASTA_EXEC_FD_PIPE,
-                              RASTA_EXEC_FD_PIPE,
-                              argv);
+    screen_id = RASTA_TIMING_CHILDREN() ? rasta_trace_screen_id(ctxt) : NULL;
+    rc = rasta_exec_command_screen(screen_id,
+                                   RASTA_PROFILE_INITCOMMAND,
+                                   &l_pid,
+                                   NULL, &l_outfd, &l_errfd,
+                                   RASTA_EXEC_FD_NULL,
+                                   RASTA_EXEC_FD_PIPE,
+                                   RASTA_EXEC_FD_PIPE,
+                                   argv);
 
     g_free(locale_cmd);
 
@@ -0,0 +1,331 @@
+/*
+ * rastalive.c
+ *
+ * Symbol liveness analysis over the PATH of a description.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+/*
+ * A symbol lives in the scope of the screen that set it, and the
+ * scope goes away when the user backs up past that screen.  So the
+ * only things that can ever read a scope's symbols are the screens
+ * at or below its path node.  For each path node we collect every
+ * name those screens can use: #SYMBOL# references in INITCOMMAND,
+ * LISTCOMMAND and ACTIONCOMMAND text, MULTIPATH SYMBOL attributes,
+ * and FIELD NAMEs, which front-ends look up to fill in a revisited
+ * dialog.  Anything else in the scope is dead.
+ *
+ * The sets are built for the whole PATH the first time they are
+ * asked for and kept with the snapshot, so every context sharing a
+ * description shares them.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <string.h>
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastalive.h"
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _LiveBuild       LiveBuild;
+
+
+
+/*
+ * Structures
+ */
+struct _LiveBuild
+{
+    RastaContext *ctxt;
+    RastaSnapshot *snapshot;
+    GHashTable *screens;        /* Screen id -> names it uses */
+};
+
+
+
+/*
+ * Prototypes
+ */
+static void live_add(LiveBuild *build, GHashTable *set, const gchar *name);
+static void live_add_command(LiveBuild *build,
+                             GHashTable *set,
+                             xmlNodePtr node);
+static GHashTable *live_scan_screen(LiveBuild *build,
+                                    xmlNodePtr screen_node);
+static void live_union_func(gpointer key,
+                            gpointer value,
+                            gpointer user_data);
+static GHashTable *live_scan_path(LiveBuild *build, xmlNodePtr node);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static void live_add(LiveBuild *build,
+ *                      GHashTable *set,
+ *                      const gchar *name)
+ *
+ * Adds a name to set.  Names are interned in the snapshot so the
+ * sets can share them.
+ */
+static void live_add(LiveBuild *build, GHashTable *set, const gchar *name)
+{
+    gchar *key;
+
+    if ((name == NULL) || (name[0] == '\0'))
+        return;
+
+    key = g_string_chunk_insert_const(build->snapshot->live_names, name);
+    g_hash_table_insert(set, key, key);
+}  /* live_add() */
+
+
+/*
+ * static void live_add_command(LiveBuild *build,
+ *                              GHashTable *set,
+ *                              xmlNodePtr node)
+ *
+ * Adds the symbols a command element refers to.  This finds
+ * #SYMBOL# the same way rasta_exec_symbol_subst() does: whitespace
+ * ends a would-be name without making it a symbol.
+ */
+static void live_add_command(LiveBuild *build,
+                             GHashTable *set,
+                             xmlNodePtr node)
+{
+    gchar *text, *ptr, *start;
+
+    text = xmlNodeListGetString(build->ctxt->doc, node->children, 1);
+    if (text == NULL)
+        return;
+
+    start = NULL;
+    for (ptr = text; *ptr != '\0'; ptr++)
+    {
+        if (start == NULL)
+        {
+            if (*ptr == '#')
+                start = ptr + 1;
+        }
+        else if (*ptr == '#')
+        {
+            *ptr = '\0';
+            live_add(build, set, start);
+            start = NULL;
+        }
+        else if ((*ptr == ' ') || (*ptr == '\t') || (*ptr == '\n'))
+            start = NULL;
+    }
+
+    g_free(text);
+}  /* live_add_command() */
+
+
+/*
+ * static GHashTable *live_scan_screen(LiveBuild *build,
+ *                                     xmlNodePtr screen_node)
+ *
+ * Returns the set of names a screen uses.
+ */
+static GHashTable *live_scan_screen(LiveBuild *build,
+                                    xmlNodePtr screen_node)
+{
+    GHashTable *set;
+    xmlNodePtr cur, sub;
+    gchar *name;
+
+    set = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (cur = screen_node->children; cur != NULL; cur = cur->next)
+    {
+        if (cur->type != XML_ELEMENT_NODE)
+            continue;
+
+        if ((xmlStrcmp(cur->name, "INITCOMMAND") == 0) ||
+            (xmlStrcmp(cur->name, "ACTIONCOMMAND") == 0))
+            live_add_command(build, set, cur);
+        else if (xmlStrcmp(cur->name, "FIELD") == 0)
+        {
+            name = xmlGetProp(cur, "NAME");
+            live_add(build, set, name);
+            if (name != NULL)
+                g_free(name);
+
+            for (sub = cur->children; sub != NULL; sub = sub->next)
+            {
+                if ((sub->type == XML_ELEMENT_NODE) &&
+                    (xmlStrcmp(sub->name, "LISTCOMMAND") == 0))
+                    live_add_command(build, set, sub);
+            }
+        }
+    }
+
+    return(set);
+}  /* live_scan_screen() */
+
+
+/*
+ * static void live_union_func(gpointer key,
+ *                             gpointer value,
+ *                             gpointer user_data)
+ *
+ * Adds key to the set in user_data.
+ */
+static void live_union_func(gpointer key,
+                            gpointer value,
+                            gpointer user_data)
+{
+    g_hash_table_insert((GHashTable *)user_data, key, value);
+}  /* live_union_func() */
+
+
+/*
+ * static GHashTable *live_scan_path(LiveBuild *build, xmlNodePtr node)
+ *
+ * Returns the names used at or below a PATH element.  Sets for
+ * MENU, DIALOG, HIDDEN and ACTION nodes are kept in the snapshot;
+ * sets for MULTIPATH and DEFAULTPATH belong to the caller.
+ */
+static GHashTable *live_scan_path(LiveBuild *build, xmlNodePtr node)
+{
+    GHashTable *set, *sub_set;
+    xmlNodePtr cur;
+    gchar *attr;
+    gboolean path_node;
+
+    set = g_hash_table_new(g_str_hash, g_str_equal);
+
+    path_node = (xmlStrcmp(node->name, "MULTIPATH") != 0) &&
+                (xmlStrcmp(node->name, "DEFAULTPATH") != 0);
+    if (path_node != FALSE)
+    {
+        attr = xmlGetProp(node, "NAME");
+        if (attr != NULL)
+        {
+            sub_set = g_hash_table_lookup(build->screens, attr);
+            if (sub_set != NULL)
+                g_hash_table_foreach(sub_set, live_union_func, set);
+            g_free(attr);
+        }
+    }
+    else if (xmlStrcmp(node->name, "MULTIPATH") == 0)
+    {
+        attr = xmlGetProp(node, "SYMBOL");
+        live_add(build, set, attr);
+        if (attr != NULL)
+            g_free(attr);
+    }
+
+    for (cur = node->children; cur != NULL; cur = cur->next)
+    {
+        if ((cur->type != XML_ELEMENT_NODE) ||
+            (cur->ns != build->ctxt->ns))
+            continue;
+
+        sub_set = live_scan_path(build, cur);
+        g_hash_table_foreach(sub_set, live_union_func, set);
+        if ((xmlStrcmp(cur->name, "MULTIPATH") == 0) ||
+            (xmlStrcmp(cur->name, "DEFAULTPATH") == 0))
+            g_hash_table_destroy(sub_set);
+    }
+
+    if (path_node != FALSE)
+        g_hash_table_insert(build->snapshot->live, node, set);
+
+    return(set);
+}  /* live_scan_path() */
+
+
+/*
+ * GHashTable *rasta_live_symbols(RastaContext *ctxt,
+ *                                xmlNodePtr path_node)
+ *
+ * Returns the set of symbol names that the screens at or below
+ * path_node can use, keyed and valued by name.  The set belongs to
+ * the context's snapshot.  Returns NULL if path_node isn't part of
+ * the description's PATH, in which case every symbol must be
+ * assumed live.
+ */
+GHashTable *rasta_live_symbols(RastaContext *ctxt,
+                               xmlNodePtr path_node)
+{
+    LiveBuild build;
+    xmlNodePtr cur;
+    gchar *id;
+
+    g_return_val_if_fail(ctxt != NULL, NULL);
+    g_return_val_if_fail(ctxt->snapshot != NULL, NULL);
+
+    if (path_node == NULL)
+        return(NULL);
+
+    if (ctxt->snapshot->live == NULL)
+    {
+        build.ctxt = ctxt;
+        build.snapshot = ctxt->snapshot;
+        build.screens =
+            g_hash_table_new_full(g_str_hash, g_str_equal,
+                                  g_free,
+                                  (GDestroyNotify)g_hash_table_destroy);
+
+        ctxt->snapshot->live_names = g_string_chunk_new(1024);
+        ctxt->snapshot->live =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                  NULL,
+                                  (GDestroyNotify)g_hash_table_destroy);
+
+        for (cur = ctxt->screens->children; cur != NULL; cur = cur->next)
+        {
+            if ((cur->type != XML_ELEMENT_NODE) || (cur->ns != ctxt->ns))
+                continue;
+            id = xmlGetProp(cur, "ID");
+            if (id == NULL)
+                continue;
+            g_hash_table_insert(build.screens, id,
+                                live_scan_screen(&build, cur));
+        }
+
+        for (cur = ctxt->path_root->children; cur != NULL; cur = cur->next)
+        {
+            if ((cur->type == XML_ELEMENT_NODE) && (cur->ns == ctxt->ns))
+                live_scan_path(&build, cur);
+        }
+
+        g_hash_table_destroy(build.screens);
+    }
+
+    return((GHashTable *)g_hash_table_lookup(ctxt->snapshot->live,
+                                             path_node));
+}  /* rasta_live_symbols() */
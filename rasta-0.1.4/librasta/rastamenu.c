@@ -47,6 +47,7 @@ struct _RastaMenuItem
     gchar *text;
     gchar *next_id;
     gchar *help;
+    xmlNodePtr help_node;       /* Set until help is loaded */
 };
 
 
@@ -54,7 +55,9 @@ struct _RastaMenuItem
 /*
  * Prototypes
  */
-static void rasta_menu_items_free(GList *menu_items);
+static void rasta_menu_items_free(gpointer data);
+static GPtrArray *rasta_menu_items_build(RastaContext *ctxt,
+                                         xmlNodePtr path_node);
 static RastaMenuItem *rasta_menu_item_new(RastaContext *ctxt,
                                           xmlNodePtr node);
 
@@ -67,29 +70,64 @@ static RastaMenuItem *rasta_menu_item_new(RastaContext *ctxt,
 
 
 /*
- * static void rasta_menu_items_free(GList *menu_items)
+ * static void rasta_menu_items_free(gpointer data)
  *
- * Frees the menu items
+ * Frees an array of menu items.  Used as the value destructor of the
+ * snapshot's menu_items table.
  */
-static void rasta_menu_items_free(GList *menu_items)
+static void rasta_menu_items_free(gpointer data)
 {
-    GList *elem;
+    guint i;
+    GPtrArray *menu_items;
     RastaMenuItem *item;
 
-    elem = menu_items;
-    while (elem != NULL)
+    menu_items = (GPtrArray *)data;
+
+    for (i = 0; i < menu_items->len; i++)
     {
-        item = (RastaMenuItem *)elem->data;
+        item = (RastaMenuItem *)g_ptr_array_index(menu_items, i);
 
         g_free(item->text);
         g_free(item->next_id);
+        g_free(item->help);
         g_free(item);
+    }
+
+    g_ptr_array_free(menu_items, TRUE);
+}  /* rasta_menu_items_free() */
+
+
+/*
+ * static GPtrArray *rasta_menu_items_build(RastaContext *ctxt,
+ *                                          xmlNodePtr path_node)
+ *
+ * Builds the menu items for the children of a MENU path node
+ */
+static GPtrArray *rasta_menu_items_build(RastaContext *ctxt,
+                                         xmlNodePtr path_node)
+{
+    xmlNodePtr cur;
+    GPtrArray *menu_items;
+    RastaMenuItem *item;
 
-        elem = g_list_next(elem);
+    menu_items = g_ptr_array_new();
+
+    for (cur = path_node->children; cur != NULL; cur = cur->next)
+    {
+        if ((cur->type == XML_ELEMENT_NODE) &&
+            ((xmlStrcmp(cur->name, "DIALOG") == 0) ||
+             (xmlStrcmp(cur->name, "HIDDEN") == 0) ||
+             (xmlStrcmp(cur->name, "MENU") == 0) ||
+             (xmlStrcmp(cur->name, "ACTION") == 0)))
+        {
+            item = rasta_menu_item_new(ctxt, cur);
+            if (item != NULL)
+                g_ptr_array_add(menu_items, item);
+        }
     }
 
-    g_list_free(menu_items);
-}  /* rasta_menu_items_frees() */
+    return(menu_items);
+}  /* rasta_menu_items_build() */
 
 
 /*
@@ -139,7 +177,8 @@ static RastaMenuItem *rasta_menu_item_new(RastaContext *ctxt,
         return(NULL);
     }
 
-    item->help = rasta_query_help(ctxt, screen);
+    item->help = NULL;
+    item->help_node = screen;
 
     return(item);
 }  /* rasta_menu_item_new() */
@@ -194,45 +233,46 @@ void rasta_menu_screen_load(RastaContext *ctxt,
  * void rasta_menu_screen_init(RastaContext *ctxt,
  *                             RastaScreen *screen)
  *
- * Initializes the menu screen for its current use
+ * Initializes the menu screen for its current use.  The items only
+ * depend on the path node, so they are built once per node and kept
+ * with the snapshot, where every context sharing the document reuses
+ * them.  They go away with the snapshot.
  */
 void rasta_menu_screen_init(RastaContext *ctxt,
                             RastaScreen *screen)
 {
-    xmlNodePtr cur;
+    xmlNodePtr path_node;
     RastaScope *scope;
     RastaMenuScreen *m_screen;
-    RastaMenuItem *item;
+    GPtrArray *menu_items;
 
     g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(ctxt->snapshot != NULL);
     g_return_if_fail(screen != NULL);
     g_return_if_fail(screen->type == RASTA_SCREEN_MENU);
 
     m_screen = RASTA_MENU_SCREEN(screen);
 
-    rasta_menu_items_free(m_screen->menu_items);
-    m_screen->menu_items = NULL;
-
     scope = rasta_scope_get_current(ctxt);
-    cur = rasta_scope_get_path_node(scope);
-    cur = cur->children;
-    while (cur != NULL)
-    {
-        if ((cur->type == XML_ELEMENT_NODE) &&
-            ((xmlStrcmp(cur->name, "DIALOG") == 0) ||
-             (xmlStrcmp(cur->name, "HIDDEN") == 0) ||
-             (xmlStrcmp(cur->name, "MENU") == 0) ||
-             (xmlStrcmp(cur->name, "ACTION") == 0)))
-        {
-            item = rasta_menu_item_new(ctxt, cur);
-            if (item != NULL)
-                m_screen->menu_items =
-                    g_list_append(m_screen->menu_items, item);
-        }
+    path_node = rasta_scope_get_path_node(scope);
 
-        cur = cur->next;
+    if (ctxt->snapshot->menu_items == NULL)
+        ctxt->snapshot->menu_items =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                  NULL, rasta_menu_items_free);
+
+    menu_items =
+        (GPtrArray *)g_hash_table_lookup(ctxt->snapshot->menu_items,
+                                         path_node);
+    if (menu_items == NULL)
+    {
+        menu_items = rasta_menu_items_build(ctxt, path_node);
+        g_hash_table_insert(ctxt->snapshot->menu_items, path_node,
+                            menu_items);
     }
 
+    m_screen->menu_items = menu_items;
+
     if (ctxt->state == RASTA_CONTEXT_INITIALIZED)
         ctxt->state = RASTA_CONTEXT_SCREEN;
 }  /* rasta_menu_screen_init() */
@@ -255,13 +295,46 @@ REnumeration *rasta_menu_screen_enumerate_items(RastaContext *ctxt,
     g_return_val_if_fail(screen->type == RASTA_SCREEN_MENU, NULL);
 
     m_screen = RASTA_MENU_SCREEN(screen);
+    if (m_screen->menu_items == NULL)
+        return(r_enumeration_new_from_array(NULL, 0));
 
-    enumer = r_enumeration_new_from_list(m_screen->menu_items);
+    enumer = r_enumeration_new_from_array(m_screen->menu_items->pdata,
+                                          m_screen->menu_items->len);
 
     return(enumer);
 }  /* rasta_menu_screen_enumerate_items() */
 
 
+/*
+ * void rasta_menu_screen_init_cursor(RastaContext *ctxt,
+ *                                    RastaScreen *screen,
+ *                                    REnumeration *cursor)
+ *
+ * Initializes a caller-owned cursor over the menu items.  The cursor
+ * needs no freeing.
+ */
+void rasta_menu_screen_init_cursor(RastaContext *ctxt,
+                                   RastaScreen *screen,
+                                   REnumeration *cursor)
+{
+    RastaMenuScreen *m_screen;
+
+    g_return_if_fail(cursor != NULL);
+    r_enumeration_init_array(cursor, NULL, 0);
+
+    g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(screen != NULL);
+    g_return_if_fail(screen->type == RASTA_SCREEN_MENU);
+
+    m_screen = RASTA_MENU_SCREEN(screen);
+    if (m_screen->menu_items == NULL)
+        return;
+
+    r_enumeration_init_array(cursor, m_screen->menu_items->pdata,
+                             m_screen->menu_items->len);
+}  /* rasta_menu_screen_init_cursor() */
+
+
 /*
  * gchar *rasta_menu_item_get_text(RastaMenuItem *item)
  *
@@ -269,9 +342,7 @@ REnumeration *rasta_menu_screen_enumerate_items(RastaContext *ctxt,
  */
 gchar *rasta_menu_item_get_text(RastaMenuItem *item)
 {
-    g_return_val_if_fail(item != NULL, NULL);
-
-    return(g_strdup(item->text));
+    return(g_strdup(rasta_menu_item_peek_text(item)));
 }  /* rasta_menu_item_get_text() */
 
 
@@ -282,20 +353,63 @@ gchar *rasta_menu_item_get_text(RastaMenuItem *item)
  */
 gchar *rasta_menu_item_get_id(RastaMenuItem *item)
 {
-    g_return_val_if_fail(item != NULL, NULL);
-    
-    return(g_strdup(item->next_id));
+    return(g_strdup(rasta_menu_item_peek_id(item)));
 }  /* rasta_menu_item_get_id() */
 
 
 /*
  * gchar *rasta_menu_item_get_help(RastaMenuItem *item)
  *
- * Returns the id of the menu item
+ * Returns the help text of the menu item
  */
 gchar *rasta_menu_item_get_help(RastaMenuItem *item)
+{
+    return(g_strdup(rasta_menu_item_peek_help(item)));
+}  /* rasta_menu_item_get_help() */
+
+
+/*
+ * const gchar *rasta_menu_item_peek_text(RastaMenuItem *item)
+ *
+ * Returns the text of the menu item without copying it.  Menu items
+ * are kept for the life of the context.
+ */
+const gchar *rasta_menu_item_peek_text(RastaMenuItem *item)
+{
+    g_return_val_if_fail(item != NULL, NULL);
+
+    return(item->text);
+}  /* rasta_menu_item_peek_text() */
+
+
+/*
+ * const gchar *rasta_menu_item_peek_id(RastaMenuItem *item)
+ *
+ * Returns the id of the menu item without copying it.
+ */
+const gchar *rasta_menu_item_peek_id(RastaMenuItem *item)
 {
     g_return_val_if_fail(item != NULL, NULL);
     
-    return(g_strdup(item->help));
-}  /* rasta_menu_item_get_help() */
+    return(item->next_id);
+}  /* rasta_menu_item_peek_id() */
+
+
+/*
+ * const gchar *rasta_menu_item_peek_help(RastaMenuItem *item)
+ *
+ * Returns the help text of the menu item without copying it.  The
+ * text is read from the document on first use.
+ */
+const gchar *rasta_menu_item_peek_help(RastaMenuItem *item)
+{
+    g_return_val_if_fail(item != NULL, NULL);
+
+    if (item->help_node != NULL)
+    {
+        item->help = rasta_query_help(NULL, item->help_node);
+        item->help_node = NULL;
+    }
+    
+    return(item->help);
+}  /* rasta_menu_item_peek_help() */
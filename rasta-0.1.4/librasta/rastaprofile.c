@@ -0,0 +1,636 @@
+/*
+ * rastaprofile.c
+ *
+ * Code for collecting per-screen profile statistics
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastaprofile.h"
+#include "rastatrace.h"
+
+
+
+/*
+ * Defines
+ */
+#define PROFILE_TABLE_SIZE      256     /* Must be a power of two */
+#define PROFILE_MAGIC           "# rastaprof 1"
+#define PROFILE_DROPPED         "# dropped\t"
+#define PROFILE_FIELDS          (2 + (RASTA_PROFILE_KINDS * 5))
+#define PROFILE_LINE_MAX        4096
+#define PROFILE_TEMP_EXTENSION  ".tmp"
+#define PROFILE_LOCK_EXTENSION  ".lock"
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _RastaProfileCounter     RastaProfileCounter;
+typedef struct _RastaProfileEntry       RastaProfileEntry;
+
+
+
+/*
+ * Structures
+ */
+
+/*
+ * One kind of command run from a screen.  Times are in microseconds,
+ * the resolution of the clock.
+ */
+struct _RastaProfileCounter
+{
+    guint64 runs;
+    guint64 failures;
+    guint64 total_us;
+    guint64 max_us;
+    guint64 bytes;
+};
+
+/*
+ * A slot in the table.  Slots with a NULL screen_id are free.
+ */
+struct _RastaProfileEntry
+{
+    gchar *screen_id;
+    guint64 visits;
+    RastaProfileCounter counters[RASTA_PROFILE_KINDS];
+};
+
+
+
+/*
+ * Globals
+ */
+gboolean rasta_profiling = FALSE;
+
+/*
+ * The table is a fixed size and open addressed, so recording a
+ * sample never allocates except for the first sample of a screen.
+ * It is emptied by every flush.  When a new screen finds it full it
+ * is flushed early; if that fails the sample is counted in
+ * profile_dropped, which is written to the stats file with the rest.
+ */
+static RastaProfileEntry *profile_table = NULL;
+static gchar *profile_filename = NULL;
+static guint profile_interval = 0;
+static time_t profile_last_flush = 0;
+static guint64 profile_dropped = 0;
+
+
+
+/*
+ * Prototypes
+ */
+static RastaProfileEntry *profile_lookup(const gchar *screen_id);
+static RastaProfileEntry *profile_claim(const gchar *screen_id);
+static void profile_maybe_flush();
+static void profile_entry_free(gpointer data);
+static void profile_merge(GHashTable *merged,
+                          RastaProfileEntry *entry);
+static void profile_read(FILE *file, GHashTable *merged,
+                         guint64 *dropped);
+static void profile_collect(gpointer key, gpointer value,
+                            gpointer user_data);
+static gint profile_compare(gconstpointer a, gconstpointer b);
+static gint profile_write(FILE *file, GHashTable *merged,
+                          guint64 dropped);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static RastaProfileEntry *profile_lookup(const gchar *screen_id)
+ *
+ * Finds the slot for screen_id, claiming a free one if needed.
+ * Returns NULL if the table is full.
+ */
+static RastaProfileEntry *profile_lookup(const gchar *screen_id)
+{
+    guint i, slot;
+    RastaProfileEntry *entry;
+
+    slot = g_str_hash(screen_id) & (PROFILE_TABLE_SIZE - 1);
+    for (i = 0; i < PROFILE_TABLE_SIZE; i++)
+    {
+        entry = &profile_table[(slot + i) & (PROFILE_TABLE_SIZE - 1)];
+        if (entry->screen_id == NULL)
+        {
+            entry->screen_id = g_strdup(screen_id);
+            return(entry);
+        }
+        if (strcmp(entry->screen_id, screen_id) == 0)
+            return(entry);
+    }
+
+    return(NULL);
+}  /* profile_lookup() */
+
+
+/*
+ * static RastaProfileEntry *profile_claim(const gchar *screen_id)
+ *
+ * Like profile_lookup(), but if the table is full it is flushed and
+ * the lookup tried again.  Returns NULL, and counts the sample as
+ * dropped, only if the flush fails.
+ */
+static RastaProfileEntry *profile_claim(const gchar *screen_id)
+{
+    RastaProfileEntry *entry;
+
+    entry = profile_lookup(screen_id);
+    if ((entry == NULL) && (rasta_profile_flush() == 0))
+        entry = profile_lookup(screen_id);
+    if (entry == NULL)
+        profile_dropped++;
+
+    return(entry);
+}  /* profile_claim() */
+
+
+/*
+ * static void profile_maybe_flush()
+ *
+ * Flushes the table if the interval has passed.
+ */
+static void profile_maybe_flush()
+{
+    if (profile_interval == 0)
+        return;
+
+    if ((time(NULL) - profile_last_flush) >= (time_t)profile_interval)
+        rasta_profile_flush();
+}  /* profile_maybe_flush() */
+
+
+/*
+ * void rasta_profile_visit(const gchar *screen_id)
+ *
+ * Counts a visit to a screen.
+ */
+void rasta_profile_visit(const gchar *screen_id)
+{
+    RastaProfileEntry *entry;
+
+    if ((rasta_profiling == FALSE) || (screen_id == NULL))
+        return;
+
+    entry = profile_claim(screen_id);
+    if (entry != NULL)
+        entry->visits++;
+
+    profile_maybe_flush();
+}  /* rasta_profile_visit() */
+
+
+/*
+ * void rasta_profile_command(const gchar *screen_id,
+ *                            RastaProfileKind kind,
+ *                            guint64 duration_ns,
+ *                            gsize bytes,
+ *                            gboolean failed)
+ *
+ * Counts a command run from a screen.
+ */
+void rasta_profile_command(const gchar *screen_id,
+                           RastaProfileKind kind,
+                           guint64 duration_ns,
+                           gsize bytes,
+                           gboolean failed)
+{
+    RastaProfileEntry *entry;
+    RastaProfileCounter *counter;
+    guint64 duration_us;
+
+    if ((rasta_profiling == FALSE) || (screen_id == NULL) ||
+        (kind >= RASTA_PROFILE_KINDS))
+        return;
+
+    entry = profile_claim(screen_id);
+    if (entry != NULL)
+    {
+        duration_us = duration_ns / 1000;
+        counter = &entry->counters[kind];
+        counter->runs++;
+        if (failed != FALSE)
+            counter->failures++;
+        counter->total_us += duration_us;
+        if (duration_us > counter->max_us)
+            counter->max_us = duration_us;
+        counter->bytes += bytes;
+    }
+
+    profile_maybe_flush();
+}  /* rasta_profile_command() */
+
+
+/*
+ * static void profile_entry_free(gpointer data)
+ *
+ * Frees a RastaProfileEntry read from the stats file.
+ */
+static void profile_entry_free(gpointer data)
+{
+    RastaProfileEntry *entry;
+
+    entry = (RastaProfileEntry *)data;
+    g_free(entry->screen_id);
+    g_free(entry);
+}  /* profile_entry_free() */
+
+
+/*
+ * static void profile_merge(GHashTable *merged,
+ *                           RastaProfileEntry *entry)
+ *
+ * Adds entry into the matching entry of merged.
+ */
+static void profile_merge(GHashTable *merged,
+                          RastaProfileEntry *entry)
+{
+    gint i;
+    RastaProfileEntry *total;
+
+    total = g_hash_table_lookup(merged, entry->screen_id);
+    if (total == NULL)
+    {
+        total = g_new0(RastaProfileEntry, 1);
+        total->screen_id = g_strdup(entry->screen_id);
+        g_hash_table_insert(merged, total->screen_id, total);
+    }
+
+    total->visits += entry->visits;
+    for (i = 0; i < RASTA_PROFILE_KINDS; i++)
+    {
+        total->counters[i].runs += entry->counters[i].runs;
+        total->counters[i].failures += entry->counters[i].failures;
+        total->counters[i].total_us += entry->counters[i].total_us;
+        if (entry->counters[i].max_us > total->counters[i].max_us)
+            total->counters[i].max_us = entry->counters[i].max_us;
+        total->counters[i].bytes += entry->counters[i].bytes;
+    }
+}  /* profile_merge() */
+
+
+/*
+ * static void profile_read(FILE *file, GHashTable *merged,
+ *                          guint64 *dropped)
+ *
+ * Reads the stats file into merged, adding its count of dropped
+ * samples to dropped.  Lines that don't parse are dropped.
+ */
+static void profile_read(FILE *file, GHashTable *merged,
+                         guint64 *dropped)
+{
+    gint i;
+    gchar line[PROFILE_LINE_MAX];
+    gchar **fields;
+    RastaProfileEntry entry;
+
+    while (fgets(line, PROFILE_LINE_MAX, file) != NULL)
+    {
+        if (strncmp(line, PROFILE_DROPPED,
+                    strlen(PROFILE_DROPPED)) == 0)
+            *dropped += g_ascii_strtoull(line + strlen(PROFILE_DROPPED),
+                                         NULL, 10);
+        if (line[0] == '#')
+            continue;
+        g_strchomp(line);
+
+        fields = g_strsplit(line, "\t", 0);
+        for (i = 0; fields[i] != NULL; i++);
+        if ((i == PROFILE_FIELDS) && (fields[0][0] != '\0'))
+        {
+            entry.screen_id = fields[0];
+            entry.visits = g_ascii_strtoull(fields[1], NULL, 10);
+            for (i = 0; i < RASTA_PROFILE_KINDS; i++)
+            {
+                entry.counters[i].runs =
+                    g_ascii_strtoull(fields[2 + (i * 5)], NULL, 10);
+                entry.counters[i].failures =
+                    g_ascii_strtoull(fields[3 + (i * 5)], NULL, 10);
+                entry.counters[i].total_us =
+                    g_ascii_strtoull(fields[4 + (i * 5)], NULL, 10);
+                entry.counters[i].max_us =
+                    g_ascii_strtoull(fields[5 + (i * 5)], NULL, 10);
+                entry.counters[i].bytes =
+                    g_ascii_strtoull(fields[6 + (i * 5)], NULL, 10);
+            }
+            profile_merge(merged, &entry);
+        }
+        g_strfreev(fields);
+    }
+}  /* profile_read() */
+
+
+/*
+ * static void profile_collect(gpointer key, gpointer value,
+ *                             gpointer user_data)
+ *
+ * Hash table callback to put every entry into an array.
+ */
+static void profile_collect(gpointer key, gpointer value,
+                            gpointer user_data)
+{
+    g_ptr_array_add((GPtrArray *)user_data, value);
+}  /* profile_collect() */
+
+
+/*
+ * static gint profile_compare(gconstpointer a, gconstpointer b)
+ *
+ * Sorts entries by screen id.
+ */
+static gint profile_compare(gconstpointer a, gconstpointer b)
+{
+    const RastaProfileEntry *entry_a, *entry_b;
+
+    entry_a = *(const RastaProfileEntry **)a;
+    entry_b = *(const RastaProfileEntry **)b;
+
+    return(strcmp(entry_a->screen_id, entry_b->screen_id));
+}  /* profile_compare() */
+
+
+/*
+ * static gint profile_write(FILE *file, GHashTable *merged,
+ *                           guint64 dropped)
+ *
+ * Writes merged out as the stats file, one screen per line.  A
+ * nonzero dropped count goes in a comment line after the header, so
+ * older readers skip it.
+ */
+static gint profile_write(FILE *file, GHashTable *merged,
+                          guint64 dropped)
+{
+    guint i, j;
+    gchar host[256];
+    GPtrArray *entries;
+    RastaProfileEntry *entry;
+
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "unknown");
+    host[sizeof(host) - 1] = '\0';
+
+    fprintf(file, PROFILE_MAGIC " %s\n", host);
+    fprintf(file, "# screen\tvisits");
+    for (i = 0; i < RASTA_PROFILE_KINDS; i++)
+        fprintf(file, "\truns\tfailures\ttotal_us\tmax_us\tbytes");
+    fprintf(file, "\n");
+    if (dropped > 0)
+        fprintf(file, PROFILE_DROPPED "%" G_GUINT64_FORMAT "\n", dropped);
+
+    entries = g_ptr_array_new();
+    g_hash_table_foreach(merged, profile_collect, entries);
+    g_ptr_array_sort(entries, profile_compare);
+
+    for (i = 0; i < entries->len; i++)
+    {
+        entry = (RastaProfileEntry *)g_ptr_array_index(entries, i);
+        fprintf(file, "%s\t%" G_GUINT64_FORMAT,
+                entry->screen_id, entry->visits);
+        for (j = 0; j < RASTA_PROFILE_KINDS; j++)
+            fprintf(file,
+                    "\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT
+                    "\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT
+                    "\t%" G_GUINT64_FORMAT,
+                    entry->counters[j].runs,
+                    entry->counters[j].failures,
+                    entry->counters[j].total_us,
+                    entry->counters[j].max_us,
+                    entry->counters[j].bytes);
+        fprintf(file, "\n");
+    }
+    g_ptr_array_free(entries, TRUE);
+
+    if (fflush(file) != 0)
+        return(-errno);
+
+    return(0);
+}  /* profile_write() */
+
+
+/*
+ * gint rasta_profile_start(const gchar *filename,
+ *                          guint interval)
+ *
+ * Starts collecting visit counts and command times for each screen.
+ * The counts are added to the stats file filename every interval
+ * seconds (0 for never), by rasta_profile_flush(), and by
+ * rasta_profile_stop().  A NULL filename means RASTA_PROFILE_FILE
+ * in the user's home directory.  Several processes may share a
+ * stats file.  Use rastaprof(1) to read it.
+ *
+ * Returns 0 if successful, otherwise -ERROR.
+ */
+gint rasta_profile_start(const gchar *filename,
+                         guint interval)
+{
+    rasta_profile_stop();
+
+    profile_table = g_new0(RastaProfileEntry, PROFILE_TABLE_SIZE);
+    if (profile_table == NULL)
+        return(-ENOMEM);
+
+    if (filename != NULL)
+        profile_filename = g_strdup(filename);
+    else
+        profile_filename = g_build_filename(g_get_home_dir(),
+                                            RASTA_PROFILE_FILE,
+                                            NULL);
+    profile_interval = interval;
+    profile_last_flush = time(NULL);
+    rasta_profiling = TRUE;
+
+    return(0);
+}  /* rasta_profile_start() */
+
+
+/*
+ * gint rasta_profile_flush()
+ *
+ * Adds the counts collected since the last flush to the stats file
+ * and starts counting again from zero.  The merged counts are
+ * written to a temporary file next to the stats file and renamed
+ * over it, so rastaprof sees either the old or the new file, never
+ * a partial one.  Writers serialize on an fcntl() lock on a
+ * PROFILE_LOCK_EXTENSION file, as the stats file itself is replaced.
+ * Returns 0 if successful, otherwise -ERROR.  On error the counts
+ * are kept for the next flush.
+ */
+gint rasta_profile_flush()
+{
+    gint fd, rc, i;
+    FILE *file;
+    gchar *lock_name, *tmp_name;
+    struct flock lock;
+    GHashTable *merged;
+    guint64 dropped;
+
+    if (profile_table == NULL)
+        return(0);
+
+    profile_last_flush = time(NULL);
+
+    lock_name = g_strconcat(profile_filename, PROFILE_LOCK_EXTENSION,
+                            NULL);
+    fd = open(lock_name, O_RDWR | O_CREAT, 0644);
+    g_free(lock_name);
+    if (fd < 0)
+        return(-errno);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) < 0)
+    {
+        if (errno != EINTR)
+        {
+            rc = -errno;
+            close(fd);
+            return(rc);
+        }
+    }
+
+    merged = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   NULL, profile_entry_free);
+    rc = 0;
+    dropped = 0;
+    file = fopen(profile_filename, "r");
+    if (file != NULL)
+    {
+        profile_read(file, merged, &dropped);
+        fclose(file);
+    }
+    else if (errno != ENOENT)
+        rc = -errno;
+
+    tmp_name = g_strconcat(profile_filename, PROFILE_TEMP_EXTENSION,
+                           NULL);
+    if (rc == 0)
+    {
+        for (i = 0; i < PROFILE_TABLE_SIZE; i++)
+        {
+            if (profile_table[i].screen_id != NULL)
+                profile_merge(merged, &profile_table[i]);
+        }
+
+        file = fopen(tmp_name, "w");
+        if (file == NULL)
+            rc = -errno;
+        else
+        {
+            rc = profile_write(file, merged, dropped + profile_dropped);
+            if ((rc == 0) && (fsync(fileno(file)) != 0))
+                rc = -errno;
+            if ((fclose(file) != 0) && (rc == 0))
+                rc = -errno;
+            if ((rc == 0) && (rename(tmp_name, profile_filename) != 0))
+                rc = -errno;
+            if (rc != 0)
+                unlink(tmp_name);
+        }
+    }
+    g_free(tmp_name);
+    g_hash_table_destroy(merged);
+
+    /* Closing drops the lock */
+    close(fd);
+
+    if (rc == 0)
+    {
+        for (i = 0; i < PROFILE_TABLE_SIZE; i++)
+            g_free(profile_table[i].screen_id);
+        memset(profile_table, 0,
+               sizeof(RastaProfileEntry) * PROFILE_TABLE_SIZE);
+        profile_dropped = 0;
+    }
+
+    return(rc);
+}  /* rasta_profile_flush() */
+
+
+/*
+ * void rasta_profile_stop()
+ *
+ * Flushes the counts and stops collecting.
+ */
+void rasta_profile_stop()
+{
+    gint i;
+
+    if (profile_table == NULL)
+        return;
+
+    rasta_profile_flush();
+    rasta_profiling = FALSE;
+    rasta_trace_forget_children();
+
+    for (i = 0; i < PROFILE_TABLE_SIZE; i++)
+        g_free(profile_table[i].screen_id);
+    g_free(profile_table);
+    profile_table = NULL;
+    profile_dropped = 0;
+    g_free(profile_filename);
+    profile_filename = NULL;
+}  /* rasta_profile_stop() */
+
+
+/*
+ * void rasta_profile_action(RastaContext *ctxt, pid_t pid)
+ *
+ * Front ends start the command of an action screen themselves.
+ * They call this with the child's pid after starting it so that the
+ * command is counted against the current screen.  The child must
+ * have been started by rasta_exec_command_v() or
+ * rasta_exec_command_l().
+ */
+void rasta_profile_action(RastaContext *ctxt, pid_t pid)
+{
+    g_return_if_fail(ctxt != NULL);
+
+    if (rasta_profiling == FALSE)
+        return;
+
+    rasta_trace_child_set_screen(pid, rasta_trace_screen_id(ctxt),
+                                 RASTA_PROFILE_ACTION);
+}  /* rasta_profile_action() */
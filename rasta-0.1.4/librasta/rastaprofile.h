@@ -0,0 +1,72 @@
+/*
+ * rastaprofile.h
+ *
+ * Private header file for per-screen profiling.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+
+#ifndef _RASTA_PROFILE_H
+#define _RASTA_PROFILE_H
+
+
+
+/*
+ * Defines
+ */
+#define RASTA_PROFILING()       (rasta_profiling != FALSE)
+
+
+
+/*
+ * Enums
+ */
+typedef enum
+{
+    RASTA_PROFILE_INITCOMMAND,
+    RASTA_PROFILE_LISTCOMMAND,
+    RASTA_PROFILE_ACTION,
+    RASTA_PROFILE_OTHER         /* Not profiled */
+} RastaProfileKind;
+
+/* The number of kinds that are profiled */
+#define RASTA_PROFILE_KINDS     RASTA_PROFILE_OTHER
+
+
+
+/*
+ * Globals
+ */
+extern gboolean rasta_profiling;
+
+
+
+/*
+ * Prototypes
+ */
+void rasta_profile_visit(const gchar *screen_id);
+void rasta_profile_command(const gchar *screen_id,
+                           RastaProfileKind kind,
+                           guint64 duration_ns,
+                           gsize bytes,
+                           gboolean failed);
+
+#endif /* _RASTA_PROFILE_H */
@@ -0,0 +1,569 @@
+/*
+ * rastareload.c
+ *
+ * Description snapshots and reloading of watched descriptions
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastareload.h"
+#include "rastaprofile.h"
+#include "rastatrace.h"
+
+
+
+/*
+ * Defines
+ */
+#define RASTA_WATCH_DELAY       250     /* ms for writes to settle */
+#define RASTA_WATCH_BUFFER      4096
+#define RASTA_WATCH_CHUNK       8192    /* Bytes parsed per idle call */
+
+
+
+/*
+ * Typedefs
+ */
+typedef         struct _RastaWatch      RastaWatch;
+
+
+
+/*
+ * Structures
+ */
+struct _RastaWatch
+{
+    gchar *filename;
+    gchar *basename;            /* Name reported by inotify */
+    gint wd;                    /* Watch on the containing directory */
+    RastaSnapshot *current;     /* What new contexts start from */
+    guint reload_id;            /* Pending reload, 0 if none */
+    xmlParserCtxtPtr parser;    /* Reload being parsed, or NULL */
+    gint fd;                    /* File being parsed */
+    guint parse_id;             /* Idle source feeding parser */
+};
+
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+/*
+ * Prototypes
+ */
+static void rasta_watch_free(RastaWatch *watch);
+static void rasta_watch_cancel(RastaWatch *watch);
+static gboolean rasta_watch_reload(gpointer user_data);
+static gboolean rasta_watch_parse(gpointer user_data);
+static void rasta_watch_match(gpointer key,
+                              gpointer value,
+                              gpointer user_data);
+static gboolean rasta_watch_dispatch(GIOChannel *chan,
+                                     GIOCondition cond,
+                                     gpointer user_data);
+static void rasta_watch_uses_wd(gpointer key,
+                               gpointer value,
+                               gpointer user_data);
+
+
+
+/*
+ * Globals
+ */
+static GHashTable *watches = NULL;      /* filename -> RastaWatch */
+static gint inotify_fd = -1;
+static guint inotify_source = 0;
+#endif  /* HAVE_SYS_INOTIFY_H */
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * RastaSnapshot *rasta_snapshot_new(xmlDocPtr doc)
+ *
+ * Wraps a validated description document in a snapshot with one
+ * reference.  The snapshot owns doc from here on.
+ */
+RastaSnapshot *rasta_snapshot_new(xmlDocPtr doc)
+{
+    RastaSnapshot *snapshot;
+
+    g_return_val_if_fail(doc != NULL, NULL);
+
+    snapshot = g_new(RastaSnapshot, 1);
+    snapshot->ref_count = 1;
+    snapshot->doc = doc;
+    snapshot->live = NULL;
+    snapshot->live_names = NULL;
+    snapshot->menu_items = NULL;
+
+    return(snapshot);
+}  /* rasta_snapshot_new() */
+
+
+/*
+ * RastaSnapshot *rasta_snapshot_ref(RastaSnapshot *snapshot)
+ *
+ * Takes a reference on snapshot and returns it.
+ */
+RastaSnapshot *rasta_snapshot_ref(RastaSnapshot *snapshot)
+{
+    g_return_val_if_fail(snapshot != NULL, NULL);
+    g_return_val_if_fail(snapshot->ref_count > 0, NULL);
+
+    snapshot->ref_count++;
+
+    return(snapshot);
+}  /* rasta_snapshot_ref() */
+
+
+/*
+ * void rasta_snapshot_unref(RastaSnapshot *snapshot)
+ *
+ * Drops a reference on snapshot, freeing the document with the
+ * last one.
+ */
+void rasta_snapshot_unref(RastaSnapshot *snapshot)
+{
+    g_return_if_fail(snapshot != NULL);
+    g_return_if_fail(snapshot->ref_count > 0);
+
+    snapshot->ref_count--;
+    if (snapshot->ref_count > 0)
+        return;
+
+    if (snapshot->live != NULL)
+        g_hash_table_destroy(snapshot->live);
+    if (snapshot->live_names != NULL)
+        g_string_chunk_free(snapshot->live_names);
+    if (snapshot->menu_items != NULL)
+        g_hash_table_destroy(snapshot->menu_items);
+    xmlFreeDoc(snapshot->doc);
+    g_free(snapshot);
+}  /* rasta_snapshot_unref() */
+
+
+/*
+ * RastaSnapshot *rasta_watch_get_snapshot(const gchar *filename)
+ *
+ * Returns a new reference to the newest snapshot of filename, or
+ * NULL if filename isn't being watched.
+ */
+RastaSnapshot *rasta_watch_get_snapshot(const gchar *filename)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    RastaWatch *watch;
+
+    g_return_val_if_fail(filename != NULL, NULL);
+
+    if (watches == NULL)
+        return(NULL);
+
+    watch = (RastaWatch *)g_hash_table_lookup(watches, filename);
+    if (watch == NULL)
+        return(NULL);
+
+    return(rasta_snapshot_ref(watch->current));
+#else
+    return(NULL);
+#endif  /* HAVE_SYS_INOTIFY_H */
+}  /* rasta_watch_get_snapshot() */
+
+
+/*
+ * gint rasta_watch_description(const gchar *filename)
+ *
+ * Starts watching the description file filename.  Contexts later
+ * created on the same filename share its parsed document.  When the
+ * file changes, it is parsed again a chunk at a time from low
+ * priority idle calls in the default main loop, so the front end
+ * keeps running, and new contexts get the new copy once it has
+ * validated.  Contexts already running keep the
+ * copy they have until they back up to their initial screen.
+ *
+ * Returns 0, -ENOSYS if the system can't watch files, or -EINVAL if
+ * the file isn't a valid description.
+ */
+gint rasta_watch_description(const gchar *filename)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    gint rc;
+    gchar *dirname;
+    xmlDocPtr doc;
+    RastaWatch *watch;
+    GIOChannel *chan;
+
+    g_return_val_if_fail(filename != NULL, -EINVAL);
+
+    if (watches == NULL)
+        watches = g_hash_table_new(g_str_hash, g_str_equal);
+    else if (g_hash_table_lookup(watches, filename) != NULL)
+        return(0);
+
+    if (inotify_fd < 0)
+    {
+        inotify_fd = inotify_init();
+        if (inotify_fd < 0)
+            return(-errno);
+        fcntl(inotify_fd, F_SETFL, O_NONBLOCK);
+        fcntl(inotify_fd, F_SETFD, FD_CLOEXEC);
+
+        chan = g_io_channel_unix_new(inotify_fd);
+        inotify_source = g_io_add_watch(chan, G_IO_IN,
+                                        rasta_watch_dispatch, NULL);
+        g_io_channel_unref(chan);
+    }
+
+    doc = rasta_context_load_doc(filename);
+    if (doc == NULL)
+        return(-EINVAL);
+
+    watch = g_new0(RastaWatch, 1);
+    watch->fd = -1;
+    watch->filename = g_strdup(filename);
+    watch->basename = g_path_get_basename(filename);
+
+    /*
+     * Watch the directory, not the file.  rastaadd and rastadel
+     * rename a new file into place, which a watch on the old
+     * inode would never see.
+     */
+    dirname = g_path_get_dirname(filename);
+    watch->wd = inotify_add_watch(inotify_fd, dirname,
+                                  IN_CLOSE_WRITE | IN_MOVED_TO);
+    g_free(dirname);
+    if (watch->wd < 0)
+    {
+        rc = -errno;
+        xmlFreeDoc(doc);
+        rasta_watch_free(watch);
+        return(rc);
+    }
+
+    watch->current = rasta_snapshot_new(doc);
+    g_hash_table_insert(watches, watch->filename, watch);
+
+    return(0);
+#else
+    return(-ENOSYS);
+#endif  /* HAVE_SYS_INOTIFY_H */
+}  /* rasta_watch_description() */
+
+
+/*
+ * void rasta_unwatch_description(const gchar *filename)
+ *
+ * Stops watching filename.  Contexts sharing its document keep it
+ * until they are destroyed.
+ */
+void rasta_unwatch_description(const gchar *filename)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    gint wd_used[2];
+    RastaWatch *watch;
+
+    g_return_if_fail(filename != NULL);
+
+    if (watches == NULL)
+        return;
+
+    watch = (RastaWatch *)g_hash_table_lookup(watches, filename);
+    if (watch == NULL)
+        return;
+
+    g_hash_table_remove(watches, filename);
+
+    /* Other files in the same directory share the watch */
+    wd_used[0] = watch->wd;
+    wd_used[1] = FALSE;
+    g_hash_table_foreach(watches, rasta_watch_uses_wd, wd_used);
+    if (wd_used[1] == FALSE)
+        inotify_rm_watch(inotify_fd, watch->wd);
+    rasta_watch_free(watch);
+
+    if (g_hash_table_size(watches) == 0)
+    {
+        g_source_remove(inotify_source);
+        inotify_source = 0;
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+#endif  /* HAVE_SYS_INOTIFY_H */
+}  /* rasta_unwatch_description() */
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+/*
+ * static void rasta_watch_free(RastaWatch *watch)
+ *
+ * Frees a watch and drops its snapshot.
+ */
+static void rasta_watch_free(RastaWatch *watch)
+{
+    rasta_watch_cancel(watch);
+    if (watch->reload_id != 0)
+        g_source_remove(watch->reload_id);
+    if (watch->current != NULL)
+        rasta_snapshot_unref(watch->current);
+    g_free(watch->filename);
+    g_free(watch->basename);
+    g_free(watch);
+}  /* rasta_watch_free() */
+
+
+/*
+ * static void rasta_watch_cancel(RastaWatch *watch)
+ *
+ * Abandons a reload that is being parsed.
+ */
+static void rasta_watch_cancel(RastaWatch *watch)
+{
+    if (watch->parse_id != 0)
+    {
+        g_source_remove(watch->parse_id);
+        watch->parse_id = 0;
+    }
+    if (watch->parser != NULL)
+    {
+        if (watch->parser->myDoc != NULL)
+            xmlFreeDoc(watch->parser->myDoc);
+        xmlFreeParserCtxt(watch->parser);
+        watch->parser = NULL;
+    }
+    if (watch->fd > -1)
+    {
+        close(watch->fd);
+        watch->fd = -1;
+    }
+}  /* rasta_watch_cancel() */
+
+
+/*
+ * static gboolean rasta_watch_reload(gpointer user_data)
+ *
+ * Starts parsing a changed description.  The file is fed to a push
+ * parser by rasta_watch_parse(), so a large description never
+ * holds up the main loop for the whole parse.
+ */
+static gboolean rasta_watch_reload(gpointer user_data)
+{
+    RastaWatch *watch;
+
+    watch = (RastaWatch *)user_data;
+    watch->reload_id = 0;
+
+    rasta_watch_cancel(watch);
+
+    watch->fd = open(watch->filename, O_RDONLY);
+    if (watch->fd < 0)
+        return(FALSE);
+    fcntl(watch->fd, F_SETFD, FD_CLOEXEC);
+
+    watch->parser = xmlCreatePushParserCtxt(NULL, NULL, NULL, 0,
+                                            watch->filename);
+    if (watch->parser == NULL)
+    {
+        rasta_watch_cancel(watch);
+        return(FALSE);
+    }
+
+    watch->parse_id = g_idle_add_full(G_PRIORITY_LOW,
+                                      rasta_watch_parse, watch, NULL);
+
+    return(FALSE);
+}  /* rasta_watch_reload() */
+
+
+/*
+ * static gboolean rasta_watch_parse(gpointer user_data)
+ *
+ * Parses the next chunk of a changed description.  At the end of
+ * the file the document is validated and only then made current.
+ * The old snapshot lives on in whatever contexts still hold it.  A
+ * file that doesn't parse or validate is ignored; the next change
+ * to it will be tried again.
+ */
+static gboolean rasta_watch_parse(gpointer user_data)
+{
+    gint rc;
+    ssize_t len;
+    guint64 start;
+    gboolean well_formed;
+    gchar buf[RASTA_WATCH_CHUNK];
+    xmlDocPtr doc;
+    RastaWatch *watch;
+
+    watch = (RastaWatch *)user_data;
+
+    len = read(watch->fd, buf, sizeof(buf));
+    if (len < 0)
+    {
+        if (errno == EINTR)
+            return(TRUE);
+        watch->parse_id = 0;
+        rasta_watch_cancel(watch);
+        return(FALSE);
+    }
+
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
+    rc = xmlParseChunk(watch->parser, buf, len, (len == 0) ? 1 : 0);
+    if (start != 0)
+        rasta_trace_emit(RASTA_TRACE_PARSE, NULL, watch->filename,
+                         start, len, 0);
+    if (rc != 0)
+    {
+        watch->parse_id = 0;
+        rasta_watch_cancel(watch);
+        return(FALSE);
+    }
+    if (len > 0)
+        return(TRUE);
+
+    /* The whole file is in */
+    watch->parse_id = 0;
+    doc = watch->parser->myDoc;
+    well_formed = watch->parser->wellFormed;
+    watch->parser->myDoc = NULL;
+    rasta_watch_cancel(watch);
+
+    if (doc == NULL)
+        return(FALSE);
+    if (well_formed == FALSE)
+    {
+        xmlFreeDoc(doc);
+        return(FALSE);
+    }
+
+    doc = rasta_context_check_doc(doc);
+    if (doc == NULL)
+        return(FALSE);
+
+    rasta_snapshot_unref(watch->current);
+    watch->current = rasta_snapshot_new(doc);
+
+    return(FALSE);
+}  /* rasta_watch_parse() */
+
+
+/*
+ * static void rasta_watch_match(gpointer key,
+ *                               gpointer value,
+ *                               gpointer user_data)
+ *
+ * Schedules a reload of the watch in value if the inotify event in
+ * user_data is about its file.  Bursts of events are folded into
+ * one reload.
+ */
+static void rasta_watch_match(gpointer key,
+                              gpointer value,
+                              gpointer user_data)
+{
+    RastaWatch *watch;
+    struct inotify_event *event;
+
+    watch = (RastaWatch *)value;
+    event = (struct inotify_event *)user_data;
+
+    if (!(event->mask & IN_Q_OVERFLOW))
+    {
+        if ((event->wd != watch->wd) || (event->len == 0) ||
+            (strcmp(event->name, watch->basename) != 0))
+            return;
+    }
+
+    /* A parse of the file as it was is no longer wanted */
+    rasta_watch_cancel(watch);
+    if (watch->reload_id != 0)
+        g_source_remove(watch->reload_id);
+    watch->reload_id = g_timeout_add(RASTA_WATCH_DELAY,
+                                     rasta_watch_reload, watch);
+}  /* rasta_watch_match() */
+
+
+/*
+ * static gboolean rasta_watch_dispatch(GIOChannel *chan,
+ *                                      GIOCondition cond,
+ *                                      gpointer user_data)
+ *
+ * Reads pending inotify events.
+ */
+static gboolean rasta_watch_dispatch(GIOChannel *chan,
+                                     GIOCondition cond,
+                                     gpointer user_data)
+{
+    ssize_t len, offset;
+    struct inotify_event *event;
+    union
+    {
+        struct inotify_event align;
+        gchar buf[RASTA_WATCH_BUFFER];
+    } events;
+
+    while ((len = read(inotify_fd, events.buf, sizeof(events.buf))) > 0)
+    {
+        for (offset = 0; offset < len;
+             offset += sizeof(struct inotify_event) + event->len)
+        {
+            event = (struct inotify_event *)(events.buf + offset);
+            g_hash_table_foreach(watches, rasta_watch_match, event);
+        }
+    }
+
+    return(TRUE);
+}  /* rasta_watch_dispatch() */
+
+
+/*
+ * static void rasta_watch_uses_wd(gpointer key,
+ *                                 gpointer value,
+ *                                 gpointer user_data)
+ *
+ * Sets the second element of the gint array in user_data if the
+ * watch in value is on the directory watch in the first.
+ */
+static void rasta_watch_uses_wd(gpointer key,
+                               gpointer value,
+                               gpointer user_data)
+{
+    gint *wd_used;
+
+    wd_used = (gint *)user_data;
+    if (((RastaWatch *)value)->wd == wd_used[0])
+        wd_used[1] = TRUE;
+}  /* rasta_watch_uses_wd() */
+#endif  /* HAVE_SYS_INOTIFY_H */
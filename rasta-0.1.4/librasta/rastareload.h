@@ -0,0 +1,65 @@
+/*
+ * rastareload.h
+ *
+ * Header file for description snapshots and reloading
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+
+#ifndef __RASTA_RELOAD_H
+#define __RASTA_RELOAD_H
+
+/*
+ * Typedefs
+ */
+typedef         struct _RastaSnapshot   RastaSnapshot;
+
+
+
+/*
+ * Structures
+ */
+
+/*
+ * A parsed description document shared by every context using it.
+ * The document is freed when the last reference goes away, so a
+ * reload never pulls a document out from under a running context.
+ */
+struct _RastaSnapshot
+{
+    gint ref_count;
+    xmlDocPtr doc;
+    GHashTable *live;           /* Path node -> live symbols, built lazily */
+    GStringChunk *live_names;   /* Storage for the names in live */
+    GHashTable *menu_items;     /* Path node -> menu items, built lazily */
+};
+
+
+
+/*
+ * Prototypes
+ */
+RastaSnapshot *rasta_snapshot_new(xmlDocPtr doc);
+RastaSnapshot *rasta_snapshot_ref(RastaSnapshot *snapshot);
+void rasta_snapshot_unref(RastaSnapshot *snapshot);
+RastaSnapshot *rasta_watch_get_snapshot(const gchar *filename);
+
+#endif  /* __RASTA_RELOAD_H */
@@ -55,9 +55,6 @@ struct _RastaScope
  */
 static RastaScope *rasta_scope_new(xmlNodePtr node);
 static void rasta_scope_free(RastaScope *scope);
-static void rasta_scope_build_symbol_xml(gpointer key,
-                                         gpointer value,
-                                         gpointer user_data);
 
 
 
@@ -187,6 +184,24 @@ void rasta_scope_pop(RastaContext *ctxt)
 }  /* rasta_scope_pop() */
 
 
+/*
+ * void rasta_scope_clear(RastaContext *ctxt)
+ *
+ * Frees every scope on the stack, the initial one included
+ */
+void rasta_scope_clear(RastaContext *ctxt)
+{
+    GList *elem;
+
+    g_return_if_fail(ctxt != NULL);
+
+    for (elem = ctxt->scopes; elem != NULL; elem = g_list_next(elem))
+        rasta_scope_free(RASTA_SCOPE(elem->data));
+    g_list_free(ctxt->scopes);
+    ctxt->scopes = NULL;
+}  /* rasta_scope_clear() */
+
+
 /*
  * RastaScope *rasta_scope_get_current(RastaContext *ctxt)
  *
@@ -208,12 +223,24 @@ RastaScope *rasta_scope_get_current(RastaContext *ctxt)
  */
 gchar *rasta_scope_get_id(RastaScope *scope)
 {
-    g_return_val_if_fail(scope != NULL, NULL);
-    
-    return(g_strdup(scope->id));
+    return(g_strdup(rasta_scope_peek_id(scope)));
 }  /* rasta_scope_get_id() */
 
 
+/*
+ * const gchar *rasta_scope_peek_id(RastaScope *scope)
+ *
+ * Returns the id of the passed scope without copying it.  The
+ * string is valid as long as the scope is on the stack.
+ */
+const gchar *rasta_scope_peek_id(RastaScope *scope)
+{
+    g_return_val_if_fail(scope != NULL, NULL);
+
+    return(scope->id);
+}  /* rasta_scope_peek_id() */
+
+
 /*
  * RastaScreen *rasta_scope_get_screen(RastaScope *scope)
  *
@@ -333,78 +360,20 @@ gchar *rasta_symbol_lookup(RastaContext *ctxt,
 }  /* rasta_symbol_lookup() */
 
 
-/* static void rasta_scope_build_symbol_xml(gpointer key,
- *                                          gpointer value,
- *                                          gpointer user_data)
- *
- * Builds the XML for one scope's symbols.
- */
-static void rasta_scope_build_symbol_xml(gpointer key,
-                                         gpointer value,
-                                         gpointer user_data)
-{
-    xmlNodePtr node, cur;
-
-    g_return_if_fail(key != NULL);
-    g_return_if_fail(user_data != NULL);
-
-    cur = (xmlNodePtr)user_data;
-    node = xmlNewNode(NULL, "SYMBOL");
-    if (node == NULL)
-        return;
-
-    xmlSetProp(node, "NAME", (gchar *)key);
-    xmlSetProp(node, "VALUE", (gchar *)(value ? value : ""));
-
-    xmlAddChild(cur, node);
-}  /* rasta_scope_build_symbol_xml() */
-
-
 /*
- * gint rasta_scope_add_state_xml(RastaContext *ctxt,
- *                                xmlDocPtr doc)
+ * void rasta_scope_foreach_symbol(RastaScope *scope,
+ *                                 GHFunc func,
+ *                                 gpointer user_data)
  *
- * Adds XML data for the scopes to doc
+ * Calls func for each symbol of this scope alone, with the name
+ * as key and the value as value.
  */
-gint rasta_scope_add_state_xml(RastaContext *ctxt,
-                               xmlDocPtr doc)
+void rasta_scope_foreach_symbol(RastaScope *scope,
+                                GHFunc func,
+                                gpointer user_data)
 {
-    xmlNodePtr par, cur;
-    RastaScope *scope;
-    GList *elem;
-
-    g_return_val_if_fail(ctxt != NULL, -EINVAL);
-    g_return_val_if_fail(ctxt->scopes != NULL, -EINVAL);
-    g_return_val_if_fail(doc != NULL, -EINVAL);
-
-    par = xmlDocGetRootElement(doc);
-    g_return_val_if_fail(par != NULL, -EINVAL);
-
-    elem = ctxt->scopes;
-    while(elem->next != NULL)
-        elem = g_list_next(elem);
-    
-    while (elem != NULL)
-    {
-        scope = (RastaScope *)elem->data;
-        g_assert(scope != NULL);
-
-        cur = xmlNewNode(NULL, "SCOPE");
-        if (cur == NULL)
-            return(-ENOMEM);
-
-        xmlSetProp(cur, "NAME", scope->id);
-        xmlAddChild(par, cur);
-
-        g_hash_table_foreach(scope->symbols,
-                             rasta_scope_build_symbol_xml,
-                             cur);
-
-        par = cur;
-        elem = g_list_previous(elem);
-    }
-
-    return(0);
-}  /* rasta_scope_add_state_xml() */
-
+    g_return_if_fail(scope != NULL);
+    g_return_if_fail(func != NULL);
 
+    g_hash_table_foreach(scope->symbols, func, user_data);
+}  /* rasta_scope_foreach_symbol() */
@@ -47,15 +47,18 @@ typedef         struct _RastaScope      RastaScope;
 void rasta_scope_push(RastaContext *ctxt, xmlNodePtr node);
 gboolean rasta_scope_is_top(RastaContext *ctxt);
 void rasta_scope_pop(RastaContext *ctxt);
+void rasta_scope_clear(RastaContext *ctxt);
 RastaScope *rasta_scope_get_current(RastaContext *ctxt);
 gchar *rasta_scope_get_id(RastaScope *scope);
+const gchar *rasta_scope_peek_id(RastaScope *scope);
 RastaScreen *rasta_scope_get_screen(RastaScope *scope);
 void rasta_scope_set_screen(RastaScope *scope,
                             RastaScreen *screen);
 xmlNodePtr rasta_scope_get_path_node(RastaScope *scope);
 void rasta_scope_set_path_node(RastaScope *scope,
                                xmlNodePtr node);
-gint rasta_scope_add_state_xml(RastaContext *ctxt,
-                               xmlDocPtr doc);
+void rasta_scope_foreach_symbol(RastaScope *scope,
+                                GHFunc func,
+                                gpointer user_data);
 
 #endif  /* __RASTA_SCOPE_H */
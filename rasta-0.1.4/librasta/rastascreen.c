@@ -39,6 +39,8 @@
 #include "rastaaction.h"
 #include "rastatraverse.h"
 #include "rastascope.h"
+#include "rastaprofile.h"
+#include "rastatrace.h"
 
 
 
@@ -53,7 +55,9 @@ static void rasta_screen_init(RastaContext *ctxt,
 static RastaScreen *rasta_screen_cache_lookup(RastaContext *ctxt,
                                               const gchar *id);
 static void rasta_screen_cache_put(RastaContext *ctxt,
+                                   const gchar *id,
                                    RastaScreen *screen);
+static void rasta_screen_free(gpointer data);
 
 
 /*
@@ -80,6 +84,18 @@ RastaScreenType rasta_screen_get_type(RastaScreen *screen)
  * Returns the title of the given screen
  */
 gchar *rasta_screen_get_title(RastaScreen *screen)
+{
+    return(g_strdup(rasta_screen_peek_title(screen)));
+}  /* rasta_screen_get_title() */
+
+
+/*
+ * const gchar *rasta_screen_peek_title(RastaScreen *screen)
+ *
+ * Returns the title of the given screen without copying it.  The
+ * string belongs to the screen and must not be freed.
+ */
+const gchar *rasta_screen_peek_title(RastaScreen *screen)
 {
     RastaAnyScreen *any;
 
@@ -87,14 +103,15 @@ gchar *rasta_screen_get_title(RastaScreen *screen)
 
     any = RASTA_ANY_SCREEN(screen);
 
-    return(g_strdup(any->title));
-}  /* rasta_screen_get_title() */
+    return(any->title);
+}  /* rasta_screen_peek_title() */
 
 
 /*
  * void rasta_screen_previous(RastaContext *ctxt)
  *
- * Backs up to the previous screen
+ * Backs up to the previous screen.  Scopes restored directly from
+ * a saved state get their screen loaded here, on the way back.
  */
 void rasta_screen_previous(RastaContext *ctxt)
 {
@@ -106,9 +123,20 @@ void rasta_screen_previous(RastaContext *ctxt)
         rasta_scope_pop(ctxt);
         scope = rasta_scope_get_current(ctxt);
         screen = rasta_scope_get_screen(scope);
+        if (screen == NULL)
+        {
+            screen = rasta_screen_load(ctxt, rasta_scope_peek_id(scope));
+            if (screen == NULL)
+                return;
+            rasta_scope_set_screen(scope, screen);
+        }
     }
     while (screen->type == RASTA_SCREEN_HIDDEN);
 
+    /* Back at the start, a reloaded description can take over */
+    if (rasta_scope_is_top(ctxt) && rasta_context_reload(ctxt))
+        return;
+
     /* Clear any initcommand the old screen wanted */
     if (ctxt->state == RASTA_CONTEXT_INITCOMMAND)
         ctxt->state = RASTA_CONTEXT_SCREEN;
@@ -130,17 +158,19 @@ void rasta_screen_prepare(RastaContext *ctxt)
 {
     RastaScope *scope;
     RastaScreen *screen;
-    gchar *id;
+    const gchar *id;
     
     g_return_if_fail(ctxt != NULL);
 
     scope = rasta_scope_get_current(ctxt);
-    id = rasta_scope_get_id(scope);
+    id = rasta_scope_peek_id(scope);
     if (id == NULL)  /* Invalid scope */
         return;
 
+    if (RASTA_PROFILING())
+        rasta_profile_visit(id);
+
     screen = rasta_screen_load(ctxt, id);
-    g_free(id);
     rasta_scope_set_screen(scope, screen);
     rasta_screen_init(ctxt, screen);
 }  /* rasta_screen_prepare() */
@@ -158,6 +188,7 @@ static RastaScreen *rasta_screen_load(RastaContext *ctxt,
 {
     RastaScreen *screen;
     xmlNodePtr screen_node;
+    guint64 start;
 
     g_return_val_if_fail(ctxt != NULL, NULL);
     g_return_val_if_fail(id != NULL, NULL);
@@ -167,6 +198,9 @@ static RastaScreen *rasta_screen_load(RastaContext *ctxt,
     if (screen != NULL)
         return(screen);
 
+    /* Only cache misses are worth a trace event */
+    start = RASTA_TRACING() ? rasta_trace_now() : 0;
+
     screen_node = rasta_find_screen(ctxt, id);
     if (screen_node == NULL)
         return(NULL);
@@ -198,7 +232,8 @@ static RastaScreen *rasta_screen_load(RastaContext *ctxt,
     else
         screen->type = RASTA_SCREEN_NONE;
 
-    rasta_screen_cache_put(ctxt, screen);
+    rasta_screen_cache_put(ctxt, id, screen);
+    rasta_trace_emit(RASTA_TRACE_SCREEN_LOAD, id, NULL, start, 0, 0);
 
     return(screen);
 }  /* rasta_screen_load() */
@@ -254,33 +289,70 @@ static RastaScreen *rasta_screen_cache_lookup(RastaContext *ctxt,
 
 /*
  * static void rasta_screen_cache_put(RastaContext *ctxt,
+ *                                    const gchar *id,
  *                                    RastaScreen *screen)
  *
- * Inserts a screen cache entry
+ * Inserts a screen cache entry.  Entries are keyed by screen id, the
+ * same key rasta_screen_cache_lookup() uses.
  */
 static void rasta_screen_cache_put(RastaContext *ctxt,
+                                   const gchar *id,
                                    RastaScreen *screen)
 {
-    gchar *id;
-    RastaAnyScreen *any;
+    gchar *key;
 
     g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(id != NULL);
     g_return_if_fail(screen != NULL);
 
-    any = RASTA_ANY_SCREEN(screen);
-
-    id = g_strdup(any->title);
+    key = g_strdup(id);
 
     if (ctxt->screen_cache == NULL)
     {
-        ctxt->screen_cache = g_hash_table_new(g_str_hash, g_str_equal);
+        ctxt->screen_cache = g_hash_table_new_full(g_str_hash,
+                                                   g_str_equal,
+                                                   g_free,
+                                                   rasta_screen_free);
         if (ctxt->screen_cache == NULL)
         {
-            g_free(id);
+            g_free(key);
             return;
         }
     }
 
-    g_hash_table_insert(ctxt->screen_cache, id, screen);
+    g_hash_table_insert(ctxt->screen_cache, key, screen);
 }  /* rasta_screen_cache_put() */
 
+
+/*
+ * static void rasta_screen_free(gpointer data)
+ *
+ * Frees a screen loaded by rasta_screen_load().  This is the screen
+ * cache's value destructor, as the cache owns every loaded screen.
+ */
+static void rasta_screen_free(gpointer data)
+{
+    RastaScreen *screen;
+
+    screen = RASTA_SCREEN(data);
+    g_return_if_fail(screen != NULL);
+
+    if (screen->type == RASTA_SCREEN_DIALOG)
+        rasta_dialog_screen_free(screen);
+    else if (screen->type == RASTA_SCREEN_HIDDEN)
+    {
+        g_free(screen->hidden.init_command);
+        g_free(screen->hidden.encoding);
+    }
+    else if (screen->type == RASTA_SCREEN_ACTION)
+    {
+        g_free(screen->action.command);
+        g_free(screen->action.encoding);
+    }
+    /* A menu's items belong to the menu cache */
+
+    g_free(screen->any.title);
+    g_free(screen->any.help);
+    g_free(screen);
+}  /* rasta_screen_free() */
+
@@ -56,7 +56,7 @@ struct _RastaMenuScreen
     RastaScreenType type;
     gchar *title;
     gchar *help;
-    GList *menu_items;
+    GPtrArray *menu_items;     /* Borrowed from the snapshot */
 };
 
 struct _RastaDialogScreen
@@ -64,7 +64,7 @@ struct _RastaDialogScreen
     RastaScreenType type;
     gchar *title;
     gchar *help;
-    GList *fields;
+    GPtrArray *fields;
     gchar *init_command;
     RastaEscapeStyleType escape_style;
     gchar *encoding;
@@ -0,0 +1,618 @@
+/*
+ * rastastate.c
+ *
+ * Writing saved states without a DOM, and reading binary states.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+/*
+ * The binary encoding is a 12 byte header followed by records.  The
+ * header is RASTA_STATE_MAGIC, the format version and a flags word
+ * (currently 0), both 32 bit big-endian.  Each record is a one byte
+ * tag:
+ *
+ *   'S' <name> <steps>   Enter the named scope
+ *   'Y' <name> <value>   A symbol of the current scope
+ *   'E'                  End of state
+ *
+ * Strings are a 32 bit big-endian length followed by that many bytes
+ * of UTF-8, with no terminator.  Scopes nest in the order they
+ * appear, the first being the initial screen, just like the SCOPE
+ * elements of a RASTASTATE document.  <steps> is a 32 bit count and
+ * that many 32 bit steps from rasta_traverse_steps(), locating the
+ * scope's path node from the one before.  Version 1 had no steps.
+ */
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastascope.h"
+#include "rastatraverse.h"
+#include "rastalive.h"
+#include "rastastate.h"
+
+
+
+/*
+ * Defines
+ */
+#define RASTA_STATE_HEADER_LEN  12
+#define RASTA_STATE_FLUSH       8192    /* Bytes buffered before write() */
+
+
+
+/*
+ * Prototypes
+ */
+static void state_put_uint32(GString *buf, guint32 val);
+static guint32 state_get_uint32(const guchar *ptr);
+static void state_put_string(GString *buf, const gchar *str);
+static const guchar *state_get_string(const guchar *ptr,
+                                      const guchar *end,
+                                      GString *str);
+static void state_put_escaped(GString *buf, const gchar *str);
+static void state_maybe_flush(RastaStateWriter *writer, gsize limit);
+static void state_write_symbol_func(gpointer key,
+                                    gpointer value,
+                                    gpointer user_data);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static void state_put_uint32(GString *buf, guint32 val)
+ *
+ * Appends val to buf, big-endian.
+ */
+static void state_put_uint32(GString *buf, guint32 val)
+{
+    gchar bytes[4];
+
+    bytes[0] = (val >> 24) & 0xFF;
+    bytes[1] = (val >> 16) & 0xFF;
+    bytes[2] = (val >> 8) & 0xFF;
+    bytes[3] = val & 0xFF;
+    g_string_append_len(buf, bytes, 4);
+}  /* state_put_uint32() */
+
+
+/*
+ * static guint32 state_get_uint32(const guchar *ptr)
+ *
+ * Reads a big-endian value from ptr.
+ */
+static guint32 state_get_uint32(const guchar *ptr)
+{
+    return(((guint32)ptr[0] << 24) | ((guint32)ptr[1] << 16) |
+           ((guint32)ptr[2] << 8) | (guint32)ptr[3]);
+}  /* state_get_uint32() */
+
+
+/*
+ * static void state_put_string(GString *buf, const gchar *str)
+ *
+ * Appends a length-prefixed string.  NULL is written as "".
+ */
+static void state_put_string(GString *buf, const gchar *str)
+{
+    gsize len;
+
+    len = (str != NULL) ? strlen(str) : 0;
+    state_put_uint32(buf, len);
+    g_string_append_len(buf, str, len);
+}  /* state_put_string() */
+
+
+/*
+ * static const guchar *state_get_string(const guchar *ptr,
+ *                                       const guchar *end,
+ *                                       GString *str)
+ *
+ * Reads a length-prefixed string at ptr into str.  Returns the
+ * position after it, or NULL if it overruns end or isn't UTF-8.
+ */
+static const guchar *state_get_string(const guchar *ptr,
+                                      const guchar *end,
+                                      GString *str)
+{
+    guint32 len;
+
+    if ((end - ptr) < 4)
+        return(NULL);
+    len = state_get_uint32(ptr);
+    ptr += 4;
+    if ((guint32)(end - ptr) < len)
+        return(NULL);
+
+    g_string_truncate(str, 0);
+    g_string_append_len(str, (const gchar *)ptr, len);
+    if (g_utf8_validate(str->str, str->len, NULL) == FALSE)
+        return(NULL);
+
+    return(ptr + len);
+}  /* state_get_string() */
+
+
+/*
+ * static void state_put_escaped(GString *buf, const gchar *str)
+ *
+ * Appends str as an XML attribute value.  Whitespace other than
+ * spaces is written as character references so that attribute
+ * normalization doesn't eat newlines in symbol values.
+ */
+static void state_put_escaped(GString *buf, const gchar *str)
+{
+    const gchar *ptr, *run;
+
+    if (str == NULL)
+        return;
+
+    run = str;
+    for (ptr = str; *ptr != '\0'; ptr++)
+    {
+        switch (*ptr)
+        {
+            case '&':
+            case '<':
+            case '>':
+            case '"':
+            case '\n':
+            case '\r':
+            case '\t':
+                break;
+
+            default:
+                continue;
+        }
+
+        g_string_append_len(buf, run, ptr - run);
+        run = ptr + 1;
+        switch (*ptr)
+        {
+            case '&':
+                g_string_append(buf, "&amp;");
+                break;
+            case '<':
+                g_string_append(buf, "&lt;");
+                break;
+            case '>':
+                g_string_append(buf, "&gt;");
+                break;
+            case '"':
+                g_string_append(buf, "&quot;");
+                break;
+            case '\n':
+                g_string_append(buf, "&#10;");
+                break;
+            case '\r':
+                g_string_append(buf, "&#13;");
+                break;
+            case '\t':
+                g_string_append(buf, "&#9;");
+                break;
+        }
+    }
+    g_string_append_len(buf, run, ptr - run);
+}  /* state_put_escaped() */
+
+
+/*
+ * static void state_maybe_flush(RastaStateWriter *writer, gsize limit)
+ *
+ * Writes the pending output to the writer's fd once it reaches
+ * limit bytes.  Memory writers keep everything.
+ */
+static void state_maybe_flush(RastaStateWriter *writer, gsize limit)
+{
+    gsize off;
+    gssize rc;
+
+    if ((writer->fd < 0) || (writer->buf->len < limit))
+        return;
+
+    off = 0;
+    while ((off < writer->buf->len) && (writer->rc == 0))
+    {
+        rc = write(writer->fd, writer->buf->str + off,
+                   writer->buf->len - off);
+        if (rc < 0)
+        {
+            if (errno != EINTR)
+                writer->rc = -errno;
+        }
+        else
+            off += rc;
+    }
+    g_string_truncate(writer->buf, 0);
+}  /* state_maybe_flush() */
+
+
+/*
+ * void rasta_state_writer_init(RastaStateWriter *writer,
+ *                              gint fd,
+ *                              RastaStateFlags flags)
+ *
+ * Starts a state on fd, or in memory if fd is -1, and writes the
+ * header.
+ */
+void rasta_state_writer_init(RastaStateWriter *writer,
+                             gint fd,
+                             RastaStateFlags flags)
+{
+    g_return_if_fail(writer != NULL);
+
+    writer->buf = g_string_sized_new(RASTA_STATE_FLUSH);
+    writer->fd = fd;
+    writer->flags = flags;
+    writer->depth = 0;
+    writer->rc = 0;
+    writer->live = NULL;
+
+    if (flags & RASTA_STATE_BINARY)
+    {
+        g_string_append_len(writer->buf, RASTA_STATE_MAGIC,
+                            RASTA_STATE_MAGIC_LEN);
+        state_put_uint32(writer->buf, RASTA_STATE_VERSION);
+        state_put_uint32(writer->buf, 0);
+    }
+    else
+    {
+        g_string_append(writer->buf,
+                        "<?xml version=\"1.0\"?>\n"
+                        "<!DOCTYPE RASTASTATE SYSTEM \"file://"
+                        _RASTA_DATA_DIR G_DIR_SEPARATOR_S RASTASTATE_DTD
+                        "\">\n"
+                        "<RASTASTATE xmlns=\"" RASTA_NAMESPACE "\">");
+    }
+}  /* rasta_state_writer_init() */
+
+
+/*
+ * void rasta_state_write_scope(RastaStateWriter *writer,
+ *                              const gchar *name,
+ *                              const guint *steps,
+ *                              guint n_steps)
+ *
+ * Opens a scope inside the current one.  steps locate its path
+ * node from the enclosing scope's; there are none for the first
+ * scope, or when they couldn't be worked out.
+ */
+void rasta_state_write_scope(RastaStateWriter *writer,
+                             const gchar *name,
+                             const guint *steps,
+                             guint n_steps)
+{
+    guint i;
+
+    g_return_if_fail(writer != NULL);
+    g_return_if_fail(name != NULL);
+    g_return_if_fail((n_steps == 0) || (steps != NULL));
+
+    if (writer->flags & RASTA_STATE_BINARY)
+    {
+        g_string_append_c(writer->buf, 'S');
+        state_put_string(writer->buf, name);
+        state_put_uint32(writer->buf, n_steps);
+        for (i = 0; i < n_steps; i++)
+            state_put_uint32(writer->buf, steps[i]);
+    }
+    else
+    {
+        g_string_append(writer->buf, "<SCOPE NAME=\"");
+        state_put_escaped(writer->buf, name);
+        if (n_steps > 0)
+        {
+            g_string_append(writer->buf, "\" PATH=\"");
+            for (i = 0; i < n_steps; i++)
+            {
+                g_string_append_printf(writer->buf, i ? " %u" : "%u",
+                                       steps[i]);
+            }
+        }
+        g_string_append(writer->buf, "\">");
+    }
+    writer->depth++;
+
+    state_maybe_flush(writer, RASTA_STATE_FLUSH);
+}  /* rasta_state_write_scope() */
+
+
+/*
+ * void rasta_state_write_symbol(RastaStateWriter *writer,
+ *                               const gchar *name,
+ *                               const gchar *value)
+ *
+ * Writes a symbol of the innermost open scope.
+ */
+void rasta_state_write_symbol(RastaStateWriter *writer,
+                              const gchar *name,
+                              const gchar *value)
+{
+    g_return_if_fail(writer != NULL);
+    g_return_if_fail(writer->depth > 0);
+    g_return_if_fail(name != NULL);
+
+    if (writer->flags & RASTA_STATE_BINARY)
+    {
+        g_string_append_c(writer->buf, 'Y');
+        state_put_string(writer->buf, name);
+        state_put_string(writer->buf, value);
+    }
+    else
+    {
+        g_string_append(writer->buf, "<SYMBOL NAME=\"");
+        state_put_escaped(writer->buf, name);
+        g_string_append(writer->buf, "\" VALUE=\"");
+        state_put_escaped(writer->buf, value);
+        g_string_append(writer->buf, "\"/>");
+    }
+
+    state_maybe_flush(writer, RASTA_STATE_FLUSH);
+}  /* rasta_state_write_symbol() */
+
+
+/*
+ * static void state_write_symbol_func(gpointer key,
+ *                                     gpointer value,
+ *                                     gpointer user_data)
+ *
+ * Writes one of a scope's symbols, unless the writer knows it is
+ * dead.
+ */
+static void state_write_symbol_func(gpointer key,
+                                    gpointer value,
+                                    gpointer user_data)
+{
+    RastaStateWriter *writer = (RastaStateWriter *)user_data;
+
+    if ((writer->live != NULL) &&
+        (g_hash_table_lookup(writer->live, key) == NULL))
+        return;
+
+    rasta_state_write_symbol(writer,
+                             (const gchar *)key,
+                             (const gchar *)value);
+}  /* state_write_symbol_func() */
+
+
+/*
+ * gint rasta_state_write_context(RastaStateWriter *writer,
+ *                                RastaContext *ctxt)
+ *
+ * Writes every scope of ctxt and its symbols, outermost first.
+ * With RASTA_STATE_LIVE_ONLY, symbols that no screen at or below a
+ * scope's path node refers to are left out.
+ */
+gint rasta_state_write_context(RastaStateWriter *writer,
+                               RastaContext *ctxt)
+{
+    guint steps[RASTA_TRAVERSE_STEPS_MAX];
+    guint n_steps;
+    xmlNodePtr node, prev_node;
+    RastaScope *scope;
+    GList *elem;
+
+    g_return_val_if_fail(writer != NULL, -EINVAL);
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(ctxt->scopes != NULL, -EINVAL);
+
+    prev_node = NULL;
+    for (elem = g_list_last(ctxt->scopes);
+         elem != NULL;
+         elem = g_list_previous(elem))
+    {
+        scope = RASTA_SCOPE(elem->data);
+        node = rasta_scope_get_path_node(scope);
+        n_steps = 0;
+        if ((prev_node != NULL) && (node != NULL))
+            n_steps = rasta_traverse_steps(prev_node, node, steps);
+        prev_node = node;
+
+        rasta_state_write_scope(writer, rasta_scope_peek_id(scope),
+                                steps, n_steps);
+        if (writer->flags & RASTA_STATE_LIVE_ONLY)
+            writer->live = rasta_live_symbols(ctxt, node);
+        rasta_scope_foreach_symbol(scope,
+                                   state_write_symbol_func,
+                                   writer);
+    }
+    writer->live = NULL;
+
+    return(writer->rc);
+}  /* rasta_state_write_context() */
+
+
+/*
+ * gint rasta_state_writer_finish(RastaStateWriter *writer)
+ *
+ * Closes the open scopes and the document, and writes out anything
+ * pending.  A memory writer's output is left in writer->buf for the
+ * caller to take and free; otherwise the buffer is freed here.
+ * Returns 0 or the first write error.
+ */
+gint rasta_state_writer_finish(RastaStateWriter *writer)
+{
+    g_return_val_if_fail(writer != NULL, -EINVAL);
+
+    if (writer->flags & RASTA_STATE_BINARY)
+        g_string_append_c(writer->buf, 'E');
+    else
+    {
+        for (; writer->depth > 0; writer->depth--)
+            g_string_append(writer->buf, "</SCOPE>");
+        g_string_append(writer->buf, "</RASTASTATE>\n");
+    }
+    writer->depth = 0;
+
+    if (writer->fd > -1)
+    {
+        state_maybe_flush(writer, 0);
+        g_string_free(writer->buf, TRUE);
+        writer->buf = NULL;
+    }
+
+    return(writer->rc);
+}  /* rasta_state_writer_finish() */
+
+
+/*
+ * gboolean rasta_state_is_binary(const gchar *data, gsize len)
+ *
+ * Returns TRUE if data starts like a binary state.
+ */
+gboolean rasta_state_is_binary(const gchar *data, gsize len)
+{
+    return((len >= RASTA_STATE_MAGIC_LEN) &&
+           (memcmp(data, RASTA_STATE_MAGIC, RASTA_STATE_MAGIC_LEN) == 0));
+}  /* rasta_state_is_binary() */
+
+
+/*
+ * gint rasta_state_load_binary(RastaContext *ctxt,
+ *                              const gchar *data,
+ *                              gsize len,
+ *                              gboolean direct)
+ *
+ * Moves the context to the state in a binary encoding.  The first
+ * scope must be the context's initial screen.  If direct is TRUE,
+ * scopes with recorded steps are restored without navigating (see
+ * rasta_context_restore_scope()).  There is no DTD to check against,
+ * so every length is bounds checked and every string must be UTF-8.
+ * On failure the context may be part way there; the caller reverts
+ * it.
+ */
+gint rasta_state_load_binary(RastaContext *ctxt,
+                             const gchar *data,
+                             gsize len,
+                             gboolean direct)
+{
+    gint rc;
+    guint32 version;
+    guint steps[RASTA_TRAVERSE_STEPS_MAX];
+    guint i, n_steps;
+    const guchar *ptr, *end;
+    const gchar *id;
+    GString *name, *value;
+    gboolean first;
+
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(data != NULL, -EINVAL);
+
+    if ((rasta_state_is_binary(data, len) == FALSE) ||
+        (len < RASTA_STATE_HEADER_LEN))
+        return(-EBADF);
+
+    ptr = (const guchar *)data;
+    end = ptr + len;
+    version = state_get_uint32(ptr + RASTA_STATE_MAGIC_LEN);
+    if ((version < 1) || (version > RASTA_STATE_VERSION))
+        return(-EBADF);
+    ptr += RASTA_STATE_HEADER_LEN;
+
+    name = g_string_new(NULL);
+    value = g_string_new(NULL);
+    first = TRUE;
+    rc = -EBADF;  /* Until the end record */
+    while (ptr < end)
+    {
+        switch (*ptr++)
+        {
+            case 'S':
+                ptr = state_get_string(ptr, end, name);
+                if ((ptr == NULL) || (name->len == 0))
+                    goto out;
+                n_steps = 0;
+                if (version > 1)
+                {
+                    if ((end - ptr) < 4)
+                        goto out;
+                    n_steps = state_get_uint32(ptr);
+                    ptr += 4;
+                    if ((n_steps > RASTA_TRAVERSE_STEPS_MAX) ||
+                        ((guint32)(end - ptr) < (n_steps * 4)))
+                        goto out;
+                    for (i = 0; i < n_steps; i++, ptr += 4)
+                        steps[i] = state_get_uint32(ptr);
+                }
+
+                if (first != FALSE)
+                {
+                    id = rasta_scope_peek_id(rasta_scope_get_current(ctxt));
+                    if ((id == NULL) || (strcmp(id, name->str) != 0))
+                        goto out;
+                    first = FALSE;
+                    break;
+                }
+
+                if ((direct != FALSE) && (n_steps > 0))
+                    rc = rasta_context_restore_scope(ctxt, name->str,
+                                                     steps, n_steps);
+                else
+                    rc = rasta_context_travel_scope(ctxt, name->str);
+                if (rc != 0)
+                    goto out;
+                rc = -EBADF;
+                break;
+
+            case 'Y':
+                if (first != FALSE)
+                    goto out;
+                ptr = state_get_string(ptr, end, name);
+                if ((ptr == NULL) || (name->len == 0))
+                    goto out;
+                ptr = state_get_string(ptr, end, value);
+                if (ptr == NULL)
+                    goto out;
+                rasta_symbol_put(ctxt, name->str, value->str);
+                break;
+
+            case 'E':
+                if (first == FALSE)
+                {
+                    rasta_context_restore_finish(ctxt);
+                    rc = 0;
+                }
+                goto out;
+
+            default:
+                goto out;
+        }
+    }
+
+out:
+    g_string_free(value, TRUE);
+    g_string_free(name, TRUE);
+
+    return(rc);
+}  /* rasta_state_load_binary() */
@@ -0,0 +1,85 @@
+/*
+ * rastastate.h
+ *
+ * Private header file for writing and reading saved states.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+
+#ifndef _RASTA_STATE_H
+#define _RASTA_STATE_H
+
+
+
+/*
+ * Defines
+ */
+#define RASTA_STATE_MAGIC       "\211RST"
+#define RASTA_STATE_MAGIC_LEN   4
+#define RASTA_STATE_VERSION     2
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _RastaStateWriter        RastaStateWriter;
+
+
+
+/*
+ * Structures
+ */
+struct _RastaStateWriter
+{
+    GString *buf;               /* Pending output */
+    gint fd;                    /* Output fd, or -1 to keep it all */
+    RastaStateFlags flags;
+    guint depth;                /* Open scopes */
+    gint rc;                    /* First error, or 0 */
+    GHashTable *live;           /* Symbols worth writing, or NULL */
+};
+
+
+
+/*
+ * Prototypes
+ */
+void rasta_state_writer_init(RastaStateWriter *writer,
+                             gint fd,
+                             RastaStateFlags flags);
+void rasta_state_write_scope(RastaStateWriter *writer,
+                             const gchar *name,
+                             const guint *steps,
+                             guint n_steps);
+void rasta_state_write_symbol(RastaStateWriter *writer,
+                              const gchar *name,
+                              const gchar *value);
+gint rasta_state_write_context(RastaStateWriter *writer,
+                               RastaContext *ctxt);
+gint rasta_state_writer_finish(RastaStateWriter *writer);
+gboolean rasta_state_is_binary(const gchar *data, gsize len);
+gint rasta_state_load_binary(RastaContext *ctxt,
+                             const gchar *data,
+                             gsize len,
+                             gboolean direct);
+
+#endif /* _RASTA_STATE_H */
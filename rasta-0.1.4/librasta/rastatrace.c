@@ -0,0 +1,482 @@
+/*
+ * rastatrace.c
+ *
+ * Code for tracing where librasta spends its time
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastascope.h"
+#include "rastaprofile.h"
+#include "rastatrace.h"
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _RastaTraceChild RastaTraceChild;
+
+
+
+/*
+ * Structures
+ */
+
+/*
+ * A child started while tracing or profiling, waiting to exit
+ */
+struct _RastaTraceChild
+{
+    gchar *screen_id;
+    gchar *detail;              /* NULL unless tracing */
+    guint64 start_ns;
+    RastaProfileKind kind;
+};
+
+
+
+/*
+ * Globals
+ */
+RastaTraceFunc rasta_trace_func = NULL;
+static gpointer rasta_trace_data = NULL;
+static GHashTable *rasta_trace_children = NULL;
+
+/* The built-in Chrome trace writer */
+static FILE *chrome_file = NULL;
+static guint64 chrome_base_ns = 0;
+static gboolean chrome_first = TRUE;
+
+
+
+/*
+ * Prototypes
+ */
+static void rasta_trace_child_free(gpointer data);
+static void chrome_write_string(const gchar *str);
+static void chrome_trace_handler(const RastaTraceEvent *event,
+                                 gpointer user_data);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * void rasta_set_trace_handler(RastaTraceFunc func,
+ *                              gpointer user_data)
+ *
+ * Installs func to receive a RastaTraceEvent for every parse,
+ * validation, screen load, symbol substitution and command librasta
+ * performs.  Passing NULL turns tracing off.  There is one handler
+ * per process.
+ */
+void rasta_set_trace_handler(RastaTraceFunc func,
+                             gpointer user_data)
+{
+    rasta_trace_data = user_data;
+    rasta_trace_func = func;
+    rasta_trace_forget_children();
+}  /* rasta_set_trace_handler() */
+
+
+/*
+ * const gchar *rasta_trace_phase_name(RastaTracePhase phase)
+ *
+ * Returns a short name for phase.
+ */
+const gchar *rasta_trace_phase_name(RastaTracePhase phase)
+{
+    switch (phase)
+    {
+        case RASTA_TRACE_PARSE:
+            return("parse");
+
+        case RASTA_TRACE_VALIDATE:
+            return("validate");
+
+        case RASTA_TRACE_SCREEN_LOAD:
+            return("screen_load");
+
+        case RASTA_TRACE_SYMBOL_SUBST:
+            return("symbol_subst");
+
+        case RASTA_TRACE_SPAWN:
+            return("spawn");
+
+        case RASTA_TRACE_COMMAND:
+            return("command");
+
+        default:
+            break;
+    }
+
+    return("unknown");
+}  /* rasta_trace_phase_name() */
+
+
+/*
+ * guint64 rasta_trace_now()
+ *
+ * Returns the time of day in nanoseconds.  The clock only has
+ * microsecond resolution, which is all a trace viewer shows anyway.
+ */
+guint64 rasta_trace_now()
+{
+    GTimeVal now;
+
+    g_get_current_time(&now);
+
+    return(((guint64)now.tv_sec * G_GINT64_CONSTANT(1000000000)) +
+           ((guint64)now.tv_usec * 1000));
+}  /* rasta_trace_now() */
+
+
+/*
+ * void rasta_trace_emit(RastaTracePhase phase,
+ *                       const gchar *screen_id,
+ *                       const gchar *detail,
+ *                       guint64 start_ns,
+ *                       gsize bytes,
+ *                       pid_t pid)
+ *
+ * Sends an event that started at start_ns and ends now to the
+ * handler.  A start of 0 means tracing was off when the operation
+ * started, and the event is dropped.
+ */
+void rasta_trace_emit(RastaTracePhase phase,
+                      const gchar *screen_id,
+                      const gchar *detail,
+                      guint64 start_ns,
+                      gsize bytes,
+                      pid_t pid)
+{
+    RastaTraceEvent event;
+    guint64 end_ns;
+
+    if ((rasta_trace_func == NULL) || (start_ns == 0))
+        return;
+
+    end_ns = rasta_trace_now();
+
+    event.phase = phase;
+    event.screen_id = screen_id;
+    event.detail = detail;
+    event.start_ns = start_ns;
+    event.duration_ns = (end_ns > start_ns) ? (end_ns - start_ns) : 0;
+    event.bytes = bytes;
+    event.pid = pid;
+
+    rasta_trace_func(&event, rasta_trace_data);
+}  /* rasta_trace_emit() */
+
+
+/*
+ * const gchar *rasta_trace_screen_id(RastaContext *ctxt)
+ *
+ * Returns the id of the current screen for an event, or NULL.
+ */
+const gchar *rasta_trace_screen_id(RastaContext *ctxt)
+{
+    if ((ctxt == NULL) || (ctxt->scopes == NULL))
+        return(NULL);
+
+    return(rasta_scope_peek_id(rasta_scope_get_current(ctxt)));
+}  /* rasta_trace_screen_id() */
+
+
+/*
+ * gsize rasta_trace_file_size(const gchar *filename)
+ *
+ * Returns the size of filename for an event, or 0.
+ */
+gsize rasta_trace_file_size(const gchar *filename)
+{
+    struct stat stat_buf;
+
+    if ((filename == NULL) || (stat(filename, &stat_buf) != 0))
+        return(0);
+
+    return((gsize)stat_buf.st_size);
+}  /* rasta_trace_file_size() */
+
+
+/*
+ * static void rasta_trace_child_free(gpointer data)
+ *
+ * Frees a RastaTraceChild.
+ */
+static void rasta_trace_child_free(gpointer data)
+{
+    RastaTraceChild *child;
+
+    child = (RastaTraceChild *)data;
+    g_free(child->screen_id);
+    g_free(child->detail);
+    g_free(child);
+}  /* rasta_trace_child_free() */
+
+
+/*
+ * void rasta_trace_spawned(pid_t pid,
+ *                          const gchar *screen_id,
+ *                          RastaProfileKind kind,
+ *                          gchar *args[],
+ *                          guint64 start_ns)
+ *
+ * Sends the SPAWN event for a child started at start_ns, and
+ * remembers the child so rasta_trace_child_exited() can time the
+ * whole command for the trace and the profile.
+ */
+void rasta_trace_spawned(pid_t pid,
+                         const gchar *screen_id,
+                         RastaProfileKind kind,
+                         gchar *args[],
+                         guint64 start_ns)
+{
+    RastaTraceChild *child;
+
+    if (start_ns == 0)
+        return;
+
+    child = g_new(RastaTraceChild, 1);
+    child->screen_id = g_strdup(screen_id);
+    child->detail = RASTA_TRACING() ? g_strjoinv(" ", args) : NULL;
+    child->start_ns = start_ns;
+    child->kind = kind;
+
+    rasta_trace_emit(RASTA_TRACE_SPAWN, child->screen_id, child->detail,
+                     start_ns, 0, pid);
+
+    if (rasta_trace_children == NULL)
+        rasta_trace_children =
+            g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                  NULL, rasta_trace_child_free);
+    g_hash_table_insert(rasta_trace_children, GINT_TO_POINTER(pid),
+                        child);
+}  /* rasta_trace_spawned() */
+
+
+/*
+ * void rasta_trace_child_set_screen(pid_t pid,
+ *                                   const gchar *screen_id,
+ *                                   RastaProfileKind kind)
+ *
+ * Labels a child after the fact.
+ */
+void rasta_trace_child_set_screen(pid_t pid,
+                                  const gchar *screen_id,
+                                  RastaProfileKind kind)
+{
+    RastaTraceChild *child;
+
+    if (rasta_trace_children == NULL)
+        return;
+
+    child = g_hash_table_lookup(rasta_trace_children,
+                                GINT_TO_POINTER(pid));
+    if (child == NULL)
+        return;
+
+    g_free(child->screen_id);
+    child->screen_id = g_strdup(screen_id);
+    child->kind = kind;
+}  /* rasta_trace_child_set_screen() */
+
+
+/*
+ * void rasta_trace_child_exited(pid_t pid, gint status, gsize bytes)
+ *
+ * Sends the COMMAND event for a child, timed from when it was
+ * started until now, and counts it in the profile.  status is the
+ * wait status and bytes is the output collected from the child.
+ * rasta_exec_watch_child() does this itself; front ends that reap
+ * their own children call it once waitpid(2) returns.
+ */
+void rasta_trace_child_exited(pid_t pid, gint status, gsize bytes)
+{
+    RastaTraceChild *child;
+
+    if (rasta_trace_children == NULL)
+        return;
+
+    child = g_hash_table_lookup(rasta_trace_children,
+                                GINT_TO_POINTER(pid));
+    if (child == NULL)
+        return;
+
+    rasta_trace_emit(RASTA_TRACE_COMMAND, child->screen_id, child->detail,
+                     child->start_ns, bytes, pid);
+    if (RASTA_PROFILING())
+        rasta_profile_command(child->screen_id, child->kind,
+                              rasta_trace_now() - child->start_ns, bytes,
+                              !WIFEXITED(status) ||
+                              (WEXITSTATUS(status) != 0));
+    g_hash_table_remove(rasta_trace_children, GINT_TO_POINTER(pid));
+}  /* rasta_trace_child_exited() */
+
+
+/*
+ * void rasta_trace_forget_children()
+ *
+ * Drops the children still waiting for rasta_trace_child_exited()
+ * once neither tracing nor profiling is on.  Front ends don't report
+ * every exit, and those entries would otherwise be kept for good.
+ */
+void rasta_trace_forget_children()
+{
+    if ((rasta_trace_children == NULL) || RASTA_TIMING_CHILDREN())
+        return;
+
+    g_hash_table_destroy(rasta_trace_children);
+    rasta_trace_children = NULL;
+}  /* rasta_trace_forget_children() */
+
+
+/*
+ * static void chrome_write_string(const gchar *str)
+ *
+ * Writes str as a JSON string.
+ */
+static void chrome_write_string(const gchar *str)
+{
+    const gchar *ptr;
+
+    fputc('"', chrome_file);
+    for (ptr = str; *ptr != '\0'; ptr++)
+    {
+        if ((*ptr == '"') || (*ptr == '\\'))
+            fprintf(chrome_file, "\\%c", *ptr);
+        else if ((guchar)*ptr < 0x20)
+            fprintf(chrome_file, "\\u%04x", (guchar)*ptr);
+        else
+            fputc(*ptr, chrome_file);
+    }
+    fputc('"', chrome_file);
+}  /* chrome_write_string() */
+
+
+/*
+ * static void chrome_trace_handler(const RastaTraceEvent *event,
+ *                                  gpointer user_data)
+ *
+ * Writes an event as a Chrome trace "complete" event.  librasta's
+ * own work is on one track and each child gets a track of its own.
+ * Times are in microseconds from the start of the trace.
+ */
+static void chrome_trace_handler(const RastaTraceEvent *event,
+                                 gpointer user_data)
+{
+    gdouble ts;
+
+    if (chrome_file == NULL)
+        return;
+
+    ts = (event->start_ns > chrome_base_ns) ?
+        (gdouble)(event->start_ns - chrome_base_ns) / 1000.0 : 0.0;
+
+    fprintf(chrome_file,
+            "%s\n{\"name\":\"%s\",\"cat\":\"rasta\",\"ph\":\"X\","
+            "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,"
+            "\"args\":{\"bytes\":%lu",
+            chrome_first ? "" : ",",
+            rasta_trace_phase_name(event->phase),
+            ts, (gdouble)event->duration_ns / 1000.0,
+            (glong)getpid(), (glong)event->pid,
+            (gulong)event->bytes);
+    if (event->screen_id != NULL)
+    {
+        fputs(",\"screen\":", chrome_file);
+        chrome_write_string(event->screen_id);
+    }
+    if (event->detail != NULL)
+    {
+        fputs(",\"detail\":", chrome_file);
+        chrome_write_string(event->detail);
+    }
+    fputs("}}", chrome_file);
+
+    /* Keep what we have if the program dies */
+    fflush(chrome_file);
+    chrome_first = FALSE;
+}  /* chrome_trace_handler() */
+
+
+/*
+ * gint rasta_trace_chrome_start(const gchar *filename)
+ *
+ * Installs the built-in handler, which writes Chrome trace event
+ * JSON to filename for chrome://tracing and compatible viewers.
+ * The file is usable even if rasta_trace_chrome_stop() is never
+ * called.  Returns 0 if successful, otherwise -ERROR.
+ */
+gint rasta_trace_chrome_start(const gchar *filename)
+{
+    g_return_val_if_fail(filename != NULL, -EINVAL);
+
+    rasta_trace_chrome_stop();
+
+    chrome_file = fopen(filename, "w");
+    if (chrome_file == NULL)
+        return(-errno);
+
+    fputs("[", chrome_file);
+    chrome_first = TRUE;
+    chrome_base_ns = rasta_trace_now();
+    rasta_set_trace_handler(chrome_trace_handler, NULL);
+
+    return(0);
+}  /* rasta_trace_chrome_start() */
+
+
+/*
+ * void rasta_trace_chrome_stop()
+ *
+ * Removes the built-in handler and finishes its file.
+ */
+void rasta_trace_chrome_stop()
+{
+    if (chrome_file == NULL)
+        return;
+
+    if (rasta_trace_func == chrome_trace_handler)
+        rasta_set_trace_handler(NULL, NULL);
+
+    fputs("\n]\n", chrome_file);
+    fclose(chrome_file);
+    chrome_file = NULL;
+}  /* rasta_trace_chrome_stop() */
@@ -0,0 +1,76 @@
+/*
+ * rastatrace.h
+ *
+ * Private header file for tracing.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+
+#ifndef _RASTA_TRACE_H
+#define _RASTA_TRACE_H
+
+
+
+/*
+ * Defines
+ */
+
+/*
+ * Callers check this before taking a timestamp, so an untraced
+ * program pays for one pointer test per traced operation.
+ */
+#define RASTA_TRACING()         (rasta_trace_func != NULL)
+
+/* Children are timed for the profile too */
+#define RASTA_TIMING_CHILDREN() (RASTA_TRACING() || RASTA_PROFILING())
+
+
+
+/*
+ * Globals
+ */
+extern RastaTraceFunc rasta_trace_func;
+
+
+
+/*
+ * Prototypes
+ */
+guint64 rasta_trace_now();
+void rasta_trace_emit(RastaTracePhase phase,
+                      const gchar *screen_id,
+                      const gchar *detail,
+                      guint64 start_ns,
+                      gsize bytes,
+                      pid_t pid);
+const gchar *rasta_trace_screen_id(RastaContext *ctxt);
+gsize rasta_trace_file_size(const gchar *filename);
+void rasta_trace_spawned(pid_t pid,
+                         const gchar *screen_id,
+                         RastaProfileKind kind,
+                         gchar *args[],
+                         guint64 start_ns);
+void rasta_trace_child_set_screen(pid_t pid,
+                                  const gchar *screen_id,
+                                  RastaProfileKind kind);
+void rasta_trace_forget_children();
+
+#endif /* _RASTA_TRACE_H */
@@ -36,6 +36,14 @@
 #include "rastascope.h"
 
 
+/*
+ * Prototypes
+ */
+static gboolean rasta_traverse_taken(RastaContext *ctxt,
+                                     xmlNodePtr node);
+
+
+
 /*
  * Functions
  */
@@ -386,10 +394,184 @@ next_elem:
 }  /* rasta_traverse_forward() */
 
 
+/*
+ * guint rasta_traverse_steps(xmlNodePtr from,
+ *                            xmlNodePtr to,
+ *                            guint *steps)
+ *
+ * Records how to get from one path node to a later one, so a saved
+ * state can go straight there.  Each step is the element index of a
+ * node among its siblings, outermost first; the nodes in between are
+ * the MULTIPATH and DEFAULTPATH elements taken.  steps must hold
+ * RASTA_TRAVERSE_STEPS_MAX entries.  Returns the number of steps, or
+ * 0 if to isn't below from or is nested too deeply.
+ */
+guint rasta_traverse_steps(xmlNodePtr from,
+                           xmlNodePtr to,
+                           guint *steps)
+{
+    guint n_steps, i, tmp;
+    xmlNodePtr cur, sib;
+
+    g_return_val_if_fail(from != NULL, 0);
+    g_return_val_if_fail(to != NULL, 0);
+    g_return_val_if_fail(steps != NULL, 0);
+
+    n_steps = 0;
+    for (cur = to; (cur != NULL) && (cur != from); cur = cur->parent)
+    {
+        if ((cur->type != XML_ELEMENT_NODE) ||
+            (n_steps == RASTA_TRAVERSE_STEPS_MAX))
+            return(0);
+
+        steps[n_steps] = 0;
+        for (sib = cur->prev; sib != NULL; sib = sib->prev)
+        {
+            if (sib->type == XML_ELEMENT_NODE)
+                steps[n_steps]++;
+        }
+        n_steps++;
+    }
+    if (cur == NULL)
+        return(0);
+
+    for (i = 0; i < (n_steps / 2); i++)
+    {
+        tmp = steps[i];
+        steps[i] = steps[n_steps - i - 1];
+        steps[n_steps - i - 1] = tmp;
+    }
+
+    return(n_steps);
+}  /* rasta_traverse_steps() */
+
+
+/*
+ * xmlNodePtr rasta_traverse_follow(RastaContext *ctxt,
+ *                                  xmlNodePtr from,
+ *                                  const guint *steps,
+ *                                  guint n_steps)
+ *
+ * Follows steps from rasta_traverse_steps() down from a path node.
+ * A MENU's next node is one of its children.  Below a DIALOG or
+ * HIDDEN, each step must be the branch rasta_traverse_forward()
+ * would take with the symbols now in scope: a MULTIPATH must match,
+ * and no earlier sibling may be taken first, so a DEFAULTPATH only
+ * counts when no MULTIPATH before it matches.  The enclosing
+ * scopes' symbols are restored before a nested scope is followed.
+ * Returns NULL if the steps don't lead to a path node this way.
+ */
+xmlNodePtr rasta_traverse_follow(RastaContext *ctxt,
+                                 xmlNodePtr from,
+                                 const guint *steps,
+                                 guint n_steps)
+{
+    guint i, index;
+    xmlNodePtr cur;
+
+    g_return_val_if_fail(ctxt != NULL, NULL);
+    g_return_val_if_fail(from != NULL, NULL);
+    g_return_val_if_fail((n_steps == 0) || (steps != NULL), NULL);
+
+    if (n_steps == 0)
+        return(NULL);
+    if (xmlStrcmp(from->name, "MENU") == 0)
+    {
+        if (n_steps != 1)
+            return(NULL);
+    }
+    else if ((xmlStrcmp(from->name, "DIALOG") != 0) &&
+             (xmlStrcmp(from->name, "HIDDEN") != 0))
+        return(NULL);
+
+    cur = from;
+    for (i = 0; i < n_steps; i++)
+    {
+        if ((i > 0) &&
+            (xmlStrcmp(cur->name, "MULTIPATH") != 0) &&
+            (xmlStrcmp(cur->name, "DEFAULTPATH") != 0))
+            return(NULL);
+
+        index = steps[i];
+        for (cur = cur->children; cur != NULL; cur = cur->next)
+        {
+            if (cur->type != XML_ELEMENT_NODE)
+                continue;
+            if (index == 0)
+                break;
+            index--;
+
+            /* MENU steps are picked by name, not by traversal */
+            if ((xmlStrcmp(from->name, "MENU") != 0) &&
+                (cur->ns == ctxt->ns) &&
+                rasta_traverse_taken(ctxt, cur))
+                return(NULL);
+        }
+        if ((cur == NULL) || (cur->ns != ctxt->ns))
+            return(NULL);
+        if ((xmlStrcmp(from->name, "MENU") != 0) &&
+            (rasta_traverse_taken(ctxt, cur) == FALSE))
+            return(NULL);
+    }
+
+    if ((xmlStrcmp(cur->name, "MENU") != 0) &&
+        (xmlStrcmp(cur->name, "DIALOG") != 0) &&
+        (xmlStrcmp(cur->name, "HIDDEN") != 0) &&
+        (xmlStrcmp(cur->name, "ACTION") != 0))
+        return(NULL);
+
+    return(cur);
+}  /* rasta_traverse_follow() */
+
+
+/*
+ * static gboolean rasta_traverse_taken(RastaContext *ctxt,
+ *                                      xmlNodePtr node)
+ *
+ * Returns TRUE if rasta_traverse_forward() would stop at node or
+ * descend into it when it came to it: a path node, a DEFAULTPATH,
+ * or a MULTIPATH whose SYMBOL has its VALUE.
+ */
+static gboolean rasta_traverse_taken(RastaContext *ctxt,
+                                     xmlNodePtr node)
+{
+    gchar *key, *val, *sym_val;
+    gboolean taken;
+
+    if ((xmlStrcmp(node->name, "DIALOG") == 0) ||
+        (xmlStrcmp(node->name, "HIDDEN") == 0) ||
+        (xmlStrcmp(node->name, "ACTION") == 0) ||
+        (xmlStrcmp(node->name, "DEFAULTPATH") == 0))
+        return(TRUE);
+    if (xmlStrcmp(node->name, "MULTIPATH") != 0)
+        return(FALSE);
+
+    taken = FALSE;
+    key = xmlGetProp(node, "SYMBOL");
+    val = xmlGetProp(node, "VALUE");
+    if ((key != NULL) && (val != NULL))
+    {
+        sym_val = rasta_symbol_lookup(ctxt, key);
+        if (sym_val != NULL)
+        {
+            taken = (xmlStrcmp(val, sym_val) == 0);
+            g_free(sym_val);
+        }
+    }
+    if (key != NULL)
+        g_free(key);
+    if (val != NULL)
+        g_free(val);
+
+    return(taken);
+}  /* rasta_traverse_taken() */
+
+
 /*
  * gchar *rasta_query_help(RastaContext *ctxt, xmlNodePtr node)
  *
- * Returns the HELP subtag of the given node (if there is one)
+ * Returns the HELP subtag of the given node (if there is one).  The
+ * text is read from the node's own document, so ctxt may be NULL.
  */
 gchar *rasta_query_help(RastaContext *ctxt, xmlNodePtr node)
 {
@@ -408,7 +590,7 @@ gchar *rasta_query_help(RastaContext *ctxt, xmlNodePtr node)
         if ((node->type == XML_ELEMENT_NODE) &&
             (xmlStrcmp(node->name, "HELP") == 0))
         {
-            help = xmlNodeListGetString(ctxt->doc, node->children, 1);
+            help = xmlNodeListGetString(node->doc, node->children, 1);
             break;
         }
         node = node->next;
@@ -27,6 +27,9 @@
 #ifndef _RASTA_TRAVERSE_H
 #define _RASTA_TRAVERSE_H
 
+/* Deepest MULTIPATH nesting a saved state records */
+#define RASTA_TRAVERSE_STEPS_MAX        16
+
 
 gboolean rasta_find_fastpath(RastaContext *ctxt);
 gboolean rasta_validate_root(RastaContext *ctxt);
@@ -34,6 +37,13 @@ xmlNodePtr rasta_find_screen(RastaContext *ctxt,
                              const gchar *screen_id);
 xmlNodePtr rasta_traverse_forward(RastaContext *ctxt,
                                   const gchar *next_id);
+guint rasta_traverse_steps(xmlNodePtr from,
+                           xmlNodePtr to,
+                           guint *steps);
+xmlNodePtr rasta_traverse_follow(RastaContext *ctxt,
+                                 xmlNodePtr from,
+                                 const guint *steps,
+                                 guint n_steps);
 gchar *rasta_query_help(RastaContext *ctxt, xmlNodePtr node);
 
 #endif /* _RASTA_TRAVERSE_H */
@@ -35,20 +35,10 @@
 #include "rasta.h"
 
 
-/* Structures
+/* The structure lives in rasta.h so that array cursors can be
+ * allocated on the stack.  Array-backed enumerations have a non-NULL
+ * items pointer (or n_items == 0) and no callbacks.
  */
-struct _REnumeration
-{
-  gpointer context;
-  REnumerationFunc      has_more_func;
-  REnumerationFunc      get_next_func;
-  GDestroyNotify        notify_func;
-};
-
-
-static gpointer r_enumeration_list_has_more       (gpointer   context);
-static gpointer r_enumeration_list_get_next       (gpointer   context);
-static void     r_enumeration_list_destroy_notify (gpointer   context);
 
 
 
@@ -62,11 +52,12 @@ r_enumeration_new (gpointer               context,
 {
   REnumeration *enumeration;
 
-  enumeration = g_new (REnumeration, 1);
+  enumeration = g_new0 (REnumeration, 1);
   enumeration->context = context;
   enumeration->has_more_func = has_more_func;
   enumeration->get_next_func = get_next_func;
   enumeration->notify_func = notify_func;
+  enumeration->allocated = TRUE;
 
   return enumeration;
 }  /* r_enumeration_new() */
@@ -75,24 +66,61 @@ REnumeration*
 r_enumeration_new_from_list (GList *init_list)
 {
   REnumeration *enumeration;
-  GList *list_copy, *header;
+  gpointer *items;
+  guint n_items, i;
+
+  /* The list pointers are copied here, the caller is responsible
+   * for the data items.  On _free(), the copy is removed and the
+   * data items left alone.  If the caller wants different
+   * semantics, the caller can specify their own functions with
+   * _new().  The copy shares the enumeration's allocation. */
+  n_items = g_list_length (init_list);
+  enumeration = g_malloc (sizeof (REnumeration) +
+                          (n_items * sizeof (gpointer)));
+  items = (gpointer *) (enumeration + 1);
+  for (i = 0; init_list != NULL; init_list = g_list_next (init_list))
+    items[i++] = init_list->data;
+
+  r_enumeration_init_array (enumeration, items, n_items);
+  enumeration->allocated = TRUE;
 
-  /* The list is copied here, the caller is responsible for the
-   * data items.  On _free(), the list is removed and the data items
-   * left alone.  If the caller wants different semantics, the
-   * caller can specify their own functions with _new() */
-  list_copy = g_list_copy(init_list);
+  return(enumeration);
+}  /* r_enumeration_new_from_list() */
 
-  /* This is a header element to refer to the list */
-  header = g_list_prepend(NULL, (gpointer) list_copy);
+REnumeration*
+r_enumeration_new_from_array (gpointer *items,
+                              guint     n_items)
+{
+  REnumeration *enumeration;
 
-  enumeration = r_enumeration_new ((gpointer) header,
-                                   r_enumeration_list_has_more,
-                                   r_enumeration_list_get_next,
-                                   r_enumeration_list_destroy_notify);
+  /* The array is not copied.  It must outlive the enumeration and
+   * must not change while the enumeration is in use. */
+  enumeration = g_new (REnumeration, 1);
+  r_enumeration_init_array (enumeration, items, n_items);
+  enumeration->allocated = TRUE;
 
   return(enumeration);
-}  /* r_enumeration_new_from_list() */
+}  /* r_enumeration_new_from_array() */
+
+void
+r_enumeration_init_array (REnumeration *enumeration,
+                          gpointer     *items,
+                          guint         n_items)
+{
+  /* Initializes a caller-owned cursor over items.  Nothing is
+   * allocated, and r_enumeration_free() on the cursor is a no-op. */
+  g_return_if_fail (enumeration != NULL);
+  g_return_if_fail ((items != NULL) || (n_items == 0));
+
+  enumeration->context = NULL;
+  enumeration->has_more_func = NULL;
+  enumeration->get_next_func = NULL;
+  enumeration->notify_func = NULL;
+  enumeration->items = items;
+  enumeration->n_items = n_items;
+  enumeration->position = 0;
+  enumeration->allocated = FALSE;
+}  /* r_enumeration_init_array() */
 
 gboolean
 r_enumeration_has_more (REnumeration *enumeration)
@@ -101,6 +129,9 @@ r_enumeration_has_more (REnumeration *enumeration)
 
   g_return_val_if_fail (enumeration != NULL, FALSE);
 
+  if (enumeration->has_more_func == NULL)
+    return (enumeration->position < enumeration->n_items);
+
   result = (*enumeration->has_more_func) (enumeration->context);
 
   return (gboolean)GPOINTER_TO_INT(result);
@@ -113,69 +144,53 @@ r_enumeration_get_next (REnumeration *enumeration)
 
   g_return_val_if_fail (enumeration != NULL, NULL);
 
+  if (enumeration->get_next_func == NULL)
+    {
+      /* User should have called has_more() */
+      g_return_val_if_fail (enumeration->position < enumeration->n_items,
+                            NULL);
+
+      return enumeration->items[enumeration->position++];
+    }
+
   result = (*enumeration->get_next_func) (enumeration->context);
 
   return result;
 }  /* r_enumeration_get_next() */
 
-void
-r_enumeration_free (REnumeration *enumeration)
+gint
+r_enumeration_count (REnumeration *enumeration)
 {
-  (*enumeration->notify_func) (enumeration->context);
+  g_return_val_if_fail (enumeration != NULL, -1);
 
-  g_free(enumeration);
-}  /* r_enumeration_free() */
+  /* Only array-backed enumerations know their size */
+  if (enumeration->has_more_func != NULL)
+    return -1;
 
-static gpointer
-r_enumeration_list_has_more (gpointer context)
-{
-  GList *header, *elem;
-  gboolean result;
-
-  g_return_val_if_fail (context != NULL, (gpointer) FALSE);
-
-  header = (GList *) context;
-  elem = (GList *) header->data;
-
-  result = (elem != NULL);
-
-  return GINT_TO_POINTER(result);
-}  /* r_enumeration_list_has_more() */
+  return (gint) enumeration->n_items;
+}  /* r_enumeration_count() */
 
-static gpointer
-r_enumeration_list_get_next (gpointer context)
+gpointer
+r_enumeration_nth (REnumeration *enumeration,
+                   guint         n)
 {
-  GList *header, *elem;
-  gpointer result;
-
-  g_return_val_if_fail(context != NULL, NULL);
-
-  header = (GList *) context;
-  elem = (GList *) header->data;
-
-  /* User should have called has_more() */
-  g_return_val_if_fail(elem != NULL, NULL);
-
-  result = elem->data;
+  g_return_val_if_fail (enumeration != NULL, NULL);
+  g_return_val_if_fail (enumeration->has_more_func == NULL, NULL);
 
-  header->data = (gpointer) g_list_next(elem);
+  if (n >= enumeration->n_items)
+    return NULL;
 
-  g_list_free_1(elem);
+  return enumeration->items[n];
+}  /* r_enumeration_nth() */
 
-  return result;
-}  /* r_enumeration_list_get_next() */
-
-static void
-r_enumeration_list_destroy_notify (gpointer context)
+void
+r_enumeration_free (REnumeration *enumeration)
 {
-  GList *header, *elem;
-
-  g_return_if_fail (context != NULL);
-
-  header = (GList *) context;
-  elem = (GList *) header->data;
+  if ((enumeration == NULL) || !enumeration->allocated)
+    return;
 
-  g_list_free(elem);  /* NULL if at end of list */
+  if (enumeration->notify_func != NULL)
+    (*enumeration->notify_func) (enumeration->context);
 
-  g_list_free(header);
-}  /* r_enumeration_list_destroy_notify() */
+  g_free(enumeration);
+}  /* r_enumeration_free() */
@@ -0,0 +1,878 @@
+/*
+ * cgibench.c
+ *
+ * End-to-end request benchmark for cgirasta
+ *
+ * Copyright (C) 2002 Joel Becker <jlbec@evilplan.org>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+/* crypt(), setenv() and mkdtemp() */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+
+
+
+/*
+ * Defines
+ */
+#define CGIBENCH_ITERATIONS     200
+#define CGIBENCH_WARMUP         5
+#define CGIBENCH_TRACED         5       /* Requests run under strace */
+#define CGIBENCH_USER           "bench"
+#define CGIBENCH_PASSWORD       "bench"
+#define CGIBENCH_AUTH           "BENCHAUTH"
+#define CGIBENCH_SESSION        "BENCHSESSION"
+#define CGIBENCH_SCRIPT_NAME    "/cgi-bin/cgirasta"
+#define CGIBENCH_PATH_INFO      "/bench"
+#define CGIBENCH_DTD(name)      "file:" _RASTA_DATA_DIR "/" name
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _CGIBenchOptions CGIBenchOptions;
+typedef struct _CGIBenchFlow    CGIBenchFlow;
+
+
+
+/*
+ * Structures
+ */
+struct _CGIBenchOptions
+{
+    gchar *cgirasta;            /* Program to benchmark */
+    gchar *templates;           /* Copy templates from here */
+    guint iterations;
+    guint warmup;
+    gboolean syscalls;
+};
+
+/*
+ * One kind of request.  body is the POST body, or the QUERY_STRING
+ * for GET requests.
+ */
+struct _CGIBenchFlow
+{
+    const gchar *name;
+    const gchar *method;
+    const gchar *body;
+    gboolean cookie;            /* Send the auth cookie */
+};
+
+
+
+/*
+ * Prototypes
+ */
+static void print_usage(gint rc);
+static gint load_options(CGIBenchOptions *options,
+                         gint argc,
+                         gchar *argv[]);
+static gint cgibench_write_file(const gchar *dir,
+                                const gchar *name,
+                                const gchar *text);
+static gint cgibench_refresh(const gchar *base);
+static gint cgibench_setup(CGIBenchOptions *options, gchar **base);
+static void cgibench_remove_tree(const gchar *path);
+static gint cgibench_request(CGIBenchOptions *options,
+                             const gchar *base,
+                             CGIBenchFlow *flow,
+                             const gchar *trace_file);
+static gint cgibench_count_syscalls(const gchar *trace_file);
+static gint cgibench_compare(gconstpointer a, gconstpointer b);
+static gdouble cgibench_percentile(GArray *samples, guint percent);
+static gint cgibench_flow(CGIBenchOptions *options,
+                          const gchar *base,
+                          CGIBenchFlow *flow);
+static gint cgibench_run(CGIBenchOptions *options);
+
+
+
+/*
+ * Flows
+ */
+static CGIBenchFlow flows[] =
+{
+    /* A fresh login, crypt() and a new auth file */
+    {"login", "POST",
+     "u=" CGIBENCH_USER "&p=" CGIBENCH_PASSWORD "&k=login", FALSE},
+    /* A logged in page view, the auth file is checked and rewritten */
+    {"page", "GET", "", TRUE},
+    /* A logged in request in a session */
+    {"session", "POST", "k=" CGIBENCH_SESSION, TRUE},
+    {NULL, NULL, NULL, FALSE}
+};
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static void print_usage(gint rc)
+ *
+ * Prints a usage message and exits
+ */
+static void print_usage(gint rc)
+{
+    FILE *output;
+
+    output = rc ? stderr : stdout;
+
+    fprintf(output,
+            "Usage: cgibench --cgirasta <program> [--templates <dir>] [--iterations <n>] [--warmup <n>] [--no-syscalls]\n");
+    exit(rc);
+}  /* print_usage() */
+
+
+/*
+ * static gint load_options(CGIBenchOptions *options,
+ *                          gint argc,
+ *                          gchar *argv[])
+ *
+ * Loads all the options.
+ */
+static gint load_options(CGIBenchOptions *options,
+                         gint argc,
+                         gchar *argv[])
+{
+    gint i;
+    guint *val;
+    gchar **str;
+
+    for (i = 1; i < argc; i++)
+    {
+        val = NULL;
+        str = NULL;
+        if ((strcmp(argv[i], "-h") == 0) ||
+            (strcmp(argv[i], "-?") == 0) ||
+            (strcmp(argv[i], "--help") == 0))
+            return(1);
+        else if (strcmp(argv[i], "--cgirasta") == 0)
+            str = &(options->cgirasta);
+        else if (strcmp(argv[i], "--templates") == 0)
+            str = &(options->templates);
+        else if (strcmp(argv[i], "--iterations") == 0)
+            val = &(options->iterations);
+        else if (strcmp(argv[i], "--warmup") == 0)
+            val = &(options->warmup);
+        else if (strcmp(argv[i], "--no-syscalls") == 0)
+        {
+            options->syscalls = FALSE;
+            continue;
+        }
+        else
+            return(-EINVAL);
+
+        i++;
+        if (i >= argc)
+            return(-EINVAL);
+        if (str != NULL)
+        {
+            if (argv[i][0] == '-')
+                return(-EINVAL);
+            *str = argv[i];
+        }
+        else
+        {
+            if (!g_ascii_isdigit(argv[i][0]))
+                return(-EINVAL);
+            *val = (guint)strtoul(argv[i], NULL, 10);
+        }
+    }
+
+    if ((options->cgirasta == NULL) || (options->iterations == 0))
+        return(-EINVAL);
+
+    return(0);
+}  /* load_options() */
+
+
+/*
+ * static gint cgibench_write_file(const gchar *dir,
+ *                                 const gchar *name,
+ *                                 const gchar *text)
+ *
+ * Writes text to the file name in dir.
+ */
+static gint cgibench_write_file(const gchar *dir,
+                                const gchar *name,
+                                const gchar *text)
+{
+    gint rc;
+    gchar *filename;
+    FILE *f;
+
+    filename = g_build_filename(dir, name, NULL);
+    f = fopen(filename, "w");
+    g_free(filename);
+    if (f == NULL)
+        return(-errno);
+
+    rc = 0;
+    if (fputs(text, f) == EOF)
+        rc = -errno;
+    if ((fclose(f) != 0) && (rc == 0))
+        rc = -errno;
+
+    return(rc);
+}  /* cgibench_write_file() */
+
+
+/*
+ * static gint cgibench_refresh(const gchar *base)
+ *
+ * Writes the auth and session entries with the current time.
+ * cgirasta only refreshes the auth timestamp, so this is done before
+ * each flow to keep long runs from timing out.
+ */
+static gint cgibench_refresh(const gchar *base)
+{
+    gint rc;
+    gchar *dir, *text;
+    time_t now;
+
+    now = time(NULL);
+
+    dir = g_build_filename(base, "auths", NULL);
+    text = g_strdup_printf("<?xml version=\"1.0\"?>\n"
+                           "<!DOCTYPE RASTACGIAUTH SYSTEM \"%s\">\n"
+                           "<RASTACGIAUTH xmlns=\"" RASTA_NAMESPACE "\">\n"
+                           "  <AUTH USERID=\"" CGIBENCH_USER "\" KEY=\"" CGIBENCH_AUTH "\" TIMESTAMP=\"%ld\"/>\n"
+                           "</RASTACGIAUTH>\n",
+                           CGIBENCH_DTD("rastacgiauth.dtd"),
+                           (long)now);
+    rc = cgibench_write_file(dir, CGIBENCH_AUTH, text);
+    g_free(text);
+    g_free(dir);
+    if (rc != 0)
+        return(rc);
+
+    dir = g_build_filename(base, "sessions", NULL);
+    text = g_strdup_printf("<?xml version=\"1.0\"?>\n"
+                           "<!DOCTYPE RASTACGISESSION SYSTEM \"%s\">\n"
+                           "<RASTACGISESSION xmlns=\"" RASTA_NAMESPACE "\">\n"
+                           "  <SESSION KEY=\"" CGIBENCH_SESSION "\" USERID=\"" CGIBENCH_USER "\" TYPE=\"description\" FILE=\"%s.state\" TIMESTAMP=\"%ld\"/>\n"
+                           "</RASTACGISESSION>\n",
+                           CGIBENCH_DTD("rastacgisession.dtd"),
+                           CGIBENCH_SESSION, (long)now);
+    rc = cgibench_write_file(dir, CGIBENCH_SESSION, text);
+    g_free(text);
+    g_free(dir);
+
+    return(rc);
+}  /* cgibench_refresh() */
+
+
+/*
+ * static gint cgibench_setup(CGIBenchOptions *options, gchar **base)
+ *
+ * Creates a throwaway cgirasta database, the directory cgirasta
+ * finds through PATH_TRANSLATED.  It holds cgirasta.conf, cgi.rasta,
+ * the templates, one user, and an auth and session for that user.
+ * base is set to the new directory.
+ */
+static gint cgibench_setup(CGIBenchOptions *options, gchar **base)
+{
+    gint rc;
+    guint i;
+    gchar *dir, *text, *contents, *crypted;
+    GError *error;
+    static const gchar *templates[] =
+    {
+        "login.html", "error.html", "screen.html", "action.html", NULL
+    };
+    static const gchar *subdirs[] =
+    {
+        "templates", "users", "auths", "sessions", NULL
+    };
+
+    dir = g_build_filename(g_get_tmp_dir(), "cgibenchXXXXXX", NULL);
+    if (mkdtemp(dir) == NULL)
+    {
+        rc = -errno;
+        g_free(dir);
+        return(rc);
+    }
+    *base = dir;
+
+    for (i = 0; subdirs[i] != NULL; i++)
+    {
+        text = g_build_filename(*base, subdirs[i], NULL);
+        rc = mkdir(text, 0755);
+        g_free(text);
+        if (rc != 0)
+            return(-errno);
+    }
+
+    rc = cgibench_write_file(*base, "cgirasta.conf",
+                             "<?xml version=\"1.0\"?>\n"
+                             "<!DOCTYPE RASTACGICONF SYSTEM \"" CGIBENCH_DTD("rastacgiconf.dtd") "\">\n"
+                             "<RASTACGICONF xmlns=\"" RASTA_NAMESPACE "\">\n"
+                             "  <PREFERENCE NAME=\"usermodify\" VALUE=\"admin\"/>\n"
+                             "</RASTACGICONF>\n");
+    if (rc != 0)
+        return(rc);
+
+    rc = cgibench_write_file(*base, "cgi.rasta",
+                             "<?xml version=\"1.0\"?>\n"
+                             "<!DOCTYPE RASTA SYSTEM \"" CGIBENCH_DTD("rasta.dtd") "\">\n"
+                             "<RASTA xmlns=\"" RASTA_NAMESPACE "\">\n"
+                             "  <SCREENS>\n"
+                             "    <MENUSCREEN ID=\"top\" TEXT=\"Benchmark\"/>\n"
+                             "  </SCREENS>\n"
+                             "  <PATH>\n"
+                             "    <MENU NAME=\"top\"/>\n"
+                             "  </PATH>\n"
+                             "</RASTA>\n");
+    if (rc != 0)
+        return(rc);
+
+    /* The real templates, so template loading costs what it should */
+    dir = g_build_filename(*base, "templates", NULL);
+    for (i = 0; (options->templates != NULL) && (templates[i] != NULL); i++)
+    {
+        text = g_build_filename(options->templates, templates[i], NULL);
+        error = NULL;
+        if (!g_file_get_contents(text, &contents, NULL, &error))
+        {
+            fprintf(stderr, "cgibench: Unable to read template: %s\n",
+                    error->message);
+            g_error_free(error);
+            g_free(text);
+            g_free(dir);
+            return(-ENOENT);
+        }
+        g_free(text);
+        rc = cgibench_write_file(dir, templates[i], contents);
+        g_free(contents);
+        if (rc != 0)
+        {
+            g_free(dir);
+            return(rc);
+        }
+    }
+    g_free(dir);
+
+    crypted = crypt(CGIBENCH_PASSWORD, "bn");
+    if (crypted == NULL)
+        return(-ENOSYS);
+
+    dir = g_build_filename(*base, "users", NULL);
+    text = g_strdup_printf("<?xml version=\"1.0\"?>\n"
+                           "<!DOCTYPE RASTACGIUSER SYSTEM \"%s\">\n"
+                           "<RASTACGIUSER xmlns=\"" RASTA_NAMESPACE "\">\n"
+                           "  <USER NAME=\"Benchmark User\" USERID=\"" CGIBENCH_USER "\" CRYPT=\"%s\" AUTHLEVEL=\"user\"/>\n"
+                           "</RASTACGIUSER>\n",
+                           CGIBENCH_DTD("rastacgiuser.dtd"), crypted);
+    rc = cgibench_write_file(dir, CGIBENCH_USER, text);
+    g_free(text);
+    g_free(dir);
+    if (rc != 0)
+        return(rc);
+
+    return(cgibench_refresh(*base));
+}  /* cgibench_setup() */
+
+
+/*
+ * static void cgibench_remove_tree(const gchar *path)
+ *
+ * Removes path and everything below it.
+ */
+static void cgibench_remove_tree(const gchar *path)
+{
+    GDir *dir;
+    const gchar *name;
+    gchar *child;
+
+    dir = g_dir_open(path, 0, NULL);
+    if (dir == NULL)
+    {
+        unlink(path);
+        return;
+    }
+
+    while ((name = g_dir_read_name(dir)) != NULL)
+    {
+        child = g_build_filename(path, name, NULL);
+        cgibench_remove_tree(child);
+        g_free(child);
+    }
+    g_dir_close(dir);
+
+    rmdir(path);
+}  /* cgibench_remove_tree() */
+
+
+/*
+ * static gint cgibench_request(CGIBenchOptions *options,
+ *                              const gchar *base,
+ *                              CGIBenchFlow *flow,
+ *                              const gchar *trace_file)
+ *
+ * Runs cgirasta once with the CGI environment for flow, the way a
+ * web server would.  If trace_file is not NULL, cgirasta runs under
+ * "strace -c" writing the syscall summary there.  Returns 0 if the
+ * request succeeded.  A failed login or a lost auth makes cgirasta
+ * send the login form, so that is an error for every flow.
+ */
+static gint cgibench_request(CGIBenchOptions *options,
+                             const gchar *base,
+                             CGIBenchFlow *flow,
+                             const gchar *trace_file)
+{
+    gint rc, status, in_fds[2], out_fds[2];
+    gssize count;
+    gsize len, written;
+    gchar buf[4096];
+    gchar *length;
+    GString *response;
+    pid_t pid;
+
+    if (pipe(in_fds) != 0)
+        return(-errno);
+    if (pipe(out_fds) != 0)
+    {
+        rc = -errno;
+        close(in_fds[0]);
+        close(in_fds[1]);
+        return(rc);
+    }
+
+    pid = fork();
+    if (pid < 0)
+    {
+        rc = -errno;
+        close(in_fds[0]);
+        close(in_fds[1]);
+        close(out_fds[0]);
+        close(out_fds[1]);
+        return(rc);
+    }
+
+    if (pid == 0)
+    {
+        dup2(in_fds[0], STDIN_FILENO);
+        dup2(out_fds[1], STDOUT_FILENO);
+        close(in_fds[0]);
+        close(in_fds[1]);
+        close(out_fds[0]);
+        close(out_fds[1]);
+
+        setenv("GATEWAY_INTERFACE", "CGI/1.1", 1);
+        setenv("SERVER_PROTOCOL", "HTTP/1.0", 1);
+        setenv("SCRIPT_NAME", CGIBENCH_SCRIPT_NAME, 1);
+        setenv("PATH_INFO", CGIBENCH_PATH_INFO, 1);
+        setenv("PATH_TRANSLATED", base, 1);
+        setenv("REQUEST_METHOD", flow->method, 1);
+        if (strcmp(flow->method, "POST") == 0)
+        {
+            length = g_strdup_printf("%lu",
+                                     (gulong)strlen(flow->body));
+            setenv("CONTENT_LENGTH", length, 1);
+            setenv("CONTENT_TYPE",
+                   "application/x-www-form-urlencoded", 1);
+            unsetenv("QUERY_STRING");
+        }
+        else
+        {
+            setenv("QUERY_STRING", flow->body, 1);
+            unsetenv("CONTENT_LENGTH");
+            unsetenv("CONTENT_TYPE");
+        }
+        if (flow->cookie != FALSE)
+            setenv("HTTP_COOKIE", "a=" CGIBENCH_AUTH, 1);
+        else
+            unsetenv("HTTP_COOKIE");
+
+        if (trace_file != NULL)
+            execlp("strace", "strace", "-f", "-c", "-o", trace_file,
+                   options->cgirasta, NULL);
+        else
+            execl(options->cgirasta, options->cgirasta, NULL);
+        _exit(127);
+    }
+
+    close(in_fds[0]);
+    close(out_fds[1]);
+
+    /* Bodies are far smaller than a pipe buffer */
+    rc = 0;
+    if (strcmp(flow->method, "POST") == 0)
+    {
+        len = strlen(flow->body);
+        written = 0;
+        while (written < len)
+        {
+            count = write(in_fds[1], flow->body + written, len - written);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                rc = -errno;
+                break;
+            }
+            written += count;
+        }
+    }
+    close(in_fds[1]);
+
+    response = g_string_new(NULL);
+    while (1)
+    {
+        count = read(out_fds[0], buf, sizeof(buf));
+        if (count == 0)
+            break;
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            rc = -errno;
+            break;
+        }
+        g_string_append_len(response, buf, count);
+    }
+    close(out_fds[0]);
+
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            rc = -errno;
+            break;
+        }
+    }
+
+    if ((rc == 0) &&
+        (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)))
+    {
+        fprintf(stderr, "cgibench: %s request: cgirasta exited abnormally\n",
+                flow->name);
+        rc = -ECHILD;
+    }
+    else if ((rc == 0) &&
+             ((strstr(response->str, "Error Occur") != NULL) ||
+              (strstr(response->str, "VALUE=\"login\"") != NULL)))
+    {
+        fprintf(stderr,
+                "cgibench: %s request failed (are the DTDs installed in "
+                _RASTA_DATA_DIR "?):\n%s\n",
+                flow->name, response->str);
+        rc = -EPROTO;
+    }
+
+    g_string_free(response, TRUE);
+
+    return(rc);
+}  /* cgibench_request() */
+
+
+/*
+ * static gint cgibench_count_syscalls(const gchar *trace_file)
+ *
+ * Returns the total number of calls from a "strace -c" summary, or
+ * -1 if there is none.
+ */
+static gint cgibench_count_syscalls(const gchar *trace_file)
+{
+    gint calls;
+    guint n, i, field;
+    gchar *text, *line;
+    gchar **lines, **fields;
+
+    if (!g_file_get_contents(trace_file, &text, NULL, NULL))
+        return(-1);
+
+    /* "100.00  <seconds>  <usecs/call>  <calls>  [<errors>]  total" */
+    calls = -1;
+    lines = g_strsplit(text, "\n", 0);
+    for (n = 0; lines[n] != NULL; n++)
+    {
+        line = g_strstrip(lines[n]);
+        if (!g_str_has_suffix(line, " total"))
+            continue;
+
+        fields = g_strsplit_set(line, " \t", 0);
+        field = 0;
+        for (i = 0; fields[i] != NULL; i++)
+        {
+            if (fields[i][0] == '\0')
+                continue;
+            if (field++ == 3)
+            {
+                calls = atoi(fields[i]);
+                break;
+            }
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(text);
+
+    return(calls);
+}  /* cgibench_count_syscalls() */
+
+
+/*
+ * static gint cgibench_compare(gconstpointer a, gconstpointer b)
+ *
+ * Orders two samples.
+ */
+static gint cgibench_compare(gconstpointer a, gconstpointer b)
+{
+    gdouble da, db;
+
+    da = *(const gdouble *)a;
+    db = *(const gdouble *)b;
+
+    return((da < db) ? -1 : (da > db));
+}  /* cgibench_compare() */
+
+
+/*
+ * static gdouble cgibench_percentile(GArray *samples, guint percent)
+ *
+ * Returns the nearest-rank percentile of sorted samples.
+ */
+static gdouble cgibench_percentile(GArray *samples, guint percent)
+{
+    guint rank;
+
+    rank = ((samples->len * percent) + 99) / 100;
+    if (rank > 0)
+        rank--;
+
+    return(g_array_index(samples, gdouble, rank));
+}  /* cgibench_percentile() */
+
+
+/*
+ * static gint cgibench_flow(CGIBenchOptions *options,
+ *                           const gchar *base,
+ *                           CGIBenchFlow *flow)
+ *
+ * Times one flow and prints its results.  Requests are sent one at
+ * a time, so the rate is what a single CGI worker sustains.  Disk
+ * writes come from the block output count of the reaped children.
+ * Syscalls are counted in separate requests under strace, so the
+ * tracing does not skew the timings.
+ */
+static gint cgibench_flow(CGIBenchOptions *options,
+                          const gchar *base,
+                          CGIBenchFlow *flow)
+{
+    gint rc, fd, calls;
+    guint i;
+    const gchar *name;
+    gchar *trace_file;
+    gdouble total, elapsed;
+    glong blocks;
+    GArray *samples, *syscalls;
+    GTimer *timer;
+    GError *error;
+    struct rusage before, after;
+
+    rc = cgibench_refresh(base);
+    if (rc != 0)
+        return(rc);
+
+    for (i = 0; i < options->warmup; i++)
+    {
+        rc = cgibench_request(options, base, flow, NULL);
+        if (rc != 0)
+            return(rc);
+    }
+
+    samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    timer = g_timer_new();
+    total = 0.0;
+
+    getrusage(RUSAGE_CHILDREN, &before);
+    for (i = 0; i < options->iterations; i++)
+    {
+        g_timer_start(timer);
+        rc = cgibench_request(options, base, flow, NULL);
+        g_timer_stop(timer);
+        if (rc != 0)
+            goto out;
+
+        elapsed = g_timer_elapsed(timer, NULL);
+        total += elapsed;
+        g_array_append_val(samples, elapsed);
+    }
+    getrusage(RUSAGE_CHILDREN, &after);
+
+    qsort(samples->data, samples->len, sizeof(gdouble), cgibench_compare);
+
+    name = flow->name;
+    fprintf(stdout, "%s_rate\t%.1f\treq/s\n",
+            name, (gdouble)options->iterations / total);
+    fprintf(stdout, "%s_p50\t%.1f\tus\n",
+            name, cgibench_percentile(samples, 50) * 1000000.0);
+    fprintf(stdout, "%s_p90\t%.1f\tus\n",
+            name, cgibench_percentile(samples, 90) * 1000000.0);
+    fprintf(stdout, "%s_p99\t%.1f\tus\n",
+            name, cgibench_percentile(samples, 99) * 1000000.0);
+
+    /* ru_oublock counts 512 byte blocks */
+    blocks = after.ru_oublock - before.ru_oublock;
+    fprintf(stdout, "%s_disk_write\t%.2f\tKiB\n",
+            name, ((gdouble)blocks * 512.0 / 1024.0) / options->iterations);
+
+    if (options->syscalls == FALSE)
+        goto out;
+
+    error = NULL;
+    fd = g_file_open_tmp("cgibenchXXXXXX", &trace_file, &error);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cgibench: Unable to create temporary file: %s\n",
+                error->message);
+        g_error_free(error);
+        rc = -EIO;
+        goto out;
+    }
+    close(fd);
+
+    syscalls = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    for (i = 0; i < CGIBENCH_TRACED; i++)
+    {
+        rc = cgibench_request(options, base, flow, trace_file);
+        if (rc != 0)
+            break;
+        calls = cgibench_count_syscalls(trace_file);
+        if (calls < 0)
+        {
+            fprintf(stderr, "cgibench: Unable to read strace summary\n");
+            rc = -EINVAL;
+            break;
+        }
+        elapsed = (gdouble)calls;
+        g_array_append_val(syscalls, elapsed);
+    }
+
+    if (rc == 0)
+    {
+        qsort(syscalls->data, syscalls->len, sizeof(gdouble),
+              cgibench_compare);
+        fprintf(stdout, "%s_syscalls\t%.0f\tcalls\n",
+                name, cgibench_percentile(syscalls, 50));
+    }
+
+    g_array_free(syscalls, TRUE);
+    unlink(trace_file);
+    g_free(trace_file);
+
+out:
+    g_timer_destroy(timer);
+    g_array_free(samples, TRUE);
+
+    return(rc);
+}  /* cgibench_flow() */
+
+
+/*
+ * static gint cgibench_run(CGIBenchOptions *options)
+ *
+ * Sets up the database and times each flow against it.
+ */
+static gint cgibench_run(CGIBenchOptions *options)
+{
+    gint rc;
+    guint i;
+    gchar *base;
+
+    if (options->syscalls != FALSE)
+    {
+        base = g_find_program_in_path("strace");
+        if (base == NULL)
+        {
+            fprintf(stderr,
+                    "cgibench: strace not found, syscalls will not be counted\n");
+            options->syscalls = FALSE;
+        }
+        g_free(base);
+    }
+
+    base = NULL;
+    rc = cgibench_setup(options, &base);
+    if (rc != 0)
+    {
+        fprintf(stderr, "cgibench: Unable to create the CGI database: %s\n",
+                g_strerror(-rc));
+        goto out;
+    }
+
+    fprintf(stdout, "# cgibench iterations=%u warmup=%u\n",
+            options->iterations, options->warmup);
+
+    for (i = 0; flows[i].name != NULL; i++)
+    {
+        rc = cgibench_flow(options, base, &(flows[i]));
+        if (rc != 0)
+            break;
+    }
+
+out:
+    if (base != NULL)
+    {
+        cgibench_remove_tree(base);
+        g_free(base);
+    }
+
+    return(rc);
+}  /* cgibench_run() */
+
+
+
+/*
+ * Main program
+ */
+gint main(gint argc, gchar *argv[])
+{
+    gint rc;
+    CGIBenchOptions options = {NULL, NULL, CGIBENCH_ITERATIONS,
+                               CGIBENCH_WARMUP, TRUE};
+
+    rc = load_options(&options, argc, argv);
+    if (rc < 0)
+        print_usage(rc);
+    else if (rc > 0)
+        print_usage(0);
+
+    return(cgibench_run(&options) ? 1 : 0);
+}  /* main() */
@@ -0,0 +1,984 @@
+/*
+ * rastabench.c
+ *
+ * Microbenchmarks for librasta over a generated description
+ *
+ * Copyright (C) 2001 Oracle Corporation, Joel Becker
+ * <joel.becker@oracle.com> and Manish Singh <manish.singh@oracle.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+#include "rastacontext.h"
+#include "rastatraverse.h"
+#include "rastaprofile.h"
+#include "rastaexec.h"
+
+
+
+/*
+ * Defines
+ */
+#define BENCH_SCREENS           1000
+#define BENCH_FANOUT            8
+#define BENCH_DEPTH             4
+#define BENCH_FIELDS            6
+#define BENCH_HELP              50      /* Percent with HELP */
+#define BENCH_ITERATIONS        20
+#define BENCH_NUMBERS           1000    /* Values per number check */
+#define BENCH_FORMAT            "1,9.0,2"       /* FORMAT of field f0 */
+#define BENCH_ESCAPE_SIZE       65536   /* Bytes in an escaped value */
+#define BENCH_ESCAPE_CALLS      100     /* Escapes per sample */
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _BenchOptions    BenchOptions;
+typedef struct _BenchNode       BenchNode;
+typedef gchar * (*BenchEscapeFunc) (const gchar *str);
+
+
+
+/*
+ * Structures
+ */
+struct _BenchOptions
+{
+    guint screens;
+    guint fanout;
+    guint depth;
+    guint fields;
+    guint help;
+    guint iterations;
+    gchar *generate;            /* Only write the description here */
+};
+
+/*
+ * One PATH entry of the generated description.  Menus have children,
+ * each dialog leads to the action with the same number.
+ */
+struct _BenchNode
+{
+    guint id;
+    guint depth;
+    gboolean menu;
+    BenchNode *parent;
+    GPtrArray *children;
+};
+
+
+
+/*
+ * Prototypes
+ */
+static void print_usage(gint rc);
+static gint load_options(BenchOptions *options, gint argc, gchar *argv[]);
+static BenchNode *bench_node_new(BenchNode *parent, guint id,
+                                 gboolean menu);
+static void bench_node_free(BenchNode *node);
+static BenchNode *bench_build_tree(BenchOptions *options,
+                                   GPtrArray *nodes,
+                                   BenchNode **deepest);
+static gboolean bench_wants_help(BenchOptions *options, guint *count);
+static void bench_write_path(FILE *f, BenchNode *node, guint indent);
+static gint bench_generate(BenchOptions *options,
+                           const gchar *filename,
+                           gchar **fastpath,
+                           GPtrArray **route);
+static void bench_sample(GArray *samples, GTimer *timer);
+static gint bench_compare(gconstpointer a, gconstpointer b);
+static void bench_report(const gchar *name, GArray *samples);
+static gint bench_state(BenchOptions *options,
+                        RastaContext *ctxt,
+                        const gchar *filename,
+                        const gchar *state_filename,
+                        RastaStateFlags flags,
+                        const gchar *prefix,
+                        GArray *samples,
+                        GTimer *timer);
+static gchar *bench_escape_single_old(const gchar *str);
+static gchar *bench_escape_double_old(const gchar *str);
+static void bench_escape(BenchOptions *options,
+                         const gchar *name,
+                         BenchEscapeFunc func,
+                         const gchar *value,
+                         GArray *samples,
+                         GTimer *timer);
+static gint bench_run(BenchOptions *options);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static void print_usage(gint rc)
+ *
+ * Prints a usage message and exits
+ */
+static void print_usage(gint rc)
+{
+    FILE *output;
+
+    output = rc ? stderr : stdout;
+
+    fprintf(output,
+            "Usage: rastabench [--screens <n>] [--fanout <n>] [--depth <n>] [--fields <n>] [--help-density <percent>] [--iterations <n>] [--generate <file>]\n");
+    exit(rc);
+}  /* print_usage() */
+
+
+/*
+ * static gint load_options(BenchOptions *options,
+ *                          gint argc,
+ *                          gchar *argv[])
+ *
+ * Loads all the options.
+ */
+static gint load_options(BenchOptions *options, gint argc, gchar *argv[])
+{
+    gint i;
+    guint *val;
+
+    for (i = 1; i < argc; i++)
+    {
+        val = NULL;
+        if ((strcmp(argv[i], "-h") == 0) ||
+            (strcmp(argv[i], "-?") == 0) ||
+            (strcmp(argv[i], "--help") == 0))
+            return(1);
+        else if (strcmp(argv[i], "--screens") == 0)
+            val = &(options->screens);
+        else if (strcmp(argv[i], "--fanout") == 0)
+            val = &(options->fanout);
+        else if (strcmp(argv[i], "--depth") == 0)
+            val = &(options->depth);
+        else if (strcmp(argv[i], "--fields") == 0)
+            val = &(options->fields);
+        else if (strcmp(argv[i], "--help-density") == 0)
+            val = &(options->help);
+        else if (strcmp(argv[i], "--iterations") == 0)
+            val = &(options->iterations);
+        else if (strcmp(argv[i], "--generate") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(-EINVAL);
+            options->generate = argv[i];
+            continue;
+        }
+        else
+            return(-EINVAL);
+
+        i++;
+        if ((i >= argc) || !g_ascii_isdigit(argv[i][0]))
+            return(-EINVAL);
+        *val = (guint)strtoul(argv[i], NULL, 10);
+    }
+
+    if ((options->fanout == 0) || (options->depth == 0) ||
+        (options->screens < 3) || (options->iterations == 0) ||
+        (options->help > 100))
+        return(-EINVAL);
+
+    return(0);
+}  /* load_options() */
+
+
+/*
+ * static BenchNode *bench_node_new(BenchNode *parent,
+ *                                  guint id,
+ *                                  gboolean menu)
+ *
+ * Creates a PATH entry below parent.
+ */
+static BenchNode *bench_node_new(BenchNode *parent, guint id,
+                                 gboolean menu)
+{
+    BenchNode *node;
+
+    node = g_new0(BenchNode, 1);
+    node->id = id;
+    node->menu = menu;
+    node->parent = parent;
+    node->depth = parent ? parent->depth + 1 : 0;
+    node->children = g_ptr_array_new();
+    if (parent != NULL)
+        g_ptr_array_add(parent->children, node);
+
+    return(node);
+}  /* bench_node_new() */
+
+
+/*
+ * static void bench_node_free(BenchNode *node)
+ *
+ * Frees a PATH entry.  Children are freed by their owner.
+ */
+static void bench_node_free(BenchNode *node)
+{
+    g_ptr_array_free(node->children, TRUE);
+    g_free(node);
+}  /* bench_node_free() */
+
+
+/*
+ * static BenchNode *bench_build_tree(BenchOptions *options,
+ *                                    GPtrArray *nodes,
+ *                                    BenchNode **deepest)
+ *
+ * Lays out the menu tree breadth first, so a small screen budget
+ * still gets the requested fan-out near the top.  Menus above the
+ * requested depth hold menus, the rest hold dialogs.  Each dialog
+ * and its action count as two screens.  Every node is added to
+ * nodes, and deepest is set to the last dialog created.
+ */
+static BenchNode *bench_build_tree(BenchOptions *options,
+                                   GPtrArray *nodes,
+                                   BenchNode **deepest)
+{
+    BenchNode *root, *node, *child;
+    guint pos, i, n_screens;
+    gboolean menu;
+
+    root = bench_node_new(NULL, 0, TRUE);
+    g_ptr_array_add(nodes, root);
+    n_screens = 1;
+    *deepest = NULL;
+
+    for (pos = 0; pos < nodes->len; pos++)
+    {
+        node = g_ptr_array_index(nodes, pos);
+        if (node->menu == FALSE)
+            continue;
+
+        menu = (node->depth + 1) < options->depth;
+        for (i = 0; i < options->fanout; i++)
+        {
+            if ((n_screens + (menu ? 1 : 2)) > options->screens)
+                break;
+
+            child = bench_node_new(node, nodes->len, menu);
+            g_ptr_array_add(nodes, child);
+            n_screens += menu ? 1 : 2;
+            if (menu == FALSE)
+                *deepest = child;
+        }
+    }
+
+    return(root);
+}  /* bench_build_tree() */
+
+
+/*
+ * static gboolean bench_wants_help(BenchOptions *options,
+ *                                  guint *count)
+ *
+ * Decides whether the next screen or field gets a HELP element, so
+ * that the requested percentage of them do.
+ */
+static gboolean bench_wants_help(BenchOptions *options, guint *count)
+{
+    return(((*count)++ % 100) < options->help);
+}  /* bench_wants_help() */
+
+
+/*
+ * static void bench_write_path(FILE *f, BenchNode *node, guint indent)
+ *
+ * Writes the PATH entry for node and everything below it.
+ */
+static void bench_write_path(FILE *f, BenchNode *node, guint indent)
+{
+    guint i;
+
+    if (node->menu == FALSE)
+    {
+        fprintf(f, "%*s<DIALOG NAME=\"d%u\">\n", indent, "", node->id);
+        fprintf(f, "%*s<ACTION NAME=\"a%u\"/>\n",
+                indent + 2, "", node->id);
+        fprintf(f, "%*s</DIALOG>\n", indent, "");
+        return;
+    }
+
+    fprintf(f, "%*s<MENU NAME=\"m%u\">\n", indent, "", node->id);
+    for (i = 0; i < node->children->len; i++)
+        bench_write_path(f, g_ptr_array_index(node->children, i),
+                         indent + 2);
+    fprintf(f, "%*s</MENU>\n", indent, "");
+}  /* bench_write_path() */
+
+
+/*
+ * static gint bench_generate(BenchOptions *options,
+ *                            const gchar *filename,
+ *                            gchar **fastpath,
+ *                            GPtrArray **route)
+ *
+ * Writes a valid description with the requested shape to filename.
+ * The first field of each dialog is numeric, with BENCH_FORMAT.  If
+ * fastpath is not NULL, it is set to the id of the deepest
+ * dialog.  If route is not NULL, it is set to the menu item ids
+ * leading from the top to that dialog.
+ */
+static gint bench_generate(BenchOptions *options,
+                           const gchar *filename,
+                           gchar **fastpath,
+                           GPtrArray **route)
+{
+    FILE *f;
+    GPtrArray *nodes;
+    BenchNode *root, *node, *deepest;
+    guint i, j, help_count;
+
+    g_return_val_if_fail(options != NULL, -EINVAL);
+    g_return_val_if_fail(filename != NULL, -EINVAL);
+
+    f = fopen(filename, "w");
+    if (f == NULL)
+        return(-errno);
+
+    nodes = g_ptr_array_new();
+    root = bench_build_tree(options, nodes, &deepest);
+
+    fprintf(f,
+            "<?xml version=\"1.0\"?>\n"
+            "<!DOCTYPE RASTA\n"
+            "  SYSTEM \"file:" _RASTA_DATA_DIR "/" RASTA_DTD "\">\n"
+            "<RASTA xmlns=\"" RASTA_NAMESPACE "\">\n"
+            "  <SCREENS>\n");
+
+    help_count = 0;
+    for (i = 0; i < nodes->len; i++)
+    {
+        node = g_ptr_array_index(nodes, i);
+        if (node->menu != FALSE)
+        {
+            fprintf(f, "    <MENUSCREEN ID=\"m%u\" TEXT=\"Menu %u\">\n",
+                    node->id, node->id);
+            if (bench_wants_help(options, &help_count))
+                fprintf(f, "      <HELP>Help for menu %u.</HELP>\n",
+                        node->id);
+            fprintf(f, "    </MENUSCREEN>\n");
+            continue;
+        }
+
+        fprintf(f, "    <DIALOGSCREEN ID=\"d%u\" TEXT=\"Dialog %u\">\n",
+                node->id, node->id);
+        if (bench_wants_help(options, &help_count))
+            fprintf(f, "      <HELP>Help for dialog %u.</HELP>\n",
+                    node->id);
+        for (j = 0; j < options->fields; j++)
+        {
+            fprintf(f,
+                    "      <FIELD NAME=\"f%u\" TYPE=\"entry\" TEXT=\"Field %u\"%s>\n",
+                    j, j,
+                    (j == 0) ?
+                    " NUMERIC=\"true\" FORMAT=\"" BENCH_FORMAT "\"" : "");
+            if (bench_wants_help(options, &help_count))
+                fprintf(f, "        <HELP>Help for field %u.</HELP>\n",
+                        j);
+            fprintf(f, "      </FIELD>\n");
+        }
+        fprintf(f, "    </DIALOGSCREEN>\n");
+
+        fprintf(f,
+                "    <ACTIONSCREEN ID=\"a%u\" TEXT=\"Action %u\" TTY=\"no\">\n"
+                "      <ACTIONCOMMAND ESCAPESTYLE=\"single\">echo",
+                node->id, node->id);
+        for (j = 0; j < options->fields; j++)
+            fprintf(f, " '#f%u#'", j);
+        fprintf(f,
+                "</ACTIONCOMMAND>\n"
+                "    </ACTIONSCREEN>\n");
+    }
+
+    fprintf(f,
+            "  </SCREENS>\n"
+            "  <PATH>\n");
+    bench_write_path(f, root, 4);
+    fprintf(f,
+            "  </PATH>\n"
+            "</RASTA>\n");
+
+    if (fastpath != NULL)
+        *fastpath = deepest ? g_strdup_printf("d%u", deepest->id) : NULL;
+    if (route != NULL)
+    {
+        *route = g_ptr_array_new();
+        for (node = deepest; (node != NULL) && (node != root);
+             node = node->parent)
+            g_ptr_array_add(*route,
+                            g_strdup_printf("%c%u",
+                                            node->menu ? 'm' : 'd',
+                                            node->id));
+    }
+
+    for (i = 0; i < nodes->len; i++)
+        bench_node_free(g_ptr_array_index(nodes, i));
+    g_ptr_array_free(nodes, TRUE);
+
+    if (fclose(f) != 0)
+        return(-errno);
+
+    return(0);
+}  /* bench_generate() */
+
+
+/*
+ * static void bench_sample(GArray *samples, GTimer *timer)
+ *
+ * Records the time of the last timer run.
+ */
+static void bench_sample(GArray *samples, GTimer *timer)
+{
+    gdouble elapsed;
+
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_array_append_val(samples, elapsed);
+}  /* bench_sample() */
+
+
+/*
+ * static gint bench_compare(gconstpointer a, gconstpointer b)
+ *
+ * Orders two samples.
+ */
+static gint bench_compare(gconstpointer a, gconstpointer b)
+{
+    gdouble da, db;
+
+    da = *(const gdouble *)a;
+    db = *(const gdouble *)b;
+
+    return((da < db) ? -1 : (da > db));
+}  /* bench_compare() */
+
+
+/*
+ * static void bench_report(const gchar *name, GArray *samples)
+ *
+ * Prints the median of samples, in microseconds.  Each result is a
+ * line of "name<TAB>value<TAB>unit", which is what benchcheck reads.
+ */
+static void bench_report(const gchar *name, GArray *samples)
+{
+    gdouble median;
+
+    if (samples->len == 0)
+        return;
+
+    qsort(samples->data, samples->len, sizeof(gdouble), bench_compare);
+    median = g_array_index(samples, gdouble, samples->len / 2);
+
+    fprintf(stdout, "%s\t%.3f\tus\n", name, median * 1000000.0);
+    g_array_set_size(samples, 0);
+}  /* bench_report() */
+
+
+/*
+ * static gchar *bench_escape_single_old(const gchar *str)
+ *
+ * rasta_escape_single() as it was, a character at a time, to
+ * compare against.
+ */
+static gchar *bench_escape_single_old(const gchar *str)
+{
+    GString *buf;
+    gint i, len;
+    gchar *ret;
+
+    len = strlen(str);
+    buf = g_string_sized_new(len);
+
+    for (i = 0; i < len; i++)
+    {
+        if (str[i] == '\'')
+            g_string_append(buf, "'\\''");
+        else
+            g_string_append_c(buf, str[i]);
+    }
+
+    ret = g_strdup(buf->str);
+    g_string_free(buf, TRUE);
+
+    return(ret);
+}  /* bench_escape_single_old() */
+
+
+/*
+ * static gchar *bench_escape_double_old(const gchar *str)
+ *
+ * rasta_escape_double() as it was.
+ */
+static gchar *bench_escape_double_old(const gchar *str)
+{
+    GString *buf;
+    gint i, len;
+    gchar *ret;
+
+    len = strlen(str);
+    buf = g_string_sized_new(len);
+
+    for (i = 0; i < len; i++)
+    {
+        switch (str[i])
+        {
+            case '"':
+            case '*':
+            case '[':
+            case ']':
+            case '\\':
+                g_string_append_c(buf, '\\');
+                g_string_append_c(buf, str[i]);
+                break;
+
+            default:
+                g_string_append_c(buf, str[i]);
+                break;
+        }
+    }
+
+    ret = g_strdup(buf->str);
+    g_string_free(buf, TRUE);
+
+    return(ret);
+}  /* bench_escape_double_old() */
+
+
+/*
+ * static void bench_escape(BenchOptions *options,
+ *                          const gchar *name,
+ *                          BenchEscapeFunc func,
+ *                          const gchar *value,
+ *                          GArray *samples,
+ *                          GTimer *timer)
+ *
+ * Times BENCH_ESCAPE_CALLS escapes of value and reports them as
+ * name.
+ */
+static void bench_escape(BenchOptions *options,
+                         const gchar *name,
+                         BenchEscapeFunc func,
+                         const gchar *value,
+                         GArray *samples,
+                         GTimer *timer)
+{
+    guint i, j;
+
+    for (i = 0; i < options->iterations; i++)
+    {
+        g_timer_start(timer);
+        for (j = 0; j < BENCH_ESCAPE_CALLS; j++)
+            g_free(func(value));
+        g_timer_stop(timer);
+        bench_sample(samples, timer);
+    }
+    bench_report(name, samples);
+}  /* bench_escape() */
+
+
+/*
+ * static gint bench_state(BenchOptions *options,
+ *                         RastaContext *ctxt,
+ *                         const gchar *filename,
+ *                         const gchar *state_filename,
+ *                         RastaStateFlags flags,
+ *                         const gchar *prefix,
+ *                         GArray *samples,
+ *                         GTimer *timer)
+ *
+ * Times saving ctxt's state in the given format, then loading it
+ * into fresh contexts.  Reports <prefix>_save, <prefix>_load and
+ * <prefix>_size.
+ */
+static gint bench_state(BenchOptions *options,
+                        RastaContext *ctxt,
+                        const gchar *filename,
+                        const gchar *state_filename,
+                        RastaStateFlags flags,
+                        const gchar *prefix,
+                        GArray *samples,
+                        GTimer *timer)
+{
+    gint rc, size;
+    guint i;
+    gchar *str, *name;
+    RastaContext *state_ctxt;
+
+    size = 0;
+    for (i = 0; i < options->iterations; i++)
+    {
+        g_timer_start(timer);
+        rasta_context_save_state_memory_full(ctxt, &str, &size, flags);
+        g_timer_stop(timer);
+        xmlFree(str);
+        bench_sample(samples, timer);
+    }
+    name = g_strdup_printf("%s_save", prefix);
+    bench_report(name, samples);
+    g_free(name);
+    fprintf(stdout, "%s_size\t%d\tbytes\n", prefix, size);
+
+    if (rasta_context_save_state_full(ctxt, state_filename, flags) != 0)
+    {
+        fprintf(stderr, "rastabench: Unable to save state\n");
+        return(-EIO);
+    }
+    for (i = 0; i < options->iterations; i++)
+    {
+        state_ctxt = rasta_context_init(filename, NULL);
+        if (state_ctxt == NULL)
+            return(-EINVAL);
+        g_timer_start(timer);
+        rc = rasta_context_load_state(state_ctxt, state_filename);
+        g_timer_stop(timer);
+        rasta_context_destroy(state_ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastabench: Unable to load state: %s\n",
+                    g_strerror(-rc));
+            return(rc);
+        }
+        bench_sample(samples, timer);
+    }
+    name = g_strdup_printf("%s_load", prefix);
+    bench_report(name, samples);
+    g_free(name);
+
+    return(0);
+}  /* bench_state() */
+
+
+/*
+ * static gint bench_run(BenchOptions *options)
+ *
+ * Generates a description and times librasta against it.
+ */
+static gint bench_run(BenchOptions *options)
+{
+    gint rc, fd;
+    gint *results;
+    const gchar * const *values;
+    guint i, j;
+    gchar *filename, *state_filename, *fastpath, *cmd, *text;
+    gchar *sym_name;
+    GPtrArray *route, *numbers;
+    GArray *samples, *menu_samples;
+    GTimer *timer;
+    GString *cmd_str;
+    GError *error;
+    xmlNodePtr saved_root;
+    RastaContext *ctxt;
+    RastaDialogField *number_field;
+    REnumeration cursor;
+    struct rusage usage;
+
+    fastpath = NULL;
+    route = NULL;
+    error = NULL;
+    fd = g_file_open_tmp("rastabenchXXXXXX", &filename, &error);
+    if (fd < 0)
+    {
+        fprintf(stderr, "rastabench: Unable to create temporary file: %s\n",
+                error->message);
+        g_error_free(error);
+        return(-EIO);
+    }
+    close(fd);
+    fd = g_file_open_tmp("rastabenchXXXXXX", &state_filename, &error);
+    if (fd < 0)
+    {
+        fprintf(stderr, "rastabench: Unable to create temporary file: %s\n",
+                error->message);
+        g_error_free(error);
+        unlink(filename);
+        g_free(filename);
+        return(-EIO);
+    }
+    close(fd);
+
+    rc = bench_generate(options, filename, &fastpath, &route);
+    if ((rc != 0) || (fastpath == NULL))
+    {
+        fprintf(stderr, "rastabench: Unable to generate description: %s\n",
+                rc ? g_strerror(-rc) : "Too few screens");
+        rc = rc ? rc : -EINVAL;
+        goto out;
+    }
+
+    fprintf(stdout,
+            "# rastabench screens=%u fanout=%u depth=%u fields=%u help=%u iterations=%u\n",
+            options->screens, options->fanout, options->depth,
+            options->fields, options->help, options->iterations);
+
+    samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    menu_samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+    timer = g_timer_new();
+    rc = -EINVAL;
+
+    /* Parse and validate */
+    ctxt = NULL;
+    for (i = 0; i < options->iterations; i++)
+    {
+        if (ctxt != NULL)
+            rasta_context_destroy(ctxt);
+        g_timer_start(timer);
+        ctxt = rasta_context_init(filename, NULL);
+        g_timer_stop(timer);
+        if (ctxt == NULL)
+        {
+            fprintf(stderr, "rastabench: Unable to load description\n");
+            goto out_timer;
+        }
+        bench_sample(samples, timer);
+    }
+    bench_report("context_init", samples);
+
+    /* Fastpath search from the top of the PATH */
+    saved_root = ctxt->path_root;
+    for (i = 0; i < options->iterations; i++)
+    {
+        ctxt->fastpath = fastpath;
+        g_timer_start(timer);
+        rasta_find_fastpath(ctxt);
+        g_timer_stop(timer);
+        ctxt->fastpath = NULL;
+        ctxt->path_root = saved_root;
+        bench_sample(samples, timer);
+    }
+    bench_report("find_fastpath", samples);
+
+    /* Walk down to the deepest dialog and back */
+    cmd_str = g_string_new("echo");
+    for (j = 0; j < options->fields; j++)
+        g_string_append_printf(cmd_str, " '#f%u#'", j);
+
+    number_field = NULL;
+    for (i = 0; i < options->iterations; i++)
+    {
+        /* route runs from the dialog back up to the top */
+        for (j = route->len; j > 0; j--)
+        {
+            g_timer_start(timer);
+            rasta_menu_screen_next(ctxt,
+                                   g_ptr_array_index(route, j - 1));
+            g_timer_stop(timer);
+            bench_sample(menu_samples, timer);
+        }
+
+        /* The last dialog stays loaded under the action screen */
+        if (i == (options->iterations - 1))
+        {
+            rasta_dialog_screen_init_cursor(ctxt,
+                                            rasta_context_get_screen(ctxt),
+                                            &cursor);
+            if (r_enumeration_has_more(&cursor))
+                number_field = r_enumeration_get_next(&cursor);
+        }
+
+        for (j = 0; j < options->fields; j++)
+        {
+            sym_name = g_strdup_printf("f%u", j);
+            text = g_strdup_printf("value's %u", j);
+            rasta_symbol_put(ctxt, sym_name, text);
+            g_free(text);
+            g_free(sym_name);
+        }
+
+        g_timer_start(timer);
+        rasta_dialog_screen_next(ctxt);
+        g_timer_stop(timer);
+        bench_sample(samples, timer);
+
+        if (i < (options->iterations - 1))
+        {
+            for (j = 0; j <= route->len; j++)
+                rasta_screen_previous(ctxt);
+        }
+    }
+    bench_report("menu_screen_next", menu_samples);
+    bench_report("dialog_screen_next", samples);
+
+    /* Symbol substitution on the action screen */
+    for (i = 0; i < options->iterations; i++)
+    {
+        g_timer_start(timer);
+        cmd = rasta_exec_symbol_subst(ctxt, cmd_str->str,
+                                      RASTA_ESCAPE_STYLE_SINGLE);
+        g_timer_stop(timer);
+        g_free(cmd);
+        bench_sample(samples, timer);
+    }
+    bench_report("exec_symbol_subst", samples);
+    g_string_free(cmd_str, TRUE);
+
+    /*
+     * A batch of numbers checked against one FORMAT, a value at a
+     * time and then all at once against the loaded numeric field.
+     */
+    numbers = g_ptr_array_new();
+    for (j = 0; j < BENCH_NUMBERS; j++)
+        g_ptr_array_add(numbers, g_strdup_printf("%u.%02u", j * 7, j % 100));
+    for (i = 0; i < options->iterations; i++)
+    {
+        g_timer_start(timer);
+        for (j = 0; j < numbers->len; j++)
+            rasta_verify_number_format(BENCH_FORMAT,
+                                       g_ptr_array_index(numbers, j));
+        g_timer_stop(timer);
+        bench_sample(samples, timer);
+    }
+    bench_report("verify_number_format", samples);
+    if (number_field != NULL)
+    {
+        values = (const gchar * const *)numbers->pdata;
+        results = g_new(gint, numbers->len);
+        for (i = 0; i < options->iterations; i++)
+        {
+            g_timer_start(timer);
+            rasta_dialog_field_validate_many(number_field, values,
+                                             numbers->len, results);
+            g_timer_stop(timer);
+            bench_sample(samples, timer);
+        }
+        bench_report("dialog_field_validate_many", samples);
+        g_free(results);
+    }
+    for (j = 0; j < numbers->len; j++)
+        g_free(g_ptr_array_index(numbers, j));
+    g_ptr_array_free(numbers, TRUE);
+
+    /*
+     * Escaping a large value, old and new.  "plain" has nothing to
+     * escape, "quoted" has a special character every 64 bytes.
+     */
+    text = g_malloc(BENCH_ESCAPE_SIZE + 1);
+    for (j = 0; j < BENCH_ESCAPE_SIZE; j++)
+        text[j] = 'a' + (j % 26);
+    text[BENCH_ESCAPE_SIZE] = '\0';
+    bench_escape(options, "escape_single_plain_old",
+                 bench_escape_single_old, text, samples, timer);
+    bench_escape(options, "escape_single_plain",
+                 rasta_escape_single, text, samples, timer);
+    bench_escape(options, "escape_double_plain_old",
+                 bench_escape_double_old, text, samples, timer);
+    bench_escape(options, "escape_double_plain",
+                 rasta_escape_double, text, samples, timer);
+    for (j = 63; j < BENCH_ESCAPE_SIZE; j += 64)
+        text[j] = ((j / 64) % 2) ? '\'' : '"';
+    bench_escape(options, "escape_single_quoted_old",
+                 bench_escape_single_old, text, samples, timer);
+    bench_escape(options, "escape_single_quoted",
+                 rasta_escape_single, text, samples, timer);
+    bench_escape(options, "escape_double_quoted_old",
+                 bench_escape_double_old, text, samples, timer);
+    bench_escape(options, "escape_double_quoted",
+                 rasta_escape_double, text, samples, timer);
+    g_free(text);
+
+    /* State save, then restore into fresh contexts */
+    rc = bench_state(options, ctxt, filename, state_filename,
+                     RASTA_STATE_XML, "state", samples, timer);
+    if (rc != 0)
+        goto out_ctxt;
+    rc = bench_state(options, ctxt, filename, state_filename,
+                     RASTA_STATE_BINARY, "state_binary", samples, timer);
+    if (rc != 0)
+        goto out_ctxt;
+    rc = bench_state(options, ctxt, filename, state_filename,
+                     RASTA_STATE_BINARY | RASTA_STATE_LIVE_ONLY,
+                     "state_live", samples, timer);
+    if (rc != 0)
+        goto out_ctxt;
+
+    /* ru_maxrss is in kilobytes */
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        fprintf(stdout, "peak_rss\t%ld\tKiB\n", usage.ru_maxrss);
+
+    rc = 0;
+
+out_ctxt:
+    rasta_context_destroy(ctxt);
+out_timer:
+    g_timer_destroy(timer);
+    g_array_free(menu_samples, TRUE);
+    g_array_free(samples, TRUE);
+out:
+    if (route != NULL)
+    {
+        for (i = 0; i < route->len; i++)
+            g_free(g_ptr_array_index(route, i));
+        g_ptr_array_free(route, TRUE);
+    }
+    g_free(fastpath);
+    unlink(state_filename);
+    g_free(state_filename);
+    unlink(filename);
+    g_free(filename);
+
+    return(rc);
+}  /* bench_run() */
+
+
+
+/*
+ * Main program
+ */
+gint main(gint argc, gchar *argv[])
+{
+    gint rc;
+    BenchOptions options = {BENCH_SCREENS, BENCH_FANOUT, BENCH_DEPTH,
+                            BENCH_FIELDS, BENCH_HELP, BENCH_ITERATIONS,
+                            NULL};
+
+    rc = load_options(&options, argc, argv);
+    if (rc < 0)
+        print_usage(rc);
+    else if (rc > 0)
+        print_usage(0);
+
+    if (options.generate != NULL)
+    {
+        rc = bench_generate(&options, options.generate, NULL, NULL);
+        if (rc != 0)
+            fprintf(stderr, "rastabench: Unable to write %s: %s\n",
+                    options.generate, g_strerror(-rc));
+        return(rc ? 1 : 0);
+    }
+
+    return(bench_run(&options) ? 1 : 0);
+}  /* main() */
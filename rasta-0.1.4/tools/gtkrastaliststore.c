@@ -43,9 +43,32 @@
 #define GTK_RASTA_LIST_STORE_IS_SORTED(list) (GTK_RASTA_LIST_STORE (list)->sort_column_id != -1)
 #define VALID_ITER(iter, rasta_list_store) (iter!= NULL && iter->user_data != NULL && rasta_list_store->stamp == iter->stamp)
 
+enum
+{
+  COLUMN_TYPE,
+  COLUMN_NAME,
+  N_COLUMNS
+};
+
+/* What the view asks for, decoded once per FIELD */
+typedef struct _GtkRastaListRow GtkRastaListRow;
+struct _GtkRastaListRow
+{
+  xmlNodePtr node;
+  gint index;
+  gchar *columns[N_COLUMNS];
+};
+
+static GObjectClass *parent_class = NULL;
+
 static void         gtk_rasta_list_store_init            (GtkRastaListStore      *rasta_list_store);
 static void         gtk_rasta_list_store_class_init      (GtkRastaListStoreClass *class);
 static void         gtk_rasta_list_store_tree_model_init (GtkTreeModelIface *iface);
+static void         gtk_rasta_list_store_finalize        (GObject           *object);
+static void         gtk_rasta_list_store_invalidate      (GtkRastaListStore *rasta_list_store);
+static void         gtk_rasta_list_store_build_rows      (GtkRastaListStore *rasta_list_store);
+static GtkRastaListRow *gtk_rasta_list_store_lookup_row  (GtkRastaListStore *rasta_list_store,
+                                                          xmlNodePtr         node);
 #if 0 /* Drag */
 static void         gtk_rasta_list_store_drag_source_init(GtkTreeDragSourceIface *iface);
 static void         gtk_rasta_list_store_drag_dest_init  (GtkTreeDragDestIface   *iface);
@@ -175,6 +198,10 @@ gtk_rasta_list_store_class_init (GtkRastaListStoreClass *class)
   GObjectClass *object_class;
 
   object_class = (GObjectClass*) class;
+
+  parent_class = g_type_class_peek_parent (class);
+
+  object_class->finalize = gtk_rasta_list_store_finalize;
 }
 
 static void
@@ -215,6 +242,84 @@ gtk_rasta_list_store_init (GtkRastaListStore *rasta_list_store)
 {
   rasta_list_store->stamp = g_random_int ();
   rasta_list_store->screen_node = NULL;
+  rasta_list_store->rows = NULL;
+  rasta_list_store->row_index = NULL;
+}
+
+static void
+gtk_rasta_list_store_finalize (GObject *object)
+{
+  gtk_rasta_list_store_invalidate (GTK_RASTA_LIST_STORE (object));
+
+  (* parent_class->finalize) (object);
+}
+
+/* The row cache.  Anything that changes which FIELD children the
+ * screen has, or their order, must call
+ * gtk_rasta_list_store_invalidate(); the next lookup rebuilds it.
+ */
+static void
+gtk_rasta_list_store_invalidate (GtkRastaListStore *rasta_list_store)
+{
+  GtkRastaListRow *row;
+  guint i;
+
+  if (rasta_list_store->rows == NULL)
+    return;
+
+  for (i = 0; i < rasta_list_store->rows->len; i++)
+    {
+      row = g_ptr_array_index (rasta_list_store->rows, i);
+      g_free (row->columns[COLUMN_TYPE]);
+      g_free (row->columns[COLUMN_NAME]);
+      g_free (row);
+    }
+  g_ptr_array_free (rasta_list_store->rows, TRUE);
+  rasta_list_store->rows = NULL;
+
+  g_hash_table_destroy (rasta_list_store->row_index);
+  rasta_list_store->row_index = NULL;
+}
+
+static void
+gtk_rasta_list_store_build_rows (GtkRastaListStore *rasta_list_store)
+{
+  GtkRastaListRow *row;
+  xmlNodePtr cur;
+
+  if (rasta_list_store->rows != NULL)
+    return;
+
+  rasta_list_store->rows = g_ptr_array_new ();
+  rasta_list_store->row_index = g_hash_table_new (g_direct_hash,
+                                                  g_direct_equal);
+
+  for (cur = rasta_list_store->screen_node->children;
+       cur != NULL;
+       cur = cur->next)
+    {
+      if ((cur->type != XML_ELEMENT_NODE) ||
+          (xmlStrcmp (cur->name, "FIELD") != 0))
+        continue;
+
+      row = g_new (GtkRastaListRow, 1);
+      row->node = cur;
+      row->index = rasta_list_store->rows->len;
+      row->columns[COLUMN_TYPE] = xmlGetProp (cur, "TYPE");
+      row->columns[COLUMN_NAME] = xmlGetProp (cur, "NAME");
+
+      g_ptr_array_add (rasta_list_store->rows, row);
+      g_hash_table_insert (rasta_list_store->row_index, cur, row);
+    }
+}
+
+static GtkRastaListRow *
+gtk_rasta_list_store_lookup_row (GtkRastaListStore *rasta_list_store,
+                                 xmlNodePtr         node)
+{
+  gtk_rasta_list_store_build_rows (rasta_list_store);
+
+  return g_hash_table_lookup (rasta_list_store->row_index, node);
 }
 
 /**
@@ -273,7 +378,7 @@ gtk_rasta_list_store_get_n_columns (GtkTreeModel *tree_model)
 {
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), 0);
 
-  return 2;
+  return N_COLUMNS;
 }
 
 static GType
@@ -281,7 +386,7 @@ gtk_rasta_list_store_get_column_type (GtkTreeModel *tree_model,
 				gint          index)
 {
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), G_TYPE_INVALID);
-  g_return_val_if_fail (index < 2 && index >= 0, G_TYPE_INVALID);
+  g_return_val_if_fail (index < N_COLUMNS && index >= 0, G_TYPE_INVALID);
 
   return G_TYPE_STRING;
 }
@@ -291,7 +396,8 @@ gtk_rasta_list_store_get_iter (GtkTreeModel *tree_model,
 			 GtkTreeIter  *iter,
 			 GtkTreePath  *path)
 {
-    xmlNodePtr cur;
+  GtkRastaListStore *rasta_list_store;
+  GtkRastaListRow *row;
   gint i;
 
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), FALSE);
@@ -299,27 +405,14 @@ gtk_rasta_list_store_get_iter (GtkTreeModel *tree_model,
 
   i = gtk_tree_path_get_indices (path)[0];
 
-  cur = GTK_RASTA_LIST_STORE(tree_model)->screen_node;
-  cur = cur->children;
-  while (cur != NULL)
-  {
-      g_assert(i >= 0);
-
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-      {
-          if (i == 0)
-              break;
-          else
-              i--;
-      }
-      cur = cur->next;
-  }
-  if (cur == NULL)
+  rasta_list_store = GTK_RASTA_LIST_STORE (tree_model);
+  gtk_rasta_list_store_build_rows (rasta_list_store);
+  if ((i < 0) || (i >= (gint)rasta_list_store->rows->len))
       return FALSE;
-  
-  iter->stamp = GTK_RASTA_LIST_STORE (tree_model)->stamp;
-  iter->user_data = cur;
+  row = g_ptr_array_index (rasta_list_store->rows, i);
+
+  iter->stamp = rasta_list_store->stamp;
+  iter->user_data = row->node;
   return TRUE;
 }
 
@@ -328,31 +421,18 @@ gtk_rasta_list_store_get_path (GtkTreeModel *tree_model,
 			 GtkTreeIter  *iter)
 {
   GtkTreePath *retval;
-  xmlNodePtr cur = NULL;
-  gint i = 0;
+  GtkRastaListRow *row;
 
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), NULL);
   g_return_val_if_fail (VALID_ITER(iter, GTK_RASTA_LIST_STORE(tree_model)), NULL);
 
-  cur = GTK_RASTA_LIST_STORE(tree_model)->screen_node;
-  cur = cur->children;
-  while (cur != NULL)
-  {
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-      {
-          if (cur == (xmlNodePtr)iter->user_data)
-              break;
-          else
-              i++;
-      }
-      cur = cur->next;
-  }
-  if (cur == NULL)
+  row = gtk_rasta_list_store_lookup_row (GTK_RASTA_LIST_STORE (tree_model),
+                                         (xmlNodePtr)iter->user_data);
+  if (row == NULL)
     return NULL;
 
   retval = gtk_tree_path_new ();
-  gtk_tree_path_append_index (retval, i);
+  gtk_tree_path_append_index (retval, row->index);
   return retval;
 }
 
@@ -362,26 +442,21 @@ gtk_rasta_list_store_get_value (GtkTreeModel *tree_model,
 			  gint          column,
 			  GValue       *value)
 {
-    gchar *tmp = NULL;
-    xmlNodePtr cur;
+  GtkRastaListRow *row;
+  const gchar *tmp;
 
   g_return_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model));
   g_return_if_fail (VALID_ITER(iter, GTK_RASTA_LIST_STORE(tree_model)));
-  g_return_if_fail(((xmlNodePtr)iter->user_data)->type == XML_ELEMENT_NODE);
-  g_return_if_fail(xmlStrcmp(((xmlNodePtr)iter->user_data)->name, "FIELD") == 0);
-  g_return_if_fail (column < 2);
+  g_return_if_fail (column >= 0 && column < N_COLUMNS);
 
+  row = gtk_rasta_list_store_lookup_row (GTK_RASTA_LIST_STORE (tree_model),
+                                         (xmlNodePtr)iter->user_data);
+  g_return_if_fail (row != NULL);
 
-  cur = (xmlNodePtr)iter->user_data;
   g_value_init(value, G_TYPE_STRING);
-  if (column == 0)
-      tmp = xmlGetProp(cur, "TYPE");
-  else if (column == 1)
-      tmp = xmlGetProp(cur, "NAME");
-  else
-      g_assert_not_reached();
+  tmp = row->columns[column];
   if (tmp == NULL)
-      tmp = g_strdup("(null)");
+      tmp = "(null)";
   g_value_set_string(value, tmp);
 }
 
@@ -389,22 +464,22 @@ static gboolean
 gtk_rasta_list_store_iter_next (GtkTreeModel  *tree_model,
 			  GtkTreeIter   *iter)
 {
-    xmlNodePtr cur;
+  GtkRastaListStore *rasta_list_store;
+  GtkRastaListRow *row;
+
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), FALSE);
   g_return_val_if_fail (VALID_ITER(iter, GTK_RASTA_LIST_STORE(tree_model)), FALSE);
 
-  cur = (xmlNodePtr)iter->user_data;
-  cur = cur->next;
-  while (cur != NULL)
-  {
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-          break;
-
-      cur = cur->next;
-  }
-
-  iter->user_data = cur;
+  rasta_list_store = GTK_RASTA_LIST_STORE (tree_model);
+  row = gtk_rasta_list_store_lookup_row (rasta_list_store,
+                                         (xmlNodePtr)iter->user_data);
+  if ((row == NULL) || (row->index + 1 >= (gint)rasta_list_store->rows->len))
+    iter->user_data = NULL;
+  else
+    {
+      row = g_ptr_array_index (rasta_list_store->rows, row->index + 1);
+      iter->user_data = row->node;
+    }
 
   return (iter->user_data != NULL);
 }
@@ -414,8 +489,6 @@ gtk_rasta_list_store_iter_children (GtkTreeModel *tree_model,
 			      GtkTreeIter  *iter,
 			      GtkTreeIter  *parent)
 {
-    xmlNodePtr cur;
-
     g_return_val_if_fail(GTK_IS_RASTA_LIST_STORE(tree_model), FALSE);
     g_return_val_if_fail(GTK_RASTA_LIST_STORE(tree_model)->screen_node != NULL, FALSE);
 
@@ -426,25 +499,7 @@ gtk_rasta_list_store_iter_children (GtkTreeModel *tree_model,
   /* but if parent == NULL we return the list itself as children of the
    * "root"
    */
-
-  cur = GTK_RASTA_LIST_STORE(tree_model)->screen_node;
-  cur = cur->children;
-  while (cur != NULL)
-  {
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-          break;
-      cur = cur->next;
-  }
-
-  if (cur != NULL)
-  {
-      iter->stamp = GTK_RASTA_LIST_STORE (tree_model)->stamp;
-      iter->user_data = cur;
-      return TRUE;
-  }
-  else
-    return FALSE;
+  return gtk_rasta_list_store_iter_nth_child (tree_model, iter, NULL, 0);
 }
 
 static gboolean
@@ -458,24 +513,13 @@ static gint
 gtk_rasta_list_store_iter_n_children (GtkTreeModel *tree_model,
 				GtkTreeIter  *iter)
 {
-    xmlNodePtr cur;
-    gint i = 0;
-
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), -1);
   g_return_val_if_fail(GTK_RASTA_LIST_STORE(tree_model)->screen_node != NULL, -1);
 
   if (iter == NULL)
   {
-      cur = GTK_RASTA_LIST_STORE(tree_model)->screen_node;
-      cur = cur->children;
-      while (cur != NULL)
-      {
-          if ((cur->type == XML_ELEMENT_NODE) &&
-              (xmlStrcmp(cur->name, "FIELD") == 0))
-              i++;
-          cur = cur->next;
-      }
-      return(i);
+      gtk_rasta_list_store_build_rows (GTK_RASTA_LIST_STORE (tree_model));
+      return(GTK_RASTA_LIST_STORE (tree_model)->rows->len);
   }
 
   g_return_val_if_fail (GTK_RASTA_LIST_STORE (tree_model)->stamp == iter->stamp, -1);
@@ -488,7 +532,8 @@ gtk_rasta_list_store_iter_nth_child (GtkTreeModel *tree_model,
 			       GtkTreeIter  *parent,
 			       gint          n)
 {
-    xmlNodePtr cur;
+  GtkRastaListStore *rasta_list_store;
+  GtkRastaListRow *row;
 
   g_return_val_if_fail (GTK_IS_RASTA_LIST_STORE (tree_model), FALSE);
   g_return_val_if_fail(GTK_RASTA_LIST_STORE(tree_model)->screen_node != NULL, FALSE);
@@ -496,31 +541,15 @@ gtk_rasta_list_store_iter_nth_child (GtkTreeModel *tree_model,
   if (parent)
     return FALSE;
 
-  cur = GTK_RASTA_LIST_STORE(tree_model)->screen_node;
-  cur = cur->children;
-  while (cur != NULL)
-  {
-      g_assert(n >= 0);
-
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-      {
-          if (n == 0)
-              break;
-          else
-              n--;
-      }
-      cur = cur->next;
-  }
-
-  if (cur != NULL)
-    {
-      iter->stamp = GTK_RASTA_LIST_STORE (tree_model)->stamp;
-      iter->user_data = cur;
-      return TRUE;
-    }
-  else
+  rasta_list_store = GTK_RASTA_LIST_STORE (tree_model);
+  gtk_rasta_list_store_build_rows (rasta_list_store);
+  if ((n < 0) || (n >= (gint)rasta_list_store->rows->len))
     return FALSE;
+  row = g_ptr_array_index (rasta_list_store->rows, n);
+
+  iter->stamp = rasta_list_store->stamp;
+  iter->user_data = row->node;
+  return TRUE;
 }
 
 static gboolean
@@ -572,9 +601,14 @@ gtk_rasta_list_store_remove (GtkRastaListStore *rasta_list_store,
   g_return_if_fail (GTK_IS_RASTA_LIST_STORE (rasta_list_store));
   g_return_if_fail (VALID_ITER (iter, rasta_list_store));
 
+  path = gtk_rasta_list_store_get_path (GTK_TREE_MODEL (rasta_list_store),
+                                        iter);
+  g_return_if_fail (path != NULL);
+
   cur = (xmlNodePtr)iter->user_data;
   xmlUnlinkNode(cur);
   xmlFreeNode(cur);
+  gtk_rasta_list_store_invalidate (rasta_list_store);
 
   rasta_list_store->stamp ++;
   gtk_tree_model_row_deleted (GTK_TREE_MODEL (rasta_list_store), path);
@@ -648,6 +682,7 @@ gtk_rasta_list_store_insert (GtkRastaListStore *rasta_list_store,
   iter->stamp = rasta_list_store->stamp;
   iter->user_data = new_list;
 
+  gtk_rasta_list_store_invalidate (rasta_list_store);
   validate_rasta_list_store (rasta_list_store);
 
   path = gtk_tree_path_new ();
@@ -735,6 +770,7 @@ gtk_rasta_list_store_insert_before (GtkRastaListStore *rasta_list_store,
 
   rasta_list_store->length += 1;
 
+  gtk_rasta_list_store_invalidate (rasta_list_store);
   validate_rasta_list_store (rasta_list_store);
 
   path = gtk_tree_path_new ();
@@ -787,6 +823,7 @@ gtk_rasta_list_store_insert_after (GtkRastaListStore *rasta_list_store,
   iter->stamp = rasta_list_store->stamp;
   iter->user_data = new_list;
 
+  gtk_rasta_list_store_invalidate (rasta_list_store);
   validate_rasta_list_store (rasta_list_store);
 
   path = gtk_tree_path_new ();
@@ -825,6 +862,7 @@ gtk_rasta_list_store_prepend (GtkRastaListStore *rasta_list_store,
 
   rasta_list_store->length += 1;
 
+  gtk_rasta_list_store_invalidate (rasta_list_store);
   validate_rasta_list_store (rasta_list_store);
 
   path = gtk_tree_path_new ();
@@ -850,6 +888,7 @@ gtk_rasta_list_store_append (GtkRastaListStore *rasta_list_store,
 		       GtkTreeIter  *iter)
 {
   GtkTreePath *path;
+  GtkRastaListRow *row;
   xmlNodePtr parent, cur;
   gint length;
 
@@ -864,6 +903,18 @@ gtk_rasta_list_store_append (GtkRastaListStore *rasta_list_store,
   xmlSetProp(cur, "TYPE", "readonly");
   xmlAddChild(parent, cur);
 
+  /* Appending can't move other rows, so extend the cache in place */
+  if (rasta_list_store->rows != NULL)
+    {
+      row = g_new (GtkRastaListRow, 1);
+      row->node = cur;
+      row->index = rasta_list_store->rows->len;
+      row->columns[COLUMN_TYPE] = g_strdup ("readonly");
+      row->columns[COLUMN_NAME] = g_strdup ("field0");
+      g_ptr_array_add (rasta_list_store->rows, row);
+      g_hash_table_insert (rasta_list_store->row_index, cur, row);
+    }
+
   iter->stamp = rasta_list_store->stamp;
   iter->user_data = cur;
 
@@ -880,26 +931,30 @@ gtk_rasta_list_store_append (GtkRastaListStore *rasta_list_store,
 void
 gtk_rasta_list_store_clear (GtkRastaListStore *rasta_list_store)
 {
-    xmlNodePtr screen, cur;
-    GtkTreeIter iter;
+  GtkRastaListRow *row;
+  GtkTreePath *path;
+  gint i;
 
   g_return_if_fail (GTK_IS_RASTA_LIST_STORE (rasta_list_store));
   g_return_if_fail (GTK_RASTA_LIST_STORE(rasta_list_store)->screen_node != NULL);
 
-  screen = GTK_RASTA_LIST_STORE(rasta_list_store)->screen_node;
-  cur = screen->children;
-  while (cur != NULL)
+  /* From the end, so the cache stays right for every "deleted" */
+  gtk_rasta_list_store_build_rows (rasta_list_store);
+  for (i = (gint)rasta_list_store->rows->len - 1; i >= 0; i--)
   {
-      if ((cur->type == XML_ELEMENT_NODE) &&
-          (xmlStrcmp(cur->name, "FIELD") == 0))
-      {
-          iter.stamp = rasta_list_store->stamp;
-          iter.user_data = cur;
-          gtk_rasta_list_store_remove(rasta_list_store, &iter);
-          /* inefficient, but don't trust changed xml */
-          cur = screen->children;
-      }
-      cur = cur->next;
+      row = g_ptr_array_remove_index (rasta_list_store->rows, i);
+      g_hash_table_remove (rasta_list_store->row_index, row->node);
+      xmlUnlinkNode(row->node);
+      xmlFreeNode(row->node);
+      g_free (row->columns[COLUMN_TYPE]);
+      g_free (row->columns[COLUMN_NAME]);
+      g_free (row);
+
+      rasta_list_store->stamp ++;
+      path = gtk_tree_path_new ();
+      gtk_tree_path_append_index (path, i);
+      gtk_tree_model_row_deleted (GTK_TREE_MODEL (rasta_list_store), path);
+      gtk_tree_path_free (path);
   }
 }
 
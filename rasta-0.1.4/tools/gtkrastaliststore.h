@@ -56,6 +56,8 @@ struct _GtkRastaListStore
   /*< private >*/
   gint stamp;
   xmlNodePtr screen_node;
+  GPtrArray *rows;              /* FIELD rows in order, NULL when stale */
+  GHashTable *row_index;        /* FIELD node -> row */
 };
 
 struct _GtkRastaListStoreClass
@@ -29,8 +29,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/sem.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 #include <errno.h>
 #include <gtk/gtk.h>
@@ -48,6 +49,24 @@
  */
 #define BACKUP_EXTENSION ".bak"
 #define TEMP_EXTENSION ".tmp"
+#define LOCK_EXTENSION ".lock"
+
+
+/*
+ * Prototypes
+ */
+static void rad_lock_alarm(gint signum);
+static RADPathNode *rad_path_node_new(xmlNodePtr node);
+static void rad_path_node_free(gpointer data);
+static gboolean rad_is_path_element(xmlNodePtr node);
+static void rad_path_node_add_child(RADPathNode *pnode, xmlNodePtr child);
+static RADPathNode *rad_path_node_lookup(RADPathNode *pnode,
+                                         const gchar *name);
+static RADPathNode *rad_find_path_node(RADContext *ctxt,
+                                       const gchar *path,
+                                       RADPathNode **parent,
+                                       gchar **leaf);
+
 
 
 /*
@@ -99,10 +118,250 @@ gint rad_validate_file(RADContext *ctxt)
     if ((ctxt->main.screens == NULL) || (ctxt->main.path == NULL))
         return(-ESRCH);
 
+    ctxt->path_trie = rad_path_node_new(ctxt->main.path);
+
+    ctxt->screen_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, NULL);
+    for (cur = ctxt->main.screens->children; cur != NULL; cur = cur->next)
+    {
+        if (rad_is_screen(cur))
+            rad_index_screen(ctxt, cur);
+    }
+
     return(0);
 }  /* rad_validate_file() */
 
 
+/*
+ * gboolean rad_is_screen(xmlNodePtr node)
+ *
+ * Returns TRUE if node is one of the screen elements.
+ */
+gboolean rad_is_screen(xmlNodePtr node)
+{
+    g_return_val_if_fail(node != NULL, FALSE);
+
+    return((node->type == XML_ELEMENT_NODE) &&
+           ((xmlStrcmp(node->name, "MENUSCREEN") == 0) ||
+            (xmlStrcmp(node->name, "DIALOGSCREEN") == 0) ||
+            (xmlStrcmp(node->name, "HIDDENSCREEN") == 0) ||
+            (xmlStrcmp(node->name, "ACTIONSCREEN") == 0)));
+}  /* rad_is_screen() */
+
+
+/*
+ * xmlNodePtr rad_lookup_screen(RADContext *ctxt, const gchar *id)
+ *
+ * Returns the screen of the main document with the given ID, or
+ * NULL if there is none.
+ */
+xmlNodePtr rad_lookup_screen(RADContext *ctxt, const gchar *id)
+{
+    g_return_val_if_fail(ctxt != NULL, NULL);
+    g_return_val_if_fail(ctxt->screen_index != NULL, NULL);
+    g_return_val_if_fail(id != NULL, NULL);
+
+    return((xmlNodePtr)g_hash_table_lookup(ctxt->screen_index, id));
+}  /* rad_lookup_screen() */
+
+
+/*
+ * void rad_index_screen(RADContext *ctxt, xmlNodePtr screen)
+ *
+ * Adds a screen of the main document to the ID index.  Screens
+ * without an ID are ignored.
+ */
+void rad_index_screen(RADContext *ctxt, xmlNodePtr screen)
+{
+    gchar *id;
+
+    g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(ctxt->screen_index != NULL);
+    g_return_if_fail(screen != NULL);
+
+    id = xmlGetProp(screen, "ID");
+    if (id == NULL)
+        return;
+
+    g_hash_table_replace(ctxt->screen_index, id, screen);
+}  /* rad_index_screen() */
+
+
+/*
+ * void rad_unindex_screen(RADContext *ctxt, const gchar *id)
+ *
+ * Removes a screen from the ID index.
+ */
+void rad_unindex_screen(RADContext *ctxt, const gchar *id)
+{
+    g_return_if_fail(ctxt != NULL);
+    g_return_if_fail(ctxt->screen_index != NULL);
+    g_return_if_fail(id != NULL);
+
+    g_hash_table_remove(ctxt->screen_index, id);
+}  /* rad_unindex_screen() */
+
+
+/*
+ * static RADPathNode *rad_path_node_new(xmlNodePtr node)
+ *
+ * Creates a trie node for an element of the path tree.  Its
+ * children are indexed the first time they are looked up.
+ */
+static RADPathNode *rad_path_node_new(xmlNodePtr node)
+{
+    RADPathNode *pnode;
+
+    pnode = g_new0(RADPathNode, 1);
+    pnode->node = node;
+    pnode->children = NULL;
+
+    return(pnode);
+}  /* rad_path_node_new() */
+
+
+/*
+ * static void rad_path_node_free(gpointer data)
+ *
+ * Frees a trie node and everything below it.
+ */
+static void rad_path_node_free(gpointer data)
+{
+    RADPathNode *pnode;
+
+    pnode = (RADPathNode *)data;
+    if (pnode->children != NULL)
+        g_hash_table_destroy(pnode->children);
+    g_free(pnode);
+}  /* rad_path_node_free() */
+
+
+/*
+ * static gboolean rad_is_path_element(xmlNodePtr node)
+ *
+ * Returns TRUE if node can be named by a path.
+ */
+static gboolean rad_is_path_element(xmlNodePtr node)
+{
+    return((node->type == XML_ELEMENT_NODE) &&
+           ((xmlStrcmp(node->name, "MENU") == 0) ||
+            (xmlStrcmp(node->name, "DIALOG") == 0) ||
+            (xmlStrcmp(node->name, "HIDDEN") == 0)));
+}  /* rad_is_path_element() */
+
+
+/*
+ * static void rad_path_node_add_child(RADPathNode *pnode,
+ *                                     xmlNodePtr child)
+ *
+ * Adds child to the index of pnode.  As with a walk of the
+ * document, the first child with a given NAME wins.
+ */
+static void rad_path_node_add_child(RADPathNode *pnode, xmlNodePtr child)
+{
+    gchar *name;
+
+    if (!rad_is_path_element(child))
+        return;
+
+    name = xmlGetProp(child, "NAME");
+    if (name == NULL)
+        return;
+
+    if (g_hash_table_lookup(pnode->children, name) != NULL)
+    {
+        g_free(name);
+        return;
+    }
+
+    g_hash_table_insert(pnode->children, name, rad_path_node_new(child));
+}  /* rad_path_node_add_child() */
+
+
+/*
+ * static RADPathNode *rad_path_node_lookup(RADPathNode *pnode,
+ *                                          const gchar *name)
+ *
+ * Returns the child of pnode with the given NAME.  The children of
+ * a node are walked only once, on the first lookup.
+ */
+static RADPathNode *rad_path_node_lookup(RADPathNode *pnode,
+                                         const gchar *name)
+{
+    xmlNodePtr cur;
+
+    if (pnode->children == NULL)
+    {
+        pnode->children = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free,
+                                                rad_path_node_free);
+        for (cur = pnode->node->children; cur != NULL; cur = cur->next)
+            rad_path_node_add_child(pnode, cur);
+    }
+
+    return((RADPathNode *)g_hash_table_lookup(pnode->children, name));
+}  /* rad_path_node_lookup() */
+
+
+/*
+ * static RADPathNode *rad_find_path_node(RADContext *ctxt,
+ *                                        const gchar *path,
+ *                                        RADPathNode **parent,
+ *                                        gchar **leaf)
+ *
+ * Resolves path against the path trie.  If parent is not NULL, it
+ * is set to the trie node above the result.  If leaf is not NULL,
+ * it is set to a copy of the last path element, which the caller
+ * must free.
+ */
+static RADPathNode *rad_find_path_node(RADContext *ctxt,
+                                       const gchar *path,
+                                       RADPathNode **parent,
+                                       gchar **leaf)
+{
+    gchar *p_copy, *elem, *next;
+    RADPathNode *cur, *prev;
+
+    g_return_val_if_fail(ctxt != NULL, NULL);
+    g_return_val_if_fail(ctxt->path_trie != NULL, NULL);
+    g_return_val_if_fail(path != NULL, NULL);
+    g_return_val_if_fail(path[0] == '/', NULL);
+
+    prev = NULL;
+    cur = ctxt->path_trie;
+    elem = NULL;
+
+    /* Split in place; one copy of the path, no vector */
+    p_copy = g_strdup(path + 1);
+    for (next = p_copy; (next != NULL) && (cur != NULL);)
+    {
+        elem = next;
+        next = strchr(elem, '/');
+        if (next != NULL)
+            *next++ = '\0';
+        if (elem[0] == '\0')
+        {
+            /* "/" and trailing slashes name the node itself */
+            if (next == NULL)
+                break;
+            continue;
+        }
+
+        prev = cur;
+        cur = rad_path_node_lookup(cur, elem);
+    }
+
+    if (parent != NULL)
+        *parent = prev;
+    if (leaf != NULL)
+        *leaf = ((elem != NULL) && (elem[0] != '\0')) ?
+            g_strdup(elem) : NULL;
+    g_free(p_copy);
+
+    return(cur);
+}  /* rad_find_path_node() */
+
+
 /*
  * xmlNodePtr rad_find_path(RADContext *ctxt, const gchar *path)
  *
@@ -117,54 +376,81 @@ gint rad_validate_file(RADContext *ctxt)
  *        <MENU NAME="bar">  |
  *            <MENU NAME="baz">
  *
- *  And yes, this is ugly O() as well.
+ * Lookups go through a trie over the path tree, so each level of
+ * the document is walked at most once per run.
  */
 xmlNodePtr rad_find_path(RADContext *ctxt, const gchar *path)
 {
-    gint i;
-    xmlNodePtr cur;
-    gchar **p_elem;
-    gchar *test_id;
+    RADPathNode *pnode;
 
-    g_return_val_if_fail(ctxt != NULL, NULL);
-    g_return_val_if_fail(path != NULL, NULL);
-    g_return_val_if_fail(path[0] == '/', NULL);
+    pnode = rad_find_path_node(ctxt, path, NULL, NULL);
+
+    return(pnode ? pnode->node : NULL);
+}  /* rad_find_path() */
 
-    cur = ctxt->main.path;
-    if (strcmp(path, "/") == 0)
-        return(cur);
 
-    p_elem = g_strsplit(path, "/", 0);
-    /* i is 1 to skip the "" before the leading '/' */
-    for (i = 1; (p_elem[i] != NULL) && (cur != NULL); i++)
+/*
+ * gint rad_insert_path(RADContext *ctxt, const gchar *path,
+ *                      xmlNodePtr new_path)
+ *
+ * Moves the list of nodes starting at new_path under the node named
+ * by path, keeping the path trie current.
+ */
+gint rad_insert_path(RADContext *ctxt, const gchar *path,
+                     xmlNodePtr new_path)
+{
+    RADPathNode *pnode;
+    xmlNodePtr cur, next;
+
+    pnode = rad_find_path_node(ctxt, path, NULL, NULL);
+    if (pnode == NULL)
+        return(-ESRCH);
+
+    for (cur = new_path; cur != NULL; cur = next)
     {
-        cur = cur->children;
-        while (cur != NULL)
-        {
-            if ((cur->type == XML_ELEMENT_NODE) &&
-                ((xmlStrcmp(cur->name, "MENU") == 0) ||
-                 (xmlStrcmp(cur->name, "DIALOG") == 0) ||
-                 (xmlStrcmp(cur->name, "HIDDEN") == 0)))
-            {
-                test_id = xmlGetProp(cur, "NAME");
-                if (test_id != NULL)
-                {
-                    if (xmlStrcmp(test_id, p_elem[i]) == 0)
-                    {
-                        g_free(test_id);
-                        break;
-                    }
-                    g_free(test_id);
-                }
-            }
+        next = cur->next;
+        xmlUnlinkNode(cur);
+        cur = xmlAddChild(pnode->node, cur);
+        if ((cur != NULL) && (pnode->children != NULL))
+            rad_path_node_add_child(pnode, cur);
+    }
 
-            cur = cur->next;
-        }
+    return(0);
+}  /* rad_insert_path() */
+
+
+/*
+ * gint rad_delete_path(RADContext *ctxt, const gchar *path)
+ *
+ * Removes the node named by path from the document and the path
+ * trie.  The root cannot be removed.
+ */
+gint rad_delete_path(RADContext *ctxt, const gchar *path)
+{
+    gchar *leaf;
+    xmlNodePtr target, cur;
+    RADPathNode *pnode, *parent;
+
+    pnode = rad_find_path_node(ctxt, path, &parent, &leaf);
+    if ((pnode == NULL) || (parent == NULL) || (leaf == NULL))
+    {
+        g_free(leaf);
+        return(-ESRCH);
     }
-    g_strfreev(p_elem);
 
-    return(cur);
-}  /* rad_find_path() */
+    target = pnode->node;
+    g_hash_table_remove(parent->children, leaf);  /* frees pnode */
+    g_free(leaf);
+
+    /* A later sibling of the same name now answers to this path */
+    for (cur = target->next; cur != NULL; cur = cur->next)
+        rad_path_node_add_child(parent, cur);
+
+    xmlUnlinkNode(target);
+    xmlFreeNode(target);
+
+    return(0);
+}  /* rad_delete_path() */
 
 
 /*
@@ -262,87 +548,139 @@ out_err:
 }  /* rad_parse_file() */
 
 /*
- * int rad_get_lock(gchar *filename)
+ * static void rad_lock_alarm(gint signum)
  *
- * Acquires a lock based on a hash of the filename.  Nope, this isn't
- * really NFS safe, but usually rastaadd is run on system files, aka
- * local files.
+ * Does nothing.  It exists so SIGALRM interrupts a waiting lock.
  */
-int rad_get_lock(gchar *filename)
+static void rad_lock_alarm(gint signum)
 {
-    gint semid, rc;
-    key_t key;
-    struct sembuf sops[2] = 
-    {
-        {0, 0, IPC_NOWAIT},
-        {0, 1, SEM_UNDO}
-    };
+}  /* rad_lock_alarm() */
+
+
+/*
+ * gint rad_get_lock(const gchar *filename, guint timeout)
+ *
+ * Takes the writer lock for filename, waiting up to timeout seconds
+ * behind other writers.  The lock is an fcntl() lock on a
+ * LOCK_EXTENSION file beside filename, not on filename itself,
+ * because rad_save_file() replaces filename by rename.  It goes away
+ * with the process, so a crashed writer can't wedge the file.
+ * Readers never take it; they see either the old file or the new
+ * one.  Nope, this isn't really NFS safe, but usually rastaadd is
+ * run on system files, aka local files.
+ *
+ * Returns the lock descriptor, -ETIMEDOUT if the wait expired, or
+ * another -errno on failure.
+ */
+gint rad_get_lock(const gchar *filename, guint timeout)
+{
+    gint fd, rc, cmd;
+    gchar *lock_name;
+    struct flock fl;
+    struct sigaction sa, old_sa;
 
     g_return_val_if_fail(filename != NULL, -EINVAL);
     g_return_val_if_fail(filename[0] != '\0', -EINVAL);
 
-    key = (key_t)g_str_hash(filename);
-    if (key == 0)
-        key = 1;
-
-    semid = semget(key, 1, 0600 | IPC_CREAT | IPC_EXCL);
-    if (semid == -1)
+    lock_name = g_strconcat(filename, LOCK_EXTENSION, NULL);
+    fd = open(lock_name, O_RDWR | O_CREAT, 0600);
+    g_free(lock_name);
+    if (fd < 0)
         return(-errno);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+
+#ifdef F_OFD_SETLKW
+    /* Open file description locks survive closing other fds */
+    cmd = F_OFD_SETLKW;
+#else
+    cmd = F_SETLKW;
+#endif
 
-    /* lock exists */
+    /* SIGALRM without SA_RESTART bounds the wait */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = rad_lock_alarm;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGALRM, &sa, &old_sa);
+    alarm(timeout);
+
+    rc = fcntl(fd, cmd, &fl);
+#ifdef F_OFD_SETLKW
+    if ((rc < 0) && (errno == EINVAL))
+    {
+        /* Kernel without OFD locks */
+        rc = fcntl(fd, F_SETLKW, &fl);
+    }
+#endif
+    if (rc < 0)
+        rc = (errno == EINTR) ? -ETIMEDOUT : -errno;
+
+    alarm(0);
+    sigaction(SIGALRM, &old_sa, NULL);
 
-    do
+    if (rc < 0)
     {
-        rc = semop(semid, sops, 2);
-        if ((rc == -1) && (errno != EINTR))
-        {
-            /* delete lock */
-            semctl(semid, 0, IPC_RMID, 0);
-            return(-errno);
-        }
+        close(fd);
+        return(rc);
     }
-    while (rc < 0);
 
     /* lock is held */
 
-    return(semid);
+    return(fd);
 }  /* rad_get_lock() */
 
 
 /*
- * void rad_drop_lock(gint semid)
+ * void rad_drop_lock(gint fd)
  *
- * Drops the lock pointed to by semid.
+ * Drops the lock held on fd.  The lock file itself is left alone;
+ * removing it would let a waiting writer lock a file nobody else
+ * can see.
  */
-void rad_drop_lock(gint semid)
+void rad_drop_lock(gint fd)
 {
-    gint rc;
-    struct sembuf sops[1] =
-    {
-        {0, -1, IPC_NOWAIT}
-    };
+    g_return_if_fail(fd >= 0);
 
-    g_return_if_fail(semid != -1);
+    /* Closing releases both kinds of fcntl() lock */
+    close(fd);
+}  /* rad_drop_lock() */
 
-    do
-    {
-        rc = semop(semid, sops, 1);
-        if (rc == -1)
-        {
-            if (errno == EIDRM)
-                return;
-            else if (errno != EINTR)
-                break;
-        }
-    }
-    while (rc < 0);
 
-    /* lock released */
+/*
+ * gint rad_load_delta(RADContext *ctxt, const gchar *filename)
+ *
+ * Parses and validates a RASTAMODIFY document and makes it the
+ * current delta.  Earlier delta documents are not freed, as their
+ * nodes may have been moved into the main document.  Returns
+ * -ENOENT if the file cannot be parsed and -EINVAL if it is invalid.
+ */
+gint rad_load_delta(RADContext *ctxt, const gchar *filename)
+{
+    g_return_val_if_fail(ctxt != NULL, -EINVAL);
+    g_return_val_if_fail(filename != NULL, -EINVAL);
+
+    ctxt->delta.doc = NULL;
+    ctxt->delta.ns = NULL;
+    ctxt->delta.screens = NULL;
+    ctxt->delta.path = NULL;
 
-    rc = semctl(semid, 0, IPC_RMID, 0);
-    
-    /* lock deleted */
-}  /* rad_drop_lock() */
+    ctxt->delta.doc = rad_parse_file((gchar *)filename);
+    if (ctxt->delta.doc == NULL)
+        return(-ENOENT);
+
+    if (rad_validate_doc(ctxt->delta.doc, "RASTAMODIFY",
+                         "file:" _RASTA_DATA_DIR
+                         G_DIR_SEPARATOR_S RASTAMODIFY_DTD) != 0)
+        return(-EINVAL);
+
+    return(0);
+}  /* rad_load_delta() */
 
 
 /*
@@ -354,8 +692,12 @@ void rad_clean_context(RADContext *ctxt)
 {
     if (ctxt->main_filename != NULL)
         g_free(ctxt->main_filename);
-    if (ctxt->delta_filename != NULL)
-        g_free(ctxt->delta_filename);
+    if (ctxt->delta_filenames != NULL)
+        g_strfreev(ctxt->delta_filenames);
+    if (ctxt->screen_index != NULL)
+        g_hash_table_destroy(ctxt->screen_index);
+    if (ctxt->path_trie != NULL)
+        rad_path_node_free(ctxt->path_trie);
 
     /*
      * Currently, the documents have intermingling pointers, so a 
@@ -373,35 +715,87 @@ void rad_clean_context(RADContext *ctxt)
 /*
  * gint rad_save_file(RADContext *ctxt)
  *
- * Saves the XML back to disk.
+ * Saves the XML back to disk.  The document is written to a
+ * temporary file next to the original and renamed over it, so
+ * readers see either the old or the new file, never a partial one.
+ * With --backup, the old file is kept as a hard link.
  */
 gint rad_save_file(RADContext *ctxt)
 {
     FILE *outf;
     gint rc;
     gchar *tmp_name, *bak_name;
+    struct stat stat_buf;
 
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
 
     rc = -ENOMEM;
+    outf = NULL;
     tmp_name = g_strconcat(ctxt->main_filename, TEMP_EXTENSION, NULL);
     bak_name = g_strconcat(ctxt->main_filename, BACKUP_EXTENSION, NULL);
     if ((tmp_name == NULL) || (bak_name == NULL))
         goto out;
 
-    outf = fopen(ctxt->main_filename, "w");
+    outf = fopen(tmp_name, "w");
     if (outf == NULL)
     {
         rc = -errno;
         goto out;
     }
 
-    rc = xmlDocDump(outf, ctxt->main.doc);
-    fclose(outf);
+    /* Keep the permissions of the file being replaced */
+    if (stat(ctxt->main_filename, &stat_buf) == 0)
+        fchmod(fileno(outf), stat_buf.st_mode & 07777);
+
+    if (xmlDocDump(outf, ctxt->main.doc) == -1)
+    {
+        rc = -EIO;
+        goto out_unlink;
+    }
+
+    if ((fflush(outf) != 0) || (fsync(fileno(outf)) != 0))
+    {
+        rc = -errno;
+        goto out_unlink;
+    }
+
+    rc = fclose(outf);
+    outf = NULL;
+    if (rc != 0)
+    {
+        rc = -errno;
+        goto out_unlink;
+    }
+
+    if (ctxt->backup != FALSE)
+    {
+        unlink(bak_name);
+        if ((link(ctxt->main_filename, bak_name) != 0) &&
+            (errno != ENOENT))
+        {
+            rc = -errno;
+            goto out_unlink;
+        }
+    }
+
+    if (rename(tmp_name, ctxt->main_filename) != 0)
+    {
+        rc = -errno;
+        goto out_unlink;
+    }
+
+    rc = 0;
+    goto out;
+
+out_unlink:
+    if (outf != NULL)
+        fclose(outf);
+    outf = NULL;
+    unlink(tmp_name);
 
 out:
     g_free(tmp_name);
     g_free(bak_name);
 
-    return(rc == -1);
-}
+    return(rc);
+}  /* rad_save_file() */
@@ -26,11 +26,18 @@
 
 #ifndef __RADCOMMON_H
 
+/*
+ * Defines
+ */
+#define RAD_LOCK_TIMEOUT 60     /* Default wait for the writer lock */
+
+
 /*
  * Typedefs
  */
 typedef struct _RADDocInfo RADDocInfo;
 typedef struct _RADContext RADContext;
+typedef struct _RADPathNode RADPathNode;
 
 
 
@@ -46,30 +53,47 @@ struct _RADDocInfo
     xmlNodePtr path;
 };
 
+struct _RADPathNode
+{
+    xmlNodePtr node;            /* PATH, MENU, DIALOG or HIDDEN element */
+    GHashTable *children;       /* NAME -> RADPathNode, NULL until used */
+};
+
 struct _RADContext
 {
     gchar *main_filename;       /* Description file */
-    gchar *delta_filename;      /* Additions to the description */
+    gchar **delta_filenames;    /* Changes to apply, NULL terminated */
     RADDocInfo main;            /* Description document */
-    RADDocInfo delta;           /* Addition document */
-    gboolean force;             /* Force overwrite - unused */
+    RADDocInfo delta;           /* Change document being applied */
+    GHashTable *screen_index;   /* Screen ID -> node in main.screens */
+    RADPathNode *path_trie;     /* Path lookups into main.path */
+    gboolean force;             /* Replace existing screens */
     gboolean verbose;           /* Spit out verbose things */
     gboolean backup;            /* Make a backup of main_filename */
+    guint lock_timeout;         /* Seconds to wait for other writers */
 };
 
 
 /*
  * Prototypes
  */
-key_t rad_get_lock(gchar *filename);
-void rad_drop_lock(gint semid);
+gint rad_get_lock(const gchar *filename, guint timeout);
+void rad_drop_lock(gint fd);
 xmlDocPtr rad_parse_file(gchar *filename);
 gint rad_validate_doc(xmlDocPtr doc,
                       const gchar *name,
                       const gchar *id);
 gint rad_validate_file(RADContext *ctxt);
+gint rad_load_delta(RADContext *ctxt, const gchar *filename);
+gboolean rad_is_screen(xmlNodePtr node);
+xmlNodePtr rad_lookup_screen(RADContext *ctxt, const gchar *id);
+void rad_index_screen(RADContext *ctxt, xmlNodePtr screen);
+void rad_unindex_screen(RADContext *ctxt, const gchar *id);
 void rad_clean_context(RADContext *ctxt);
 xmlNodePtr rad_find_path(RADContext *ctxt, const gchar *path);
+gint rad_insert_path(RADContext *ctxt, const gchar *path,
+                     xmlNodePtr new_path);
+gint rad_delete_path(RADContext *ctxt, const gchar *path);
 gint rad_save_file(RADContext *ctxt);
 
 #endif  /* __RADCOMMON_H */
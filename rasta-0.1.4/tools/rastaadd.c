@@ -29,8 +29,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/sem.h>
 #include <unistd.h>
 #include <errno.h>
 #include <gtk/gtk.h>
@@ -50,10 +48,9 @@ static gint validate_addition(RADContext *ctxt);
 static gint load_options(RADContext *ctxt, gint argc, gchar *argv[]);
 static gint add_screens(RADContext *ctxt);
 static gint add_paths(RADContext *ctxt);
-static gint process_path(RADContext *ctxt, xmlNodePtr new_path,
-                         xmlNodePtr parent_path);
 static gint process_screens(RADContext *ctxt, xmlNodePtr new_screens,
                             xmlNodePtr screen_parent);
+static gint check_screens(RADContext *ctxt, xmlNodePtr new_screens);
 
 
 
@@ -113,54 +110,117 @@ static gint validate_addition(RADContext *ctxt)
 
 
 /*
- * static gint process_path(RADContext *ctxt, xmlNodePtr new_path,
- *                          xmlNodePtr parent_path)
+ * static gint check_screens(RADContext *ctxt, xmlNodePtr new_screens)
  *
- * Adds new_path as a child of parent_path.
+ * Looks for new screens whose IDs already exist in the main
+ * document.  Unless force is enabled, every conflict is reported and
+ * -EEXIST is returned before anything has been changed.
  */
-static gint process_path(RADContext *ctxt, xmlNodePtr new_path,
-                         xmlNodePtr parent_path)
+static gint check_screens(RADContext *ctxt, xmlNodePtr new_screens)
 {
+    gint rc;
+    gchar *id;
+    xmlNodePtr cur;
+
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
-    g_return_val_if_fail(new_path != NULL, -EINVAL);
-    g_return_val_if_fail(parent_path != NULL, -EINVAL);
 
-    xmlAddChildList(parent_path, new_path);
+    rc = 0;
+    for (cur = new_screens; cur != NULL; cur = cur->next)
+    {
+        if (!rad_is_screen(cur))
+            continue;
+
+        id = xmlGetProp(cur, "ID");
+        if (id == NULL)
+            continue;
 
-    return(0);
-}  /* process_path() */
+        if (rad_lookup_screen(ctxt, id) != NULL)
+        {
+            if (ctxt->force != FALSE)
+            {
+                if (ctxt->verbose != FALSE)
+                    fprintf(stderr,
+                            "rastaadd: Replacing screen \"%s\"\n", id);
+            }
+            else
+            {
+                fprintf(stderr,
+                        "rastaadd: Screen \"%s\" already exists\n", id);
+                rc = -EEXIST;
+            }
+        }
+        g_free(id);
+    }
+
+    return(rc);
+}  /* check_screens() */
 
 
 /*
  * static gint process_screens(RADContext *ctxt, xmlNodePtr new_screens,
  *                             xmlNodePtr screen_parent)
  *
- * Processes a screen.  If there is an old screen and force is not
- * enabled, it errors.
+ * Moves the new screens into screen_parent.  An old screen with the
+ * same ID is replaced; check_screens() has already made sure that is
+ * allowed.
  */
 static gint process_screens(RADContext *ctxt, xmlNodePtr new_screens,
                             xmlNodePtr screen_parent)
 {
+    gchar *id;
+    xmlNodePtr cur, next, old;
+
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
-    g_return_val_if_fail(new_screens != NULL, -EINVAL);
     g_return_val_if_fail(screen_parent != NULL, -EINVAL);
 
-    xmlAddChildList(screen_parent, new_screens);
+    for (cur = new_screens; cur != NULL; cur = next)
+    {
+        next = cur->next;
+
+        if (rad_is_screen(cur))
+        {
+            id = xmlGetProp(cur, "ID");
+            if (id != NULL)
+            {
+                old = rad_lookup_screen(ctxt, id);
+                if (old != NULL)
+                {
+                    rad_unindex_screen(ctxt, id);
+                    xmlUnlinkNode(old);
+                    xmlFreeNode(old);
+                }
+                g_free(id);
+            }
+        }
+
+        xmlUnlinkNode(cur);
+        cur = xmlAddChild(screen_parent, cur);
+        if ((cur != NULL) && rad_is_screen(cur))
+            rad_index_screen(ctxt, cur);
+    }
 
     return(0);
-}  /* process_screen() */
+}  /* process_screens() */
 
 
 /*
  * static gint add_screens(RADContext *ctxt)
  *
- * Adds the SCREEN elements to the main context.  This is ugly and
- * O(n^2).  Someone got a better way?
+ * Adds the SCREEN elements to the main context.  Conflicts are
+ * resolved against the screen index, so this is linear in the size
+ * of the addition.
  */
 static gint add_screens(RADContext *ctxt)
 {
     gint rc;
 
+    if (ctxt->delta.screens == NULL)
+        return(0);
+
+    rc = check_screens(ctxt, ctxt->delta.screens->children);
+    if (rc != 0)
+        return(rc);
+
     rc = process_screens(ctxt, ctxt->delta.screens->children,
                          ctxt->main.screens);
     return(rc);
@@ -170,14 +230,15 @@ static gint add_screens(RADContext *ctxt)
 /*
  * static gint add_paths(RADContext *ctxt)
  *
- * Adds the PATHINSERT elements to the main context.  This is ugly as
- * well.
+ * Adds the PATHINSERT elements to the main context.  Targets are
+ * resolved through the path trie, which is kept current as nodes
+ * are added.
  */
 static gint add_paths(RADContext *ctxt)
 {
     gint rc;
     gchar *path;
-    xmlNodePtr cur, target;
+    xmlNodePtr cur;
 
     cur = ctxt->delta.path;
     while (cur != NULL)
@@ -186,11 +247,8 @@ static gint add_paths(RADContext *ctxt)
             (xmlStrcmp(cur->name, "PATHINSERT") == 0))
         {
             path = xmlGetProp(cur, "PATH");
-            target = rad_find_path(ctxt, path);
+            rc = rad_insert_path(ctxt, path, cur->children);
             xmlFree(path);
-            if (target == NULL)
-                return(-ESRCH);
-            rc = process_path(ctxt, cur->children, target);
             if (rc != 0)
                 return(rc);
         }
@@ -213,7 +271,7 @@ static void print_usage(gint rc)
     output = rc ? stderr : stdout;
 
     fprintf(output,
-            "Usage: rastaadd [--file <system_file>] [--force] [--verbose] <addition_file>\n");
+            "Usage: rastaadd [--file <system_file>] [--wait <seconds>] [--force] [--verbose] <addition_file> [<addition_file> ...]\n");
     exit(rc);
 }  /* print_usage() */
 
@@ -252,6 +310,15 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
         }
         else if (strcmp(argv[i], "--backup") == 0)
             ctxt->backup = TRUE;
+        else if (strcmp(argv[i], "--wait") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(-EINVAL);
+            ctxt->lock_timeout = (guint)strtoul(argv[i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--force") == 0)
+            ctxt->force = TRUE;
         else if ((strcmp(argv[i], "-v") == 0) ||
                  (strcmp(argv[i], "--verbose") == 0))
             ctxt->verbose = TRUE;
@@ -264,7 +331,7 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
                                                RASTA_SYSTEM_FILE,
                                                NULL);
     if (i < argc)
-        ctxt->delta_filename = g_strdup(argv[i]);
+        ctxt->delta_filenames = g_strdupv(&argv[i]);
     else
         return(-EINVAL);
 
@@ -278,7 +345,7 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
  */
 gint main(gint argc, gchar *argv[])
 {
-    gint semid, rc;
+    gint i, lock_fd, rc;
     RADContext *ctxt;
 
     ctxt = g_new0(RADContext, 1);
@@ -287,6 +354,7 @@ gint main(gint argc, gchar *argv[])
         fprintf(stderr, "Unable to allocate memory\n");
         return(-ENOMEM);
     }
+    ctxt->lock_timeout = RAD_LOCK_TIMEOUT;
 
     rc = load_options(ctxt, argc, argv);
     if (rc < 0)
@@ -294,11 +362,12 @@ gint main(gint argc, gchar *argv[])
     else if (rc > 0)
         print_usage(0);
 
-    semid = rad_get_lock(ctxt->main_filename);
-    if (semid < 0)
+    lock_fd = rad_get_lock(ctxt->main_filename, ctxt->lock_timeout);
+    if (lock_fd < 0)
     {
-        fprintf(stderr, "rastaadd: Unable to acquire lock\n");
-        return(semid);
+        fprintf(stderr, "rastaadd: Unable to acquire lock: %s\n",
+                g_strerror(-lock_fd));
+        return(lock_fd);
     }
 
     ctxt->main.doc = rad_parse_file(ctxt->main_filename);
@@ -328,45 +397,42 @@ gint main(gint argc, gchar *argv[])
         goto out;
     }
 
-    ctxt->delta.doc = rad_parse_file(ctxt->delta_filename);
-    if (ctxt->delta.doc == NULL)
+    /* Apply every change in memory, then write the result once */
+    for (i = 0; ctxt->delta_filenames[i] != NULL; i++)
     {
-        fprintf(stderr, "rastaadd: Unable to parse file \"%s\"\n",
-                ctxt->delta_filename);
-        rc = -ENOENT;
-        goto out;
-    }
+        rc = rad_load_delta(ctxt, ctxt->delta_filenames[i]);
+        if (rc == -ENOENT)
+        {
+            fprintf(stderr, "rastaadd: Unable to parse file \"%s\"\n",
+                    ctxt->delta_filenames[i]);
+            goto out;
+        }
+        else if (rc == 0)
+            rc = validate_addition(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastaadd: File \"%s\" is invalid\n",
+                    ctxt->delta_filenames[i]);
+            goto out;
+        }
 
-    rc = rad_validate_doc(ctxt->delta.doc, "RASTAMODIFY",
-                          "file:" _RASTA_DATA_DIR
-                          G_DIR_SEPARATOR_S RASTAMODIFY_DTD);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastaadd: File \"%s\" is invalid\n",
-                ctxt->main_filename);
-        goto out;
-    }
+        rc = add_screens(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastaadd: Unable to add new screens\n");
+            goto out;
+        }
 
-    rc = validate_addition(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastaadd: File \"%s\" is invalid\n",
-                ctxt->delta_filename);
-        goto out;
-    }
+        rc = add_paths(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastaadd: Unable to add new paths\n");
+            goto out;
+        }
 
-    rc = add_screens(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastaadd: Unable to add new screens\n");
-        goto out;
-    }
-    
-    rc = add_paths(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastaadd: Unable to add new paths\n");
-        goto out;
+        if (ctxt->verbose != FALSE)
+            fprintf(stdout, "rastaadd: Applied \"%s\"\n",
+                    ctxt->delta_filenames[i]);
     }
 
     rc = rad_validate_doc(ctxt->main.doc, "RASTA",
@@ -385,7 +451,7 @@ gint main(gint argc, gchar *argv[])
                 ctxt->main_filename);
 
 out:
-    rad_drop_lock(semid);
+    rad_drop_lock(lock_fd);
     rad_clean_context(ctxt);
 
     return(rc);
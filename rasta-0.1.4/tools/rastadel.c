@@ -29,8 +29,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/ipc.h>
-#include <sys/sem.h>
 #include <unistd.h>
 #include <errno.h>
 #include <gtk/gtk.h>
@@ -120,7 +118,7 @@ static gint process_screen(RADContext *ctxt, xmlNodePtr screens,
                            xmlNodePtr del_screen)
 {
     xmlNodePtr cur;
-    gchar *test_id, *del_id;
+    gchar *del_id;
 
     g_return_val_if_fail(ctxt != NULL, -EINVAL);
     g_return_val_if_fail(screens != NULL, -EINVAL);
@@ -135,29 +133,12 @@ static gint process_screen(RADContext *ctxt, xmlNodePtr screens,
         return(-EINVAL);
     }
 
-    cur = screens->children;
-    while (cur != NULL)
+    cur = rad_lookup_screen(ctxt, del_id);
+    if (cur != NULL)
     {
-        if ((cur->type == XML_ELEMENT_NODE) &&
-            ((xmlStrcmp(cur->name, "MENUSCREEN") == 0) ||
-             (xmlStrcmp(cur->name, "DIALOGSCREEN") == 0) ||
-             (xmlStrcmp(cur->name, "HIDDENSCREEN") == 0) ||
-             (xmlStrcmp(cur->name, "ACTIONSCREEN") == 0)))
-        {
-            test_id = xmlGetProp(cur, "ID");
-            if (test_id != NULL)
-            {
-                if (xmlStrcmp(del_id, test_id) == 0)
-                {
-                    g_free(test_id);
-                    xmlUnlinkNode(cur);
-                    xmlFreeNode(cur);
-                    break;
-                }
-                g_free(test_id);
-            }
-        }
-        cur = cur->next;
+        rad_unindex_screen(ctxt, del_id);
+        xmlUnlinkNode(cur);
+        xmlFreeNode(cur);
     }
 
     if ((cur == NULL) && (ctxt->verbose != FALSE))
@@ -207,7 +188,7 @@ static gint delete_screens(RADContext *ctxt)
 static gint delete_paths(RADContext *ctxt)
 {
     gchar *path;
-    xmlNodePtr cur, target;
+    xmlNodePtr cur;
 
     cur = ctxt->delta.path;
     while (cur != NULL)
@@ -216,20 +197,12 @@ static gint delete_paths(RADContext *ctxt)
             (xmlStrcmp(cur->name, "PATHDELETE") == 0))
         {
             path = xmlGetProp(cur, "PATH");
-            target = rad_find_path(ctxt, path);
-            if (target == NULL)
+            if ((rad_delete_path(ctxt, path) != 0) &&
+                (ctxt->verbose != FALSE))
             {
-                if (ctxt->verbose != FALSE)
-                {
-                    fprintf(stderr,
-                            "rastadel: Path \"%s\" does not exist - Ignored\n",
-                            path);
-                }
-            }
-            else
-            {
-                xmlUnlinkNode(target);
-                xmlFreeNode(target);
+                fprintf(stderr,
+                        "rastadel: Path \"%s\" does not exist - Ignored\n",
+                        path);
             }
             xmlFree(path);
         }
@@ -252,7 +225,7 @@ static void print_usage(gint rc)
     output = rc ? stderr : stdout;
 
     fprintf(output,
-            "Usage: rastadel [--file <system_file>] [--force] [--verbose] <deletion_file>\n");
+            "Usage: rastadel [--file <system_file>] [--wait <seconds>] [--force] [--verbose] <deletion_file> [<deletion_file> ...]\n");
     exit(rc);
 }  /* print_usage() */
 
@@ -291,6 +264,13 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
         }
         else if (strcmp(argv[i], "--backup") == 0)
             ctxt->backup = TRUE;
+        else if (strcmp(argv[i], "--wait") == 0)
+        {
+            i++;
+            if ((i >= argc) || (argv[i][0] == '-'))
+                return(-EINVAL);
+            ctxt->lock_timeout = (guint)strtoul(argv[i], NULL, 10);
+        }
         else if (strcmp(argv[i], "--force") == 0)
             ctxt->force = TRUE;
         else if ((strcmp(argv[i], "-v") == 0) ||
@@ -305,7 +285,7 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
                                                RASTA_SYSTEM_FILE,
                                                NULL);
     if (i < argc)
-        ctxt->delta_filename = g_strdup(argv[i]);
+        ctxt->delta_filenames = g_strdupv(&argv[i]);
     else
         return(-EINVAL);
 
@@ -319,7 +299,7 @@ static gint load_options(RADContext *ctxt, gint argc, gchar *argv[])
  */
 gint main(gint argc, gchar *argv[])
 {
-    gint semid, rc;
+    gint i, lock_fd, rc;
     RADContext *ctxt;
 
     ctxt = g_new0(RADContext, 1);
@@ -328,6 +308,7 @@ gint main(gint argc, gchar *argv[])
         fprintf(stderr, "Unable to allocate memory\n");
         return(-ENOMEM);
     }
+    ctxt->lock_timeout = RAD_LOCK_TIMEOUT;
 
     rc = load_options(ctxt, argc, argv);
     if (rc < 0)
@@ -335,11 +316,12 @@ gint main(gint argc, gchar *argv[])
     else if (rc > 0)
         print_usage(0);
 
-    semid = rad_get_lock(ctxt->main_filename);
-    if (semid < 0)
+    lock_fd = rad_get_lock(ctxt->main_filename, ctxt->lock_timeout);
+    if (lock_fd < 0)
     {
-        fprintf(stderr, "rastadel: Unable to acquire lock\n");
-        return(semid);
+        fprintf(stderr, "rastadel: Unable to acquire lock: %s\n",
+                g_strerror(-lock_fd));
+        return(lock_fd);
     }
 
     ctxt->main.doc = rad_parse_file(ctxt->main_filename);
@@ -369,45 +351,42 @@ gint main(gint argc, gchar *argv[])
         goto out;
     }
 
-    ctxt->delta.doc = rad_parse_file(ctxt->delta_filename);
-    if (ctxt->delta.doc == NULL)
+    /* Apply every change in memory, then write the result once */
+    for (i = 0; ctxt->delta_filenames[i] != NULL; i++)
     {
-        fprintf(stderr, "rastadel: Unable to parse file \"%s\"\n",
-                ctxt->delta_filename);
-        rc = -ENOENT;
-        goto out;
-    }
+        rc = rad_load_delta(ctxt, ctxt->delta_filenames[i]);
+        if (rc == -ENOENT)
+        {
+            fprintf(stderr, "rastadel: Unable to parse file \"%s\"\n",
+                    ctxt->delta_filenames[i]);
+            goto out;
+        }
+        else if (rc == 0)
+            rc = validate_deletion(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastadel: File \"%s\" is invalid\n",
+                    ctxt->delta_filenames[i]);
+            goto out;
+        }
 
-    rc = rad_validate_doc(ctxt->delta.doc, "RASTAMODIFY",
-                          "file:" _RASTA_DATA_DIR
-                          G_DIR_SEPARATOR_S RASTAMODIFY_DTD);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastadel: File \"%s\" is invalid\n",
-                ctxt->delta_filename);
-        goto out;
-    }
+        rc = delete_screens(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastadel: Unable to delete screens\n");
+            goto out;
+        }
 
-    rc = validate_deletion(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastadel: File \"%s\" is invalid\n",
-                ctxt->delta_filename);
-        goto out;
-    }
+        rc = delete_paths(ctxt);
+        if (rc != 0)
+        {
+            fprintf(stderr, "rastadel: Unable to delete paths\n");
+            goto out;
+        }
 
-    rc = delete_screens(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastadel: Unable to delete screens\n");
-        goto out;
-    }
-    
-    rc = delete_paths(ctxt);
-    if (rc != 0)
-    {
-        fprintf(stderr, "rastadel: Unable to delete paths\n");
-        goto out;
+        if (ctxt->verbose != FALSE)
+            fprintf(stdout, "rastadel: Applied \"%s\"\n",
+                    ctxt->delta_filenames[i]);
     }
 
     rc = rad_validate_doc(ctxt->main.doc, "RASTA",
@@ -426,7 +405,7 @@ gint main(gint argc, gchar *argv[])
                 ctxt->main_filename);
 
 out:
-    rad_drop_lock(semid);
+    rad_drop_lock(lock_fd);
     rad_clean_context(ctxt);
 
     return(rc);
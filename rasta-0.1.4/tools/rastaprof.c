@@ -0,0 +1,585 @@
+/*
+ * rastaprof.c
+ *
+ * A tool to report on rasta profile statistics.
+ *
+ * Copyright (C) 2001 Oracle Corporation, Inc., Joel Becker
+ * <joel.becker@oracle.com>
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have recieved a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 021110-1307, USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+#include <libxml/tree.h>
+
+#include "rasta.h"
+
+
+
+/*
+ * Defines
+ */
+
+/* The stats file format, see rastaprofile.c in librasta */
+#define PROF_MAGIC              "# rastaprof 1"
+#define PROF_DROPPED            "# dropped\t"
+#define PROF_KINDS              3
+#define PROF_FIELDS             (2 + (PROF_KINDS * 5))
+#define PROF_LINE_MAX           4096
+
+#define PROF_DEFAULT_TOP        20
+
+
+
+/*
+ * Typedefs
+ */
+typedef struct _ProfCounter     ProfCounter;
+typedef struct _ProfScreen      ProfScreen;
+typedef struct _ProfCommand     ProfCommand;
+typedef struct _ProfContext     ProfContext;
+
+
+
+/*
+ * Enums
+ */
+typedef enum
+{
+    PROF_SORT_TOTAL,
+    PROF_SORT_MEAN,
+    PROF_SORT_MAX,
+    PROF_SORT_FAILURES,
+    PROF_SORT_RUNS
+} ProfSortType;
+
+
+
+/*
+ * Structures
+ */
+struct _ProfCounter
+{
+    guint64 runs;
+    guint64 failures;
+    guint64 total_us;
+    guint64 max_us;
+    guint64 bytes;
+};
+
+struct _ProfScreen
+{
+    gchar *screen_id;
+    guint64 visits;
+    ProfCounter counters[PROF_KINDS];
+};
+
+/* One row of the command ranking */
+struct _ProfCommand
+{
+    ProfScreen *screen;
+    gint kind;
+};
+
+struct _ProfContext
+{
+    GHashTable *screens;
+    gchar **filenames;
+    guint n_files;
+    guint64 dropped;            /* Samples lost to full tables */
+    guint top;
+    gint kind;                  /* -1 for all */
+    ProfSortType sort;
+};
+
+
+
+/*
+ * Globals
+ */
+static const gchar *kind_names[PROF_KINDS] =
+{
+    "initcommand",
+    "listcommand",
+    "action"
+};
+
+/* qsort() has no user data */
+static ProfSortType sort_type = PROF_SORT_TOTAL;
+
+
+
+/*
+ * Prototypes
+ */
+static void print_usage(gint rc);
+static gint load_options(ProfContext *ctxt, gint argc, gchar *argv[]);
+static gint load_file(ProfContext *ctxt, const gchar *filename);
+static guint64 command_key(ProfCounter *counter);
+static gint compare_commands(gconstpointer a, gconstpointer b);
+static gint compare_screens(gconstpointer a, gconstpointer b);
+static void collect_screen(gpointer key, gpointer value,
+                           gpointer user_data);
+static void report_commands(ProfContext *ctxt, GPtrArray *screens);
+static void report_screens(ProfContext *ctxt, GPtrArray *screens);
+
+
+
+/*
+ * Functions
+ */
+
+
+/*
+ * static gint load_file(ProfContext *ctxt, const gchar *filename)
+ *
+ * Adds a stats file to the totals.  The files from every host and
+ * user are simply summed.
+ */
+static gint load_file(ProfContext *ctxt, const gchar *filename)
+{
+    gint i;
+    FILE *file;
+    gchar line[PROF_LINE_MAX];
+    gchar **fields;
+    guint64 max_us;
+    ProfScreen *screen;
+    ProfCounter *counter;
+
+    file = fopen(filename, "r");
+    if (file == NULL)
+        return(-errno);
+
+    if ((fgets(line, PROF_LINE_MAX, file) == NULL) ||
+        (strncmp(line, PROF_MAGIC, strlen(PROF_MAGIC)) != 0))
+    {
+        fclose(file);
+        return(-EINVAL);
+    }
+
+    while (fgets(line, PROF_LINE_MAX, file) != NULL)
+    {
+        if (strncmp(line, PROF_DROPPED, strlen(PROF_DROPPED)) == 0)
+            ctxt->dropped += g_ascii_strtoull(line + strlen(PROF_DROPPED),
+                                              NULL, 10);
+        if (line[0] == '#')
+            continue;
+        g_strchomp(line);
+
+        fields = g_strsplit(line, "\t", 0);
+        for (i = 0; fields[i] != NULL; i++);
+        if ((i != PROF_FIELDS) || (fields[0][0] == '\0'))
+        {
+            g_strfreev(fields);
+            continue;
+        }
+
+        screen = g_hash_table_lookup(ctxt->screens, fields[0]);
+        if (screen == NULL)
+        {
+            screen = g_new0(ProfScreen, 1);
+            screen->screen_id = g_strdup(fields[0]);
+            g_hash_table_insert(ctxt->screens, screen->screen_id,
+                                screen);
+        }
+
+        screen->visits += g_ascii_strtoull(fields[1], NULL, 10);
+        for (i = 0; i < PROF_KINDS; i++)
+        {
+            counter = &screen->counters[i];
+            counter->runs +=
+                g_ascii_strtoull(fields[2 + (i * 5)], NULL, 10);
+            counter->failures +=
+                g_ascii_strtoull(fields[3 + (i * 5)], NULL, 10);
+            counter->total_us +=
+                g_ascii_strtoull(fields[4 + (i * 5)], NULL, 10);
+            max_us = g_ascii_strtoull(fields[5 + (i * 5)], NULL, 10);
+            if (max_us > counter->max_us)
+                counter->max_us = max_us;
+            counter->bytes +=
+                g_ascii_strtoull(fields[6 + (i * 5)], NULL, 10);
+        }
+        g_strfreev(fields);
+    }
+
+    fclose(file);
+    ctxt->n_files++;
+
+    return(0);
+}  /* load_file() */
+
+
+/*
+ * static guint64 command_key(ProfCounter *counter)
+ *
+ * Returns the value a command is ranked by.
+ */
+static guint64 command_key(ProfCounter *counter)
+{
+    switch (sort_type)
+    {
+        case PROF_SORT_MEAN:
+            return(counter->runs ? (counter->total_us / counter->runs) : 0);
+
+        case PROF_SORT_MAX:
+            return(counter->max_us);
+
+        case PROF_SORT_FAILURES:
+            return(counter->failures);
+
+        case PROF_SORT_RUNS:
+            return(counter->runs);
+
+        case PROF_SORT_TOTAL:
+        default:
+            break;
+    }
+
+    return(counter->total_us);
+}  /* command_key() */
+
+
+/*
+ * static gint compare_commands(gconstpointer a, gconstpointer b)
+ *
+ * Sorts commands by the sort key, biggest first.
+ */
+static gint compare_commands(gconstpointer a, gconstpointer b)
+{
+    const ProfCommand *cmd_a, *cmd_b;
+    guint64 key_a, key_b;
+
+    cmd_a = (const ProfCommand *)a;
+    cmd_b = (const ProfCommand *)b;
+    key_a = command_key(&cmd_a->screen->counters[cmd_a->kind]);
+    key_b = command_key(&cmd_b->screen->counters[cmd_b->kind]);
+
+    if (key_a != key_b)
+        return((key_a > key_b) ? -1 : 1);
+
+    return(strcmp(cmd_a->screen->screen_id, cmd_b->screen->screen_id));
+}  /* compare_commands() */
+
+
+/*
+ * static gint compare_screens(gconstpointer a, gconstpointer b)
+ *
+ * Sorts screens by total command time, then by visits, biggest
+ * first.
+ */
+static gint compare_screens(gconstpointer a, gconstpointer b)
+{
+    const ProfScreen *screen_a, *screen_b;
+    guint64 total_a, total_b;
+    gint i;
+
+    screen_a = *(const ProfScreen **)a;
+    screen_b = *(const ProfScreen **)b;
+
+    total_a = total_b = 0;
+    for (i = 0; i < PROF_KINDS; i++)
+    {
+        total_a += screen_a->counters[i].total_us;
+        total_b += screen_b->counters[i].total_us;
+    }
+
+    if (total_a != total_b)
+        return((total_a > total_b) ? -1 : 1);
+    if (screen_a->visits != screen_b->visits)
+        return((screen_a->visits > screen_b->visits) ? -1 : 1);
+
+    return(strcmp(screen_a->screen_id, screen_b->screen_id));
+}  /* compare_screens() */
+
+
+/*
+ * static void collect_screen(gpointer key, gpointer value,
+ *                            gpointer user_data)
+ *
+ * Hash table callback to put every screen into an array.
+ */
+static void collect_screen(gpointer key, gpointer value,
+                           gpointer user_data)
+{
+    g_ptr_array_add((GPtrArray *)user_data, value);
+}  /* collect_screen() */
+
+
+/*
+ * static void report_commands(ProfContext *ctxt, GPtrArray *screens)
+ *
+ * Prints the commands, slowest first.
+ */
+static void report_commands(ProfContext *ctxt, GPtrArray *screens)
+{
+    guint i, n_commands;
+    gint kind;
+    ProfCommand *commands;
+    ProfScreen *screen;
+    ProfCounter *counter;
+
+    commands = g_new(ProfCommand, screens->len * PROF_KINDS);
+    n_commands = 0;
+    for (i = 0; i < screens->len; i++)
+    {
+        screen = (ProfScreen *)g_ptr_array_index(screens, i);
+        for (kind = 0; kind < PROF_KINDS; kind++)
+        {
+            if ((ctxt->kind > -1) && (kind != ctxt->kind))
+                continue;
+            if (screen->counters[kind].runs == 0)
+                continue;
+            commands[n_commands].screen = screen;
+            commands[n_commands].kind = kind;
+            n_commands++;
+        }
+    }
+
+    sort_type = ctxt->sort;
+    qsort(commands, n_commands, sizeof(ProfCommand), compare_commands);
+
+    fprintf(stdout,
+            "Commands\n"
+            "%-24s %-11s %8s %6s %10s %10s %10s %10s\n",
+            "screen", "command", "runs", "failed",
+            "mean ms", "max ms", "total s", "output KiB");
+    for (i = 0; (i < n_commands) && (i < ctxt->top); i++)
+    {
+        counter = &commands[i].screen->counters[commands[i].kind];
+        fprintf(stdout,
+                "%-24s %-11s %8lu %6lu %10.1f %10.1f %10.1f %10.1f\n",
+                commands[i].screen->screen_id,
+                kind_names[commands[i].kind],
+                (gulong)counter->runs,
+                (gulong)counter->failures,
+                (gdouble)counter->total_us / counter->runs / 1000.0,
+                (gdouble)counter->max_us / 1000.0,
+                (gdouble)counter->total_us / 1000000.0,
+                (gdouble)counter->bytes / 1024.0);
+    }
+
+    g_free(commands);
+}  /* report_commands() */
+
+
+/*
+ * static void report_screens(ProfContext *ctxt, GPtrArray *screens)
+ *
+ * Prints the screens that spend the most time in commands.
+ */
+static void report_screens(ProfContext *ctxt, GPtrArray *screens)
+{
+    guint i;
+    gint kind;
+    guint64 total, runs, failures;
+    ProfScreen *screen;
+
+    g_ptr_array_sort(screens, compare_screens);
+
+    fprintf(stdout,
+            "Screens\n"
+            "%-24s %8s %8s %6s %10s %14s\n",
+            "screen", "visits", "commands", "failed",
+            "total s", "s per visit");
+    for (i = 0; (i < screens->len) && (i < ctxt->top); i++)
+    {
+        screen = (ProfScreen *)g_ptr_array_index(screens, i);
+        total = runs = failures = 0;
+        for (kind = 0; kind < PROF_KINDS; kind++)
+        {
+            total += screen->counters[kind].total_us;
+            runs += screen->counters[kind].runs;
+            failures += screen->counters[kind].failures;
+        }
+        fprintf(stdout, "%-24s %8lu %8lu %6lu %10.1f %14.3f\n",
+                screen->screen_id,
+                (gulong)screen->visits,
+                (gulong)runs,
+                (gulong)failures,
+                (gdouble)total / 1000000.0,
+                screen->visits ?
+                (gdouble)total / screen->visits / 1000000.0 : 0.0);
+    }
+}  /* report_screens() */
+
+
+/*
+ * static void print_usage(gint rc)
+ *
+ * Prints the usage statement, then exits with the given return code.
+ */
+static void print_usage(gint rc)
+{
+    FILE *output;
+
+    output = rc ? stderr : stdout;
+
+    fprintf(output,
+            "Usage: rastaprof [--sort total|mean|max|failures|runs] [--top <count>]\n"
+            "                 [--command initcommand|listcommand|action]\n"
+            "                 [<stats_file> ...]\n");
+    exit(rc);
+}  /* print_usage() */
+
+
+/*
+ * static gint load_options(ProfContext *ctxt, gint argc, gchar *argv[])
+ *
+ * Loads all the options.
+ */
+static gint load_options(ProfContext *ctxt, gint argc, gchar *argv[])
+{
+    gint i, kind;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-')
+            break;
+        if (strcmp(argv[i], "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if ((strcmp(argv[i], "-h") == 0) ||
+            (strcmp(argv[i], "-?") == 0) ||
+            (strcmp(argv[i], "--help") == 0))
+            return(1);
+        else if (strcmp(argv[i], "--sort") == 0)
+        {
+            i++;
+            if (i >= argc)
+                return(-EINVAL);
+            if (strcmp(argv[i], "total") == 0)
+                ctxt->sort = PROF_SORT_TOTAL;
+            else if (strcmp(argv[i], "mean") == 0)
+                ctxt->sort = PROF_SORT_MEAN;
+            else if (strcmp(argv[i], "max") == 0)
+                ctxt->sort = PROF_SORT_MAX;
+            else if (strcmp(argv[i], "failures") == 0)
+                ctxt->sort = PROF_SORT_FAILURES;
+            else if (strcmp(argv[i], "runs") == 0)
+                ctxt->sort = PROF_SORT_RUNS;
+            else
+                return(-EINVAL);
+        }
+        else if (strcmp(argv[i], "--top") == 0)
+        {
+            i++;
+            if ((i >= argc) || !g_ascii_isdigit(argv[i][0]))
+                return(-EINVAL);
+            ctxt->top = (guint)strtoul(argv[i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--command") == 0)
+        {
+            i++;
+            if (i >= argc)
+                return(-EINVAL);
+            for (kind = 0; kind < PROF_KINDS; kind++)
+            {
+                if (strcmp(argv[i], kind_names[kind]) == 0)
+                    break;
+            }
+            if (kind >= PROF_KINDS)
+                return(-EINVAL);
+            ctxt->kind = kind;
+        }
+        else
+            return(-EINVAL);
+    }
+
+    if (i < argc)
+        ctxt->filenames = g_strdupv(&argv[i]);
+    else
+    {
+        ctxt->filenames = g_new0(gchar *, 2);
+        ctxt->filenames[0] = g_build_filename(g_get_home_dir(),
+                                              RASTA_PROFILE_FILE,
+                                              NULL);
+    }
+
+    return(0);
+}  /* load_options() */
+
+
+
+/*
+ * Main program
+ */
+gint main(gint argc, gchar *argv[])
+{
+    gint i, rc;
+    guint n;
+    guint64 visits;
+    ProfContext *ctxt;
+    GPtrArray *screens;
+
+    ctxt = g_new0(ProfContext, 1);
+    if (ctxt == NULL)
+    {
+        fprintf(stderr, "Unable to allocate memory\n");
+        return(-ENOMEM);
+    }
+    ctxt->top = PROF_DEFAULT_TOP;
+    ctxt->kind = -1;
+    ctxt->sort = PROF_SORT_TOTAL;
+
+    rc = load_options(ctxt, argc, argv);
+    if (rc < 0)
+        print_usage(rc);
+    else if (rc > 0)
+        print_usage(0);
+
+    ctxt->screens = g_hash_table_new(g_str_hash, g_str_equal);
+    for (i = 0; ctxt->filenames[i] != NULL; i++)
+    {
+        rc = load_file(ctxt, ctxt->filenames[i]);
+        if (rc != 0)
+            fprintf(stderr, "rastaprof: Unable to read \"%s\": %s\n",
+                    ctxt->filenames[i],
+                    (rc == -EINVAL) ? "Not a stats file" :
+                    g_strerror(-rc));
+    }
+    if (ctxt->n_files == 0)
+        return(-ENOENT);
+
+    screens = g_ptr_array_new();
+    g_hash_table_foreach(ctxt->screens, collect_screen, screens);
+
+    visits = 0;
+    for (n = 0; n < screens->len; n++)
+        visits += ((ProfScreen *)g_ptr_array_index(screens, n))->visits;
+    fprintf(stdout, "%u file(s), %u screen(s), %lu visit(s)\n\n",
+            ctxt->n_files, screens->len, (gulong)visits);
+    if (ctxt->dropped > 0)
+        fprintf(stdout,
+                "Warning: %lu sample(s) were dropped and are not counted\n\n",
+                (gulong)ctxt->dropped);
+
+    report_commands(ctxt, screens);
+    fprintf(stdout, "\n");
+    report_screens(ctxt, screens);
+
+    return(0);
+}  /* main() */